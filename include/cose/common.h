@@ -17,6 +17,33 @@
 extern "C" {
 #endif
 
+/**
+ * @name CBOR size helpers
+ *
+ * Compile time sizes of encoded CBOR items, used to size buffers for
+ * fixed-size COSE messages.
+ * @{
+ */
+
+/**
+ * @brief Size of the CBOR initial byte and argument encoding @p n
+ */
+#define COSE_CBOR_HEAD_SIZE(n)  (((n) < 24U) ? 1U : \
+                                 ((n) < 0x100U) ? 2U : \
+                                 ((n) < 0x10000U) ? 3U : \
+                                 ((uint64_t)(n) < 0x100000000ULL) ? 5U : 9U)
+
+/**
+ * @brief Size of a CBOR byte or text string with a content length of @p n
+ */
+#define COSE_CBOR_BSTR_SIZE(n)  (COSE_CBOR_HEAD_SIZE(n) + (n))
+
+/**
+ * @brief Largest of two size expressions
+ */
+#define COSE_CBOR_SIZE_MAX(a, b) (((a) > (b)) ? (a) : (b))
+/** @} */
+
 int cose_cbor_decode_get_pos(const uint8_t *start, size_t len,
                              nanocbor_value_t *arr,
                              unsigned idx);
@@ -27,6 +54,173 @@ int cose_cbor_decode_get_prot(const uint8_t *start, size_t len,
 int cose_cbor_decode_get_unprot(const uint8_t *start, size_t len,
                                 const uint8_t **unprot, size_t *unprot_len);
 
+/**
+ * @name Validating decoder
+ *
+ * The validating decode functions walk a complete COSE message once before
+ * it is accepted and reject it when it is malformed or exceeds any of the
+ * limits below. This bounds the work done on hostile input, the accessors
+ * used afterwards only operate on structures that passed these checks.
+ * @{
+ */
+
+/**
+ * @brief Work limits for the validating decoder
+ */
+typedef struct cose_decode_limits {
+    uint32_t items;         /**< Maximum number of CBOR items visited */
+    uint16_t hdrs;          /**< Maximum number of entries in a header map */
+    uint16_t map_size;      /**< Maximum number of entries in nested maps */
+    uint8_t depth;          /**< Maximum container nesting depth */
+} cose_decode_limits_t;
+
+/**
+ * @brief Validator state, tracks the work done so far
+ */
+typedef struct cose_cbor_validator {
+    const cose_decode_limits_t *limits; /**< Limits to enforce */
+    uint32_t items;                     /**< Number of items visited */
+} cose_cbor_validator_t;
+
+/**
+ * @brief Initialize decoder limits with the compile time defaults
+ *
+ * @param   limits  Limits struct to initialize
+ */
+void cose_decode_limits_init(cose_decode_limits_t *limits);
+
+/**
+ * @brief Initialize a validator
+ *
+ * @param   v       Validator to initialize
+ * @param   limits  Limits to enforce, NULL for the compile time defaults
+ */
+void cose_cbor_validator_init(cose_cbor_validator_t *v,
+                              const cose_decode_limits_t *limits);
+
+/**
+ * @brief Validate a single CBOR item, including nested items
+ *
+ * @param   v       Validator
+ * @param   it      Decoder positioned at the item, advanced past it
+ * @param   depth   Current container nesting depth
+ *
+ * @return          COSE_OK when the item is valid
+ * @return          COSE_ERR_INVALID_CBOR on malformed CBOR
+ * @return          COSE_ERR_CBOR_NOTSUP when a limit is exceeded
+ */
+int cose_cbor_validate_item(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                            unsigned depth);
+
+/**
+ * @brief Enter a definite length array with the expected number of items
+ *
+ * @param   v       Validator
+ * @param   it      Decoder positioned at the array
+ * @param   arr     Decoder for the array contents
+ * @param   min     Minimum number of items in the array
+ * @param   max     Maximum number of items in the array
+ * @param   depth   Current container nesting depth
+ *
+ * @return          COSE_OK when the array is entered
+ * @return          Negative on error
+ */
+int cose_cbor_validate_array(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                             nanocbor_value_t *arr, uint32_t min, uint32_t max,
+                             unsigned depth);
+
+/**
+ * @brief Validate the protected and unprotected headers of a COSE structure
+ *
+ * @param   v       Validator
+ * @param   arr     Decoder positioned at the protected header bstr,
+ *                  advanced past the unprotected header map
+ * @param   depth   Container nesting depth of the structure array
+ *
+ * @return          COSE_OK when both header maps are valid
+ * @return          Negative on error
+ */
+int cose_cbor_validate_headers(cose_cbor_validator_t *v, nanocbor_value_t *arr,
+                               unsigned depth);
+
+/**
+ * @brief Validate a byte string
+ *
+ * @param   v       Validator
+ * @param   it      Decoder positioned at the byte string
+ * @param   nil     Whether a nil value is accepted instead
+ *
+ * @return          COSE_OK when the item is valid
+ * @return          Negative on error
+ */
+int cose_cbor_validate_bstr(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                            bool nil);
+
+/**
+ * @brief Skip the COSE tag in front of a message
+ *
+ * @param   v       Validator
+ * @param   it      Decoder positioned at the start of the message
+ *
+ * @return          COSE_OK on success
+ * @return          Negative on error
+ */
+int cose_cbor_validate_tag(cose_cbor_validator_t *v, nanocbor_value_t *it);
+/** @} */
+
+/**
+ * @name Executor interface
+ *
+ * libcose never creates threads itself. Functions that can split their work
+ * into independent jobs hand them to an executor supplied by the
+ * application, for example backed by a thread pool.
+ * @{
+ */
+
+/**
+ * @brief Job function run by an executor
+ */
+typedef void (*cose_job_fn_t)(void *arg);
+
+/**
+ * @brief Executor running jobs concurrently
+ */
+typedef struct cose_executor {
+    /**
+     * @brief Queue a job, negative when the job can't be queued, in which
+     *        case the caller runs it directly
+     */
+    int (*submit)(void *ctx, cose_job_fn_t fn, void *arg);
+    void (*wait)(void *ctx);    /**< Block until all queued jobs are done */
+    void *ctx;                  /**< Executor context */
+} cose_executor_t;
+/** @} */
+
+/**
+ * @name Lock interface
+ *
+ * State shared between threads, such as caches, is protected by a lock
+ * supplied by the application. Without a lock the state must only be used
+ * from a single thread.
+ * @{
+ */
+
+/**
+ * @brief Mutual exclusion lock
+ */
+typedef struct cose_lock {
+    void (*lock)(void *ctx);    /**< Acquire the lock */
+    void (*unlock)(void *ctx);  /**< Release the lock */
+    void *ctx;                  /**< Lock context */
+} cose_lock_t;
+
+/**
+ * @brief Monotonic clock, in seconds for expiring cached state and in
+ *        microseconds for scheduling deadlines
+ */
+typedef uint32_t (*cose_clock_fn_t)(void *arg);
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,126 @@ extern "C" {
 #define COSE_HDR_MAX 4 /**< Default maximum number of headers in a COSE object */
 #endif /* COSE_HDR_MAX */
 
+/**
+ * @name Direct+HKDF derivation cache
+ *
+ * Size of @ref cose_hkdf_cache_t. Salts and contexts longer than the
+ * maximum are derived without caching.
+ * @{
+ */
+#ifndef COSE_HKDF_CACHE_PRKS
+#define COSE_HKDF_CACHE_PRKS        2   /**< Number of cached pseudorandom keys */
+#endif /* COSE_HKDF_CACHE_PRKS */
+
+#ifndef COSE_HKDF_CACHE_CEKS
+#define COSE_HKDF_CACHE_CEKS        4   /**< Number of cached content keys */
+#endif /* COSE_HKDF_CACHE_CEKS */
+
+#ifndef COSE_HKDF_CACHE_SALT_MAX
+#define COSE_HKDF_CACHE_SALT_MAX    32  /**< Maximum cached salt length */
+#endif /* COSE_HKDF_CACHE_SALT_MAX */
+
+#ifndef COSE_HKDF_CACHE_CONTEXT_MAX
+#define COSE_HKDF_CACHE_CONTEXT_MAX 96  /**< Maximum cached COSE_KDF_Context length */
+#endif /* COSE_HKDF_CACHE_CONTEXT_MAX */
+/** @} */
+
+/**
+ * @name Static-static ECDH secret cache
+ *
+ * Size of @ref cose_ecdh_cache_t. Secrets of keys with a longer key
+ * identifier are not cached.
+ * @{
+ */
+#ifndef COSE_ECDH_CACHE_ENTRIES
+#define COSE_ECDH_CACHE_ENTRIES     4   /**< Number of cached shared secrets */
+#endif /* COSE_ECDH_CACHE_ENTRIES */
+
+#ifndef COSE_ECDH_CACHE_KID_MAX
+#define COSE_ECDH_CACHE_KID_MAX     16  /**< Maximum cached key identifier length */
+#endif /* COSE_ECDH_CACHE_KID_MAX */
+/** @} */
+
+#ifndef COSE_KEY_GEN_JOBS_MAX
+#define COSE_KEY_GEN_JOBS_MAX   8 /**< Maximum number of jobs a bulk key generation is split into */
+#endif /* COSE_KEY_GEN_JOBS_MAX */
+
+/**
+ * @name Verification scheduler
+ *
+ * Defaults of @ref cose_sign_sched_cfg_t
+ * @{
+ */
+#ifndef COSE_SIGN_SCHED_BATCH
+#define COSE_SIGN_SCHED_BATCH       64  /**< Maximum number of requests in a batch */
+#endif /* COSE_SIGN_SCHED_BATCH */
+
+#ifndef COSE_SIGN_SCHED_DEADLINE
+#define COSE_SIGN_SCHED_DEADLINE    200 /**< Maximum queueing time of a request in microseconds */
+#endif /* COSE_SIGN_SCHED_DEADLINE */
+
+#ifndef COSE_SIGN_SCHED_JOBS_MAX
+#define COSE_SIGN_SCHED_JOBS_MAX    8   /**< Maximum number of jobs a batch is split into */
+#endif /* COSE_SIGN_SCHED_JOBS_MAX */
+/** @} */
+
+/**
+ * @brief Size of a @ref cose_replay_window_t in sequence numbers
+ *
+ * A multiple of 32 from 64 up to 1024.
+ */
+#ifndef COSE_REPLAY_WINDOW
+#define COSE_REPLAY_WINDOW          256
+#endif /* COSE_REPLAY_WINDOW */
+
+/**
+ * @brief Compact memory layout
+ *
+ * Define COSE_COMPACT_LAYOUT to shrink the structs kept per message: header
+ * lengths and types are narrowed and the recipients of an encrypt object
+ * are stored out of line, see @ref cose_encrypt_set_recipients. Disabled by
+ * default.
+ */
+#ifdef DOXYGEN
+#define COSE_COMPACT_LAYOUT
+#endif
+
+/**
+ * @brief Deterministic ECDSA
+ *
+ * Define COSE_ECDSA_DETERMINISTIC to derive the ECDSA nonce from the private
+ * key and the message hash as specified in RFC 6979 instead of drawing it
+ * from the random number generator. ECDSA signing then never waits on the
+ * RNG. Disabled by default.
+ */
+#ifdef DOXYGEN
+#define COSE_ECDSA_DETERMINISTIC
+#endif
+
+/**
+ * @name Validating decoder limits
+ *
+ * Defaults for @ref cose_decode_limits_t, used by the validating decode
+ * functions when no explicit limits are passed.
+ * @{
+ */
+#ifndef COSE_DECODE_DEPTH_MAX
+#define COSE_DECODE_DEPTH_MAX   8   /**< Maximum CBOR container nesting depth */
+#endif /* COSE_DECODE_DEPTH_MAX */
+
+#ifndef COSE_DECODE_HDRS_MAX
+#define COSE_DECODE_HDRS_MAX    16  /**< Maximum entries in a single header map */
+#endif /* COSE_DECODE_HDRS_MAX */
+
+#ifndef COSE_DECODE_MAP_MAX
+#define COSE_DECODE_MAP_MAX     16  /**< Maximum entries in a map inside a header value */
+#endif /* COSE_DECODE_MAP_MAX */
+
+#ifndef COSE_DECODE_ITEMS_MAX
+#define COSE_DECODE_ITEMS_MAX   256 /**< Maximum CBOR items visited per message */
+#endif /* COSE_DECODE_ITEMS_MAX */
+/** @} */
+
 #ifndef COSE_MSGSIZE_MAX
 #define COSE_MSGSIZE_MAX    512 /**< Maximum payload in a COSE object */
 #endif /* COSE_MSGSIZE_MAX */
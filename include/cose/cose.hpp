@@ -0,0 +1,797 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_cxx C++20 wrapper
+ * @ingroup     cose
+ *
+ * Header-only C++20 layer over the sign and encrypt decode API.
+ *
+ * Buffers are passed as std::span, the caller keeps owning all memory and
+ * no heap allocation is done. The constexpr size helpers mirror the C size
+ * macros, so the output of a fixed-size message fits a std::array sized at
+ * compile time:
+ *
+ *     std::array<uint8_t, cose::sign1_buffer_size(COSE_ALGO_EDDSA, 12, 4)> buf;
+ *     cose::sign_encoder<> sign;
+ *     sign.set_payload(payload);
+ *     sign.add_signer(key);
+ *     std::span<const uint8_t> msg = sign.encode(buf);
+ *
+ * Errors of the C API are thrown as @ref cose::error. Message objects are
+ * move-only views: they reference the payload, keys and input buffers
+ * passed to them, which must outlive the object.
+ *
+ * Signing, verification and decryption are also available as coroutine
+ * awaitables that run only the crypto operation on an executor:
+ *
+ *     std::span<const uint8_t> msg = co_await sign.async_encode(pool, buf);
+ *     bool valid = co_await cose::sign_decoder(msg).async_verify(pool, pub, scratch);
+ * @{
+ *
+ * @file
+ * @brief       C++20 wrapper definitions
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_COSE_HPP
+#define COSE_COSE_HPP
+
+#if __cplusplus < 202002L
+#error "cose/cose.hpp requires C++20"
+#endif
+
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+
+#include "cose.h"
+#include "cose/crypto.h"
+
+namespace cose {
+
+/**
+ * @brief Error code returned by the C API
+ */
+class error : public std::exception {
+public:
+    explicit error(int code) noexcept : _code(code) {}
+
+    /** @brief The COSE_ERR_* code */
+    int code() const noexcept { return _code; }
+
+    const char *what() const noexcept override
+    {
+        switch (_code) {
+            case COSE_ERR_NOMEM:
+                return "cose: buffer too small";
+            case COSE_ERR_CRYPTO:
+                return "cose: crypto operation failed";
+            case COSE_ERR_INVALID_CBOR:
+                return "cose: invalid CBOR";
+            case COSE_ERR_CBOR_NOTSUP:
+                return "cose: unsupported CBOR";
+            case COSE_ERR_INVALID_PARAM:
+                return "cose: invalid parameter";
+            case COSE_ERR_NOT_FOUND:
+                return "cose: not found";
+            case COSE_ERR_NOTIMPLEMENTED:
+                return "cose: algorithm not implemented";
+            default:
+                return "cose: error";
+        }
+    }
+
+private:
+    int _code;
+};
+
+/**
+ * @name Compile time sizes
+ * @{
+ */
+
+/** @brief Size of a CBOR head with argument @p n, see COSE_CBOR_HEAD_SIZE */
+constexpr size_t cbor_head_size(uint64_t n)
+{
+    return COSE_CBOR_HEAD_SIZE(n);
+}
+
+/** @brief Size of a CBOR byte string of @p n bytes */
+constexpr size_t cbor_bstr_size(size_t n)
+{
+    return COSE_CBOR_BSTR_SIZE(n);
+}
+
+/**
+ * @brief Signature size of a signature algorithm, 0 when it depends on the
+ *        key or the algorithm is not a signature algorithm
+ */
+constexpr size_t signature_size(cose_algo_t algo)
+{
+    switch (algo) {
+        case COSE_ALGO_EDDSA:
+            return COSE_CRYPTO_SIGN_ED25519_SIGNBYTES;
+        case COSE_ALGO_ES256:
+            return COSE_CRYPTO_SIGN_P256_SIGNBYTES;
+        case COSE_ALGO_ES384:
+            return COSE_CRYPTO_SIGN_P384_SIGNBYTES;
+        case COSE_ALGO_ES512:
+            return COSE_CRYPTO_SIGN_P521_SIGNBYTES;
+        default:
+            return 0;
+    }
+}
+
+/** @brief Size of the protected header map holding only the algorithm */
+constexpr size_t algo_prot_size(cose_algo_t algo)
+{
+    int32_t value = static_cast<int32_t>(algo);
+    uint64_t arg = value < 0 ? static_cast<uint64_t>(-1 - value)
+                             : static_cast<uint64_t>(value);
+    return cbor_head_size(1) + cbor_head_size(COSE_HDR_ALG) +
+           cbor_head_size(arg);
+}
+
+/** @brief Size of the unprotected header map holding only a key ID */
+constexpr size_t kid_unprot_size(size_t kid_len)
+{
+    return kid_len ? cbor_head_size(1) + cbor_head_size(COSE_HDR_KID) +
+                     cbor_bstr_size(kid_len)
+                   : cbor_head_size(0);
+}
+
+/**
+ * @brief Buffer size for @ref sign_encoder::encode of a COSE sign1 object
+ *        signed with @p algo, see COSE_SIGN1_ENCODE_BUFSIZE
+ */
+constexpr size_t sign1_buffer_size(cose_algo_t algo, size_t payload,
+                                   size_t kid_len = 0, size_t aad = 0)
+{
+    return COSE_SIGN1_ENCODE_BUFSIZE(algo_prot_size(algo),
+                                     kid_unprot_size(kid_len), aad, payload,
+                                     signature_size(algo));
+}
+
+/**
+ * @brief Scratch size for @ref sign_decoder::verify of a COSE sign1 object
+ *        signed with @p algo, see COSE_SIGN1_TBS_SIZE
+ */
+constexpr size_t sign1_verify_size(cose_algo_t algo, size_t payload,
+                                   size_t aad = 0)
+{
+    return COSE_SIGN1_TBS_SIZE(algo_prot_size(algo), aad, payload);
+}
+/** @} */
+
+/**
+ * @name Coroutine support
+ *
+ * The async members build the to be signed or decrypted structures in the
+ * awaiting coroutine and hand only the crypto operation to an executor,
+ * using the split-phase C calls. The coroutine resumes on the thread that
+ * ran the operation. The awaitables allocate nothing; the message object,
+ * buffers, keys and executor must stay valid until the co_await completes.
+ * @{
+ */
+
+/**
+ * @brief Executor accepting jobs, with the submit contract of
+ *        cose_executor_t
+ *
+ * submit returns negative when the job can't be queued, the awaiting
+ * coroutine then runs it directly without suspending.
+ */
+template <typename E>
+concept executor = requires(E &exec, cose_job_fn_t fn, void *arg) {
+    { exec.submit(fn, arg) } -> std::convertible_to<int>;
+};
+
+/**
+ * @brief Executor running every job directly in the awaiting coroutine
+ */
+struct inline_executor {
+    int submit(cose_job_fn_t, void *) const noexcept { return -1; }
+};
+
+/**
+ * @brief Executor adapter for a C executor, its wait callback is not used
+ */
+class executor_ref {
+public:
+    explicit executor_ref(const cose_executor_t &exec) noexcept : _exec(&exec)
+    {}
+
+    int submit(cose_job_fn_t fn, void *arg) const
+    {
+        return _exec->submit(_exec->ctx, fn, arg);
+    }
+
+private:
+    const cose_executor_t *_exec;
+};
+
+namespace detail {
+
+/**
+ * @brief Awaitable base running the crypto step of @p Derived on an
+ *        executor
+ *
+ * Derived classes run the preparation in their constructor, store its
+ * error in _res and provide run() for the crypto step. The awaiting
+ * coroutine is not suspended when the preparation failed.
+ */
+template <executor Executor, typename Derived>
+class offload {
+public:
+    offload(const offload &) = delete;
+    offload &operator=(const offload &) = delete;
+
+    bool await_ready() const noexcept { return _res != COSE_OK; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        _handle = handle;
+        if (_exec.submit(&offload::_job, this) < 0) {
+            static_cast<Derived *>(this)->run();
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    explicit offload(Executor &exec) noexcept : _exec(exec) {}
+
+    int _res = COSE_OK;
+
+private:
+    static void _job(void *arg)
+    {
+        auto *self = static_cast<offload *>(arg);
+        static_cast<Derived *>(self)->run();
+        self->_handle.resume();
+    }
+
+    Executor &_exec;
+    std::coroutine_handle<> _handle;
+};
+
+} /* namespace detail */
+/** @} */
+
+/**
+ * @brief Signing or verification key
+ *
+ * A view on key material owned by the caller.
+ */
+class key {
+public:
+    key() noexcept { cose_key_init(&_key); }
+
+    /**
+     * @brief Key from its coordinates and private part
+     *
+     * @param   curve   Curve of the key
+     * @param   algo    Algorithm of the key
+     * @param   x       x coordinate or public key
+     * @param   y       y coordinate, empty for OKP keys
+     * @param   d       Private part, empty for a public key
+     */
+    key(cose_curve_t curve, cose_algo_t algo, std::span<uint8_t> x,
+        std::span<uint8_t> y = {}, std::span<uint8_t> d = {}) noexcept
+        : key()
+    {
+        cose_key_set_keys(&_key, curve, algo, x.data(),
+                          y.empty() ? nullptr : y.data(),
+                          d.empty() ? nullptr : d.data());
+    }
+
+    /**
+     * @brief Symmetric key
+     *
+     * @param   algo    Algorithm of the key
+     * @param   secret  Key material
+     */
+    key(cose_algo_t algo, std::span<uint8_t> secret) noexcept : key()
+    {
+        cose_key_set_keys(&_key, COSE_EC_NONE, algo, nullptr, nullptr,
+                          secret.data());
+    }
+
+    /** @brief Set the key ID, referenced by the key */
+    void set_kid(std::span<const uint8_t> kid) noexcept
+    {
+        /* The key ID is only read */
+        cose_key_set_kid(&_key, const_cast<uint8_t *>(kid.data()), kid.size());
+    }
+
+    /** @brief The underlying C key */
+    cose_key_t *get() noexcept { return &_key; }
+    const cose_key_t *get() const noexcept { return &_key; }
+
+private:
+    cose_key_t _key;
+};
+
+/**
+ * @brief COSE sign and sign1 encoder for up to @p MaxSigners signers
+ *
+ * The C structures are set up on every encode, which keeps the encoder
+ * movable although the C signer list is linked through pointers.
+ */
+template <size_t MaxSigners = 1>
+class sign_encoder {
+    static_assert(MaxSigners > 0, "At least one signer is required");
+
+public:
+    explicit sign_encoder(uint16_t flags = 0) noexcept : _flags(flags) {}
+
+    sign_encoder(const sign_encoder &) = delete;
+    sign_encoder &operator=(const sign_encoder &) = delete;
+    sign_encoder(sign_encoder &&) noexcept = default;
+    sign_encoder &operator=(sign_encoder &&) noexcept = default;
+
+    /** @brief Set the payload, referenced by the encoder */
+    void set_payload(std::span<const uint8_t> payload) noexcept
+    {
+        _payload = payload;
+    }
+
+    /** @brief Set the external additional authenticated data */
+    void set_external_aad(std::span<const uint8_t> aad) noexcept
+    {
+        _aad = aad;
+    }
+
+    /** @brief Add a signer, referenced by the encoder */
+    void add_signer(const key &signer)
+    {
+        if (_num == MaxSigners) {
+            throw error(COSE_ERR_NOMEM);
+        }
+        _signers[_num++] = &signer;
+    }
+
+    /**
+     * @brief Sign and encode the message
+     *
+     * @param   buf     Scratch and output buffer, see @ref sign1_buffer_size
+     *
+     * @return          The encoded message, inside @p buf
+     */
+    std::span<const uint8_t> encode(std::span<uint8_t> buf) const
+    {
+        cose_sign_enc_t sign;
+        std::array<cose_signature_t, MaxSigners> signatures;
+        uint8_t *out = nullptr;
+
+        cose_sign_init(&sign, _flags);
+        cose_sign_set_payload(&sign, _payload.data(), _payload.size());
+        cose_sign_set_external_aad(&sign, _aad.data(), _aad.size());
+        for (size_t i = 0; i < _num; i++) {
+            cose_signature_init(&signatures[i]);
+            cose_sign_add_signer(&sign, &signatures[i], _signers[i]->get());
+        }
+        COSE_ssize_t res = cose_sign_encode(&sign, buf.data(), buf.size(),
+                                            &out);
+        if (res < 0) {
+            throw error(static_cast<int>(res));
+        }
+        return { out, static_cast<size_t>(res) };
+    }
+
+    /**
+     * @brief Awaitable of @ref async_encode, resumes with the encoded message
+     */
+    template <executor Executor>
+    class encode_awaitable
+        : public detail::offload<Executor, encode_awaitable<Executor>> {
+        using base = detail::offload<Executor, encode_awaitable<Executor>>;
+        friend base;
+
+    public:
+        encode_awaitable(const sign_encoder &enc, Executor &exec,
+                         std::span<uint8_t> buf)
+            : base(exec), _buf(buf)
+        {
+            cose_sign_init(&_sign, enc._flags);
+            cose_sign_set_payload(&_sign, enc._payload.data(),
+                                  enc._payload.size());
+            cose_sign_set_external_aad(&_sign, enc._aad.data(),
+                                       enc._aad.size());
+            for (size_t i = 0; i < enc._num; i++) {
+                cose_signature_init(&_signatures[i]);
+                cose_sign_add_signer(&_sign, &_signatures[i],
+                                     enc._signers[i]->get());
+            }
+            _num = enc._num;
+            this->_res = _prepare();
+        }
+
+        std::span<const uint8_t> await_resume()
+        {
+            if (this->_res != COSE_OK) {
+                throw error(this->_res);
+            }
+            for (size_t i = 0; i < _num; i++) {
+                cose_signature_set_signature(&_signatures[i], _sig[i].data(),
+                                             _sig_len[i]);
+            }
+            uint8_t *out = nullptr;
+            COSE_ssize_t res = cose_sign_encode_signed(&_sign, _rest.data(),
+                                                       _rest.size(), &out);
+            if (res < 0) {
+                throw error(static_cast<int>(res));
+            }
+            return { out, static_cast<size_t>(res) };
+        }
+
+    private:
+        /* Signatures first, the Sig_structures of all signers behind them */
+        int _prepare()
+        {
+            std::span<uint8_t> avail = _buf;
+            for (size_t i = 0; i < _num; i++) {
+                size_t size = cose_crypto_sig_size(_signatures[i].signer);
+                if (size > avail.size()) {
+                    return COSE_ERR_NOMEM;
+                }
+                _sig[i] = avail.first(size);
+                avail = avail.subspan(size);
+            }
+            _rest = avail;
+            for (size_t i = 0; i < _num; i++) {
+                COSE_ssize_t len = cose_sign_encode_tbs(&_sign,
+                                                        &_signatures[i],
+                                                        avail.data(),
+                                                        avail.size());
+                if (len < 0) {
+                    return static_cast<int>(len);
+                }
+                _tbs[i] = avail.first(static_cast<size_t>(len));
+                avail = avail.subspan(static_cast<size_t>(len));
+            }
+            return COSE_OK;
+        }
+
+        void run()
+        {
+            for (size_t i = 0; i < _num && this->_res == COSE_OK; i++) {
+                this->_res = cose_crypto_sign(_signatures[i].signer,
+                                              _sig[i].data(), &_sig_len[i],
+                                              _tbs[i].data(), _tbs[i].size());
+            }
+        }
+
+        std::span<uint8_t> _buf;
+        std::span<uint8_t> _rest;
+        cose_sign_enc_t _sign;
+        std::array<cose_signature_t, MaxSigners> _signatures;
+        std::array<std::span<uint8_t>, MaxSigners> _sig{};
+        std::array<std::span<uint8_t>, MaxSigners> _tbs{};
+        std::array<size_t, MaxSigners> _sig_len{};
+        size_t _num = 0;
+    };
+
+    /**
+     * @brief Sign and encode the message, signing on an executor
+     *
+     * The Sig_structures of all signers are placed side by side behind the
+     * signatures, a single signer needs the same buffer as @ref encode.
+     *
+     * @param   exec    Executor to sign on
+     * @param   buf     Scratch and output buffer
+     *
+     * @return          Awaitable resuming with the encoded message
+     */
+    template <executor Executor>
+    encode_awaitable<Executor> async_encode(Executor &exec,
+                                            std::span<uint8_t> buf) const
+    {
+        return { *this, exec, buf };
+    }
+
+private:
+    uint16_t _flags;
+    std::span<const uint8_t> _payload;
+    std::span<const uint8_t> _aad;
+    std::array<const key *, MaxSigners> _signers{};
+    size_t _num = 0;
+};
+
+/**
+ * @brief Decoded COSE sign or sign1 object, a view on the encoded message
+ */
+class sign_decoder {
+public:
+    /**
+     * @brief Decode and validate a message
+     *
+     * @param   msg     Encoded message, referenced by the decoder
+     * @param   limits  Decoder work limits, NULL for the defaults
+     */
+    explicit sign_decoder(std::span<const uint8_t> msg,
+                          const cose_decode_limits_t *limits = nullptr)
+    {
+        int res = cose_sign_decode_validate(&_sign, msg.data(), msg.size(),
+                                            limits);
+        if (res != COSE_OK) {
+            throw error(res);
+        }
+    }
+
+    sign_decoder(const sign_decoder &) = delete;
+    sign_decoder &operator=(const sign_decoder &) = delete;
+    sign_decoder(sign_decoder &&) noexcept = default;
+    sign_decoder &operator=(sign_decoder &&) noexcept = default;
+
+    /** @brief The payload of the message */
+    std::span<const uint8_t> payload() const noexcept
+    {
+        return { static_cast<const uint8_t *>(_sign.payload),
+                 _sign.payload_len };
+    }
+
+    /** @brief Set the payload of a message with a detached payload */
+    void set_payload(std::span<const uint8_t> payload) noexcept
+    {
+        cose_sign_decode_set_payload(&_sign, payload.data(), payload.size());
+    }
+
+    /**
+     * @brief Verify the first signature of the message
+     *
+     * @param   signer  Key to verify with
+     * @param   scratch Buffer for the Sig_structure, see
+     *                  @ref sign1_verify_size
+     *
+     * @return          true when the signature is valid
+     */
+    bool verify(key &signer, std::span<uint8_t> scratch) const
+    {
+        int res = cose_sign_verify_first(&_sign, signer.get(), scratch.data(),
+                                         scratch.size());
+        if (res == COSE_OK) {
+            return true;
+        }
+        if (res == COSE_ERR_CRYPTO) {
+            return false;
+        }
+        throw error(res);
+    }
+
+    /**
+     * @brief Awaitable of @ref async_verify, resumes with the verification
+     *        result
+     */
+    template <executor Executor>
+    class verify_awaitable
+        : public detail::offload<Executor, verify_awaitable<Executor>> {
+        using base = detail::offload<Executor, verify_awaitable<Executor>>;
+        friend base;
+
+    public:
+        verify_awaitable(const sign_decoder &dec, Executor &exec,
+                         const key &signer, std::span<uint8_t> scratch)
+            : base(exec), _signer(signer)
+        {
+            this->_res = _prepare(dec, scratch);
+        }
+
+        bool await_resume() const
+        {
+            if (this->_res == COSE_OK) {
+                return true;
+            }
+            if (this->_res == COSE_ERR_CRYPTO) {
+                return false;
+            }
+            throw error(this->_res);
+        }
+
+    private:
+        int _prepare(const sign_decoder &dec, std::span<uint8_t> scratch)
+        {
+            cose_signature_dec_t signature;
+            cose_signature_decode_init(&signature, nullptr, 0);
+            if (!cose_sign_signature_iter(&dec._sign, &signature)) {
+                return COSE_ERR_INVALID_CBOR;
+            }
+            COSE_ssize_t len = cose_sign_verify_tbs(&dec._sign, &signature,
+                                                    scratch.data(),
+                                                    scratch.size());
+            if (len < 0) {
+                return static_cast<int>(len);
+            }
+            _tbs = scratch.first(static_cast<size_t>(len));
+            return cose_sign_decode_signature(&dec._sign, &signature,
+                                              &_sig, &_sig_len);
+        }
+
+        void run()
+        {
+            if (cose_crypto_verify(_signer.get(), _sig, _sig_len,
+                                   _tbs.data(), _tbs.size()) < 0) {
+                this->_res = COSE_ERR_CRYPTO;
+            }
+        }
+
+        const key &_signer;
+        std::span<uint8_t> _tbs;
+        const uint8_t *_sig = nullptr;
+        size_t _sig_len = 0;
+    };
+
+    /**
+     * @brief Verify the first signature of the message on an executor
+     *
+     * @param   exec    Executor to verify on
+     * @param   signer  Key to verify with
+     * @param   scratch Buffer for the Sig_structure, see
+     *                  @ref sign1_verify_size
+     *
+     * @return          Awaitable resuming with true when the signature is
+     *                  valid
+     */
+    template <executor Executor>
+    verify_awaitable<Executor> async_verify(Executor &exec, const key &signer,
+                                            std::span<uint8_t> scratch) const
+    {
+        return { *this, exec, signer, scratch };
+    }
+
+    /** @brief The underlying C decoder */
+    const cose_sign_dec_t *get() const noexcept { return &_sign; }
+
+private:
+    cose_sign_dec_t _sign;
+};
+
+/**
+ * @brief Decoded COSE encrypt or encrypt0 object, a view on the encoded
+ *        message
+ */
+class encrypt_decoder {
+public:
+    /**
+     * @brief Decode and validate a message
+     *
+     * @param   msg     Encoded message, referenced by the decoder
+     * @param   limits  Decoder work limits, NULL for the defaults
+     */
+    explicit encrypt_decoder(std::span<const uint8_t> msg,
+                             const cose_decode_limits_t *limits = nullptr)
+    {
+        /* The message is only read */
+        int res = cose_encrypt_decode_validate(&_encrypt,
+                                               const_cast<uint8_t *>(msg.data()),
+                                               msg.size(), limits);
+        if (res != COSE_OK) {
+            throw error(res);
+        }
+    }
+
+    encrypt_decoder(const encrypt_decoder &) = delete;
+    encrypt_decoder &operator=(const encrypt_decoder &) = delete;
+    encrypt_decoder(encrypt_decoder &&) noexcept = default;
+    encrypt_decoder &operator=(encrypt_decoder &&) noexcept = default;
+
+    /**
+     * @brief Decrypt the message for its first recipient
+     *
+     * @param   k       Key to decrypt with
+     * @param   scratch Buffer for the Enc_structure and derived keys
+     * @param   out     Buffer for the plaintext
+     *
+     * @return          The plaintext, inside @p out
+     */
+    std::span<const uint8_t> decrypt(const key &k, std::span<uint8_t> scratch,
+                                     std::span<uint8_t> out) const
+    {
+        cose_encrypt_aead_t aead;
+        size_t len = 0;
+        int res = _prepare(k, scratch, out, &aead);
+        if (res == COSE_OK) {
+            res = cose_encrypt_decrypt_aead(&aead, out.data(), &len);
+        }
+        if (res != COSE_OK) {
+            throw error(res);
+        }
+        return out.first(len);
+    }
+
+    /**
+     * @brief Awaitable of @ref async_decrypt, resumes with the plaintext
+     */
+    template <executor Executor>
+    class decrypt_awaitable
+        : public detail::offload<Executor, decrypt_awaitable<Executor>> {
+        using base = detail::offload<Executor, decrypt_awaitable<Executor>>;
+        friend base;
+
+    public:
+        decrypt_awaitable(const encrypt_decoder &dec, Executor &exec,
+                          const key &k, std::span<uint8_t> scratch,
+                          std::span<uint8_t> out)
+            : base(exec), _out(out)
+        {
+            this->_res = dec._prepare(k, scratch, out, &_aead);
+        }
+
+        std::span<const uint8_t> await_resume() const
+        {
+            if (this->_res != COSE_OK) {
+                throw error(this->_res);
+            }
+            return _out.first(_len);
+        }
+
+    private:
+        void run()
+        {
+            this->_res = cose_encrypt_decrypt_aead(&_aead, _out.data(),
+                                                   &_len);
+        }
+
+        std::span<uint8_t> _out;
+        cose_encrypt_aead_t _aead;
+        size_t _len = 0;
+    };
+
+    /**
+     * @brief Decrypt the message for its first recipient on an executor
+     *
+     * @param   exec    Executor to run the AEAD decryption on
+     * @param   k       Key to decrypt with
+     * @param   scratch Buffer for the Enc_structure and derived keys
+     * @param   out     Buffer for the plaintext
+     *
+     * @return          Awaitable resuming with the plaintext
+     */
+    template <executor Executor>
+    decrypt_awaitable<Executor> async_decrypt(Executor &exec, const key &k,
+                                              std::span<uint8_t> scratch,
+                                              std::span<uint8_t> out) const
+    {
+        return { *this, exec, k, scratch, out };
+    }
+
+    /** @brief The underlying C decoder */
+    const cose_encrypt_dec_t *get() const noexcept { return &_encrypt; }
+
+private:
+    int _prepare(const key &k, std::span<uint8_t> scratch,
+                 std::span<uint8_t> out, cose_encrypt_aead_t *aead) const
+    {
+        cose_recp_dec_t recp;
+        cose_recp_decode_init(&recp, nullptr, 0);
+        bool has_recp = cose_encrypt_recp_iter(&_encrypt, &recp);
+        int res = cose_encrypt_decrypt_prepare(&_encrypt,
+                                               has_recp ? &recp : nullptr,
+                                               k.get(), scratch.data(),
+                                               scratch.size(), aead);
+        if (res == COSE_OK &&
+                aead->ciphertext_len > out.size() + aead->desc->tag_len) {
+            return COSE_ERR_NOMEM;
+        }
+        return res;
+    }
+
+    cose_encrypt_dec_t _encrypt;
+};
+
+} /* namespace cose */
+
+#endif
+
+/** @} */
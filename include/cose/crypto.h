@@ -47,6 +47,21 @@
 #if defined(CRYPTO_TINYCRYPT)
 #include "cose/crypto/tinycrypt.h"
 #endif
+#if defined(CRYPTO_AES)
+#include "cose/crypto/aes.h"
+#endif
+#if defined(CRYPTO_CHACHAPOLY)
+#include "cose/crypto/chachapoly.h"
+#endif
+#if defined(CRYPTO_PSA)
+#include "cose/crypto/psa.h"
+#endif
+#if defined(CRYPTO_OPENSSL)
+#include "cose/crypto/openssl.h"
+#endif
+#if defined(CRYPTO_SIGND)
+#include "cose/crypto/signd.h"
+#endif
 
 #include "cose/crypto/selectors.h"
 
@@ -119,6 +134,23 @@ extern "C" {
  */
 #define COSE_CRYPTO_SIGN_P521_SIGNBYTES                 132U
 
+/**
+ * @brief Smallest accepted RSA modulus size, 2048 bit as required by RFC 8230
+ */
+#define COSE_CRYPTO_SIGN_RSA_MINBYTES                   256U
+
+/**
+ * @brief Largest supported RSA modulus and signature size, 4096 bit
+ */
+#define COSE_CRYPTO_SIGN_RSA_MAXBYTES                   512U
+
+#ifndef COSE_CRYPTO_EC2_KEYBYTES
+/**
+ * @brief Size of the EC2 key buffers of the ECDSA backend
+ */
+#define COSE_CRYPTO_EC2_KEYBYTES                        COSE_CRYPTO_SIGN_P521_PUBLICKEYBYTES
+#endif
+
 /**
  * @brief ChaCha20Poly1305 key size
  */
@@ -192,9 +224,121 @@ extern "C" {
 typedef int (*cose_crypt_rng)(void *, unsigned char *, size_t);
 void cose_crypt_set_rng(cose_crypt_rng f_rng, void *p_rng);
 
+/**
+ * @name Algorithm descriptors
+ *
+ * Every algorithm known to libcose is described by a constant descriptor
+ * with its parameters and the functions of the selected crypto backend.
+ * The descriptor is looked up once per message, after which the parameters
+ * and the implementation are available without further dispatching.
+ * @{
+ */
+
+/**
+ * @brief Algorithm classes
+ */
+typedef enum {
+    COSE_CRYPTO_ALGO_AEAD,      /**< Authenticated encryption */
+    COSE_CRYPTO_ALGO_SIGN,      /**< Digital signature */
+    COSE_CRYPTO_ALGO_KDF,       /**< Key derivation */
+} cose_crypto_algo_class_t;
+
+/**
+ * @brief Hash functions used by the signature and key derivation algorithms
+ */
+typedef enum {
+    COSE_CRYPTO_HASH_NONE,      /**< No separate hash function */
+    COSE_CRYPTO_HASH_SHA256,    /**< SHA-256 */
+    COSE_CRYPTO_HASH_SHA384,    /**< SHA-384 */
+    COSE_CRYPTO_HASH_SHA512,    /**< SHA-512 */
+} cose_crypto_hash_t;
+
+/**
+ * @brief AEAD encryption function of a descriptor
+ */
+typedef int (*cose_crypto_aead_encrypt_fn_t)(uint8_t *c, size_t *clen,
+                                             const uint8_t *msg, size_t msglen,
+                                             const uint8_t *aad, size_t aadlen,
+                                             const uint8_t *npub,
+                                             const uint8_t *key,
+                                             cose_algo_t algo);
+
+/**
+ * @brief AEAD decryption function of a descriptor
+ */
+typedef int (*cose_crypto_aead_decrypt_fn_t)(uint8_t *msg, size_t *msglen,
+                                             const uint8_t *c, size_t clen,
+                                             const uint8_t *aad, size_t aadlen,
+                                             const uint8_t *npub,
+                                             const uint8_t *key,
+                                             cose_algo_t algo);
+
+/**
+ * @brief Symmetric key generation function of a descriptor
+ */
+typedef COSE_ssize_t (*cose_crypto_keygen_fn_t)(uint8_t *buf, size_t len,
+                                                cose_algo_t algo);
+
+/**
+ * @brief Signing function of a descriptor
+ */
+typedef int (*cose_crypto_sign_fn_t)(const cose_key_t *key, uint8_t *sign,
+                                     size_t *signlen, uint8_t *msg,
+                                     size_t msglen);
+
+/**
+ * @brief Signature verification function of a descriptor
+ */
+typedef int (*cose_crypto_verify_fn_t)(const cose_key_t *key,
+                                       const uint8_t *sign, size_t signlen,
+                                       uint8_t *msg, size_t msglen);
+
+/**
+ * @brief Algorithm descriptor
+ *
+ * Function pointers are NULL when the configured backends do not implement
+ * the algorithm.
+ */
+typedef struct cose_crypto_algo {
+    cose_algo_t algo;                       /**< COSE algorithm identifier */
+    cose_crypto_algo_class_t cls;           /**< Algorithm class */
+    cose_kty_t kty;                         /**< Key type used with the algorithm,
+                                                 EC2 for key agreement with
+                                                 EC2 and OKP keys */
+    cose_crypto_hash_t hash;                /**< Hash function of signature and
+                                                 key derivation algorithms */
+    uint8_t key_len;                        /**< Symmetric key length in bytes */
+    uint8_t nonce_len;                      /**< AEAD nonce length in bytes */
+    uint8_t tag_len;                        /**< AEAD tag length in bytes */
+    uint16_t sig_len;                       /**< Signature length, for ECDSA the
+                                                 length with the matching curve,
+                                                 for RSA the largest length */
+    cose_crypto_aead_encrypt_fn_t encrypt;  /**< AEAD encryption */
+    cose_crypto_aead_decrypt_fn_t decrypt;  /**< AEAD decryption */
+    cose_crypto_keygen_fn_t keygen;         /**< Backend key generation, NULL
+                                                 to use the random generator */
+    cose_crypto_sign_fn_t sign;             /**< Signing */
+    cose_crypto_verify_fn_t verify;         /**< Signature verification */
+} cose_crypto_algo_t;
+
+/**
+ * @brief Look up the descriptor of an algorithm
+ *
+ * @param   algo    COSE algorithm identifier
+ *
+ * @return          The descriptor
+ * @return          NULL when the algorithm is unknown
+ */
+const cose_crypto_algo_t *cose_crypto_algo_get(cose_algo_t algo);
+
+/** @} */
+
 /**
  * Generated a key suitable for the requisted algo
  *
+ * Algorithms without a backend specific key generation use the random
+ * generator configured with @ref cose_crypt_set_rng.
+ *
  * @param[out]      buf     Buffer to fill
  * @param           len     Size of the buffer
  * @param           algo    Algorithm to get the key for
@@ -204,6 +348,150 @@ void cose_crypt_set_rng(cose_crypt_rng f_rng, void *p_rng);
  */
 COSE_ssize_t cose_crypto_keygen(uint8_t *buf, size_t len, cose_algo_t algo);
 
+/**
+ * @name crypto HMAC and HKDF functions
+ * @{
+ */
+
+/**
+ * @brief Maximum output size of the supported hash functions
+ */
+#define COSE_CRYPTO_HASH_MAXBYTES   64U
+
+/**
+ * @brief Message fragment passed to @ref cose_crypto_hmac
+ */
+typedef struct cose_crypto_chunk {
+    const uint8_t *buf;     /**< Fragment data */
+    size_t len;             /**< Fragment length */
+} cose_crypto_chunk_t;
+
+/**
+ * Output size of a hash function
+ *
+ * @param   hash    Hash function
+ *
+ * @return          Digest size in bytes, 0 for COSE_CRYPTO_HASH_NONE
+ */
+size_t cose_crypto_hash_len(cose_crypto_hash_t hash);
+
+/**
+ * HMAC over the concatenation of a number of message fragments, provided
+ * by the crypto backend
+ *
+ * @param       hash    Hash function
+ * @param       key     HMAC key
+ * @param       key_len Length of the key
+ * @param       msg     Message fragments
+ * @param       num     Number of fragments
+ * @param[out]  mac     Output, @ref cose_crypto_hash_len bytes
+ *
+ * @return              COSE_OK on success
+ * @return              COSE_ERR_NOTIMPLEMENTED for unsupported hash functions
+ */
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac);
+
+/**
+ * HKDF-Extract, RFC 5869
+ *
+ * @param       algo        Key derivation algorithm, e.g.
+ *                          COSE_ALGO_DIRECT_HKDF_SHA256
+ * @param       salt        Salt, NULL for the all zero default salt
+ * @param       salt_len    Length of the salt
+ * @param       ikm         Input keying material
+ * @param       ikm_len     Length of the input keying material
+ * @param[out]  prk         Pseudorandom key, digest size of the algorithm
+ *
+ * @return                  COSE_OK on success
+ * @return                  COSE_ERR_NOTIMPLEMENTED for unsupported algorithms
+ */
+int cose_crypto_hkdf_extract(cose_algo_t algo, const uint8_t *salt,
+                             size_t salt_len, const uint8_t *ikm,
+                             size_t ikm_len, uint8_t *prk);
+
+/**
+ * HKDF-Expand, RFC 5869
+ *
+ * @param       algo        Key derivation algorithm
+ * @param       prk         Pseudorandom key from @ref cose_crypto_hkdf_extract
+ * @param       info        Context information
+ * @param       info_len    Length of the context information
+ * @param[out]  okm         Output keying material
+ * @param       okm_len     Length of the output keying material
+ *
+ * @return                  COSE_OK on success
+ * @return                  COSE_ERR_INVALID_PARAM when @p okm_len is too large
+ * @return                  COSE_ERR_NOTIMPLEMENTED for unsupported algorithms
+ */
+int cose_crypto_hkdf_expand(cose_algo_t algo, const uint8_t *prk,
+                            const uint8_t *info, size_t info_len,
+                            uint8_t *okm, size_t okm_len);
+/** @} */
+
+/**
+ * @name crypto key agreement functions
+ * @{
+ */
+
+/**
+ * @brief Size of an X25519 shared secret
+ */
+#define COSE_CRYPTO_ECDH_X25519_BYTES   32U
+
+/**
+ * @brief Maximum size of an ECDH shared secret, the P-521 x-coordinate
+ */
+#define COSE_CRYPTO_ECDH_MAXBYTES       66U
+
+/**
+ * ECDH between a private key and the public key of a peer
+ *
+ * @param       key         Key with the private part
+ * @param       peer        Public key of the peer, on the same curve
+ * @param[out]  secret      Shared secret, up to @ref COSE_CRYPTO_ECDH_MAXBYTES
+ * @param[out]  secret_len  Length of the shared secret
+ *
+ * @return                  COSE_OK on success
+ * @return                  COSE_ERR_INVALID_PARAM on mismatching keys
+ * @return                  COSE_ERR_NOTIMPLEMENTED for unsupported curves
+ * @return                  COSE_ERR_CRYPTO on invalid public keys
+ */
+int cose_crypto_ecdh(const cose_key_t *key, const cose_key_t *peer,
+                     uint8_t *secret, size_t *secret_len);
+
+/**
+ * X25519 function, provided by the crypto backend
+ *
+ * @param       key     Key with the private scalar
+ * @param       peer    Public key of the peer
+ * @param[out]  secret  Shared secret, @ref COSE_CRYPTO_ECDH_X25519_BYTES
+ *
+ * @return              COSE_OK on success
+ * @return              COSE_ERR_INVALID_PARAM without a private key
+ * @return              COSE_ERR_CRYPTO on low order public keys
+ */
+int cose_crypto_ecdh_x25519(const cose_key_t *key, const cose_key_t *peer,
+                            uint8_t *secret);
+
+/**
+ * ECDH on the NIST curves, provided by the crypto backend
+ *
+ * The shared secret is the x-coordinate with the size of the curve.
+ *
+ * @param       key         Key with the private part
+ * @param       peer        Public key of the peer
+ * @param[out]  secret      Shared secret
+ * @param[out]  secret_len  Length of the shared secret
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error
+ */
+int cose_crypto_ecdh_ecp(const cose_key_t *key, const cose_key_t *peer,
+                         uint8_t *secret, size_t *secret_len);
+/** @} */
+
 /**
  * @name crypto AEAD functions
  * @{
@@ -318,6 +606,51 @@ size_t cose_crypto_sig_size(const cose_key_t *key);
 int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg,  size_t msglen);
 int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, size_t msglen);
 size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve);
+
+/**
+ * Sign a byte string with RSASSA-PSS, RFC 8230
+ *
+ * The salt length and the MGF1 hash match the hash of the key algorithm.
+ *
+ * @param       key     Prepared RSA private key
+ * @param[out]  sign    The resulting signature, @ref cose_crypto_sig_size_rsa
+ *                      bytes
+ * @param[out]  signlen The length of the signature
+ * @param       msg     The message to sign
+ * @param       msglen  The length of the message
+ *
+ * @return              COSE_OK on success
+ * @return              COSE_ERR_INVALID_PARAM without a prepared key
+ * @return              COSE_ERR_CRYPTO when signing failed
+ */
+int cose_crypto_sign_rsa_pss(const cose_key_t *key, uint8_t *sign,
+                             size_t *signlen, uint8_t *msg, size_t msglen);
+
+/**
+ * Verify an RSASSA-PSS signature, RFC 8230
+ *
+ * @param       key     Prepared RSA public or private key
+ * @param       sign    The signature
+ * @param       signlen The signature length, the size of the modulus
+ * @param       msg     The message to verify
+ * @param       msglen  The length of the message
+ *
+ * @return              COSE_OK if verification succeeded
+ * @return              COSE_ERR_INVALID_PARAM without a prepared key
+ * @return              COSE_ERR_CRYPTO on an invalid signature
+ */
+int cose_crypto_verify_rsa_pss(const cose_key_t *key, const uint8_t *sign,
+                               size_t signlen, uint8_t *msg, size_t msglen);
+
+/**
+ * Get the size of the RSA signatures of a key
+ *
+ * @param   key     Prepared RSA key
+ *
+ * @return          Size of the modulus in bytes
+ * @return          0 without a prepared key
+ */
+size_t cose_crypto_sig_size_rsa(const cose_key_t *key);
 /**
  * Sign a byte string with an ed25519 private key
  *
@@ -349,9 +682,25 @@ int cose_crypto_verify_ed25519(const cose_key_t *key, const uint8_t *sign, size_
  * @param[out]  key  key struct to fill with generated keys
  *
  * @note key->x and key->d should provide large enough buffers for the key pair
+ *
+ * @return      COSE_OK on success
+ * @return      COSE_ERR_CRYPTO when no key could be generated
+ */
+int cose_crypto_keypair_ed25519(cose_key_t *key);
+
+/**
+ * generate an ECDSA keypair on @p curve
+ *
+ * @param[out]  key     key struct to fill with generated keys
+ * @param       curve   curve to generate the key on
+ *
+ * @note key->x, key->y and key->d should provide large enough buffers for
+ *       the key pair, see @ref COSE_CRYPTO_EC2_KEYBYTES
+ *
+ * @return      COSE_OK on success
+ * @return      COSE_ERR_CRYPTO when no key could be generated
  */
-void cose_crypto_keypair_ed25519(cose_key_t *key);
-void cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve);
+int cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve);
 
 /**
  * Get the size of an ed25519 signature
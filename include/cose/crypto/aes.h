@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_crypto_aes Crypto glue layer, built-in AES definitions
+ * @ingroup     cose_crypto
+ *
+ * Built-in AES-GCM and AES-CCM implementation. Uses the AES-NI and PCLMULQDQ
+ * instructions when the CPU supports them, detected at runtime, and a
+ * portable constant-time implementation otherwise.
+ *
+ * Define `COSE_CRYPTO_AES_PORTABLE` to build only the portable
+ * implementation.
+ * @{
+ *
+ * @file
+ * @brief       Crypto function api for the built-in AES implementation.
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_CRYPTO_AES_H
+#define COSE_CRYPTO_AES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name list of provided algorithms
+ *
+ * @{
+ */
+#define HAVE_ALGO_AES128GCM /**< AES GCM mode support with 128 bit key */
+#define HAVE_ALGO_AES192GCM /**< AES GCM mode support with 192 bit key */
+#define HAVE_ALGO_AES256GCM /**< AES GCM mode support with 256 bit key */
+
+#define HAVE_ALGO_AESCCM_16_64_128  /**< AES CCM mode support with 16 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_64_128  /**< AES CCM mode support with 64 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_128_128 /**< AES CCM mode support with 16 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_128_128 /**< AES CCM mode support with 64 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_64_256  /**< AES CCM mode support with 16 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_64_256  /**< AES CCM mode support with 64 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_16_128_256 /**< AES CCM mode support with 16 bit length, 128 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_128_256 /**< AES CCM mode support with 64 bit length, 128 bit tag 256 bit key */
+/** @} */
+
+/**
+ * @brief Check whether the hardware accelerated AES implementation is used
+ *
+ * @return  true when AES-NI and PCLMULQDQ are available and in use
+ */
+bool cose_crypto_aes_accelerated(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_crypto_chachapoly Crypto glue layer, built-in ChaCha20-Poly1305 definitions
+ * @ingroup     cose_crypto
+ *
+ * Built-in ChaCha20-Poly1305 implementation. Uses SSE2, AVX2 or AVX-512 on
+ * x86-64, selected at runtime, NEON on AArch64 and portable C otherwise.
+ * Takes precedence over the ChaCha20-Poly1305 implementation of other
+ * backends, so it can be combined with any of them.
+ *
+ * Define `COSE_CRYPTO_CHACHAPOLY_PORTABLE` to build only the portable
+ * implementation.
+ * @{
+ *
+ * @file
+ * @brief       Crypto function api for the built-in ChaCha20-Poly1305.
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_CRYPTO_CHACHAPOLY_H
+#define COSE_CRYPTO_CHACHAPOLY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name list of provided algorithms
+ *
+ * @{
+ */
+#define HAVE_ALGO_CHACHA20POLY1305  /**< ChaCha20-Poly1305 AEAD support */
+/** @} */
+
+/**
+ * @brief Name of the ChaCha20-Poly1305 implementation in use
+ *
+ * @return  One of "avx512", "avx2", "sse2", "neon" or "portable"
+ */
+const char *cose_crypto_chachapoly_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
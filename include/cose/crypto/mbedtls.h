@@ -41,9 +41,22 @@ extern "C" {
 
 #define HAVE_ALGO_ECDSA
 
+#define HAVE_ALGO_HMAC_SHA256   /**< HMAC and HKDF with SHA-256 */
+#define HAVE_ALGO_HMAC_SHA512   /**< HMAC and HKDF with SHA-512 */
+
+#define HAVE_ALGO_ECDH      /**< ECDH on the supported curves */
+
 #define HAVE_CURVE_P521     /**< EC NIST p521 curve support */
 #define HAVE_CURVE_P384     /**< EC NIST p384 curve support */
 #define HAVE_CURVE_P256     /**< EC NIST p256 curve support */
+
+#ifndef COSE_CRYPTO_MBEDTLS_NO_RSA
+#define HAVE_ALGO_PS512     /**< RSASSA-PSS with SHA-512 */
+#define HAVE_ALGO_PS384     /**< RSASSA-PSS with SHA-384 */
+#define HAVE_ALGO_PS256     /**< RSASSA-PSS with SHA-256 */
+
+#define HAVE_ALGO_RSA_PSS
+#endif
 /** @} */
 
 #define COSE_CRYPTO_AEAD_AESGCM_NONCEBYTES      12
@@ -61,6 +74,81 @@ extern "C" {
 #define COSE_CRYPTO_AEAD_AES256GCM_NONCEBYTES   COSE_CRYPTO_AEAD_AESGCM_NONCEBYTES
 #define COSE_CRYPTO_AEAD_AES256GCM_ABYTES       COSE_CRYPTO_AEAD_AESGCM_ABYTES
 
+/**
+ * @brief Size of the EC2 key buffers, coordinates and private keys are stored
+ *        right aligned with leading zeros for curves smaller than P-521
+ */
+#define COSE_CRYPTO_EC2_KEYBYTES                66
+
+#ifdef HAVE_ALGO_RSA_PSS
+/**
+ * @name RSA keys
+ *
+ * RSA keys are only used through an mbedtls RSA context prepared with one
+ * of the functions below, the context is referenced by @ref cose_key_t::rsa.
+ * Preparing computes the CRT parameters and the Montgomery constant of the
+ * modulus once, verifications with the key only read the context afterwards
+ * and can run concurrently. Signing updates the blinding values in the
+ * context and requires MBEDTLS_THREADING_C to share a private key between
+ * threads.
+ *
+ * Define COSE_CRYPTO_MBEDTLS_NO_RSA when mbedtls is built without
+ * MBEDTLS_PKCS1_V21.
+ * @{
+ */
+
+/**
+ * Prepare an RSA key from its raw big endian parameters
+ *
+ * The algorithm of @p key must be set to one of the PS algorithms
+ * beforehand.
+ *
+ * @param   key     Key to prepare
+ * @param   rsa     Uninitialized context to use, must stay valid until
+ *                  @ref cose_crypto_mbedtls_rsa_release
+ * @param   n       Modulus
+ * @param   n_len   Length of the modulus
+ * @param   e       Public exponent
+ * @param   e_len   Length of the public exponent
+ * @param   d       Private exponent, NULL for public keys
+ * @param   d_len   Length of the private exponent
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOTIMPLEMENTED when the algorithm is not RSA
+ * @return          COSE_ERR_INVALID_PARAM on invalid or too small keys
+ */
+int cose_crypto_mbedtls_rsa_prepare(cose_key_t *key,
+                                    struct mbedtls_rsa_context *rsa,
+                                    const uint8_t *n, size_t n_len,
+                                    const uint8_t *e, size_t e_len,
+                                    const uint8_t *d, size_t d_len);
+
+/**
+ * Generate a prepared RSA key pair with public exponent 65537
+ *
+ * @param   key     Key with the algorithm set
+ * @param   rsa     Uninitialized context to use
+ * @param   bits    Size of the modulus in bits
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOTIMPLEMENTED when the algorithm is not RSA
+ * @return          COSE_ERR_INVALID_PARAM for unsupported sizes
+ * @return          COSE_ERR_CRYPTO when no key could be generated
+ */
+int cose_crypto_mbedtls_rsa_generate(cose_key_t *key,
+                                     struct mbedtls_rsa_context *rsa,
+                                     unsigned bits);
+
+/**
+ * Free the context of a prepared RSA key
+ *
+ * @param   key     Key prepared with @ref cose_crypto_mbedtls_rsa_prepare or
+ *                  @ref cose_crypto_mbedtls_rsa_generate
+ */
+void cose_crypto_mbedtls_rsa_release(cose_key_t *key);
+/** @} */
+#endif /* HAVE_ALGO_RSA_PSS */
+
 #ifdef __cplusplus
 }
 #endif
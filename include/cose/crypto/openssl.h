@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_crypto_openssl Crypto glue layer, OpenSSL definitions
+ * @ingroup     cose_crypto
+ *
+ * Crypto function api for glueing OpenSSL 3.
+ *
+ * All algorithms are fetched once from the default library context and used
+ * through the EVP interface. Keys can be prepared with
+ * @ref cose_crypto_openssl_prepare, which constructs the EVP_PKEY for
+ * asymmetric keys or a keyed cipher context for symmetric keys once instead
+ * of for every operation.
+ * @{
+ *
+ * @file
+ * @brief       Crypto function api for glueing OpenSSL 3.
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_CRYPTO_OPENSSL_H
+#define COSE_CRYPTO_OPENSSL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CRYPTO_MBEDTLS) || defined(CRYPTO_TINYCRYPT) || \
+    defined(CRYPTO_PSA)
+#error "The OpenSSL backend can't be combined with another ECDSA backend"
+#endif
+
+/**
+ * @name list of provided algorithms
+ *
+ * @{
+ */
+#define HAVE_ALGO_CHACHA20POLY1305
+#define HAVE_ALGO_EDDSA
+#define HAVE_ALGO_AES128GCM /**< AES GCM mode support with 128 bit key */
+#define HAVE_ALGO_AES192GCM /**< AES GCM mode support with 192 bit key */
+#define HAVE_ALGO_AES256GCM /**< AES GCM mode support with 256 bit key */
+
+#define HAVE_ALGO_AESCCM_16_64_128  /**< AES CCM mode support with 16 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_64_128  /**< AES CCM mode support with 64 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_128_128 /**< AES CCM mode support with 16 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_128_128 /**< AES CCM mode support with 64 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_64_256  /**< AES CCM mode support with 16 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_64_256  /**< AES CCM mode support with 64 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_16_128_256 /**< AES CCM mode support with 16 bit length, 128 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_128_256 /**< AES CCM mode support with 64 bit length, 128 bit tag 256 bit key */
+
+#define HAVE_ALGO_ES512     /**< Sha512 support and some EC support */
+#define HAVE_ALGO_ES384     /**< Sha384 support and some EC support */
+#define HAVE_ALGO_ES256     /**< Sha256 support and some EC support */
+
+#define HAVE_ALGO_ECDSA
+
+#define HAVE_ALGO_HMAC_SHA256   /**< HMAC and HKDF with SHA-256 */
+#define HAVE_ALGO_HMAC_SHA512   /**< HMAC and HKDF with SHA-512 */
+
+#define HAVE_ALGO_ECDH      /**< ECDH on the supported curves */
+#define HAVE_CURVE_X25519   /**< X25519 key agreement */
+
+#define HAVE_CURVE_P521     /**< EC NIST p521 curve support */
+#define HAVE_CURVE_P384     /**< EC NIST p384 curve support */
+#define HAVE_CURVE_P256     /**< EC NIST p256 curve support */
+/** @} */
+
+/**
+ * @brief Size of the EC2 key buffers, coordinates and private keys are stored
+ *        right aligned with leading zeros for curves smaller than P-521
+ */
+#define COSE_CRYPTO_EC2_KEYBYTES    66
+
+/**
+ * @brief Number of symmetric keys that can be prepared
+ *
+ * The AEAD functions receive the raw key pointer, prepared symmetric keys
+ * are looked up by their @ref cose_key_t::d pointer.
+ */
+#ifndef COSE_CRYPTO_OPENSSL_SYMM_KEYS
+#define COSE_CRYPTO_OPENSSL_SYMM_KEYS   4
+#endif
+
+/**
+ * Prepare a key for repeated use
+ *
+ * Asymmetric keys get their EVP_PKEY constructed from the key material,
+ * the private key when @ref cose_key_t::d is set and the public key
+ * otherwise. Symmetric keys get a cipher context with the expanded key,
+ * operations running concurrently on the same prepared symmetric key fall
+ * back to a temporary context.
+ *
+ * Preparing and releasing keys must not run concurrently with operations
+ * using these keys.
+ *
+ * @param   key     Key to prepare, with the algorithm set
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOMEM when no symmetric key slot is free
+ * @return          COSE_ERR_NOTIMPLEMENTED for unsupported key types
+ * @return          COSE_ERR_CRYPTO when OpenSSL refuses the key
+ */
+int cose_crypto_openssl_prepare(cose_key_t *key);
+
+/**
+ * Release the prepared state of a key
+ *
+ * @param   key     Key prepared with @ref cose_crypto_openssl_prepare
+ */
+void cose_crypto_openssl_release(cose_key_t *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
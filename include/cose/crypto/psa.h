@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_crypto_psa Crypto glue layer, PSA Crypto API definitions
+ * @ingroup     cose_crypto
+ *
+ * Crypto function api for glueing the PSA Crypto API.
+ *
+ * Keys are used through PSA key handles stored in @ref cose_key_t. Keys
+ * without a handle are imported as volatile key for the duration of a
+ * single operation. Importing a key once with @ref cose_crypto_psa_import or
+ * attaching a persistent key with @ref cose_crypto_psa_open avoids this and
+ * keeps the key material inside the PSA implementation, for example in a
+ * secure element or accelerator driver.
+ *
+ * The AEAD functions only receive the raw key buffer. Registered symmetric
+ * keys are found by the address of their @ref cose_key_t::d buffer and a
+ * digest of its contents taken at registration. A buffer refilled with
+ * another key no longer matches its handle: the new contents are imported
+ * as temporary key instead, and for keys attached with
+ * @ref cose_crypto_psa_open the operation fails. Call
+ * @ref cose_crypto_psa_close before reusing the buffer to release the
+ * handle. The key table is shared by all threads; set a lock with
+ * @ref cose_crypto_psa_set_lock when importing, opening or closing keys
+ * while other threads encrypt.
+ * @{
+ *
+ * @file
+ * @brief       Crypto function api for glueing the PSA Crypto API.
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_CRYPTO_PSA_H
+#define COSE_CRYPTO_PSA_H
+
+#include <psa/crypto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CRYPTO_MBEDTLS) || defined(CRYPTO_TINYCRYPT)
+#error "The PSA backend can't be combined with the mbedtls or tinycrypt backend"
+#endif
+
+/**
+ * @name list of provided algorithms
+ *
+ * @{
+ */
+#define HAVE_ALGO_CHACHA20POLY1305
+#define HAVE_ALGO_AES128GCM /**< AES GCM mode support with 128 bit key */
+#define HAVE_ALGO_AES192GCM /**< AES GCM mode support with 192 bit key */
+#define HAVE_ALGO_AES256GCM /**< AES GCM mode support with 256 bit key */
+
+#define HAVE_ALGO_AESCCM_16_64_128  /**< AES CCM mode support with 16 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_64_128  /**< AES CCM mode support with 64 bit length, 64 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_128_128 /**< AES CCM mode support with 16 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_64_128_128 /**< AES CCM mode support with 64 bit length, 128 bit tag 128 bit key */
+#define HAVE_ALGO_AESCCM_16_64_256  /**< AES CCM mode support with 16 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_64_256  /**< AES CCM mode support with 64 bit length, 64 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_16_128_256 /**< AES CCM mode support with 16 bit length, 128 bit tag 256 bit key */
+#define HAVE_ALGO_AESCCM_64_128_256 /**< AES CCM mode support with 64 bit length, 128 bit tag 256 bit key */
+
+#define HAVE_ALGO_ES512     /**< Sha512 support and some EC support */
+#define HAVE_ALGO_ES384     /**< Sha384 support and some EC support */
+#define HAVE_ALGO_ES256     /**< Sha256 support and some EC support */
+
+#define HAVE_ALGO_ECDSA
+
+#define HAVE_ALGO_HMAC_SHA256   /**< HMAC and HKDF with SHA-256 */
+#define HAVE_ALGO_HMAC_SHA512   /**< HMAC and HKDF with SHA-512 */
+
+#define HAVE_ALGO_ECDH      /**< ECDH on the supported curves */
+#define HAVE_CURVE_X25519   /**< X25519 key agreement */
+
+#define HAVE_CURVE_P521     /**< EC NIST p521 curve support */
+#define HAVE_CURVE_P384     /**< EC NIST p384 curve support */
+#define HAVE_CURVE_P256     /**< EC NIST p256 curve support */
+/** @} */
+
+/**
+ * @brief Size of the EC2 key buffers, coordinates and private keys are stored
+ *        right aligned with leading zeros for curves smaller than P-521
+ */
+#define COSE_CRYPTO_EC2_KEYBYTES    66
+
+/**
+ * @brief Number of symmetric key handles that can be registered
+ *
+ * The AEAD functions receive the raw key pointer, registered symmetric keys
+ * are looked up by their @ref cose_key_t::d pointer and contents.
+ */
+#ifndef COSE_CRYPTO_PSA_SYMM_KEYS
+#define COSE_CRYPTO_PSA_SYMM_KEYS   4
+#endif
+
+/**
+ * Import the key material of a key into PSA and store the handle in the key
+ *
+ * The key usage policy follows the key: AEAD keys allow encryption and
+ * decryption, ECDSA keys signing and verification and other EC keys key
+ * agreement. The key material in the struct is not used afterwards and can
+ * be wiped by the caller, except for symmetric keys where the
+ * @ref cose_key_t::d buffer identifies the key and must stay unchanged until
+ * @ref cose_crypto_psa_close.
+ *
+ * @param   key         Key to import, with the algorithm set
+ * @param   lifetime    PSA_KEY_LIFETIME_VOLATILE or a persistent lifetime
+ * @param   id          Key identifier for persistent keys, ignored otherwise
+ *
+ * @return              COSE_OK on success
+ * @return              COSE_ERR_NOMEM when no symmetric key slot is free
+ * @return              COSE_ERR_NOTIMPLEMENTED for unsupported key types
+ * @return              COSE_ERR_CRYPTO when PSA refuses the key
+ */
+int cose_crypto_psa_import(cose_key_t *key, psa_key_lifetime_t lifetime,
+                           psa_key_id_t id);
+
+/**
+ * Attach an existing persistent PSA key to a key struct
+ *
+ * The public key of EC keys is exported into @ref cose_key_t::x and
+ * @ref cose_key_t::y when these are set. Symmetric keys require a non-NULL
+ * @ref cose_key_t::d buffer of the key length to identify them, its contents
+ * are no key material but must stay unchanged until
+ * @ref cose_crypto_psa_close.
+ *
+ * @param   key         Key struct with type, curve and algorithm set
+ * @param   id          PSA key identifier
+ *
+ * @return              COSE_OK on success
+ * @return              Negative on error
+ */
+int cose_crypto_psa_open(cose_key_t *key, psa_key_id_t id);
+
+/**
+ * Release the PSA handle of a key
+ *
+ * Volatile keys are destroyed, persistent keys remain in storage.
+ *
+ * @param   key         Key to release the handle of
+ */
+void cose_crypto_psa_close(cose_key_t *key);
+
+/**
+ * Set the lock protecting the symmetric key table
+ *
+ * Needed when keys are imported, opened or closed while other threads run
+ * AEAD operations. Set it before the first key is registered.
+ *
+ * @param   lock        Lock, NULL for single threaded use
+ */
+void cose_crypto_psa_set_lock(const cose_lock_t *lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
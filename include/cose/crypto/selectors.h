@@ -24,7 +24,9 @@
 /**
  * @name Ed25519 selector
  */
-#ifdef CRYPTO_SODIUM
+#ifdef CRYPTO_OPENSSL
+#define CRYPTO_OPENSSL_INCLUDE_ED25519
+#elif defined(CRYPTO_SODIUM)
 #define CRYPTO_SODIUM_INCLUDE_ED25519
 #elif defined(CRYPTO_MONOCYPHER)
 #define CRYPTO_MONOCYPHER_INCLUDE_ED25519
@@ -38,7 +40,13 @@
 /**
  * @name ChaCha20Poly1305 selector
  */
-#ifdef CRYPTO_SODIUM
+#ifdef CRYPTO_CHACHAPOLY
+#define CRYPTO_CHACHAPOLY_INCLUDE_CHACHAPOLY
+#elif defined(CRYPTO_OPENSSL)
+#define CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_CHACHAPOLY
+#elif defined(CRYPTO_SODIUM)
 #define CRYPTO_SODIUM_INCLUDE_CHACHAPOLY
 #elif defined(CRYPTO_MONOCYPHER)
 #define CRYPTO_MONOCYPHER_INCLUDE_CHACHAPOLY
@@ -48,6 +56,90 @@
 #define CRYPTO_HACL_INCLUDE_CHACHAPOLY
 #endif
 /** @} */
+
+/**
+ * @name AES-GCM selector
+ */
+#ifdef CRYPTO_AES
+#define CRYPTO_AES_INCLUDE_AESGCM
+#elif defined(CRYPTO_OPENSSL)
+#define CRYPTO_OPENSSL_INCLUDE_AESGCM
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_AESGCM
+#elif defined(CRYPTO_MBEDTLS)
+#define CRYPTO_MBEDTLS_INCLUDE_AESGCM
+#endif
+/** @} */
+
+/**
+ * @name AES-CCM selector
+ */
+#ifdef CRYPTO_AES
+#define CRYPTO_AES_INCLUDE_AESCCM
+#elif defined(CRYPTO_OPENSSL)
+#define CRYPTO_OPENSSL_INCLUDE_AESCCM
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_AESCCM
+#elif defined(CRYPTO_TINYCRYPT)
+#define CRYPTO_TINYCRYPT_INCLUDE_AESCCM
+#endif
+/** @} */
+
+/**
+ * @name ECDSA selector
+ */
+#ifdef CRYPTO_OPENSSL
+#define CRYPTO_OPENSSL_INCLUDE_ECDSA
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_ECDSA
+#elif defined(CRYPTO_MBEDTLS)
+#define CRYPTO_MBEDTLS_INCLUDE_ECDSA
+#elif defined(CRYPTO_TINYCRYPT)
+#define CRYPTO_TINYCRYPT_INCLUDE_ECDSA
+#endif
+/** @} */
+
+/**
+ * @name HMAC selector
+ */
+#ifdef CRYPTO_OPENSSL
+#define CRYPTO_OPENSSL_INCLUDE_HMAC
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_HMAC
+#elif defined(CRYPTO_SODIUM)
+#define CRYPTO_SODIUM_INCLUDE_HMAC
+#elif defined(CRYPTO_MBEDTLS)
+#define CRYPTO_MBEDTLS_INCLUDE_HMAC
+#elif defined(CRYPTO_TINYCRYPT)
+#define CRYPTO_TINYCRYPT_INCLUDE_HMAC
+#endif
+/** @} */
+
+/**
+ * @name X25519 selector
+ */
+#ifdef CRYPTO_OPENSSL
+#define CRYPTO_OPENSSL_INCLUDE_X25519
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_X25519
+#elif defined(CRYPTO_SODIUM)
+#define CRYPTO_SODIUM_INCLUDE_X25519
+#endif
+/** @} */
+
+/**
+ * @name ECDH selector
+ */
+#ifdef CRYPTO_OPENSSL
+#define CRYPTO_OPENSSL_INCLUDE_ECDH
+#elif defined(CRYPTO_PSA)
+#define CRYPTO_PSA_INCLUDE_ECDH
+#elif defined(CRYPTO_MBEDTLS)
+#define CRYPTO_MBEDTLS_INCLUDE_ECDH
+#elif defined(CRYPTO_TINYCRYPT)
+#define CRYPTO_TINYCRYPT_INCLUDE_ECDH
+#endif
+/** @} */
 #endif /* COSE_CRYPTO_SELECTORS_H */
 
 #if defined(HAVE_ALGO_AES128GCM) || \
@@ -56,15 +148,20 @@
 #define HAVE_ALGO_AESGCM    /**< AES GCM mode support */
 #endif
 
-#if defined(HAVE_ALGO_AES128CCM_16_64_128) || \
-    defined(HAVE_ALGO_AES128CCM_64_64_128) || \
-    defined(HAVE_ALGO_AES128CCM_16_128_128) || \
-    defined(HAVE_ALGO_AES128CCM_64_128_128) || \
-    defined(HAVE_ALGO_AES128CCM_16_64_256) || \
-    defined(HAVE_ALGO_AES128CCM_64_64_256) || \
-    defined(HAVE_ALGO_AES128CCM_16_128_256) || \
-    defined(HAVE_ALGO_AES128CCM_64_128_256)
+#if defined(HAVE_ALGO_AESCCM_16_64_128) || \
+    defined(HAVE_ALGO_AESCCM_64_64_128) || \
+    defined(HAVE_ALGO_AESCCM_16_128_128) || \
+    defined(HAVE_ALGO_AESCCM_64_128_128) || \
+    defined(HAVE_ALGO_AESCCM_16_64_256) || \
+    defined(HAVE_ALGO_AESCCM_64_64_256) || \
+    defined(HAVE_ALGO_AESCCM_16_128_256) || \
+    defined(HAVE_ALGO_AESCCM_64_128_256)
 #define HAVE_ALGO_AESCCM
 #endif
 
+#if defined(HAVE_ALGO_HMAC_SHA256) || \
+    defined(HAVE_ALGO_HMAC_SHA512)
+#define HAVE_ALGO_HMAC      /**< HMAC and HKDF support */
+#endif
+
 /** @} */
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_crypto_signd Crypto glue layer, signing daemon client
+ * @ingroup     cose_crypto
+ *
+ * Client for a local signing daemon, such as the `cose-signd` tool.
+ *
+ * The daemon holds the private keys and shares a request ring with its
+ * clients in a POSIX shared memory object. A client copies the to be signed
+ * Sig_structure into a free slot of the ring, the daemon signs all pending
+ * requests in a batch and writes the signatures back into their slots.
+ * Slots are claimed and handed over with atomic sequence numbers only, no
+ * locks or system calls are involved on either side.
+ *
+ * Keys attached to a ring with @ref cose_crypto_signd_attach only need the
+ * public key, algorithm and key identifier set. @ref cose_crypto_sign, and
+ * with it @ref cose_sign_encode, forward signing requests for these keys to
+ * the daemon, which picks its key by algorithm and key identifier.
+ *
+ * The ring isolates the private keys from the clients, not the clients from
+ * each other: every process with access to the shared memory object can read
+ * and submit requests.
+ *
+ * Clients wait at most @ref COSE_CRYPTO_SIGND_WAIT_MS for a free slot or for
+ * their signature, so a daemon that stopped or never started makes requests
+ * fail instead of hanging. A client that stops between claiming and
+ * releasing a slot holds it until the daemon reclaims it after
+ * @ref COSE_CRYPTO_SIGND_RECLAIM_MS: a claimed request that is never
+ * published blocks the requests queued behind it until then, an answered
+ * request that is never collected only takes its slot out of use until then.
+ * A client that is merely slower than the reclaim timeout loses its slot and
+ * gets an error. If it is descheduled while copying its request, that copy
+ * can race with the next client of the slot and garble its request, which
+ * then fails to verify. Keep the reclaim timeout well above any scheduling
+ * delay.
+ *
+ * This backend requires a hosted POSIX environment with lock-free C11
+ * atomics and is combined with another backend providing the signature
+ * algorithms, e.g. `CRYPTO="sodium signd"`.
+ * @{
+ *
+ * @file
+ * @brief       Signing daemon client and request ring definitions.
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_CRYPTO_SIGND_H
+#define COSE_CRYPTO_SIGND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cose/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name Request ring configuration
+ *
+ * Clients and the daemon must be built with the same values, a ring with a
+ * different layout is rejected by @ref cose_crypto_signd_open.
+ * @{
+ */
+#ifndef COSE_CRYPTO_SIGND_SLOTS
+#define COSE_CRYPTO_SIGND_SLOTS     64      /**< Number of slots in the ring, a power of two */
+#endif /* COSE_CRYPTO_SIGND_SLOTS */
+
+#ifndef COSE_CRYPTO_SIGND_MSG_MAX
+#define COSE_CRYPTO_SIGND_MSG_MAX   2048    /**< Maximum Sig_structure size of a request */
+#endif /* COSE_CRYPTO_SIGND_MSG_MAX */
+
+#ifndef COSE_CRYPTO_SIGND_SIG_MAX
+#define COSE_CRYPTO_SIGND_SIG_MAX   132     /**< Maximum signature size, enough for ES512 */
+#endif /* COSE_CRYPTO_SIGND_SIG_MAX */
+
+#ifndef COSE_CRYPTO_SIGND_KID_MAX
+#define COSE_CRYPTO_SIGND_KID_MAX   32      /**< Maximum key identifier length */
+#endif /* COSE_CRYPTO_SIGND_KID_MAX */
+
+#ifndef COSE_CRYPTO_SIGND_BATCH
+#define COSE_CRYPTO_SIGND_BATCH     16      /**< Maximum requests signed per @ref cose_crypto_signd_serve call */
+#endif /* COSE_CRYPTO_SIGND_BATCH */
+
+#ifndef COSE_CRYPTO_SIGND_SPIN
+#define COSE_CRYPTO_SIGND_SPIN      1024    /**< Polls of a client before it starts yielding the CPU */
+#endif /* COSE_CRYPTO_SIGND_SPIN */
+
+#ifndef COSE_CRYPTO_SIGND_WAIT_MS
+#define COSE_CRYPTO_SIGND_WAIT_MS   2000    /**< Default time a client waits for a slot or a signature, in ms */
+#endif /* COSE_CRYPTO_SIGND_WAIT_MS */
+
+#ifndef COSE_CRYPTO_SIGND_RECLAIM_MS
+#define COSE_CRYPTO_SIGND_RECLAIM_MS 10000  /**< Default time before the daemon reclaims an abandoned slot, in ms */
+#endif /* COSE_CRYPTO_SIGND_RECLAIM_MS */
+/** @} */
+
+/**
+ * @brief Request ring shared between the daemon and its clients
+ */
+typedef struct cose_signd_ring cose_signd_ring_t;
+
+/**
+ * Map a request ring
+ *
+ * The daemon creates the shared memory object, clients map an existing one.
+ *
+ * @param   name    POSIX shared memory object name, e.g. "/cose-signd"
+ * @param   create  Create and initialize the object, fails when it exists
+ *
+ * @return          The mapped ring
+ * @return          NULL on failure, with errno set
+ */
+cose_signd_ring_t *cose_crypto_signd_open(const char *name, bool create);
+
+/**
+ * Unmap a request ring
+ *
+ * The shared memory object itself is removed with shm_unlink by the daemon.
+ *
+ * @param   ring    Ring mapped with @ref cose_crypto_signd_open
+ */
+void cose_crypto_signd_close(cose_signd_ring_t *ring);
+
+/**
+ * Change the timeouts of a ring
+ *
+ * The timeouts are stored in the ring and apply to the daemon and all
+ * clients. They start at @ref COSE_CRYPTO_SIGND_WAIT_MS and
+ * @ref COSE_CRYPTO_SIGND_RECLAIM_MS. The reclaim timeout should be well
+ * above the wait timeout.
+ *
+ * @param   ring        Ring to configure, usually by the daemon
+ * @param   wait_ms     Time a client waits for a slot or a signature, 0 to
+ *                      wait forever
+ * @param   reclaim_ms  Time before the daemon reclaims a slot abandoned by a
+ *                      client, 0 to never reclaim slots
+ */
+void cose_crypto_signd_set_timeout(cose_signd_ring_t *ring, uint32_t wait_ms,
+                                   uint32_t reclaim_ms);
+
+/**
+ * Sign with a key through the daemon serving a ring
+ *
+ * @param   key     Key with the algorithm and key identifier of a daemon key
+ * @param   ring    Ring to send requests to, NULL to sign locally again
+ */
+void cose_crypto_signd_attach(cose_key_t *key, cose_signd_ring_t *ring);
+
+/**
+ * Queue a signing request
+ *
+ * Blocks while all slots of the ring are in use, up to the wait timeout of
+ * the ring.
+ *
+ * @param   ring    Ring to queue the request on
+ * @param   key     Key to sign with, selected by algorithm and key identifier
+ * @param   msg     Sig_structure to sign
+ * @param   msglen  Length of the Sig_structure
+ * @param   ticket  Ticket of the request, for collecting the signature
+ *
+ * @return          COSE_OK when the request is queued
+ * @return          COSE_ERR_NOMEM when the message or key identifier is too
+ *                  large for a slot
+ * @return          COSE_ERR_CRYPTO when no slot became free within the wait
+ *                  timeout, or the daemon reclaimed the slot meanwhile
+ */
+int cose_crypto_signd_request(cose_signd_ring_t *ring, const cose_key_t *key,
+                              const uint8_t *msg, size_t msglen,
+                              uint32_t *ticket);
+
+/**
+ * Check whether the daemon answered a request
+ *
+ * @param   ring    Ring the request was queued on
+ * @param   ticket  Ticket of the request
+ *
+ * @return          true when @ref cose_crypto_signd_result returns immediately
+ */
+bool cose_crypto_signd_ready(const cose_signd_ring_t *ring, uint32_t ticket);
+
+/**
+ * Collect the signature of a request and release its slot
+ *
+ * Blocks until the daemon answered the request, up to the wait timeout of
+ * the ring. Every queued request must be collected exactly once. A request
+ * that timed out must not be collected again, its slot is reclaimed by the
+ * daemon.
+ *
+ * @param   ring    Ring the request was queued on
+ * @param   ticket  Ticket of the request
+ * @param   sign    Buffer for the signature, with room for the signature
+ *                  size of the key
+ * @param   signlen Length of the signature
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOT_FOUND when the daemon holds no matching key
+ * @return          COSE_ERR_CRYPTO when the daemon did not answer within the
+ *                  wait timeout, or reclaimed the slot before it was collected
+ * @return          Negative error of the daemon signing the request
+ */
+int cose_crypto_signd_result(cose_signd_ring_t *ring, uint32_t ticket,
+                             uint8_t *sign, size_t *signlen);
+
+/**
+ * Sign a message through the daemon the key is attached to
+ *
+ * Used by @ref cose_crypto_sign for keys attached to a ring.
+ *
+ * @param   key     Attached key
+ * @param   sign    Buffer for the signature
+ * @param   signlen Length of the signature
+ * @param   msg     Sig_structure to sign
+ * @param   msglen  Length of the Sig_structure
+ *
+ * @return          COSE_OK on success
+ * @return          Negative on error
+ */
+int cose_crypto_signd_sign(const cose_key_t *key, uint8_t *sign,
+                           size_t *signlen, const uint8_t *msg, size_t msglen);
+
+/**
+ * Sign a batch of pending requests, daemon side
+ *
+ * Collects up to @ref COSE_CRYPTO_SIGND_BATCH consecutive pending requests
+ * and signs them, on the executor when supplied. Every signature is handed
+ * back as soon as it is done. Returns without waiting when no request is
+ * pending; idle calls also reclaim slots abandoned by clients for longer
+ * than the reclaim timeout. Only a single thread may serve a ring.
+ *
+ * @param   ring    Ring to serve
+ * @param   keys    Private keys of the daemon
+ * @param   num     Number of keys
+ * @param   exec    Executor to sign the requests on, NULL to sign them in
+ *                  the calling thread
+ *
+ * @return          Number of requests served
+ */
+size_t cose_crypto_signd_serve(cose_signd_ring_t *ring, const cose_key_t *keys,
+                               size_t num, const cose_executor_t *exec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
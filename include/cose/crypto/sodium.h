@@ -34,6 +34,9 @@ extern "C" {
  */
 #define HAVE_ALGO_CHACHA20POLY1305
 #define HAVE_ALGO_EDDSA
+#define HAVE_ALGO_HMAC_SHA256   /**< HMAC and HKDF with SHA-256 */
+#define HAVE_ALGO_HMAC_SHA512   /**< HMAC and HKDF with SHA-512 */
+#define HAVE_CURVE_X25519       /**< X25519 key agreement */
 /** @} */
 
 #ifdef __cplusplus
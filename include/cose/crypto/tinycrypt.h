@@ -36,12 +36,21 @@ extern "C" {
 
 #define HAVE_CURVE_P256     /**< EC NIST p256 curve support */
 
+#define HAVE_ALGO_HMAC_SHA256   /**< HMAC and HKDF with SHA-256 */
+
+#define HAVE_ALGO_ECDH      /**< ECDH on the supported curves */
+
 #define HAVE_ALGO_AESCCM
 
 #define HAVE_ALGO_AESCCM_16_64_128 /**< AES CCM mode support with 16 bit length, 64 bit tag 128 bit key */
 #define HAVE_ALGO_AESCCM_16_128_128 /**< AES CCM mode support with 16 bit length, 128 bit tag 128 bit key */
 /** @} */
 
+/**
+ * @brief Size of the EC2 key buffers
+ */
+#define COSE_CRYPTO_EC2_KEYBYTES    32
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,7 +23,9 @@
 #define COSE_ENCRYPT_H
 
 #include "cose_defines.h"
+#include "cose/common.h"
 #include "cose/conf.h"
+#include "cose/crypto.h"
 #include "cose/hdr.h"
 #include "cose/recipient.h"
 #include <stdint.h>
@@ -61,7 +63,29 @@ extern "C" {
  * ```
  *
  * @brief Struct for conversion to both the COSE encrypt and COSE encrypt0 objects.
+ *
+ * With @ref COSE_COMPACT_LAYOUT the recipients are not embedded but supplied
+ * by the caller with @ref cose_encrypt_set_recipients, reducing the struct
+ * from several hundred to 96 bytes on 64 bit platforms.
  */
+#ifdef COSE_COMPACT_LAYOUT
+typedef struct cose_encrypt {
+    const uint8_t *payload;                     /**< Pointer to the payload to encrypt */
+    size_t payload_len;                         /**< Size of the payload */
+    uint8_t *ext_aad;                           /**< Pointer to the additional authenticated data */
+    size_t ext_aad_len;                         /**< Size of the AAD */
+    uint8_t *cek;                               /**< Pointer to the content encryption key */
+    const uint8_t *nonce;                       /**< Possible Nonce to use */
+    const uint8_t *piv;                         /**< Partial IV sent instead of the nonce */
+    cose_headers_t hdrs;                        /**< Headers included in the body */
+    cose_recp_t *recps;                         /**< recipient data array, out of line */
+    cose_algo_t algo;                           /**< Algo used for the base encrypt structure */
+    uint16_t flags;                             /**< Flags as defined */
+    uint8_t num_recps;                          /**< Number of recipients to encrypt for */
+    uint8_t max_recps;                          /**< Number of entries in recps */
+    uint8_t piv_len;                            /**< Length of the Partial IV */
+} cose_encrypt_t;
+#else
 typedef struct cose_encrypt {
     const uint8_t *payload;                     /**< Pointer to the payload to encrypt */
     size_t payload_len;                         /**< Size of the payload */
@@ -71,10 +95,13 @@ typedef struct cose_encrypt {
     uint8_t *cek;                               /**< Pointer to the content encryption key */
     cose_algo_t algo;                           /**< Algo used for the base encrypt structure */
     const uint8_t *nonce;                       /**< Possible Nonce to use */
+    const uint8_t *piv;                         /**< Partial IV sent instead of the nonce */
+    uint8_t piv_len;                            /**< Length of the Partial IV */
     uint8_t num_recps;                          /**< Number of recipients to encrypt for */
     cose_headers_t hdrs;                        /**< Headers included in the body */
     cose_recp_t recps[COSE_RECIPIENTS_MAX];     /**< recipient data array */
 } cose_encrypt_t;
+#endif
 
 /**
  * @name COSE encrypt decryption struct
@@ -89,6 +116,23 @@ typedef struct cose_encrypt_dec {
     uint16_t flags;         /**< Flags as defined  */
 } cose_encrypt_dec_t;
 
+/**
+ * @brief AEAD parameters of a decoded encrypt object
+ *
+ * Filled by @ref cose_encrypt_decrypt_prepare. Contains everything required
+ * for the AEAD decryption without further access to the encrypt object.
+ */
+typedef struct cose_encrypt_aead {
+    const uint8_t *aad;             /**< Enc_structure, placed in the scratch buffer */
+    size_t aad_len;                 /**< Length of the Enc_structure */
+    const uint8_t *nonce;           /**< Nonce from the unprotected headers */
+    const uint8_t *cek;             /**< Content encryption key */
+    const uint8_t *ciphertext;      /**< Ciphertext including the tag */
+    size_t ciphertext_len;          /**< Length of the ciphertext */
+    cose_algo_t algo;               /**< AEAD algorithm */
+    const cose_crypto_algo_t *desc; /**< Descriptor of the AEAD algorithm */
+} cose_encrypt_aead_t;
+
 /**
  * cose_encrypt_init initializes an cose encrypt struct
  *
@@ -125,6 +169,41 @@ cose_algo_t cose_encrypt_get_algo(const cose_encrypt_t *encrypt);
  */
 int cose_encrypt_add_recipient(cose_encrypt_t *encrypt, const cose_key_t *key);
 
+/**
+ * cose_encrypt_add_recipient_kdf adds a direct+HKDF or ECDH-SS+HKDF
+ * recipient
+ *
+ * With the @ref COSE_ALGO_DIRECT algorithm the content encryption key is
+ * derived from the secret in key->d, or with ECDH-SS from the secret agreed
+ * between @p key and kdf->peer, with the parameters in @p kdf. As with
+ * direct recipients the content algorithm is taken from key->algo. The
+ * parameters must remain valid until the object is encoded.
+ *
+ * @param   encrypt     Encrypt struct to operate on
+ * @param   key         The key with the shared secret or own static key
+ * @param   kdf         Key derivation parameters
+ *
+ * @return              Negative when failed
+ */
+int cose_encrypt_add_recipient_kdf(cose_encrypt_t *encrypt,
+                                   const cose_key_t *key,
+                                   const cose_recp_kdf_t *kdf);
+
+/**
+ * @brief Supply the storage for the recipients of an encrypt object
+ *
+ * Required before adding recipients when @ref COSE_COMPACT_LAYOUT is
+ * enabled. Without the compact layout the recipients are stored in the
+ * encrypt struct itself and this call has no effect.
+ *
+ * @param   encrypt     Encrypt struct to operate on
+ * @param   recps       Array of recipient structs, must remain valid as
+ *                      long as the encrypt struct is used
+ * @param   num         Number of entries in @p recps
+ */
+void cose_encrypt_set_recipients(cose_encrypt_t *encrypt, cose_recp_t *recps,
+                                 size_t num);
+
 /**
  * cose_encrypt_set_algo sets the algo to encrypt with
  *
@@ -133,6 +212,39 @@ int cose_encrypt_add_recipient(cose_encrypt_t *encrypt, const cose_key_t *key);
  */
 void cose_encrypt_set_algo(cose_encrypt_t *encrypt, cose_algo_t algo);
 
+/**
+ * Send a Partial IV instead of the full nonce
+ *
+ * The nonce passed to @ref cose_encrypt_encode must be derived from the base
+ * IV of the key and this Partial IV with @ref cose_encrypt_partial_iv_nonce.
+ *
+ * @param   encrypt     Encrypt struct to operate on
+ * @param   piv         Partial IV, big endian sequence number of the sender
+ * @param   len         Length of the Partial IV, at most 8 bytes
+ */
+void cose_encrypt_set_partial_iv(cose_encrypt_t *encrypt, const uint8_t *piv,
+                                 size_t len);
+
+/**
+ * Derive a nonce from a base IV and a Partial IV
+ *
+ * The Partial IV is left padded with zeros to the nonce length and XOR'ed
+ * with the base IV, https://tools.ietf.org/html/rfc8152#section-3.1
+ *
+ * @param[out]  nonce       Buffer for the nonce
+ * @param       nonce_len   Nonce length of the algorithm
+ * @param       base_iv     Base IV, @p nonce_len bytes
+ * @param       piv         Partial IV
+ * @param       piv_len     Length of the Partial IV
+ *
+ * @return                  COSE_OK on success
+ * @return                  COSE_ERR_INVALID_PARAM when the Partial IV is
+ *                          longer than the nonce
+ */
+int cose_encrypt_partial_iv_nonce(uint8_t *nonce, size_t nonce_len,
+                                  const uint8_t *base_iv, const uint8_t *piv,
+                                  size_t piv_len);
+
 /**
  * cose_encrypt_encode builds the COSE encrypt packet from the encrypt struct
  *
@@ -159,6 +271,26 @@ COSE_ssize_t cose_encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf, size_t l
  */
 int cose_encrypt_decode(cose_encrypt_dec_t *encrypt, uint8_t *buf, size_t len);
 
+/**
+ * @brief cose_encrypt_decode_validate decodes a buffer containing a COSE
+ * encrypt object after validating it against a set of work limits
+ *
+ * The headers and all nested recipients are checked in a single pass
+ * before the struct is filled.
+ *
+ * @param[out]  encrypt     Encrypt struct to fill
+ * @param       buf         Buffer to read from
+ * @param       len         Size of the buffer
+ * @param       limits      Limits to enforce, NULL for the defaults
+ *
+ * @return                  COSE_OK when successful
+ * @return                  COSE_ERR_INVALID_CBOR on malformed input
+ * @return                  COSE_ERR_CBOR_NOTSUP when a limit is exceeded
+ */
+int cose_encrypt_decode_validate(cose_encrypt_dec_t *encrypt, uint8_t *buf,
+                                 size_t len,
+                                 const cose_decode_limits_t *limits);
+
 /**
  * @brief Iterate over the recipients in an encrypt decode context
  *
@@ -189,6 +321,171 @@ int cose_encrypt_decrypt(const cose_encrypt_dec_t *encrypt,
                          const cose_key_t *key, uint8_t *buf, size_t len,
                          uint8_t *payload, size_t *payload_len);
 
+/**
+ * @brief Prepare the decryption of a cose_encrypt_dec_t object without
+ * running the AEAD operation
+ *
+ * Together with @ref cose_encrypt_decrypt_aead this splits
+ * @ref cose_encrypt_decrypt in separate steps, allowing the decryption of
+ * large payloads to be done outside of the library call, e.g. on a worker
+ * thread. The scratch buffer, the encoded object and the key must remain
+ * valid until the decryption is done.
+ *
+ * @param       encrypt     Encrypt struct to work on
+ * @param       recp        Recipient to start decrypting from
+ * @param       key         Key to use for decryption
+ * @param       buf         Temporary buffer to use for serialized intermediates
+ * @param       len         Size of the temporary buffer
+ * @param[out]  aead        AEAD parameters to fill
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error
+ */
+int cose_encrypt_decrypt_prepare(const cose_encrypt_dec_t *encrypt,
+                                 const cose_recp_dec_t *recp,
+                                 const cose_key_t *key, uint8_t *buf,
+                                 size_t len, cose_encrypt_aead_t *aead);
+
+/**
+ * @brief Prepare the decryption with local key derivation state
+ *
+ * Same as @ref cose_encrypt_decrypt_prepare, direct+HKDF and ECDH-SS+HKDF
+ * recipients take the caches and the static key of the sender from
+ * @p local. The other parameters are decoded from the recipient.
+ *
+ * @param       encrypt     Encrypt struct to work on
+ * @param       recp        Recipient to start decrypting from
+ * @param       key         Key to use for decryption
+ * @param       local       Peer key and caches, NULL for none
+ * @param       buf         Temporary buffer to use for serialized intermediates
+ * @param       len         Size of the temporary buffer
+ * @param[out]  aead        AEAD parameters to fill
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error
+ */
+int cose_encrypt_decrypt_prepare_cached(const cose_encrypt_dec_t *encrypt,
+                                        const cose_recp_dec_t *recp,
+                                        const cose_key_t *key,
+                                        const cose_recp_kdf_t *local,
+                                        uint8_t *buf, size_t len,
+                                        cose_encrypt_aead_t *aead);
+
+/**
+ * @brief Verify and decrypt the payload with prepared AEAD parameters
+ *
+ * @param       aead        AEAD parameters from
+ *                          @ref cose_encrypt_decrypt_prepare
+ * @param[out]  payload     Buffer to write the plaintext payload to
+ * @param[out]  payload_len Size of the plaintext
+ *
+ * @return                  COSE_OK on successful verification and decryption
+ */
+int cose_encrypt_decrypt_aead(const cose_encrypt_aead_t *aead,
+                              uint8_t *payload, size_t *payload_len);
+
+/**
+ * @name Replay protection
+ *
+ * A replay window tracks the sequence numbers, taken from the Partial IV,
+ * received from a single sender key. It remembers the sequence numbers of
+ * the last @ref COSE_REPLAY_WINDOW numbers below the highest one received
+ * and rejects everything older.
+ *
+ * The window is split in blocks of 32 sequence numbers. Every block is a
+ * single 64 bit word holding the block number and a bitmap of the received
+ * sequence numbers, so checks and updates touch one word and take a single
+ * compare-and-swap. With GCC or clang atomic builtins for 64 bit words the
+ * window is lock-free and can be used from many threads without a lock,
+ * otherwise it is protected by the lock passed at initialization.
+ * Sequence numbers of a sender must not advance by 2^36 or more at once.
+ * @{
+ */
+
+/**
+ * @brief Number of blocks in a replay window
+ */
+#define COSE_REPLAY_BLOCKS  (COSE_REPLAY_WINDOW / 32)
+
+/**
+ * @brief Replay window of a single sender key
+ */
+typedef struct cose_replay_window {
+    uint64_t blocks[COSE_REPLAY_BLOCKS];    /**< Block number in the upper,
+                                                 received bitmap in the lower
+                                                 half */
+    uint64_t top;                           /**< Highest block number received */
+    const uint8_t *base_iv;                 /**< Base IV of the sender key */
+    const cose_lock_t *lock;                /**< Lock, only used without atomic
+                                                 builtins */
+} cose_replay_window_t;
+
+/**
+ * @brief Initialize an empty replay window
+ *
+ * @param   window  Window to initialize
+ * @param   base_iv Base IV of the sender key, with the nonce length of the
+ *                  key algorithm
+ * @param   lock    Lock protecting the window without atomic builtins, NULL
+ *                  for single threaded use
+ */
+void cose_replay_init(cose_replay_window_t *window, const uint8_t *base_iv,
+                      const cose_lock_t *lock);
+
+/**
+ * @brief Check a sequence number against the window without recording it
+ *
+ * @param   window  Replay window
+ * @param   seq     Sequence number
+ *
+ * @return          COSE_OK when the sequence number was not received yet
+ * @return          COSE_ERR_REPLAY when it was received or is too old
+ */
+int cose_replay_check(cose_replay_window_t *window, uint64_t seq);
+
+/**
+ * @brief Record a sequence number in the window
+ *
+ * Only record sequence numbers of authenticated messages. When the same
+ * sequence number is recorded concurrently, exactly one call succeeds.
+ *
+ * @param   window  Replay window
+ * @param   seq     Sequence number
+ *
+ * @return          COSE_OK when the sequence number is recorded
+ * @return          COSE_ERR_REPLAY when it was received or is too old
+ */
+int cose_replay_update(cose_replay_window_t *window, uint64_t seq);
+
+/**
+ * @brief Decrypt an object protected by a Partial IV and reject replays
+ *
+ * Same as @ref cose_encrypt_decrypt, the nonce is derived from the Partial IV
+ * header and the base IV of @p window. The sequence number in the Partial IV
+ * is checked against the window before the decryption and recorded after
+ * the message is authenticated. Objects with a full IV are rejected.
+ *
+ * @param       encrypt     Encrypt struct to work on
+ * @param       recp        Recipient to start decrypting from
+ * @param       key         Key to use for decryption
+ * @param       window      Replay window of the sender key
+ * @param       buf         Temporary buffer to use for serialized intermediates
+ * @param       len         Size of the temporary buffer
+ * @param[out]  payload     Buffer to write the plaintext payload to
+ * @param[out]  payload_len Size of the plaintext
+ *
+ * @return                  COSE_OK on successful verification and decryption
+ * @return                  COSE_ERR_REPLAY for replayed or too old objects
+ * @return                  Negative on other errors
+ */
+int cose_encrypt_decrypt_replay(const cose_encrypt_dec_t *encrypt,
+                                const cose_recp_dec_t *recp,
+                                const cose_key_t *key,
+                                cose_replay_window_t *window,
+                                uint8_t *buf, size_t len,
+                                uint8_t *payload, size_t *payload_len);
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,7 @@
 
 #include "cose_defines.h"
 #include <nanocbor/nanocbor.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -33,19 +34,42 @@ extern "C" {
 
 /**
  * @name COSE header struct
+ *
+ * With @ref COSE_COMPACT_LAYOUT the length and the type share a single 32 bit
+ * word, limiting the length to @ref COSE_HDR_COMPACT_LEN_MAX. Small integer
+ * values are stored inline in the value union, which shrinks the struct from
+ * 40 to 24 bytes on 64 bit platforms and from 20 to 16 bytes on 32 bit
+ * platforms.
  * @{
  */
+#ifdef COSE_COMPACT_LAYOUT
+#if UINT_MAX < 0xFFFFFFFF
+#error "COSE_COMPACT_LAYOUT requires an int of at least 32 bit"
+#endif
+/**
+ * @brief Maximum header length with @ref COSE_COMPACT_LAYOUT
+ */
+#define COSE_HDR_COMPACT_LEN_MAX    0xFFFFFFU
+#endif
+
 typedef struct cose_hdr {
     struct cose_hdr *next;      /**< Next header in list */
     int32_t key;                /**< Header label */
+#ifdef COSE_COMPACT_LAYOUT
+    unsigned len : 24;          /**< Length of the data, only used for the byte type */
+    unsigned type : 8;          /**< Type of the header, a cose_hdr_type_t */
+#else
     size_t len;                 /**< Length of the data, only used for the byte type */
+#endif
     union {                     /**< Depending on the type, the content is a pointer or an integer */
         int32_t value;          /**< Direct integer value */
         const uint8_t *data;    /**< Pointer to the content */
         const char *str;        /**< String type content */
         const uint8_t *cbor;    /**< CBOR type content */
     } v;                        /**< Union to combine different value types */
+#ifndef COSE_COMPACT_LAYOUT
     cose_hdr_type_t type;       /**< Type of the header */
+#endif
 } cose_hdr_t;
 /** @} */
 
@@ -82,12 +106,19 @@ void cose_hdr_format_string(cose_hdr_t *hdr, int32_t key, const char *str);
 /**
  * Format header with a byte array based value
  *
+ * With @ref COSE_COMPACT_LAYOUT a length above
+ * @ref COSE_HDR_COMPACT_LEN_MAX is rejected and leaves an undefined header,
+ * which fails to encode.
+ *
  * @param   hdr         The header to modify
  * @param   key         The key to add
  * @param   data        The byte array to add
  * @param   len         Length of the byte array
+ *
+ * @return              true when the header is formatted
+ * @return              false when the length does not fit the header
  */
-void cose_hdr_format_data(cose_hdr_t *hdr, int32_t key, const uint8_t *data,
+bool cose_hdr_format_data(cose_hdr_t *hdr, int32_t key, const uint8_t *data,
         size_t len);
 
 /**
@@ -109,6 +140,16 @@ int cose_hdr_encode_to_map(const cose_hdr_t *hdr, nanocbor_encoder_t *map);
  */
 size_t cose_hdr_size(const cose_hdr_t *hdr);
 
+/**
+ * Check that both lists of a header set can be encoded
+ *
+ * @param   headers Header set to check
+ *
+ * @return          False when a header is undefined, e.g. after a rejected
+ *                  @ref cose_hdr_format_data
+ */
+bool cose_hdr_encodable(const cose_headers_t *headers);
+
 /**
  * Insert a new header into the list
  *
@@ -162,6 +203,67 @@ bool cose_hdr_get(cose_headers_t *headers, cose_hdr_t *hdr,
  * @return          true if decoding succeeded
  */
 bool cose_hdr_decode_from_cbor(const uint8_t *buf, size_t len, cose_hdr_t *hdr, int32_t key);
+
+/**
+ * @name Unprotected header patching
+ *
+ * Rewrite the unprotected header map of an encoded COSE_Sign1, COSE_Sign,
+ * COSE_Encrypt0 or COSE_Encrypt object. The unprotected headers are not
+ * part of the signed or authenticated data, the signatures, ciphertext and
+ * payload are copied as is and no cryptographic operation is repeated.
+ *
+ * Every header in @p hdrs replaces the existing header with the same label
+ * or is added to the map. A header of type @ref COSE_HDR_TYPE_UNDEF removes
+ * the existing header instead. Headers of type @ref COSE_HDR_TYPE_CBOR are
+ * not supported. Decode the object again after patching.
+ * @{
+ */
+
+/**
+ * Patch the unprotected headers into a new head
+ *
+ * Writes the start of the object up to and including the new unprotected
+ * header map to @p buf. The rest of the object is not copied, the full
+ * object is the head followed by @p tail, for example as two parts of a
+ * scatter/gather write.
+ *
+ * @param       msg         Encoded COSE object
+ * @param       msg_len     Length of the encoded object
+ * @param       hdrs        Headers to set or remove
+ * @param       buf         Buffer for the head, not overlapping @p msg
+ * @param       len         Size of the buffer
+ * @param[out]  tail        Rest of the object following the head
+ * @param[out]  tail_len    Length of the rest of the object
+ *
+ * @return                  Length of the head
+ * @return                  COSE_ERR_NOMEM when the buffer is too small
+ * @return                  Negative on other errors
+ */
+COSE_ssize_t cose_hdr_patch_unprot_head(const uint8_t *msg, size_t msg_len,
+                                        const cose_hdr_t *hdrs,
+                                        uint8_t *buf, size_t len,
+                                        const uint8_t **tail,
+                                        size_t *tail_len);
+
+/**
+ * Patch the unprotected headers in place
+ *
+ * The new header map is built in the buffer behind the object, the buffer
+ * must have room for the larger of the old and new object plus the new
+ * header map.
+ *
+ * @param   buf         Buffer holding the encoded COSE object
+ * @param   len         Size of the buffer
+ * @param   msg_len     Length of the encoded object
+ * @param   hdrs        Headers to set or remove
+ *
+ * @return              Length of the patched object
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ * @return              Negative on other errors
+ */
+COSE_ssize_t cose_hdr_patch_unprot(uint8_t *buf, size_t len, size_t msg_len,
+                                   const cose_hdr_t *hdrs);
+/** @} */
 #ifdef __cplusplus
 }
 #endif
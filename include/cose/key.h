@@ -23,10 +23,16 @@
 #define COSE_SIGNER_H
 
 #include "cose_defines.h"
+#include "cose/common.h"
 #include <nanocbor/nanocbor.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+#ifdef CRYPTO_PSA
+#include <psa/crypto.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -49,6 +55,18 @@ typedef struct cose_key {
     uint8_t *x;         /**< Public key part 1, must match the expected size of the algorithm */
     uint8_t *y;         /**< Public key part 2, when not NULL, must match the expected size of the algorithm */
     uint8_t *d;         /**< Private or secret key, must match the expected size of the algorithm */
+#ifdef CRYPTO_PSA
+    psa_key_id_t psa_key; /**< PSA key handle, PSA_KEY_ID_NULL to import the key material per operation */
+#endif
+#ifdef CRYPTO_MBEDTLS
+    struct mbedtls_rsa_context *rsa; /**< Prepared RSA key, RSA keys are only used through this context */
+#endif
+#ifdef CRYPTO_OPENSSL
+    struct evp_pkey_st *evp_pkey; /**< Prepared OpenSSL key, NULL to construct it per operation */
+#endif
+#ifdef CRYPTO_SIGND
+    struct cose_signd_ring *signd; /**< Signing daemon ring, NULL to sign with the local key material */
+#endif
 } cose_key_t;
 /** @} */
 
@@ -116,6 +134,218 @@ void cose_key_protected_to_map(const cose_key_t *key, nanocbor_encoder_t *map);
  */
 void cose_key_unprotected_to_map(const cose_key_t *key, nanocbor_encoder_t *map);
 
+/**
+ * Encode a key as COSE_Key map
+ *
+ * EC2 coordinates are written with the size of the curve, symmetric keys
+ * with the key length of their algorithm. Symmetric keys without
+ * @p private_key produce a map without the key value.
+ *
+ * @param   key         The key object
+ * @param   private_key Include the private or secret key part
+ * @param   enc         Encoder to write the map to
+ *
+ * @return              COSE_OK on success
+ * @return              COSE_ERR_INVALID_PARAM for unknown key types or curves
+ */
+int cose_key_to_cbor(const cose_key_t *key, bool private_key,
+                     nanocbor_encoder_t *enc);
+
+/**
+ * Encode an array of keys as COSE_KeySet
+ *
+ * @param   keys        Keys to encode
+ * @param   num         Number of keys
+ * @param   private_key Include the private or secret key parts
+ * @param   buf         Buffer to write to, NULL to only compute the size
+ * @param   len         Size of the buffer
+ *
+ * @return              Size of the encoded key set
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ * @return              Negative on other errors
+ */
+COSE_ssize_t cose_keyset_encode(const cose_key_t *keys, size_t num,
+                                bool private_key, uint8_t *buf, size_t len);
+
+/**
+ * @name Bulk key generation
+ *
+ * Generates a batch of keys of one type at once, for example to provision
+ * devices. Key material of all keys is stored in a single caller supplied
+ * buffer. The work is split into at most @ref COSE_KEY_GEN_JOBS_MAX jobs
+ * that run on an optional executor. Every job draws from the random
+ * generator of the backend, which must be safe to call concurrently when an
+ * executor is used.
+ * @{
+ */
+
+/**
+ * @brief Key identifier assignment for generated keys
+ */
+typedef enum {
+    COSE_KEY_KID_NONE,      /**< No key identifier */
+    COSE_KEY_KID_COUNTER,   /**< Big endian counter starting at kid_base */
+    COSE_KEY_KID_PUBLIC,    /**< Leading bytes of the public key */
+} cose_key_kid_t;
+
+/**
+ * @brief Parameters of a bulk key generation
+ */
+typedef struct cose_key_gen {
+    cose_curve_t crv;       /**< Curve, 0 for symmetric keys */
+    cose_algo_t algo;       /**< Algorithm of the keys */
+    cose_key_kid_t kid;     /**< Key identifier assignment */
+    uint8_t kid_len;        /**< Length of the key identifiers, 1 to 8 for counters */
+    uint64_t kid_base;      /**< First counter value */
+} cose_key_gen_t;
+
+/**
+ * Size of the key material of a single generated key
+ *
+ * @param   gen     Generation parameters
+ *
+ * @return          Number of bytes per key in the material buffer
+ * @return          0 when the key type can't be generated
+ */
+size_t cose_key_gen_size(const cose_key_gen_t *gen);
+
+/**
+ * Generate a batch of keys
+ *
+ * The keys are initialized to point into @p buf, which must stay valid as
+ * long as the keys are used.
+ *
+ * @param   gen     Generation parameters
+ * @param   keys    Array of keys to generate
+ * @param   num     Number of keys
+ * @param   buf     Buffer for the key material of all keys
+ * @param   len     Size of the buffer, at least num * @ref cose_key_gen_size
+ * @param   exec    Executor to run the jobs on, NULL to run them directly
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOMEM when the buffer is too small
+ * @return          COSE_ERR_NOTIMPLEMENTED when the key type can't be
+ *                  generated with the configured backends
+ * @return          Negative on other errors
+ */
+int cose_key_generate(const cose_key_gen_t *gen, cose_key_t *keys, size_t num,
+                      uint8_t *buf, size_t len, const cose_executor_t *exec);
+/** @} */
+
+/**
+ * @name Indexed keystore
+ *
+ * Binary keystore image that is used in place, for example mapped read-only
+ * from a file with mmap or stored in flash. Opening a keystore only checks
+ * the header, keys are accessed as @ref cose_key_t views pointing into the
+ * image. The key material is shared with the image and must not be
+ * modified through the views.
+ *
+ * All integers are little endian, offsets are relative to the start of the
+ * image:
+ *
+ * | Section | Contents                                                    |
+ * |---------|-------------------------------------------------------------|
+ * | Header  | Magic "CKST", version, record size, number of keys and the  |
+ * |         | offsets of the other sections, 32 bytes                     |
+ * | Index   | Per key: record number, kid offset and kid length, sorted   |
+ * |         | by kid, 12 bytes                                            |
+ * | Records | Per key: kty, alg, crv, kid offset, x, y and d offsets and  |
+ * |         | the kid length, 32 bytes                                    |
+ * | Data    | Key identifiers and key material                            |
+ *
+ * EC2 coordinates and private keys are stored right aligned in
+ * @ref COSE_KEYSTORE_EC2_BYTES, matching the layout expected by the crypto
+ * backends. Absent key parts have offset 0.
+ * @{
+ */
+#define COSE_KEYSTORE_MAGIC         0x54534b43U /**< "CKST" */
+#define COSE_KEYSTORE_VERSION       1U          /**< Format version */
+#define COSE_KEYSTORE_HDR_SIZE      32U         /**< Size of the header */
+#define COSE_KEYSTORE_INDEX_SIZE    12U         /**< Size of an index entry */
+#define COSE_KEYSTORE_RECORD_SIZE   32U         /**< Size of a key record */
+#define COSE_KEYSTORE_EC2_BYTES     66U         /**< Storage size of EC2 key parts */
+
+/**
+ * @brief Opened keystore image
+ */
+typedef struct cose_keystore {
+    const uint8_t *buf;     /**< Keystore image */
+    size_t len;             /**< Size of the image */
+    uint32_t num;           /**< Number of keys */
+    uint32_t index;         /**< Offset of the index */
+    uint32_t records;       /**< Offset of the key records */
+    uint32_t stride;        /**< Size of a key record */
+    uint32_t data;          /**< Offset of the data section */
+    uint32_t data_len;      /**< Size of the data section */
+} cose_keystore_t;
+
+/**
+ * Build a keystore image from an array of keys
+ *
+ * @param   keys        Keys to store, with unique key identifiers
+ * @param   num         Number of keys
+ * @param   private_key Include the private or secret key parts
+ * @param   buf         Buffer to write to, NULL to only compute the size
+ * @param   len         Size of the buffer
+ *
+ * @return              Size of the image
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ * @return              COSE_ERR_INVALID_PARAM for unsupported key types or
+ *                      duplicate key identifiers
+ */
+COSE_ssize_t cose_keystore_encode(const cose_key_t *keys, size_t num,
+                                  bool private_key, uint8_t *buf, size_t len);
+
+/**
+ * Open a keystore image
+ *
+ * Only the header is checked, the keys are checked when they are accessed.
+ *
+ * @param   store   Keystore to initialize
+ * @param   buf     Keystore image, must remain valid while the keystore and
+ *                  the key views are used
+ * @param   len     Size of the image
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_INVALID_PARAM when the image is not a keystore
+ *                  or truncated
+ */
+int cose_keystore_open(cose_keystore_t *store, const uint8_t *buf, size_t len);
+
+/**
+ * Get a key view by position in the keystore
+ *
+ * @param   store   Opened keystore
+ * @param   idx     Key position, below @ref cose_keystore_t::num
+ * @param   key     Key to initialize as view into the image
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOT_FOUND when @p idx is out of range
+ * @return          COSE_ERR_INVALID_PARAM for malformed key records
+ */
+int cose_keystore_get(const cose_keystore_t *store, size_t idx,
+                      cose_key_t *key);
+
+/**
+ * Find a key view by key identifier
+ *
+ * Binary search over the sorted index.
+ *
+ * @param   store   Opened keystore
+ * @param   kid     Key identifier
+ * @param   kid_len Length of the key identifier
+ * @param   key     Key to initialize as view into the image
+ *
+ * @return          COSE_OK on success
+ * @return          COSE_ERR_NOT_FOUND when no key has this identifier
+ * @return          COSE_ERR_INVALID_PARAM for malformed index entries or
+ *                  key records
+ */
+int cose_keystore_find(const cose_keystore_t *store, const uint8_t *kid,
+                       size_t kid_len, cose_key_t *key);
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,12 +30,239 @@
 extern "C" {
 #endif
 
+/**
+ * @name Direct key derivation
+ *
+ * Direct+HKDF recipients derive the content encryption key from a secret
+ * shared with the recipient, RFC 9053 section 5.1. The COSE_KDF_Context
+ * used as HKDF info binds the content algorithm and key length, the PartyU
+ * and PartyV information and the protected headers of the recipient.
+ *
+ * Both HKDF steps can be cached in a @ref cose_hkdf_cache_t. The
+ * HKDF-Extract output is kept per shared secret and salt, derived keys per
+ * context, so a sender or receiver reusing a context pays the HMAC cost
+ * only once. Entries are keyed on a digest of the shared secret, or with
+ * ECDH-SS on digests of the own and the peer public key, so key objects can
+ * be refilled between calls. Own ECDH keys without public part are not
+ * cached. A cache is not thread safe.
+ *
+ * ECDH-SS+HKDF recipients, RFC 9053 section 6.3.1, take the shared secret
+ * from an ECDH between the static key of the local party and the static
+ * public key of the peer. The results of the scalar multiplication can be
+ * kept in a @ref cose_ecdh_cache_t, which can be shared between threads.
+ * @{
+ */
+
+#define COSE_HKDF_PRK_MAX   64U /**< Largest HKDF pseudorandom key */
+#define COSE_HKDF_CEK_MAX   32U /**< Largest cached content encryption key */
+#define COSE_ECDH_PEER_HASH_LEN 16U /**< Truncated digest of a peer public key */
+
+/**
+ * @brief Cached HKDF-Extract output
+ */
+typedef struct cose_hkdf_prk {
+    uint8_t key[COSE_ECDH_PEER_HASH_LEN];   /**< Digest of the shared secret
+                                                 or the own public key */
+    uint8_t peer[COSE_ECDH_PEER_HASH_LEN];  /**< Digest of the peer key with
+                                                 ECDH-SS */
+    uint32_t id;                            /**< Insertion stamp */
+    uint32_t used;                          /**< Last use, 0 when empty */
+    cose_algo_t algo;                       /**< Key derivation algorithm */
+    uint8_t salt_len;                       /**< Length of the salt */
+    uint8_t salt[COSE_HKDF_CACHE_SALT_MAX]; /**< Salt */
+    uint8_t prk[COSE_HKDF_PRK_MAX];         /**< Pseudorandom key */
+} cose_hkdf_prk_t;
+
+/**
+ * @brief Cached derived content encryption key
+ */
+typedef struct cose_hkdf_cek {
+    uint32_t prk_id;                        /**< Insertion stamp of the PRK */
+    uint32_t used;                          /**< Last use, 0 when empty */
+    uint8_t prk;                            /**< Index of the PRK entry */
+    uint8_t cek_len;                        /**< Length of the key */
+    uint16_t context_len;                   /**< Length of the context */
+    uint8_t cek[COSE_HKDF_CEK_MAX];         /**< Derived key */
+    uint8_t context[COSE_HKDF_CACHE_CONTEXT_MAX]; /**< COSE_KDF_Context */
+} cose_hkdf_cek_t;
+
+/**
+ * @brief HKDF derivation cache
+ */
+typedef struct cose_hkdf_cache {
+    cose_hkdf_prk_t prk[COSE_HKDF_CACHE_PRKS];  /**< Extract outputs */
+    cose_hkdf_cek_t cek[COSE_HKDF_CACHE_CEKS];  /**< Derived keys */
+    uint32_t clock;                             /**< Use counter */
+} cose_hkdf_cache_t;
+
+#define COSE_ECDH_SECRET_MAX    66U /**< Largest shared secret, P-521 */
+
+/**
+ * @brief Cached static-static ECDH shared secret
+ */
+typedef struct cose_ecdh_entry {
+    uint32_t used;                          /**< Last use, 0 when empty */
+    uint32_t expires;                       /**< Expiry time */
+    uint8_t kid_len;                        /**< Length of the key identifier */
+    uint8_t secret_len;                     /**< Length of the secret */
+    uint8_t kid[COSE_ECDH_CACHE_KID_MAX];   /**< Identifier of the own key */
+    uint8_t peer[COSE_ECDH_PEER_HASH_LEN];  /**< Digest of the peer key */
+    uint8_t secret[COSE_ECDH_SECRET_MAX];   /**< Shared secret */
+} cose_ecdh_entry_t;
+
+/**
+ * @brief ECDH shared secret cache
+ *
+ * Entries are keyed on the identifier of the own key and a digest of the
+ * public key of the peer, own keys without identifier are not cached.
+ * Expired and evicted secrets are wiped.
+ */
+typedef struct cose_ecdh_cache {
+    cose_ecdh_entry_t entries[COSE_ECDH_CACHE_ENTRIES]; /**< Shared secrets */
+    const cose_lock_t *lock;    /**< Lock, NULL for single threaded use */
+    cose_clock_fn_t now;        /**< Clock, NULL to disable expiry */
+    void *now_arg;              /**< Clock argument */
+    uint32_t ttl;               /**< Lifetime of an entry in seconds */
+    uint32_t clock;             /**< Use counter */
+} cose_ecdh_cache_t;
+
+/**
+ * @brief Key derivation parameters of a direct+HKDF or ECDH-SS+HKDF
+ *        recipient
+ *
+ * Optional parameters are NULL when not used.
+ */
+typedef struct cose_recp_kdf {
+    cose_algo_t algo;           /**< Direct or ECDH-SS HKDF algorithm */
+    const uint8_t *salt;        /**< Salt */
+    size_t salt_len;            /**< Length of the salt */
+    const uint8_t *u_id;        /**< PartyU identity */
+    size_t u_id_len;            /**< Length of the PartyU identity */
+    const uint8_t *u_nonce;     /**< PartyU nonce */
+    size_t u_nonce_len;         /**< Length of the PartyU nonce */
+    const uint8_t *v_id;        /**< PartyV identity */
+    size_t v_id_len;            /**< Length of the PartyV identity */
+    const uint8_t *v_nonce;     /**< PartyV nonce */
+    size_t v_nonce_len;         /**< Length of the PartyV nonce */
+    const uint8_t *skid;        /**< Static key identifier of the sender,
+                                     only set when decoding */
+    size_t skid_len;            /**< Length of the static key identifier */
+    const cose_key_t *peer;     /**< Static public key of the peer with
+                                     ECDH-SS */
+    cose_hkdf_cache_t *cache;   /**< Derivation cache, NULL to disable */
+    cose_ecdh_cache_t *ecdh;    /**< Shared secret cache, NULL to disable */
+} cose_recp_kdf_t;
+
+/**
+ * @brief Initialize a derivation cache, wiping all cached keys
+ *
+ * @param   cache   Cache to initialize
+ */
+void cose_hkdf_cache_init(cose_hkdf_cache_t *cache);
+
+/**
+ * @brief Initialize a shared secret cache
+ *
+ * @param   cache   Cache to initialize
+ * @param   ttl     Lifetime of the cached secrets in seconds
+ * @param   now     Clock, NULL to keep secrets until they are evicted
+ * @param   arg     Argument passed to the clock
+ * @param   lock    Lock protecting the cache, NULL for single threaded use
+ */
+void cose_ecdh_cache_init(cose_ecdh_cache_t *cache, uint32_t ttl,
+                          cose_clock_fn_t now, void *arg,
+                          const cose_lock_t *lock);
+
+/**
+ * @brief Wipe all secrets from a shared secret cache
+ *
+ * @param   cache   Cache to flush
+ */
+void cose_ecdh_cache_flush(cose_ecdh_cache_t *cache);
+
+/**
+ * @brief Compute an ECDH shared secret through a cache
+ *
+ * The scalar multiplication runs without holding the lock of the cache.
+ *
+ * @param       cache       Shared secret cache, NULL to disable
+ * @param       key         Own key with the private part
+ * @param       peer        Public key of the peer
+ * @param[out]  secret      Shared secret, @ref COSE_ECDH_SECRET_MAX bytes
+ * @param[out]  secret_len  Length of the shared secret
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error, see @ref cose_crypto_ecdh
+ */
+int cose_ecdh_cache_secret(cose_ecdh_cache_t *cache, const cose_key_t *key,
+                           const cose_key_t *peer, uint8_t *secret,
+                           size_t *secret_len);
+
+/**
+ * @brief Serialize the protected headers of a direct+HKDF recipient
+ *
+ * @param       kdf     Key derivation parameters
+ * @param[out]  buf     Buffer to write the header map to
+ * @param       len     Size of the buffer
+ *
+ * @return              Size of the header map
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ */
+COSE_ssize_t cose_recp_kdf_protected(const cose_recp_kdf_t *kdf, uint8_t *buf,
+                                     size_t len);
+
+/**
+ * @brief Encode the COSE_KDF_Context of a direct+HKDF recipient
+ *
+ * @param       kdf         Key derivation parameters
+ * @param       algo        Content encryption algorithm
+ * @param       key_len     Length of the content encryption key
+ * @param       prot        Serialized protected headers of the recipient
+ * @param       prot_len    Length of the protected headers
+ * @param[out]  buf         Buffer to write the context to
+ * @param       len         Size of the buffer
+ *
+ * @return                  Size of the context
+ * @return                  COSE_ERR_NOMEM when the buffer is too small
+ */
+COSE_ssize_t cose_recp_kdf_context(const cose_recp_kdf_t *kdf, cose_algo_t algo,
+                                   size_t key_len, const uint8_t *prot,
+                                   size_t prot_len, uint8_t *buf, size_t len);
+
+/**
+ * @brief Derive the content encryption key of a direct+HKDF or
+ *        ECDH-SS+HKDF recipient
+ *
+ * For direct+HKDF the shared secret is taken from key->d and has the key
+ * length of the content encryption algorithm. For ECDH-SS+HKDF it is
+ * agreed between @p key and kdf->peer.
+ *
+ * @param       kdf         Key derivation parameters
+ * @param       key         Key with the shared secret or own static key
+ * @param       algo        Content encryption algorithm
+ * @param       key_len     Length of the content encryption key
+ * @param       prot        Serialized protected headers of the recipient
+ * @param       prot_len    Length of the protected headers
+ * @param[out]  cek         Derived key, @p key_len bytes
+ * @param       buf         Scratch buffer for the context
+ * @param       len         Size of the scratch buffer
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error
+ */
+int cose_recp_kdf_derive(const cose_recp_kdf_t *kdf, const cose_key_t *key,
+                         cose_algo_t algo, size_t key_len,
+                         const uint8_t *prot, size_t prot_len, uint8_t *cek,
+                         uint8_t *buf, size_t len);
+/** @} */
+
 /**
  * @name COSE recipient struct definition
  */
 typedef struct cose_recp {
     struct cose_recp *parent;           /**< Parent recipient structure */
     const cose_key_t *key;              /**< Pointer to the key structure used */
+    const cose_recp_kdf_t *kdf;         /**< Key derivation, NULL for direct use */
     const uint8_t *skey;                /**< Secret key used */
     size_t key_len;                     /**< Length of the secret key */
     cose_headers_t hdrs;                /**< Headers included with this recipient */
@@ -62,6 +289,25 @@ int cose_recp_encrypt_to_map(cose_recp_t *recps, size_t num_recps,
  */
 void cose_recp_decode_init(cose_recp_dec_t *recp, const uint8_t *buf, size_t len);
 
+/**
+ * @brief Decode the key derivation parameters of a recipient
+ *
+ * The returned parameters point into the recipient buffer, the caches and
+ * the peer key are set to NULL. With ECDH-SS the static key identifier
+ * of the sender selects the peer key.
+ *
+ * @param       recp        Recipient to decode
+ * @param[out]  kdf         Key derivation parameters
+ * @param[out]  prot        Serialized protected headers of the recipient
+ * @param[out]  prot_len    Length of the protected headers
+ *
+ * @return                  COSE_OK for direct+HKDF and ECDH-SS+HKDF recipients
+ * @return                  COSE_ERR_NOT_FOUND for other recipients
+ * @return                  COSE_ERR_INVALID_CBOR on malformed headers
+ */
+int cose_recp_decode_kdf(const cose_recp_dec_t *recp, cose_recp_kdf_t *kdf,
+                         const uint8_t **prot, size_t *prot_len);
+
 #ifdef __cplusplus
 }
 #endif
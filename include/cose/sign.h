@@ -24,6 +24,7 @@
 #ifndef COSE_SIGN_H
 #define COSE_SIGN_H
 
+#include "cose/common.h"
 #include "cose/conf.h"
 #include "cose/hdr.h"
 #include "cose/key.h"
@@ -68,6 +69,23 @@ typedef struct cose_sign_dec {
 } cose_sign_dec_t;
 /** @} */
 
+/**
+ * @name Concurrent verification job
+ *
+ * One (counter)signature check of @ref cose_sign_verify_concurrent
+ * @{
+ */
+typedef struct cose_sign_verify_job {
+    const cose_sign_dec_t *sign;    /**< Sign object verified */
+    cose_signature_dec_t signature; /**< Signature or countersignature */
+    const cose_key_t *key;          /**< Key to verify with */
+    uint8_t *buf;                   /**< Scratch buffer of this job */
+    size_t len;                     /**< Size of the scratch buffer */
+    int res;                        /**< Verification result */
+    bool counter;                   /**< Job checks a countersignature */
+} cose_sign_verify_job_t;
+/** @} */
+
 /**
  * @brief String constant used for signing COSE signature objects
  */
@@ -83,6 +101,12 @@ static const char SIG_TYPE_SIGNATURE1[] = "Signature1";
  */
 static const char SIG_TYPE_COUNTERSIGNATURE[] = "CounterSignature";
 
+/**
+ * @brief String constant used for countersignatures over a structure with
+ *        further fields, such as the signature of a COSE sign1 object
+ */
+static const char SIG_TYPE_COUNTERSIGNATURE_V2[] = "CounterSignatureV2";
+
 /**
  * @name Size of the signature classes without zero terminator
  *
@@ -93,6 +117,95 @@ static const char SIG_TYPE_COUNTERSIGNATURE[] = "CounterSignature";
 #define COSE_SIGN_STR_COUNTERSIGNATURE_LEN  (sizeof(countersignature) - 1)
 /** @} */
 
+/**
+ * @name COSE sign buffer size helpers
+ *
+ * Compile time upper bounds for the buffers passed to @ref cose_sign_encode
+ * and @ref cose_sign_verify. All arguments are sizes in bytes. @p prot and
+ * @p unprot are the sizes of the encoded header maps, including the headers
+ * added from the signer key (algorithm and key ID). For a COSE sign1 object
+ * these are the merged body and signer header maps.
+ *
+ * With fixed-size payloads and headers these evaluate to a constant
+ * expression and can be used to size a static buffer.
+ * @{
+ */
+
+/**
+ * @brief Size of the Sig_structure of a COSE sign1 object
+ */
+#define COSE_SIGN1_TBS_SIZE(prot, aad, payload) \
+    (1U + COSE_CBOR_BSTR_SIZE(sizeof(SIG_TYPE_SIGNATURE1) - 1) + \
+     COSE_CBOR_BSTR_SIZE(prot) + COSE_CBOR_BSTR_SIZE(aad) + \
+     COSE_CBOR_BSTR_SIZE(payload))
+
+/**
+ * @brief Size of the Sig_structure of a single signer in a COSE sign object
+ */
+#define COSE_SIGN_TBS_SIZE(prot, sig_prot, aad, payload) \
+    (1U + COSE_CBOR_BSTR_SIZE(sizeof(SIG_TYPE_SIGNATURE) - 1) + \
+     COSE_CBOR_BSTR_SIZE(prot) + COSE_CBOR_BSTR_SIZE(sig_prot) + \
+     COSE_CBOR_BSTR_SIZE(aad) + COSE_CBOR_BSTR_SIZE(payload))
+
+/**
+ * @brief Size of the Countersign_structure of a countersignature
+ *
+ * @p sig is the size of the signature of a COSE sign1 object, which is part
+ * of the structure together with the "CounterSignatureV2" context. For a
+ * COSE sign object pass 0, the result is then an upper bound.
+ */
+#define COSE_COUNTERSIGN_TBS_SIZE(prot, cs_prot, aad, payload, sig) \
+    (1U + COSE_CBOR_BSTR_SIZE(sizeof(SIG_TYPE_COUNTERSIGNATURE_V2) - 1) + \
+     COSE_CBOR_BSTR_SIZE(prot) + COSE_CBOR_BSTR_SIZE(cs_prot) + \
+     COSE_CBOR_BSTR_SIZE(aad) + COSE_CBOR_BSTR_SIZE(payload) + \
+     1U + COSE_CBOR_BSTR_SIZE(sig))
+
+/**
+ * @brief Size of an encoded COSE sign1 object
+ */
+#define COSE_SIGN1_SIZE(prot, unprot, payload, sig) \
+    (COSE_CBOR_HEAD_SIZE(COSE_SIGN1) + 1U + COSE_CBOR_BSTR_SIZE(prot) + \
+     (unprot) + COSE_CBOR_BSTR_SIZE(payload) + COSE_CBOR_BSTR_SIZE(sig))
+
+/**
+ * @brief Size of a single encoded COSE_Signature structure
+ */
+#define COSE_SIGNATURE_SIZE(sig_prot, sig_unprot, sig) \
+    (1U + COSE_CBOR_BSTR_SIZE(sig_prot) + (sig_unprot) + \
+     COSE_CBOR_BSTR_SIZE(sig))
+
+/**
+ * @brief Size of an encoded COSE sign object with @p num identically shaped
+ *        signers
+ */
+#define COSE_SIGN_SIZE(prot, unprot, payload, sig_prot, sig_unprot, sig, num) \
+    (COSE_CBOR_HEAD_SIZE(COSE_SIGN) + 1U + COSE_CBOR_BSTR_SIZE(prot) + \
+     (unprot) + COSE_CBOR_BSTR_SIZE(payload) + COSE_CBOR_HEAD_SIZE(num) + \
+     (num) * COSE_SIGNATURE_SIZE(sig_prot, sig_unprot, sig))
+
+/**
+ * @brief Buffer size required by @ref cose_sign_encode for a COSE sign1
+ *        object
+ *
+ * The signature is placed at the start of the buffer, followed by either the
+ * Sig_structure or the final encoded object.
+ */
+#define COSE_SIGN1_ENCODE_BUFSIZE(prot, unprot, aad, payload, sig) \
+    ((sig) + COSE_CBOR_SIZE_MAX(COSE_SIGN1_TBS_SIZE(prot, aad, payload), \
+                                COSE_SIGN1_SIZE(prot, unprot, payload, sig)))
+
+/**
+ * @brief Buffer size required by @ref cose_sign_encode for a COSE sign
+ *        object with @p num identically shaped signers
+ */
+#define COSE_SIGN_ENCODE_BUFSIZE(prot, unprot, aad, payload, \
+                                 sig_prot, sig_unprot, sig, num) \
+    ((num) * (sig) + \
+     COSE_CBOR_SIZE_MAX(COSE_SIGN_TBS_SIZE(prot, sig_prot, aad, payload), \
+                        COSE_SIGN_SIZE(prot, unprot, payload, sig_prot, \
+                                       sig_unprot, sig, num)))
+/** @} */
+
 /**
  * @name COSE sign encoding functions
  * @{
@@ -182,7 +295,9 @@ static inline void cose_sign_insert_unprot(cose_sign_enc_t *sign, cose_hdr_t *hd
  * headers, the payload, the additionally authenticated data and the
  * signatures at the same time. This is a limitation caused by how the COSE
  * signatures to be generated and how crypto libraries require their message
- * as one continuous block of data.
+ * as one continuous block of data. @ref COSE_SIGN1_ENCODE_BUFSIZE and
+ * @ref COSE_SIGN_ENCODE_BUFSIZE give the required size for fixed-size
+ * messages.
  *
  * @param       sign    Sign struct to encode
  * @param       buf     Buffer to write in
@@ -194,6 +309,49 @@ static inline void cose_sign_insert_unprot(cose_sign_enc_t *sign, cose_hdr_t *hd
  */
 COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, uint8_t **out);
 
+/**
+ * @brief Build the Sig_structure (ToBeSigned) of a single signer
+ *
+ * Together with @ref cose_sign_encode_signed this splits
+ * @ref cose_sign_encode in separate steps, allowing the signatures to be
+ * generated outside of the library call, e.g. on a worker thread, in a
+ * hardware token or by a remote signing service. The signature over the
+ * returned bytes is attached to the signer with
+ * @ref cose_signature_set_signature.
+ *
+ * All signers must be added to the sign object before calling this function,
+ * as the number of signers determines the structure of the Sig_structure.
+ *
+ * @param   sign        Sign struct to encode
+ * @param   sig         Signer to build the Sig_structure for
+ * @param   buf         Buffer to write the Sig_structure in
+ * @param   len         Size of the buffer
+ *
+ * @return              Length of the Sig_structure
+ * @return              Negative on error
+ */
+COSE_ssize_t cose_sign_encode_tbs(cose_sign_enc_t *sign, cose_signature_t *sig,
+                                  uint8_t *buf, size_t len);
+
+/**
+ * @brief Encode a sign object with previously generated signatures
+ *
+ * No cryptographic operations are done by this function, every signer must
+ * have a signature attached by @ref cose_signature_set_signature. The
+ * signatures must remain valid until the function returns.
+ *
+ * @param       sign    Sign struct to encode
+ * @param       buf     Buffer to write in
+ * @param       len     Size of the buffer to write in
+ * @param[out]  out     Pointer to where the COSE sign struct starts
+ *
+ * @return              The number of bytes written
+ * @return              COSE_ERR_INVALID_PARAM when a signature is missing
+ * @return              Negative on error
+ */
+COSE_ssize_t cose_sign_encode_signed(cose_sign_enc_t *sign, uint8_t *buf,
+                                     size_t len, uint8_t **out);
+
 /** @} (no more encoding functions */
 
 /**
@@ -214,6 +372,26 @@ COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, u
  */
 int cose_sign_decode(cose_sign_dec_t *sign, const uint8_t *buf, size_t len);
 
+/**
+ * cose_sign_decode_validate parses a buffer to a cose sign struct after
+ * validating the complete structure against a set of work limits.
+ *
+ * All nested items, including the header maps and signatures, are checked
+ * in a single pass before the struct is filled, bounding the time spent on
+ * hostile input.
+ *
+ * @param   sign    Decoder sign struct to fill
+ * @param   buf     The buffer to read
+ * @param   len     Length of the buffer
+ * @param   limits  Limits to enforce, NULL for the compile time defaults
+ *
+ * @return          0 on success
+ * @return          COSE_ERR_INVALID_CBOR on malformed input
+ * @return          COSE_ERR_CBOR_NOTSUP when a limit is exceeded
+ */
+int cose_sign_decode_validate(cose_sign_dec_t *sign, const uint8_t *buf,
+                              size_t len, const cose_decode_limits_t *limits);
+
 /**
  * @brief Set the payload of the decoded sign structure
  *
@@ -314,12 +492,50 @@ static inline void cose_sign_signature_iter_init(cose_signature_dec_t *signature
  */
 bool cose_sign_signature_iter(const cose_sign_dec_t *sign, cose_signature_dec_t *signature);
 
+/**
+ * @brief Build the Sig_structure of a signature for verification
+ *
+ * Together with @ref cose_sign_decode_signature this allows the signature
+ * verification to be done outside of the library, e.g. on a worker thread,
+ * by passing both to @ref cose_crypto_verify.
+ *
+ * @param   sign        The sign object to verify
+ * @param   signature   A signature object belonging to the sign object
+ * @param   buf         Buffer to write the Sig_structure in
+ * @param   len         Size of the buffer
+ *
+ * @return              Length of the Sig_structure
+ * @return              Negative on error
+ */
+COSE_ssize_t cose_sign_verify_tbs(const cose_sign_dec_t *sign,
+                                  cose_signature_dec_t *signature,
+                                  uint8_t *buf, size_t len);
+
+/**
+ * @brief Retrieve the signature bytes of a signature object
+ *
+ * Handles both COSE sign1 objects, where the signature is part of the body,
+ * and COSE sign objects.
+ *
+ * @param       sign        The sign object
+ * @param       signature   A signature object belonging to the sign object
+ * @param[out]  sig         Pointer to the signature bytes
+ * @param[out]  len         Length of the signature
+ *
+ * @return                  COSE_OK on success
+ * @return                  Negative on error
+ */
+int cose_sign_decode_signature(const cose_sign_dec_t *sign,
+                               const cose_signature_dec_t *signature,
+                               const uint8_t **sig, size_t *len);
+
 /**
  * Verify the signature of the signed data with the supplied signature object
  *
  * The buffer is required as scratch space to build the signature structs in.
  * The buffer must be large enough to contain the headers, payload and the
- * additional authenticated data.
+ * additional authenticated data, see @ref COSE_SIGN1_TBS_SIZE and
+ * @ref COSE_SIGN_TBS_SIZE.
  *
  * @param   sign        The sign object to verify
  * @param   signature   A signature object belonging to the sign object
@@ -347,8 +563,296 @@ int cose_sign_verify(const cose_sign_dec_t *sign, cose_signature_dec_t *signatur
 int cose_sign_verify_first(const cose_sign_dec_t* sign, cose_key_t *key,
                            uint8_t *buf, size_t len);
 
+/**
+ * Add a signer to an already encoded COSE sign object
+ *
+ * The Sig_structure for the new signer is built from the protected headers
+ * and payload of the decoded object and the new entry is appended to the
+ * signatures array. The existing headers, payload and signatures are copied
+ * as is, only the signatures array header is rewritten. For a detached
+ * payload and external additional data, set them on @p sign first.
+ *
+ * @p buf is either the buffer holding the encoded object, which is then
+ * extended in place, or a separate buffer not overlapping it. The buffer
+ * must hold the extended object plus the signature and the Sig_structure
+ * of the new signer, which are built behind it. @p sign refers to stale
+ * data after an in place append and must be decoded again.
+ *
+ * A COSE_Sign1 can't be extended: its signature is made over a
+ * Signature1 context which is not valid inside a COSE_Sign.
+ *
+ * @param   sign        Decoded COSE sign object
+ * @param   signer      Signature struct with optional headers for the signer
+ * @param   key         Key to sign with
+ * @param   buf         Buffer to write in
+ * @param   len         Size of the buffer
+ * @param[out] out      Pointer to the start of the new object
+ *
+ * @return              Size of the new COSE sign object
+ * @return              COSE_ERR_INVALID_PARAM for a COSE_Sign1
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ * @return              Negative on other errors
+ */
+COSE_ssize_t cose_sign_append_signer(const cose_sign_dec_t *sign,
+                                     cose_signature_t *signer,
+                                     const cose_key_t *key,
+                                     uint8_t *buf, size_t len, uint8_t **out);
+
+/**
+ * Countersign an already encoded COSE sign or sign1 object
+ *
+ * Adds an RFC 9338 countersignature over the protected headers, payload and,
+ * for a COSE sign1 object, the signature of @p sign. The countersignature is
+ * added to the countersignature header (@ref COSE_HDR_COUNTERSIG_V2) in the
+ * unprotected headers, turning an existing single countersignature into an
+ * array of countersignatures. All other bytes of the object are copied as
+ * is.
+ *
+ * As with @ref cose_sign_append_signer, @p buf is either the buffer holding
+ * the encoded object or a separate buffer, and must have room for the
+ * signature and the Countersign_structure behind the new object.
+ *
+ * @param   sign        Decoded COSE sign object
+ * @param   signer      Signature struct with optional headers for the
+ *                      countersigner
+ * @param   key         Key to countersign with
+ * @param   buf         Buffer to write in
+ * @param   len         Size of the buffer
+ * @param[out] out      Pointer to the start of the new object
+ *
+ * @return              Size of the new COSE sign object
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ * @return              Negative on other errors
+ */
+COSE_ssize_t cose_sign_countersign(const cose_sign_dec_t *sign,
+                                   cose_signature_t *signer,
+                                   const cose_key_t *key,
+                                   uint8_t *buf, size_t len, uint8_t **out);
+
+/**
+ * Wrapper function initializing a countersignature decoder for iteration
+ *
+ * @param signature Signature decoder struct to initialize
+ */
+static inline void cose_sign_countersignature_iter_init(cose_signature_dec_t *signature)
+{
+    cose_signature_decode_init(signature, NULL, 0);
+}
+
+/**
+ * Iterate over the countersignatures of a sign object
+ *
+ * A COSE_Countersignature has the same structure as a COSE_Signature, the
+ * headers and signature are retrieved with the cose_signature_decode
+ * functions.
+ *
+ * @param       sign        Sign object to iterate over
+ * @param[out]  signature   Countersignature filled with the next entry
+ *
+ * @return                  True when a countersignature is found
+ */
+bool cose_sign_countersignature_iter(const cose_sign_dec_t *sign,
+                                     cose_signature_dec_t *signature);
+
+/**
+ * @brief Build the Countersign_structure of a countersignature
+ *
+ * @param   sign        The sign object
+ * @param   signature   Countersignature of the object
+ * @param   buf         Buffer to write in
+ * @param   len         Size of the buffer
+ *
+ * @return              Size of the structure
+ * @return              COSE_ERR_NOMEM when the buffer is too small
+ */
+COSE_ssize_t cose_sign_countersign_tbs(const cose_sign_dec_t *sign,
+                                       const cose_signature_dec_t *signature,
+                                       uint8_t *buf, size_t len);
+
+/**
+ * Verify a countersignature of a sign object
+ *
+ * The buffer is required as scratch space for the Countersign_structure, see
+ * @ref COSE_COUNTERSIGN_TBS_SIZE.
+ *
+ * @param   sign        The sign object
+ * @param   signature   Countersignature to verify
+ * @param   key         Key of the countersigner
+ * @param   buf         Buffer to write in
+ * @param   len         Size of the buffer
+ *
+ * @return              COSE_OK on successful verification
+ * @return              COSE_ERR_CRYPTO when the countersignature is invalid
+ * @return              Negative on other errors
+ */
+int cose_sign_verify_countersignature(const cose_sign_dec_t *sign,
+                                      const cose_signature_dec_t *signature,
+                                      const cose_key_t *key,
+                                      uint8_t *buf, size_t len);
+
+/**
+ * Verify the signature and the countersignatures of a sign object
+ * concurrently
+ *
+ * The first signature is verified with @p key, the countersignatures in
+ * order with the keys in @p cs_keys, each as a separate job on @p exec. The
+ * scratch buffer is split evenly over the @p num_cs + 1 jobs, each part must
+ * hold the largest Sig_structure or Countersign_structure. Without an
+ * executor the jobs run sequentially. Countersignatures beyond @p num_cs are
+ * not checked.
+ *
+ * @param   sign        The sign object
+ * @param   key         Key for the first signature
+ * @param   cs_keys     Keys of the countersigners
+ * @param   num_cs      Number of countersigner keys
+ * @param   jobs        Array of @p num_cs + 1 jobs, holds the individual
+ *                      results afterwards, the signature first
+ * @param   exec        Executor to run the jobs on, may be NULL
+ * @param   buf         Buffer to write in
+ * @param   len         Size of the buffer
+ *
+ * @return              COSE_OK when all signatures are valid
+ * @return              COSE_ERR_NOT_FOUND when there are less than @p num_cs
+ *                      countersignatures
+ * @return              The first failing job result otherwise
+ */
+int cose_sign_verify_concurrent(const cose_sign_dec_t *sign,
+                                const cose_key_t *key,
+                                const cose_key_t *const *cs_keys,
+                                size_t num_cs, cose_sign_verify_job_t *jobs,
+                                const cose_executor_t *exec,
+                                uint8_t *buf, size_t len);
+
 /** @} (no more decoding functions */
 
+/**
+ * @name Verification scheduler
+ *
+ * Collects verification requests from many threads into batches. A batch
+ * is dispatched as soon as no other batch is running, so an idle scheduler
+ * adds no latency, while requests arriving during a batch queue up for the
+ * next one and batches grow with the load. A batch is also dispatched when
+ * it is full or when its oldest request exceeds the deadline, even while
+ * other batches are running. With @ref cose_sign_sched_cfg_t::linger set,
+ * requests are held until the batch is full or the deadline expires, which
+ * trades latency for larger batches.
+ *
+ * The thread whose submission or poll dispatches a batch runs it, the
+ * batch is split into at most @ref COSE_SIGN_SCHED_JOBS_MAX jobs on the
+ * optional executor. No thread waits on its own, deadlines are checked on
+ * every submission and on @ref cose_sign_sched_poll, which the application
+ * calls periodically when requests can linger.
+ * @{
+ */
+
+/**
+ * @brief Verification request
+ *
+ * The request verifies the first signature of @p sign, as
+ * @ref cose_sign_verify_first. All members must stay valid until the
+ * request is completed.
+ */
+typedef struct cose_sign_sched_req {
+    const cose_sign_dec_t *sign;    /**< Decoded sign object to verify */
+    cose_key_t *key;                /**< Key to verify with */
+    uint8_t *buf;                   /**< Scratch buffer of the request */
+    size_t len;                     /**< Size of the scratch buffer */
+    /**
+     * @brief Completion callback, called with the result set, may reuse
+     *        the request but must not call into the scheduler
+     */
+    void (*done)(struct cose_sign_sched_req *req);
+    void *arg;                      /**< Argument for the callback */
+    int res;                        /**< Verification result, COSE_ERR_NOINIT
+                                         while queued */
+    uint32_t submitted;             /**< Submission time, internal */
+    struct cose_sign_sched_req *next; /**< Next queued request, internal */
+} cose_sign_sched_req_t;
+
+/**
+ * @brief Batching policy of a scheduler
+ */
+typedef struct cose_sign_sched_cfg {
+    uint32_t deadline;  /**< Maximum queueing time in microseconds */
+    uint16_t batch;     /**< Maximum number of requests in a batch */
+    bool linger;        /**< Hold requests for a full batch or the deadline
+                             even when no batch is running */
+} cose_sign_sched_cfg_t;
+
+/**
+ * @brief Verification scheduler
+ */
+typedef struct cose_sign_sched {
+    cose_sign_sched_cfg_t cfg;          /**< Batching policy */
+    const cose_lock_t *lock;            /**< Lock, NULL for single threaded use */
+    const cose_executor_t *exec;        /**< Executor, NULL to run batches
+                                             on the dispatching thread */
+    cose_clock_fn_t now;                /**< Clock, NULL to disable deadlines */
+    void *now_arg;                      /**< Clock argument */
+    cose_sign_sched_req_t *head;        /**< Oldest queued request */
+    cose_sign_sched_req_t *tail;        /**< Newest queued request */
+    size_t queued;                      /**< Number of queued requests */
+    unsigned running;                   /**< Number of running batches */
+} cose_sign_sched_t;
+
+/**
+ * @brief Initialize a batching policy with the compile time defaults
+ *
+ * @param   cfg     Policy to initialize
+ */
+void cose_sign_sched_cfg_init(cose_sign_sched_cfg_t *cfg);
+
+/**
+ * @brief Initialize a verification scheduler
+ *
+ * @param   sched   Scheduler to initialize
+ * @param   cfg     Batching policy, NULL for the compile time defaults
+ * @param   now     Microsecond clock, NULL to disable deadlines
+ * @param   arg     Argument passed to the clock
+ * @param   lock    Lock protecting the queue, NULL for single threaded use
+ * @param   exec    Executor to run the batch jobs on, may be NULL
+ */
+void cose_sign_sched_init(cose_sign_sched_t *sched,
+                          const cose_sign_sched_cfg_t *cfg,
+                          cose_clock_fn_t now, void *arg,
+                          const cose_lock_t *lock,
+                          const cose_executor_t *exec);
+
+/**
+ * @brief Submit a verification request
+ *
+ * The request is queued and completed by whichever call dispatches its
+ * batch, possibly this one.
+ *
+ * @param   sched   Scheduler
+ * @param   req     Request to queue
+ *
+ * @return          Number of requests completed during the call
+ */
+size_t cose_sign_sched_submit(cose_sign_sched_t *sched,
+                              cose_sign_sched_req_t *req);
+
+/**
+ * @brief Dispatch the batches that are due
+ *
+ * Without a clock all queued requests are due.
+ *
+ * @param   sched   Scheduler
+ *
+ * @return          Number of requests completed during the call
+ */
+size_t cose_sign_sched_poll(cose_sign_sched_t *sched);
+
+/**
+ * @brief Dispatch all queued requests
+ *
+ * @param   sched   Scheduler
+ *
+ * @return          Number of requests completed during the call
+ */
+size_t cose_sign_sched_flush(cose_sign_sched_t *sched);
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
@@ -68,6 +68,20 @@ static inline void cose_signature_init(cose_signature_t *signature)
     memset(signature, 0, sizeof(cose_signature_t));
 }
 
+/**
+ * @brief Attach a generated signature to a signature struct
+ *
+ * @param   signature   Signature encoder struct
+ * @param   sig         The signature bytes
+ * @param   len         Length of the signature
+ */
+static inline void cose_signature_set_signature(cose_signature_t *signature,
+                                                const uint8_t *sig, size_t len)
+{
+    signature->signature = sig;
+    signature->signature_len = len;
+}
+
 /**
  * @brief Serialize the protected headers of a signature struct
  *
@@ -135,7 +149,7 @@ void cose_signature_decode_init(cose_signature_dec_t *signature, const uint8_t *
 
 static inline bool cose_signature_decode_protected_buf(const cose_signature_dec_t *signature, const uint8_t **buf, size_t *len)
 {
-    return cose_cbor_decode_get_prot(signature->buf, signature->len, buf, len);
+    return cose_cbor_decode_get_prot(signature->buf, signature->len, buf, len) == COSE_OK;
 }
 
 /**
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    cose_trace COSE static tracepoints
+ * @ingroup     cose_internal
+ *
+ * Optional USDT probes for tracing libcose in production with perf,
+ * bpftrace or SystemTap.
+ *
+ * Building with `CFLAGS=-DCOSE_USDT` places SystemTap compatible probes
+ * from `<sys/sdt.h>` at the entry and return of the signing, verification,
+ * encryption and decryption functions. Every probe is a single nop
+ * instruction until a tracer attaches to it. Without `COSE_USDT` the probe
+ * macros expand to nothing and their arguments are not evaluated.
+ *
+ * All probes belong to the `libcose` provider. `*_entry` probes carry the
+ * COSE algorithm and the payload length, `*_return` probes additionally
+ * carry the result, a negative error or for encoders the encoded length:
+ *
+ * | Probe                   | Function                      |
+ * |-------------------------|-------------------------------|
+ * | `sign_encode`           | @ref cose_sign_encode         |
+ * | `sign_verify`           | @ref cose_sign_verify         |
+ * | `encrypt_encode`        | @ref cose_encrypt_encode      |
+ * | `encrypt_decrypt`       | @ref cose_encrypt_decrypt     |
+ * | `crypto_sign`           | @ref cose_crypto_sign         |
+ * | `crypto_verify`         | @ref cose_crypto_verify       |
+ * | `crypto_aead_encrypt`   | @ref cose_crypto_aead_encrypt |
+ * | `crypto_aead_decrypt`   | @ref cose_crypto_aead_decrypt |
+ *
+ * For example a latency histogram of the signature verifications per
+ * algorithm:
+ *
+ *     bpftrace -e '
+ *       usdt:./libcose.so:libcose:crypto_verify_entry { @t[tid] = nsecs; }
+ *       usdt:./libcose.so:libcose:crypto_verify_return /@t[tid]/ {
+ *           @ns[arg0] = hist(nsecs - @t[tid]); delete(@t[tid]); }'
+ * @{
+ *
+ * @file
+ * @brief       Static tracepoint definitions
+ *
+ * @author      Koen Zandberg <koen@bergzand.net>
+ */
+
+#ifndef COSE_TRACE_H
+#define COSE_TRACE_H
+
+#include <stdint.h>
+
+#ifdef COSE_USDT
+#include <sys/sdt.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(COSE_USDT) || defined(DOXYGEN)
+/**
+ * @brief Probe at the entry of a traced function
+ *
+ * @param   name    Probe name without the `_entry` suffix
+ * @param   algo    COSE algorithm of the operation
+ * @param   len     Payload length
+ */
+#define COSE_TRACE_ENTRY(name, algo, len) \
+    DTRACE_PROBE2(libcose, name##_entry, (int32_t)(algo), (uint64_t)(len))
+
+/**
+ * @brief Probe at the return of a traced function
+ *
+ * @param   name    Probe name without the `_return` suffix
+ * @param   algo    COSE algorithm of the operation
+ * @param   len     Payload length
+ * @param   res     Result of the function
+ */
+#define COSE_TRACE_RETURN(name, algo, len, res) \
+    DTRACE_PROBE3(libcose, name##_return, (int32_t)(algo), (uint64_t)(len), \
+                  (int64_t)(res))
+#else
+#define COSE_TRACE_ENTRY(name, algo, len)        do {} while (0)
+#define COSE_TRACE_RETURN(name, algo, len, res)  do {} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/** @} */
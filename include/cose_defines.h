@@ -40,6 +40,7 @@ typedef enum {
     COSE_ERR_INVALID_PARAM  = -6,   /**< Invalid parameter passed to function */
     COSE_ERR_NOT_FOUND      = -7,   /**< Header not found */
     COSE_ERR_NOTIMPLEMENTED = -8,   /**< Algorithm not implemented */
+    COSE_ERR_REPLAY         = -9,   /**< Replayed or too old message */
 } cose_err_t;
 
 
@@ -106,6 +107,18 @@ typedef enum {
     COSE_HDR_COUNTERSIG     = 7, /**< Counter signature header */
     COSE_HDR_UNASSIGN       = 8, /**< Unassigned header number */
     COSE_HDR_COUNTERSIG0    = 9, /**< Counter signature 0 header*/
+    COSE_HDR_COUNTERSIG_V2  = 11, /**< Counter signature version 2 header,
+                                   *   rfc 9338 */
+    COSE_HDR_COUNTERSIG0_V2 = 12, /**< Counter signature 0 version 2
+                                   *   header, rfc 9338 */
+    COSE_HDR_STATIC_KEY_ID  = -3, /**< Static key identifier of the sender */
+    COSE_HDR_SALT           = -20, /**< Salt for key derivation */
+    COSE_HDR_PARTYU_ID      = -21, /**< PartyU identity */
+    COSE_HDR_PARTYU_NONCE   = -22, /**< PartyU nonce */
+    COSE_HDR_PARTYU_OTHER   = -23, /**< PartyU other provided information */
+    COSE_HDR_PARTYV_ID      = -24, /**< PartyV identity */
+    COSE_HDR_PARTYV_NONCE   = -25, /**< PartyV nonce */
+    COSE_HDR_PARTYV_OTHER   = -26, /**< PartyV other provided information */
 } cose_header_param_t;
 
 /**
@@ -121,6 +134,19 @@ typedef enum {
     COSE_KEY_PARAM_BIV  = 5,    /**< Base IV */
 } cose_key_param_t;
 
+/**
+ * @brief COSE Key type specific parameters of EC2, OKP and symmetric keys
+ *
+ * https://www.iana.org/assignments/cose/cose.xhtml#key-type-parameters
+ */
+typedef enum {
+    COSE_KEY_PARAM_K    = -1,   /**< Symmetric key value */
+    COSE_KEY_PARAM_CRV  = -1,   /**< EC2 and OKP curve */
+    COSE_KEY_PARAM_X    = -2,   /**< x-coordinate or OKP public key */
+    COSE_KEY_PARAM_Y    = -3,   /**< EC2 y-coordinate */
+    COSE_KEY_PARAM_D    = -4,   /**< Private key */
+} cose_key_type_param_t;
+
 /**
  * @brief COSE key types according to rfc 8152
  *
@@ -152,8 +178,15 @@ typedef enum {
  */
 typedef enum {
     COSE_ALGO_NONE  = 0,                /**< Invalid algo */
+    COSE_ALGO_PS512 = -39,              /**< RSASSA-PSS w/ SHA-512 */
+    COSE_ALGO_PS384 = -38,              /**< RSASSA-PSS w/ SHA-384 */
+    COSE_ALGO_PS256 = -37,              /**< RSASSA-PSS w/ SHA-256 */
     COSE_ALGO_ES512 = -36,              /**< ECDSA w/ SHA512 */
     COSE_ALGO_ES384 = -35,              /**< ECDSA w/ SHA384 */
+    COSE_ALGO_ECDH_SS_HKDF_SHA512 = -28, /**< Static-static ECDH w/ HKDF and SHA-512 */
+    COSE_ALGO_ECDH_SS_HKDF_SHA256 = -27, /**< Static-static ECDH w/ HKDF and SHA-256 */
+    COSE_ALGO_DIRECT_HKDF_SHA512 = -11, /**< Shared secret w/ HKDF and SHA-512 */
+    COSE_ALGO_DIRECT_HKDF_SHA256 = -10, /**< Shared secret w/ HKDF and SHA-256 */
     COSE_ALGO_EDDSA = -8,               /**< EdDSA */
     COSE_ALGO_ES256 = -7,               /**< ECDSA w/ SHA256 */
     COSE_ALGO_DIRECT = -6,              /**< Direct use of CEK */
@@ -0,0 +1,2 @@
+CFLAGS += -DCRYPTO_AES
+CRYPTOSRC += $(SRC_DIR)/crypt/aes.c
@@ -0,0 +1,2 @@
+CFLAGS += -DCRYPTO_CHACHAPOLY
+CRYPTOSRC += $(SRC_DIR)/crypt/chachapoly.c
@@ -0,0 +1,6 @@
+OPENSSL_LIB ?= -lcrypto
+
+CFLAGS += -DCRYPTO_OPENSSL
+CRYPTOSRC += $(SRC_DIR)/crypt/openssl.c
+
+LDFLAGS_CRYPTO += $(OPENSSL_LIB)
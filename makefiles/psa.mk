@@ -0,0 +1,6 @@
+PSA_LIB ?= "/usr/lib64/libmbedcrypto.so"
+
+CFLAGS += -DCRYPTO_PSA
+CRYPTOSRC += $(SRC_DIR)/crypt/psa.c
+
+LDFLAGS_CRYPTO += -Wl,$(PSA_LIB)
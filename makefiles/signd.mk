@@ -0,0 +1,2 @@
+CFLAGS += -DCRYPTO_SIGND
+CRYPTOSRC += $(SRC_DIR)/crypt/signd.c
@@ -5,6 +5,6 @@ CFLAGS += -DCRYPTO_TINYCRYPT
 
 TINYCRYPT_INCLUDE ?= -I$(TINYCRYPT_DIR)/include
 
-CRYPTOSRC = $(SRC_DIR)/crypt/tinycrypt.c
+CRYPTOSRC += $(SRC_DIR)/crypt/tinycrypt.c
 CFLAGS_CRYPTO += $(TINYCRYPT_INCLUDE)
 LDFLAGS_CRYPTO += $(TINYCRYPT_LIB)
@@ -61,3 +61,224 @@ int cose_cbor_decode_get_unprot(const uint8_t *start, size_t len,
     }
     return COSE_OK;
 }
+
+static const cose_decode_limits_t _default_limits = {
+    .items = COSE_DECODE_ITEMS_MAX,
+    .hdrs = COSE_DECODE_HDRS_MAX,
+    .map_size = COSE_DECODE_MAP_MAX,
+    .depth = COSE_DECODE_DEPTH_MAX,
+};
+
+void cose_decode_limits_init(cose_decode_limits_t *limits)
+{
+    *limits = _default_limits;
+}
+
+void cose_cbor_validator_init(cose_cbor_validator_t *v,
+                              const cose_decode_limits_t *limits)
+{
+    v->limits = limits ? limits : &_default_limits;
+    v->items = 0;
+}
+
+static int _validate_count(cose_cbor_validator_t *v)
+{
+    if (v->items >= v->limits->items) {
+        return COSE_ERR_CBOR_NOTSUP;
+    }
+    v->items++;
+    return COSE_OK;
+}
+
+/* Enter a container, rejecting declared sizes the buffer can't hold */
+static int _validate_enter(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                           nanocbor_value_t *container, unsigned depth)
+{
+    int res = _validate_count(v);
+    if (res < 0) {
+        return res;
+    }
+    if (depth >= v->limits->depth) {
+        return COSE_ERR_CBOR_NOTSUP;
+    }
+    res = (nanocbor_get_type(it) == NANOCBOR_TYPE_MAP) ?
+        nanocbor_enter_map(it, container) : nanocbor_enter_array(it, container);
+    if (res < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    /* Every item takes at least one byte */
+    if (!nanocbor_container_indefinite(container) &&
+            nanocbor_container_remaining(container) >
+            (size_t)(container->end - container->cur)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    return COSE_OK;
+}
+
+static int _validate_map(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                         unsigned depth, uint32_t max, bool hdrs)
+{
+    nanocbor_value_t map;
+    uint32_t entries = 0;
+
+    if (nanocbor_get_type(it) != NANOCBOR_TYPE_MAP) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    int res = _validate_enter(v, it, &map, depth);
+    if (res < 0) {
+        return res;
+    }
+    if (!nanocbor_container_indefinite(&map) &&
+            nanocbor_container_remaining(&map) / 2 > max) {
+        return COSE_ERR_CBOR_NOTSUP;
+    }
+    while (!nanocbor_at_end(&map)) {
+        if (++entries > max) {
+            return COSE_ERR_CBOR_NOTSUP;
+        }
+        /* Header labels are integers or text strings */
+        int type = nanocbor_get_type(&map);
+        if (hdrs && type != NANOCBOR_TYPE_UINT && type != NANOCBOR_TYPE_NINT &&
+                type != NANOCBOR_TYPE_TSTR) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        res = cose_cbor_validate_item(v, &map, depth + 1);
+        if (res < 0) {
+            return res;
+        }
+        if (nanocbor_at_end(&map)) {
+            /* Key without a value */
+            return COSE_ERR_INVALID_CBOR;
+        }
+        res = cose_cbor_validate_item(v, &map, depth + 1);
+        if (res < 0) {
+            return res;
+        }
+    }
+    nanocbor_leave_container(it, &map);
+    return COSE_OK;
+}
+
+int cose_cbor_validate_item(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                            unsigned depth)
+{
+    int res;
+    int type = nanocbor_get_type(it);
+
+    /* Tags are unrolled here instead of recursing for every tag */
+    while (type == NANOCBOR_TYPE_TAG) {
+        uint32_t tag = 0;
+        res = _validate_count(v);
+        if (res < 0) {
+            return res;
+        }
+        if (nanocbor_get_tag(it, &tag) < 0) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        type = nanocbor_get_type(it);
+    }
+
+    if (type == NANOCBOR_TYPE_MAP) {
+        return _validate_map(v, it, depth, v->limits->map_size, false);
+    }
+    if (type == NANOCBOR_TYPE_ARR) {
+        nanocbor_value_t arr;
+        res = _validate_enter(v, it, &arr, depth);
+        if (res < 0) {
+            return res;
+        }
+        while (!nanocbor_at_end(&arr)) {
+            res = cose_cbor_validate_item(v, &arr, depth + 1);
+            if (res < 0) {
+                return res;
+            }
+        }
+        nanocbor_leave_container(it, &arr);
+        return COSE_OK;
+    }
+
+    res = _validate_count(v);
+    if (res < 0) {
+        return res;
+    }
+    return nanocbor_skip_simple(it) < 0 ? COSE_ERR_INVALID_CBOR : COSE_OK;
+}
+
+int cose_cbor_validate_array(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                             nanocbor_value_t *arr, uint32_t min, uint32_t max,
+                             unsigned depth)
+{
+    if (nanocbor_get_type(it) != NANOCBOR_TYPE_ARR) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    int res = _validate_enter(v, it, arr, depth);
+    if (res < 0) {
+        return res;
+    }
+    if (nanocbor_container_indefinite(arr) ||
+            nanocbor_container_remaining(arr) < min ||
+            nanocbor_container_remaining(arr) > max) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    return COSE_OK;
+}
+
+int cose_cbor_validate_headers(cose_cbor_validator_t *v, nanocbor_value_t *arr,
+                               unsigned depth)
+{
+    const uint8_t *prot = NULL;
+    size_t prot_len = 0;
+
+    int res = _validate_count(v);
+    if (res < 0) {
+        return res;
+    }
+    if (nanocbor_get_bstr(arr, &prot, &prot_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    /* A zero length protected header bstr is the empty map */
+    if (prot_len) {
+        nanocbor_value_t p;
+        nanocbor_decoder_init(&p, prot, prot_len);
+        res = _validate_map(v, &p, depth, v->limits->hdrs, true);
+        if (res < 0) {
+            return res;
+        }
+        if (!nanocbor_at_end(&p)) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+    }
+    return _validate_map(v, arr, depth, v->limits->hdrs, true);
+}
+
+int cose_cbor_validate_bstr(cose_cbor_validator_t *v, nanocbor_value_t *it,
+                            bool nil)
+{
+    const uint8_t *buf = NULL;
+    size_t len = 0;
+
+    int res = _validate_count(v);
+    if (res < 0) {
+        return res;
+    }
+    if (nil && nanocbor_get_null(it) == NANOCBOR_OK) {
+        return COSE_OK;
+    }
+    return nanocbor_get_bstr(it, &buf, &len) < 0 ? COSE_ERR_INVALID_CBOR
+                                                 : COSE_OK;
+}
+
+int cose_cbor_validate_tag(cose_cbor_validator_t *v, nanocbor_value_t *it)
+{
+    if (nanocbor_get_type(it) == NANOCBOR_TYPE_TAG) {
+        uint32_t tag = 0;
+        int res = _validate_count(v);
+        if (res < 0) {
+            return res;
+        }
+        if (nanocbor_get_tag(it, &tag) < 0) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+    }
+    return COSE_OK;
+}
@@ -8,6 +8,7 @@
  */
 
 #include "cose/crypto.h"
+#include "cose/trace.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,48 +23,410 @@ void cose_crypt_set_rng(cose_crypt_rng f_rng, void *p_rng)
 }
 
 
+/*
+ * Adapters for backend functions whose prototype differs from the
+ * descriptor function types
+ */
+#ifdef HAVE_ALGO_CHACHA20POLY1305
+static int _aead_encrypt_chachapoly(uint8_t *c, size_t *clen,
+                                    const uint8_t *msg, size_t msglen,
+                                    const uint8_t *aad, size_t aadlen,
+                                    const uint8_t *npub, const uint8_t *key,
+                                    cose_algo_t algo)
+{
+    (void)algo;
+    return cose_crypto_aead_encrypt_chachapoly(c, clen, msg, msglen, aad,
+                                               aadlen, npub, key);
+}
+
+static int _aead_decrypt_chachapoly(uint8_t *msg, size_t *msglen,
+                                    const uint8_t *c, size_t clen,
+                                    const uint8_t *aad, size_t aadlen,
+                                    const uint8_t *npub, const uint8_t *key,
+                                    cose_algo_t algo)
+{
+    (void)algo;
+    return cose_crypto_aead_decrypt_chachapoly(msg, msglen, c, clen, aad,
+                                               aadlen, npub, key);
+}
+
+static COSE_ssize_t _keygen_chachapoly(uint8_t *buf, size_t len,
+                                       cose_algo_t algo)
+{
+    (void)algo;
+    return cose_crypto_keygen_chachapoly(buf, len);
+}
+#define CHACHAPOLY_FUNCS \
+    .encrypt = _aead_encrypt_chachapoly, \
+    .decrypt = _aead_decrypt_chachapoly, \
+    .keygen = _keygen_chachapoly,
+#else
+#define CHACHAPOLY_FUNCS
+#endif /* HAVE_ALGO_CHACHA20POLY1305 */
+
+#ifdef HAVE_ALGO_EDDSA
+static int _sign_ed25519(const cose_key_t *key, uint8_t *sign,
+                         size_t *signlen, uint8_t *msg, size_t msglen)
+{
+    return cose_crypto_sign_ed25519(key, sign, signlen, msg, msglen);
+}
+
+static int _verify_ed25519(const cose_key_t *key, const uint8_t *sign,
+                           size_t signlen, uint8_t *msg, size_t msglen)
+{
+    return cose_crypto_verify_ed25519(key, sign, signlen, msg, msglen);
+}
+#define EDDSA_FUNCS .sign = _sign_ed25519, .verify = _verify_ed25519,
+#else
+#define EDDSA_FUNCS
+#endif /* HAVE_ALGO_EDDSA */
+
+#ifdef HAVE_ALGO_AESGCM
+#define AESGCM_FUNCS \
+    .encrypt = cose_crypto_aead_encrypt_aesgcm, \
+    .decrypt = cose_crypto_aead_decrypt_aesgcm, \
+    .keygen = cose_crypto_keygen_aesgcm,
+#endif
+#ifdef HAVE_ALGO_AESCCM
+#define AESCCM_FUNCS \
+    .encrypt = cose_crypto_aead_encrypt_aesccm, \
+    .decrypt = cose_crypto_aead_decrypt_aesccm,
+#endif
+#ifdef HAVE_ALGO_ECDSA
+#define ECDSA_FUNCS \
+    .sign = cose_crypto_sign_ecdsa, \
+    .verify = cose_crypto_verify_ecdsa,
+#endif
+
+#ifdef HAVE_ALGO_RSA_PSS
+#define RSA_PSS_FUNCS \
+    .sign = cose_crypto_sign_rsa_pss, \
+    .verify = cose_crypto_verify_rsa_pss,
+#endif
+
+#define AEAD_ALGO(id, key, nonce, tag) \
+    .algo = id, .cls = COSE_CRYPTO_ALGO_AEAD, .kty = COSE_KTY_SYMM, \
+    .hash = COSE_CRYPTO_HASH_NONE, .key_len = key, .nonce_len = nonce, \
+    .tag_len = tag
+
+#define AESCCM_ALGO(id, name) \
+    AEAD_ALGO(id, COSE_CRYPTO_AEAD_AESCCM_ ## name ## _KEYBYTES, \
+              COSE_CRYPTO_AEAD_AESCCM_ ## name ## _NONCEBYTES, \
+              COSE_CRYPTO_AEAD_AESCCM_ ## name ## _ABYTES)
+
+#define SIGN_ALGO(id, keytype, hashfn, siglen) \
+    .algo = id, .cls = COSE_CRYPTO_ALGO_SIGN, .kty = keytype, \
+    .hash = hashfn, .sig_len = siglen
+
+#define KDF_ALGO(id, hashfn) \
+    .algo = id, .cls = COSE_CRYPTO_ALGO_KDF, .kty = COSE_KTY_SYMM, \
+    .hash = hashfn
+
+#define ECDH_SS_ALGO(id, hashfn) \
+    .algo = id, .cls = COSE_CRYPTO_ALGO_KDF, .kty = COSE_KTY_EC2, \
+    .hash = hashfn
+
+static const cose_crypto_algo_t _algos[] = {
+    {
+        AEAD_ALGO(COSE_ALGO_CHACHA20POLY1305,
+                  COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES,
+                  COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES,
+                  COSE_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES),
+        CHACHAPOLY_FUNCS
+    },
+    {
+        AEAD_ALGO(COSE_ALGO_A128GCM, COSE_CRYPTO_AEAD_AES128GCM_KEYBYTES,
+                  COSE_CRYPTO_AEAD_AES128GCM_NONCEBYTES,
+                  COSE_CRYPTO_AEAD_AES128GCM_ABYTES),
+#ifdef HAVE_ALGO_AES128GCM
+        AESGCM_FUNCS
+#endif
+    },
+    {
+        AEAD_ALGO(COSE_ALGO_A192GCM, COSE_CRYPTO_AEAD_AES192GCM_KEYBYTES,
+                  COSE_CRYPTO_AEAD_AES192GCM_NONCEBYTES,
+                  COSE_CRYPTO_AEAD_AES192GCM_ABYTES),
+#ifdef HAVE_ALGO_AES192GCM
+        AESGCM_FUNCS
+#endif
+    },
+    {
+        AEAD_ALGO(COSE_ALGO_A256GCM, COSE_CRYPTO_AEAD_AES256GCM_KEYBYTES,
+                  COSE_CRYPTO_AEAD_AES256GCM_NONCEBYTES,
+                  COSE_CRYPTO_AEAD_AES256GCM_ABYTES),
+#ifdef HAVE_ALGO_AES256GCM
+        AESGCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_16_64_128, 16_64_128),
+#ifdef HAVE_ALGO_AESCCM_16_64_128
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_16_64_256, 16_64_256),
+#ifdef HAVE_ALGO_AESCCM_16_64_256
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_64_64_128, 64_64_128),
+#ifdef HAVE_ALGO_AESCCM_64_64_128
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_64_64_256, 64_64_256),
+#ifdef HAVE_ALGO_AESCCM_64_64_256
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_16_128_128, 16_128_128),
+#ifdef HAVE_ALGO_AESCCM_16_128_128
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_16_128_256, 16_128_256),
+#ifdef HAVE_ALGO_AESCCM_16_128_256
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_64_128_128, 64_128_128),
+#ifdef HAVE_ALGO_AESCCM_64_128_128
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        AESCCM_ALGO(COSE_ALGO_AESCCM_64_128_256, 64_128_256),
+#ifdef HAVE_ALGO_AESCCM_64_128_256
+        AESCCM_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_EDDSA, COSE_KTY_OCTET, COSE_CRYPTO_HASH_NONE,
+                  COSE_CRYPTO_SIGN_ED25519_SIGNBYTES),
+        EDDSA_FUNCS
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_ES256, COSE_KTY_EC2, COSE_CRYPTO_HASH_SHA256,
+                  COSE_CRYPTO_SIGN_P256_SIGNBYTES),
+#ifdef HAVE_ALGO_ES256
+        ECDSA_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_ES384, COSE_KTY_EC2, COSE_CRYPTO_HASH_SHA384,
+                  COSE_CRYPTO_SIGN_P384_SIGNBYTES),
+#ifdef HAVE_ALGO_ES384
+        ECDSA_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_ES512, COSE_KTY_EC2, COSE_CRYPTO_HASH_SHA512,
+                  COSE_CRYPTO_SIGN_P521_SIGNBYTES),
+#ifdef HAVE_ALGO_ES512
+        ECDSA_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_PS256, COSE_KTY_RSA, COSE_CRYPTO_HASH_SHA256,
+                  COSE_CRYPTO_SIGN_RSA_MAXBYTES),
+#ifdef HAVE_ALGO_PS256
+        RSA_PSS_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_PS384, COSE_KTY_RSA, COSE_CRYPTO_HASH_SHA384,
+                  COSE_CRYPTO_SIGN_RSA_MAXBYTES),
+#ifdef HAVE_ALGO_PS384
+        RSA_PSS_FUNCS
+#endif
+    },
+    {
+        SIGN_ALGO(COSE_ALGO_PS512, COSE_KTY_RSA, COSE_CRYPTO_HASH_SHA512,
+                  COSE_CRYPTO_SIGN_RSA_MAXBYTES),
+#ifdef HAVE_ALGO_PS512
+        RSA_PSS_FUNCS
+#endif
+    },
+    {
+        KDF_ALGO(COSE_ALGO_DIRECT_HKDF_SHA256, COSE_CRYPTO_HASH_SHA256),
+    },
+    {
+        KDF_ALGO(COSE_ALGO_DIRECT_HKDF_SHA512, COSE_CRYPTO_HASH_SHA512),
+    },
+    {
+        ECDH_SS_ALGO(COSE_ALGO_ECDH_SS_HKDF_SHA256, COSE_CRYPTO_HASH_SHA256),
+    },
+    {
+        ECDH_SS_ALGO(COSE_ALGO_ECDH_SS_HKDF_SHA512, COSE_CRYPTO_HASH_SHA512),
+    },
+};
+
+const cose_crypto_algo_t *cose_crypto_algo_get(cose_algo_t algo)
+{
+    for (size_t i = 0; i < sizeof(_algos) / sizeof(_algos[0]); i++) {
+        if (_algos[i].algo == algo) {
+            return &_algos[i];
+        }
+    }
+    return NULL;
+}
+
 COSE_ssize_t cose_crypto_keygen(uint8_t *buf, /* NOLINT(readability-non-const-parameter) */
         size_t len, cose_algo_t algo)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(algo) {
-#ifdef HAVE_ALGO_CHACHA20POLY1305
-        case COSE_ALGO_CHACHA20POLY1305:
-            return cose_crypto_keygen_chachapoly(buf, len);
-#endif /* HAVE_ALGO_CHACHA20POLY1305 */
-#if defined(HAVE_ALGO_AESGCM)
-        case COSE_ALGO_A128GCM:
-        case COSE_ALGO_A192GCM:
-        case COSE_ALGO_A256GCM:
-            return cose_crypto_keygen_aesgcm(buf, len, algo);
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD || !desc->encrypt) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (desc->keygen) {
+        return desc->keygen(buf, len, algo);
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
+    }
+    if (!cose_crypt_get_random) {
+        return COSE_ERR_NOINIT;
+    }
+    if (cose_crypt_get_random(cose_crypt_rng_arg, buf, desc->key_len)) {
+        return COSE_ERR_CRYPTO;
+    }
+    return desc->key_len;
+}
+
+size_t cose_crypto_hash_len(cose_crypto_hash_t hash)
+{
+    switch (hash) {
+        case COSE_CRYPTO_HASH_SHA256:
+            return 32;
+        case COSE_CRYPTO_HASH_SHA384:
+            return 48;
+        case COSE_CRYPTO_HASH_SHA512:
+            return 64;
+        default:
+            return 0;
+    }
+}
+
+static cose_crypto_hash_t _kdf_hash(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_KDF) {
+        return COSE_CRYPTO_HASH_NONE;
+    }
+    return desc->hash;
+}
+
+int cose_crypto_hkdf_extract(cose_algo_t algo, const uint8_t *salt,
+                             size_t salt_len, const uint8_t *ikm,
+                             size_t ikm_len, uint8_t *prk)
+{
+#ifdef HAVE_ALGO_HMAC
+    static const uint8_t zero_salt[COSE_CRYPTO_HASH_MAXBYTES] = { 0 };
+    cose_crypto_hash_t hash = _kdf_hash(algo);
+    cose_crypto_chunk_t msg = { .buf = ikm, .len = ikm_len };
+
+    if (hash == COSE_CRYPTO_HASH_NONE) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!salt) {
+        salt = zero_salt;
+        salt_len = cose_crypto_hash_len(hash);
+    }
+    return cose_crypto_hmac(hash, salt, salt_len, &msg, 1, prk);
+#else
+    (void)algo;
+    (void)salt;
+    (void)salt_len;
+    (void)ikm;
+    (void)ikm_len;
+    (void)prk;
+    return COSE_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+int cose_crypto_hkdf_expand(cose_algo_t algo, const uint8_t *prk,
+                            const uint8_t *info, size_t info_len,
+                            uint8_t *okm, size_t okm_len)
+{
+#ifdef HAVE_ALGO_HMAC
+    cose_crypto_hash_t hash = _kdf_hash(algo);
+    size_t hash_len = cose_crypto_hash_len(hash);
+    uint8_t t[COSE_CRYPTO_HASH_MAXBYTES];
+    uint8_t counter = 0;
+    int res = COSE_OK;
+
+    if (hash == COSE_CRYPTO_HASH_NONE) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (okm_len > 255 * hash_len) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    /* T(n) = HMAC(PRK, T(n - 1) | info | n) */
+    while (okm_len && res == COSE_OK) {
+        cose_crypto_chunk_t msg[] = {
+            { .buf = t, .len = counter ? hash_len : 0 },
+            { .buf = info, .len = info_len },
+            { .buf = &counter, .len = 1 },
+        };
+        counter++;
+        res = cose_crypto_hmac(hash, prk, hash_len, msg, 3, t);
+        size_t n = okm_len < hash_len ? okm_len : hash_len;
+        memcpy(okm, t, n);
+        okm += n;
+        okm_len -= n;
+    }
+    memset(t, 0, sizeof(t));
+    return res;
+#else
+    (void)algo;
+    (void)prk;
+    (void)info;
+    (void)info_len;
+    (void)okm;
+    (void)okm_len;
+    return COSE_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+int cose_crypto_ecdh(const cose_key_t *key, const cose_key_t *peer,
+                     uint8_t *secret, size_t *secret_len)
+{
+    if (!peer->x || key->crv != peer->crv) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    switch (key->crv) {
+#ifdef HAVE_CURVE_X25519
+        case COSE_EC_CURVE_X25519:
+            *secret_len = COSE_CRYPTO_ECDH_X25519_BYTES;
+            return cose_crypto_ecdh_x25519(key, peer, secret);
+#endif
+#ifdef HAVE_ALGO_ECDH
+        case COSE_EC_CURVE_P256:
+        case COSE_EC_CURVE_P384:
+        case COSE_EC_CURVE_P521:
+            if (!peer->y) {
+                return COSE_ERR_INVALID_PARAM;
+            }
+            return cose_crypto_ecdh_ecp(key, peer, secret, secret_len);
 #endif
         default:
-            (void)buf;
-            (void)len;
+            (void)secret;
+            (void)secret_len;
             return COSE_ERR_NOTIMPLEMENTED;
     }
 }
 
 bool cose_crypto_is_aead(cose_algo_t algo)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(algo) {
-        case COSE_ALGO_CHACHA20POLY1305:
-        case COSE_ALGO_A128GCM:
-        case COSE_ALGO_A192GCM:
-        case COSE_ALGO_A256GCM:
-        case COSE_ALGO_AESCCM_16_64_128:
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_64_256:
-        case COSE_ALGO_AESCCM_16_128_128:
-        case COSE_ALGO_AESCCM_16_128_256:
-        case COSE_ALGO_AESCCM_64_128_128:
-        case COSE_ALGO_AESCCM_64_128_256:
-            return true;
-        default:
-            return false;
-    }
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    return desc && desc->cls == COSE_CRYPTO_ALGO_AEAD;
 }
 
 int cose_crypto_aead_encrypt(uint8_t *c,  /* NOLINT(readability-non-const-parameter) */
@@ -77,41 +440,16 @@ int cose_crypto_aead_encrypt(uint8_t *c,  /* NOLINT(readability-non-const-parame
         const uint8_t *key,
         cose_algo_t algo)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(algo) {
-#ifdef HAVE_ALGO_CHACHA20POLY1305
-        case COSE_ALGO_CHACHA20POLY1305:
-            return cose_crypto_aead_encrypt_chachapoly(c, clen, msg, msglen, aad, aadlen, npub, key);
-#endif /* HAVE_ALGO_CHACHA20POLY1305 */
-#ifdef HAVE_ALGO_AESGCM
-        case COSE_ALGO_A128GCM:
-        case COSE_ALGO_A192GCM:
-        case COSE_ALGO_A256GCM:
-            return cose_crypto_aead_encrypt_aesgcm(c, clen, msg, msglen, aad, aadlen, npub, key, algo);
-#endif
-#ifdef HAVE_ALGO_AESCCM
-        case COSE_ALGO_AESCCM_16_64_128:
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_64_256:
-        case COSE_ALGO_AESCCM_16_128_128:
-        case COSE_ALGO_AESCCM_16_128_256:
-        case COSE_ALGO_AESCCM_64_128_128:
-        case COSE_ALGO_AESCCM_64_128_256:
-            return cose_crypto_aead_encrypt_aesccm(c, clen, msg, msglen, aad, aadlen, npub, key, algo);
-#endif
-        default:
-            (void)c;
-            (void)clen;
-            (void)msg;
-            (void)msglen;
-            (void)aad;
-            (void)aadlen;
-            (void)nsec;
-            (void)npub;
-            (void)key;
-            return COSE_ERR_NOTIMPLEMENTED;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    int res = COSE_ERR_NOTIMPLEMENTED;
+
+    (void)nsec;
+    COSE_TRACE_ENTRY(crypto_aead_encrypt, algo, msglen);
+    if (desc && desc->encrypt) {
+        res = desc->encrypt(c, clen, msg, msglen, aad, aadlen, npub, key, algo);
     }
+    COSE_TRACE_RETURN(crypto_aead_encrypt, algo, msglen, res);
+    return res;
 }
 
 int cose_crypto_aead_decrypt(uint8_t *msg, /* NOLINT(readability-non-const-parameter) */
@@ -124,144 +462,79 @@ int cose_crypto_aead_decrypt(uint8_t *msg, /* NOLINT(readability-non-const-param
                              const uint8_t *k,
                              cose_algo_t algo)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(algo) {
-#ifdef HAVE_ALGO_CHACHA20POLY1305
-        case COSE_ALGO_CHACHA20POLY1305:
-            return cose_crypto_aead_decrypt_chachapoly(msg, msglen, c, clen, aad, aadlen, npub, k);
-#endif
-#ifdef HAVE_ALGO_AESGCM
-        case COSE_ALGO_A128GCM:
-        case COSE_ALGO_A192GCM:
-        case COSE_ALGO_A256GCM:
-            return cose_crypto_aead_decrypt_aesgcm(msg, msglen, c, clen, aad, aadlen, npub, k, algo);
-#endif
-#ifdef HAVE_ALGO_AESCCM
-        case COSE_ALGO_AESCCM_16_64_128:
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_64_256:
-        case COSE_ALGO_AESCCM_16_128_128:
-        case COSE_ALGO_AESCCM_16_128_256:
-        case COSE_ALGO_AESCCM_64_128_128:
-        case COSE_ALGO_AESCCM_64_128_256:
-            return cose_crypto_aead_decrypt_aesccm(msg, msglen, c, clen, aad, aadlen, npub, k, algo);
-#endif
-        default:
-            (void)c;
-            (void)clen;
-            (void)msg;
-            (void)msglen;
-            (void)aad;
-            (void)aadlen;
-            (void)npub;
-            (void)k;
-            return COSE_ERR_NOTIMPLEMENTED;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    int res = COSE_ERR_NOTIMPLEMENTED;
+
+    COSE_TRACE_ENTRY(crypto_aead_decrypt, algo, clen);
+    if (desc && desc->decrypt) {
+        res = desc->decrypt(msg, msglen, c, clen, aad, aadlen, npub, k, algo);
     }
+    COSE_TRACE_RETURN(crypto_aead_decrypt, algo, clen, res);
+    return res;
 }
 
 COSE_ssize_t cose_crypto_aead_nonce_size(cose_algo_t algo)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(algo) {
-#ifdef HAVE_ALGO_CHACHA20POLY1305
-        case COSE_ALGO_CHACHA20POLY1305:
-            return COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES;
-#endif /* HAVE_ALGO_CHACHA20POLY1305 */
-        case COSE_ALGO_A128GCM:
-        case COSE_ALGO_A192GCM:
-        case COSE_ALGO_A256GCM:
-            return COSE_CRYPTO_AEAD_AES128GCM_NONCEBYTES;
-        case COSE_ALGO_AESCCM_16_64_128:
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_16_128_128:
-        case COSE_ALGO_AESCCM_16_128_256:
-            return  COSE_CRYPTO_AEAD_AESCCM_16_64_128_NONCEBYTES;
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_64_256:
-        case COSE_ALGO_AESCCM_64_128_128:
-        case COSE_ALGO_AESCCM_64_128_256:
-            return COSE_CRYPTO_AEAD_AESCCM_64_64_128_NONCEBYTES;
-        default:
-            return COSE_ERR_NOTIMPLEMENTED;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return COSE_ERR_NOTIMPLEMENTED;
     }
+    return desc->nonce_len;
 }
 
 int cose_crypto_sign(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg, unsigned long long int msglen)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(key->algo) {
-#ifdef HAVE_ALGO_ECDSA
-        case COSE_ALGO_ES256:
-        case COSE_ALGO_ES384:
-        case COSE_ALGO_ES512:
-            return cose_crypto_sign_ecdsa(key, sign, signlen, msg, msglen);
-            break;
-#endif
-#ifdef HAVE_ALGO_EDDSA
-        case COSE_ALGO_EDDSA:
-            /* Needs to be splitted as soon as ed448 support is required */
-            return cose_crypto_sign_ed25519(key, sign, signlen, msg, msglen);
-            break;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+    int res;
+
+    COSE_TRACE_ENTRY(crypto_sign, key->algo, msglen);
+    if (!desc || !desc->sign) {
+        res = COSE_ERR_NOTIMPLEMENTED;
+    }
+#ifdef CRYPTO_SIGND
+    else if (key->signd) {
+        res = cose_crypto_signd_sign(key, sign, signlen, msg, (size_t)msglen);
+    }
 #endif
-        default:
-            (void)key;
-            (void)sign;
-            (void)signlen;
-            (void)msg;
-            (void)msglen;
-            return COSE_ERR_NOTIMPLEMENTED;
+    else {
+        res = desc->sign(key, sign, signlen, msg, (size_t)msglen);
     }
-    return 0;
+    COSE_TRACE_RETURN(crypto_sign, key->algo, msglen, res);
+    return res;
 }
 
 int cose_crypto_verify(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, uint64_t msglen)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(key->algo) {
-#ifdef HAVE_ALGO_ECDSA
-        case COSE_ALGO_ES256:
-        case COSE_ALGO_ES384:
-        case COSE_ALGO_ES512:
-            return cose_crypto_verify_ecdsa(key, sign, signlen, msg, msglen);
-            break;
-#endif
-#ifdef HAVE_ALGO_EDDSA
-        case COSE_ALGO_EDDSA:
-            /* Needs to be splitted as soon as ed448 support is required */
-            return cose_crypto_verify_ed25519(key, sign, signlen, msg, msglen);
-            break;
-#endif
-        default:
-            (void)key;
-            (void)sign;
-            (void)signlen;
-            (void)msg;
-            (void)msglen;
-            return COSE_ERR_NOTIMPLEMENTED;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+    int res = COSE_ERR_NOTIMPLEMENTED;
+
+    COSE_TRACE_ENTRY(crypto_verify, key->algo, msglen);
+    if (desc && desc->verify) {
+        res = desc->verify(key, sign, signlen, msg, (size_t)msglen);
     }
-    return 0;
+    COSE_TRACE_RETURN(crypto_verify, key->algo, msglen, res);
+    return res;
 }
 
 size_t cose_crypto_sig_size(const cose_key_t *key)
 {
-    /* NOLINTNEXTLINE(hicpp-multiway-paths-covered) */
-    switch(key->algo) {
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+
+    if (!desc || !desc->sign) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
 #ifdef HAVE_ALGO_ECDSA
-        case COSE_ALGO_ES256:
-        case COSE_ALGO_ES384:
-        case COSE_ALGO_ES512:
-            return cose_crypto_sig_size_ecdsa(key->crv);
-            break;
-#endif
-#ifdef HAVE_ALGO_EDDSA
-        case COSE_ALGO_EDDSA:
-            /* Needs to be splitted as soon as ed448 support is required */
-            return cose_crypto_sig_size_ed25519();
-            break;
+    /* The signature size follows the curve of the key */
+    if (desc->kty == COSE_KTY_EC2) {
+        return cose_crypto_sig_size_ecdsa(key->crv);
+    }
 #endif
-        default:
-            return COSE_ERR_NOTIMPLEMENTED;
+#ifdef HAVE_ALGO_RSA_PSS
+    /* With RSA it follows the modulus of the key */
+    if (desc->kty == COSE_KTY_RSA) {
+        return cose_crypto_sig_size_rsa(key);
     }
-    return 0;
+#endif
+    return desc->sig_len;
 }
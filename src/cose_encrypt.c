@@ -11,18 +11,37 @@
 #include "cose/crypto.h"
 #include "cose/encrypt.h"
 #include "cose/intern.h"
+#include "cose/trace.h"
 #include <stdint.h>
 #include <string.h>
 
-static void _place_cbor_protected(cose_encrypt_t *encrypt, nanocbor_encoder_t *arr);
-static size_t _encrypt_serialize_protected(const cose_encrypt_t *encrypt, uint8_t *buf, size_t buflen);
+static void _place_cbor_protected(cose_encrypt_t *encrypt,
+                                  const cose_crypto_algo_t *desc,
+                                  nanocbor_encoder_t *arr);
+static size_t _encrypt_serialize_protected(const cose_encrypt_t *encrypt,
+                                           const cose_crypto_algo_t *desc,
+                                           uint8_t *buf, size_t buflen);
 
 static bool _is_encrypt0(cose_encrypt_t *encrypt) {
     return encrypt->flags & COSE_FLAGS_ENCRYPT0;
 }
 
+/* Descriptor of the content encryption algorithm, NULL if not an AEAD */
+static const cose_crypto_algo_t *_encrypt_algo(const cose_encrypt_t *encrypt)
+{
+    const cose_crypto_algo_t *desc =
+        cose_crypto_algo_get(cose_encrypt_get_algo(encrypt));
+
+    if (desc && desc->cls == COSE_CRYPTO_ALGO_AEAD) {
+        return desc;
+    }
+    return NULL;
+}
+
 /* Used by encrypt (encode) */
-static int _encrypt_build_cbor_enc(cose_encrypt_t *encrypt, nanocbor_encoder_t *enc)
+static int _encrypt_build_cbor_enc(cose_encrypt_t *encrypt,
+                                   const cose_crypto_algo_t *desc,
+                                   nanocbor_encoder_t *enc)
 {
     nanocbor_fmt_array(enc, 3);
     /* Add type string */
@@ -34,78 +53,80 @@ static int _encrypt_build_cbor_enc(cose_encrypt_t *encrypt, nanocbor_encoder_t *
     }
 
     /* Add body protected headers */
-    _place_cbor_protected(encrypt, enc);
+    _place_cbor_protected(encrypt, desc, enc);
 
     /* External aad */
     nanocbor_put_bstr(enc, encrypt->ext_aad, encrypt->ext_aad_len);
     return 0;
 }
 
-static bool _encrypt_unprot_to_map(const cose_encrypt_t *encrypt, nanocbor_encoder_t *map)
+static bool _encrypt_unprot_to_map(const cose_encrypt_t *encrypt,
+                                   const cose_crypto_algo_t *desc,
+                                   nanocbor_encoder_t *map)
 {
     if (cose_hdr_encode_to_map(encrypt->hdrs.unprot, map)) {
         return false;
     }
-    cose_algo_t algo = cose_encrypt_get_algo(encrypt);
-    if (!cose_crypto_is_aead(algo)) {
-        nanocbor_fmt_int(map, COSE_HDR_ALG);
-        nanocbor_fmt_int(map, algo);
+    if (encrypt->piv) {
+        nanocbor_fmt_int(map, COSE_HDR_PARTIALIV);
+        nanocbor_put_bstr(map, encrypt->piv, encrypt->piv_len);
     }
-    if (encrypt->nonce) {
+    else if (encrypt->nonce) {
         nanocbor_fmt_int(map, COSE_HDR_IV);
-        nanocbor_put_bstr(map, encrypt->nonce, cose_crypto_aead_nonce_size(algo));
+        nanocbor_put_bstr(map, encrypt->nonce, desc->nonce_len);
     }
     return true;
 }
 
 /* Add the body protected headers to a map */
-static bool _encrypt_prot_to_map(const cose_encrypt_t *encrypt, nanocbor_encoder_t *map)
+static bool _encrypt_prot_to_map(const cose_encrypt_t *encrypt,
+                                 const cose_crypto_algo_t *desc,
+                                 nanocbor_encoder_t *map)
 {
     cose_hdr_encode_to_map(encrypt->hdrs.prot, map);
-    cose_algo_t algo = cose_encrypt_get_algo(encrypt);
-    if (cose_crypto_is_aead(algo)) {
+    if (desc) {
         nanocbor_fmt_int(map, COSE_HDR_ALG);
-        nanocbor_fmt_int(map, algo);
+        nanocbor_fmt_int(map, desc->algo);
     }
     return true;
 }
 
-static size_t _encrypt_serialize_protected(const cose_encrypt_t *encrypt, uint8_t *buf, size_t buflen)
+static size_t _encrypt_serialize_protected(const cose_encrypt_t *encrypt,
+                                           const cose_crypto_algo_t *desc,
+                                           uint8_t *buf, size_t buflen)
 {
     nanocbor_encoder_t enc;
     size_t len = cose_hdr_size(encrypt->hdrs.prot);
-    if (cose_crypto_is_aead(cose_encrypt_get_algo(encrypt))) {
+    if (desc) {
         len += 1;
     }
 
     nanocbor_encoder_init(&enc, buf, buflen);
     nanocbor_fmt_map(&enc, len);
 
-    _encrypt_prot_to_map(encrypt, &enc);
+    _encrypt_prot_to_map(encrypt, desc, &enc);
     return nanocbor_encoded_len(&enc);
 }
 
-static void _place_cbor_protected(cose_encrypt_t *encrypt, nanocbor_encoder_t *arr) {
-    size_t slen = _encrypt_serialize_protected(encrypt, NULL, 0);
+static void _place_cbor_protected(cose_encrypt_t *encrypt,
+                                  const cose_crypto_algo_t *desc,
+                                  nanocbor_encoder_t *arr) {
+    size_t slen = _encrypt_serialize_protected(encrypt, desc, NULL, 0);
     nanocbor_put_bstr(arr, arr->cur, slen);
-    _encrypt_serialize_protected(encrypt, arr->cur - slen, slen);
+    _encrypt_serialize_protected(encrypt, desc, arr->cur - slen, slen);
 }
 
-static size_t _encrypt_unprot_cbor(cose_encrypt_t *encrypt, nanocbor_encoder_t *enc)
+static size_t _encrypt_unprot_cbor(cose_encrypt_t *encrypt,
+                                   const cose_crypto_algo_t *desc,
+                                   nanocbor_encoder_t *enc)
 {
     size_t len = cose_hdr_size(encrypt->hdrs.unprot);
-    /* TODO: split */
-    if (cose_crypto_is_aead(cose_encrypt_get_algo(encrypt))) {
-        /* Only the nonce */
+    if (encrypt->nonce || encrypt->piv) {
         len += 1;
     }
-    else {
-        /* Nonce and algo */
-        len += 2;
-    }
 
     nanocbor_fmt_map(enc, len);
-    _encrypt_unprot_to_map(encrypt, enc);
+    _encrypt_unprot_to_map(encrypt, desc, enc);
     return 0;
 }
 
@@ -113,14 +134,17 @@ COSE_ssize_t cose_encrypt_build_enc(cose_encrypt_t *encrypt, uint8_t *buf, size_
 {
     nanocbor_encoder_t enc;
     nanocbor_encoder_init(&enc, buf, len);
-    _encrypt_build_cbor_enc(encrypt, &enc);
+    _encrypt_build_cbor_enc(encrypt, _encrypt_algo(encrypt), &enc);
     return (COSE_ssize_t)nanocbor_encoded_len(&enc);
 }
 
 cose_algo_t cose_encrypt_get_algo(const cose_encrypt_t *encrypt)
 {
     cose_algo_t res = COSE_ALGO_NONE;
-    if (encrypt->recps[0].key) {
+    if (encrypt->num_recps == 0) {
+        res = COSE_ALGO_NONE;
+    }
+    else if (encrypt->recps[0].key) {
         res = encrypt->recps[0].key->algo;
     }
     else {
@@ -136,35 +160,40 @@ cose_algo_t cose_encrypt_get_algo(const cose_encrypt_t *encrypt)
     return encrypt->algo == COSE_ALGO_DIRECT ? res : encrypt->algo;
 }
 
-static COSE_ssize_t _encrypt_build_aad(cose_encrypt_t *encrypt, uint8_t *buf, size_t len)
+static COSE_ssize_t _encrypt_build_aad(cose_encrypt_t *encrypt,
+                                       const cose_crypto_algo_t *desc,
+                                       uint8_t *buf, size_t len)
 {
-    COSE_ssize_t enc_size = cose_encrypt_build_enc(encrypt, buf, len);
-    if (enc_size < 0) {
-        return enc_size;
-    }
-    return enc_size;
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    _encrypt_build_cbor_enc(encrypt, desc, &enc);
+    return (COSE_ssize_t)nanocbor_encoded_len(&enc);
 }
 
-static COSE_ssize_t _encrypt_payload(cose_encrypt_t *encrypt, uint8_t *buf, size_t len, const uint8_t *nonce, uint8_t **out)
+static COSE_ssize_t _encrypt_payload(cose_encrypt_t *encrypt,
+                                     const cose_crypto_algo_t *desc,
+                                     uint8_t *buf, size_t len,
+                                     const uint8_t *nonce, uint8_t **out)
 {
-    cose_algo_t algo = cose_encrypt_get_algo(encrypt);
     encrypt->nonce = nonce;
-    if (cose_crypto_is_aead(algo)) {
-        /* Protected enc structure with nonsense protected headers */
-        uint8_t *encp = buf;
-        COSE_ssize_t enc_size = _encrypt_build_aad(encrypt, encp, len);
-        if (enc_size < 0) {
-            return enc_size;
-        }
-        buf += enc_size;
-        /* At this point we have our AAD at encp with length enc_size and the
-         * encrypt->payload@encrypt->payload_len to feed our algo */
-        size_t cipherlen = 0;
-        cose_crypto_aead_encrypt(buf, &cipherlen, encrypt->payload, encrypt->payload_len, encp, enc_size, NULL, nonce, encrypt->cek, algo);
-        *out = buf;
-        return cipherlen;
+    /* Protected enc structure with nonsense protected headers */
+    uint8_t *encp = buf;
+    COSE_ssize_t enc_size = _encrypt_build_aad(encrypt, desc, encp, len);
+    if (enc_size < 0) {
+        return enc_size;
+    }
+    buf += enc_size;
+    /* At this point we have our AAD at encp with length enc_size and the
+     * encrypt->payload@encrypt->payload_len to feed our algo */
+    size_t cipherlen = 0;
+    int res = desc->encrypt(buf, &cipherlen, encrypt->payload,
+                            encrypt->payload_len, encp, enc_size, nonce,
+                            encrypt->cek, desc->algo);
+    if (res < 0) {
+        return res;
     }
-    return -1;
+    *out = buf;
+    return cipherlen;
 }
 
 void cose_encrypt_init(cose_encrypt_t *encrypt, uint16_t flags)
@@ -184,39 +213,148 @@ void cose_encrypt_set_algo(cose_encrypt_t *encrypt, cose_algo_t algo)
     encrypt->algo = algo;
 }
 
+void cose_encrypt_set_partial_iv(cose_encrypt_t *encrypt, const uint8_t *piv,
+                                 size_t len)
+{
+    encrypt->piv = piv;
+    encrypt->piv_len = (uint8_t)len;
+}
+
+int cose_encrypt_partial_iv_nonce(uint8_t *nonce, size_t nonce_len,
+                                  const uint8_t *base_iv, const uint8_t *piv,
+                                  size_t piv_len)
+{
+    if (piv_len > nonce_len) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    size_t pad = nonce_len - piv_len;
+    memcpy(nonce, base_iv, nonce_len);
+    for (size_t i = 0; i < piv_len; i++) {
+        nonce[pad + i] ^= piv[i];
+    }
+    return COSE_OK;
+}
+
+void cose_encrypt_set_recipients(cose_encrypt_t *encrypt, cose_recp_t *recps,
+                                 size_t num)
+{
+#ifdef COSE_COMPACT_LAYOUT
+    if (num > UINT8_MAX) {
+        num = UINT8_MAX;
+    }
+    memset(recps, 0, num * sizeof(cose_recp_t));
+    encrypt->recps = recps;
+    encrypt->max_recps = (uint8_t)num;
+    encrypt->num_recps = 0;
+#else
+    (void)encrypt;
+    (void)recps;
+    (void)num;
+#endif
+}
+
+static size_t _encrypt_max_recps(const cose_encrypt_t *encrypt)
+{
+#ifdef COSE_COMPACT_LAYOUT
+    return encrypt->max_recps;
+#else
+    (void)encrypt;
+    return COSE_RECIPIENTS_MAX;
+#endif
+}
+
 int cose_encrypt_add_recipient(cose_encrypt_t *encrypt, const cose_key_t *key)
 {
     /* TODO: define status codes */
-    if (encrypt->num_recps == COSE_RECIPIENTS_MAX) {
+    if (encrypt->num_recps == _encrypt_max_recps(encrypt)) {
         return COSE_ERR_NOMEM;
     }
     /* Convenience pointer */
     cose_recp_t *recp = &(encrypt->recps[encrypt->num_recps]);
     recp->key = key;
+    recp->kdf = NULL;
 
     return encrypt->num_recps++;
 }
 
-COSE_ssize_t cose_encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf, size_t len, const uint8_t *nonce, uint8_t **out)
+int cose_encrypt_add_recipient_kdf(cose_encrypt_t *encrypt,
+                                   const cose_key_t *key,
+                                   const cose_recp_kdf_t *kdf)
+{
+    int res = cose_encrypt_add_recipient(encrypt, key);
+    if (res >= 0) {
+        encrypt->recps[res].kdf = kdf;
+    }
+    return res;
+}
+
+static int _encrypt_derive_cek(cose_recp_t *recp,
+                               const cose_crypto_algo_t *desc,
+                               uint8_t *buf, size_t len)
+{
+    uint8_t prot[8];
+    COSE_ssize_t prot_len = cose_recp_kdf_protected(recp->kdf, prot,
+                                                    sizeof(prot));
+    if (prot_len < 0) {
+        return (int)prot_len;
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
+    }
+    return cose_recp_kdf_derive(recp->kdf, recp->key, desc->algo,
+                                desc->key_len, prot, (size_t)prot_len, buf,
+                                buf + desc->key_len, len - desc->key_len);
+}
+
+static COSE_ssize_t _encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf,
+                                    size_t len, const uint8_t *nonce,
+                                    uint8_t **out)
 {
     /* The buffer here is used to contain dummy data a number of times */
     uint8_t *bufptr = buf;
     encrypt->flags |= COSE_FLAGS_ENCODE;
 
+    if (!cose_hdr_encodable(&encrypt->hdrs)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+
     /* Generate intermediate key
      * or get it from the first recipient if it is direct */
     if (encrypt->algo == COSE_ALGO_DIRECT) {
+       if (encrypt->num_recps == 0) {
+           return COSE_ERR_INVALID_PARAM;
+       }
        encrypt->cek = encrypt->recps[0].key->d;
     }
-    else {
+
+    /* Resolve the content encryption algorithm once for the whole message */
+    const cose_crypto_algo_t *desc = _encrypt_algo(encrypt);
+    if (!desc || !desc->encrypt) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+
+    if (encrypt->algo == COSE_ALGO_DIRECT && encrypt->recps[0].kdf) {
+        /* Derive the key, the scratch space behind it is reused below */
+        int res = _encrypt_derive_cek(&encrypt->recps[0], desc, buf, len);
+        if (res < 0) {
+            return res;
+        }
+        encrypt->cek = buf;
+        buf += desc->key_len;
+    }
+    else if (encrypt->algo != COSE_ALGO_DIRECT) {
         /* Generate intermediate key */
+        COSE_ssize_t keylen = cose_crypto_keygen(buf, len, encrypt->algo);
+        if (keylen < 0) {
+            return keylen;
+        }
         encrypt->cek = buf;
-        buf += cose_crypto_keygen(buf, len, encrypt->algo);
+        buf += keylen;
     }
 
     /* Build ciphertext */
     uint8_t *cipherpos = 0;
-    COSE_ssize_t cipherlen = _encrypt_payload(encrypt, buf, len - (bufptr - buf), nonce, &cipherpos);
+    COSE_ssize_t cipherlen = _encrypt_payload(encrypt, desc, buf, len - (buf - bufptr), nonce, &cipherpos);
     if (cipherlen < 0) {
         return cipherlen;
     }
@@ -244,12 +382,12 @@ COSE_ssize_t cose_encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf, size_t l
     }
 
     /* Determine size of the body protected headers */
-    size_t slen = _encrypt_serialize_protected(encrypt, NULL, 0);
+    size_t slen = _encrypt_serialize_protected(encrypt, desc, NULL, 0);
     nanocbor_put_bstr(&enc, buf, slen);
-    _encrypt_serialize_protected(encrypt, enc.cur - slen, slen);
+    _encrypt_serialize_protected(encrypt, desc, enc.cur - slen, slen);
 
     /* Create unprotected body header map */
-    _encrypt_unprot_cbor(encrypt, &enc);
+    _encrypt_unprot_cbor(encrypt, desc, &enc);
 
     nanocbor_put_bstr(&enc, cipherpos, cipherlen);
 
@@ -266,6 +404,16 @@ COSE_ssize_t cose_encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf, size_t l
     return nanocbor_encoded_len(&enc);
 }
 
+COSE_ssize_t cose_encrypt_encode(cose_encrypt_t *encrypt, uint8_t *buf, size_t len, const uint8_t *nonce, uint8_t **out)
+{
+    COSE_TRACE_ENTRY(encrypt_encode, cose_encrypt_get_algo(encrypt),
+                     encrypt->payload_len);
+    COSE_ssize_t res = _encrypt_encode(encrypt, buf, len, nonce, out);
+    COSE_TRACE_RETURN(encrypt_encode, cose_encrypt_get_algo(encrypt),
+                      encrypt->payload_len, res);
+    return res;
+}
+
 static int _encrypt_decode_get_prot(const cose_encrypt_dec_t *encrypt, const uint8_t **buf, size_t *len)
 {
     return cose_cbor_decode_get_prot(encrypt->buf, encrypt->len, buf, len);
@@ -416,6 +564,63 @@ int cose_encrypt_decode(cose_encrypt_dec_t *encrypt, uint8_t *buf, size_t len)
     return COSE_OK;
 }
 
+/* Validate an encrypt or recipient structure, recursing into the
+ * recipients. Recursion is bounded by the depth limit */
+static int _encrypt_validate_struct(cose_cbor_validator_t *v,
+                                    nanocbor_value_t *it, unsigned depth)
+{
+    nanocbor_value_t arr;
+
+    int res = cose_cbor_validate_array(v, it, &arr, 3, 4, depth);
+    if (res < 0) {
+        return res;
+    }
+    res = cose_cbor_validate_headers(v, &arr, depth + 1);
+    if (res < 0) {
+        return res;
+    }
+    res = cose_cbor_validate_bstr(v, &arr, true);
+    if (res < 0) {
+        return res;
+    }
+    if (!nanocbor_at_end(&arr)) {
+        nanocbor_value_t recps;
+        res = cose_cbor_validate_array(v, &arr, &recps, 1, UINT32_MAX,
+                                       depth + 1);
+        while (res == COSE_OK && !nanocbor_at_end(&recps)) {
+            res = _encrypt_validate_struct(v, &recps, depth + 2);
+        }
+        if (res < 0) {
+            return res;
+        }
+        nanocbor_leave_container(&arr, &recps);
+    }
+    nanocbor_leave_container(it, &arr);
+    return COSE_OK;
+}
+
+int cose_encrypt_decode_validate(cose_encrypt_dec_t *encrypt, uint8_t *buf,
+                                 size_t len,
+                                 const cose_decode_limits_t *limits)
+{
+    cose_cbor_validator_t v;
+    nanocbor_value_t it;
+
+    cose_cbor_validator_init(&v, limits);
+    nanocbor_decoder_init(&it, buf, len);
+    int res = cose_cbor_validate_tag(&v, &it);
+    if (res == COSE_OK) {
+        res = _encrypt_validate_struct(&v, &it, 0);
+    }
+    if (res < 0) {
+        return res;
+    }
+    if (!nanocbor_at_end(&it)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    return cose_encrypt_decode(encrypt, buf, len);
+}
+
 bool cose_encrypt_recp_iter(const cose_encrypt_dec_t *encrypt,
                             cose_recp_dec_t *recp)
 {
@@ -446,11 +651,103 @@ bool cose_encrypt_recp_iter(const cose_encrypt_dec_t *encrypt,
     return false;
 }
 
-/* Try to decrypt a packet */
-int cose_encrypt_decrypt(const cose_encrypt_dec_t *encrypt,
-                         const cose_recp_dec_t *recp,
-                         const cose_key_t *key, uint8_t *buf,
-                         size_t len, uint8_t *payload, size_t *payload_len)
+static int _encrypt_decode_cek(const cose_recp_dec_t *recp,
+                               const cose_key_t *key,
+                               const cose_recp_kdf_t *local,
+                               const cose_crypto_algo_t *desc,
+                               uint8_t *buf, size_t len, const uint8_t **cek)
+{
+    cose_recp_kdf_t kdf;
+    const uint8_t *prot = NULL;
+    size_t prot_len = 0;
+
+    *cek = key->d;
+    if (!recp) {
+        return COSE_OK;
+    }
+    int res = cose_recp_decode_kdf(recp, &kdf, &prot, &prot_len);
+    if (res == COSE_ERR_NOT_FOUND) {
+        return COSE_OK;
+    }
+    if (res < 0) {
+        return res;
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
+    }
+    if (local) {
+        kdf.peer = local->peer;
+        kdf.cache = local->cache;
+        kdf.ecdh = local->ecdh;
+    }
+    res = cose_recp_kdf_derive(&kdf, key, desc->algo, desc->key_len, prot,
+                               prot_len, buf, buf + desc->key_len,
+                               len - desc->key_len);
+    *cek = buf;
+    return res;
+}
+
+int cose_encrypt_decrypt_prepare(const cose_encrypt_dec_t *encrypt,
+                                 const cose_recp_dec_t *recp,
+                                 const cose_key_t *key, uint8_t *buf,
+                                 size_t len, cose_encrypt_aead_t *aead)
+{
+    return cose_encrypt_decrypt_prepare_cached(encrypt, recp, key, NULL, buf,
+                                               len, aead);
+}
+
+/* Decode the nonce, a full IV or, with a replay window, a Partial IV that
+ * is combined with the base IV in the scratch buffer */
+static int _encrypt_decode_nonce(const cose_encrypt_dec_t *encrypt,
+                                 const cose_crypto_algo_t *desc,
+                                 const cose_replay_window_t *window,
+                                 uint8_t *buf, size_t len,
+                                 const uint8_t **nonce, uint64_t *seq)
+{
+    cose_hdr_t nonce_hdr;
+
+    if (!window) {
+        if (cose_encrypt_decode_unprotected(encrypt, &nonce_hdr,
+                                            COSE_HDR_IV) < 0) {
+            return COSE_ERR_CRYPTO;
+        }
+        if (nonce_hdr.type != COSE_HDR_TYPE_BSTR ||
+                nonce_hdr.len != desc->nonce_len) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        *nonce = nonce_hdr.v.data;
+        return COSE_OK;
+    }
+
+    if (cose_encrypt_decode_unprotected(encrypt, &nonce_hdr,
+                                        COSE_HDR_PARTIALIV) < 0) {
+        return COSE_ERR_CRYPTO;
+    }
+    if (nonce_hdr.type != COSE_HDR_TYPE_BSTR || nonce_hdr.len == 0 ||
+            nonce_hdr.len > sizeof(uint64_t) ||
+            nonce_hdr.len > desc->nonce_len) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (len < desc->nonce_len) {
+        return COSE_ERR_NOMEM;
+    }
+    *seq = 0;
+    for (size_t i = 0; i < nonce_hdr.len; i++) {
+        *seq = (*seq << 8) | nonce_hdr.v.data[i];
+    }
+    cose_encrypt_partial_iv_nonce(buf, desc->nonce_len, window->base_iv,
+                                  nonce_hdr.v.data, nonce_hdr.len);
+    *nonce = buf;
+    return COSE_OK;
+}
+
+static int _encrypt_decrypt_prepare(const cose_encrypt_dec_t *encrypt,
+                                    const cose_recp_dec_t *recp,
+                                    const cose_key_t *key,
+                                    const cose_recp_kdf_t *local,
+                                    cose_replay_window_t *window,
+                                    uint8_t *buf, size_t len,
+                                    cose_encrypt_aead_t *aead, uint64_t *seq)
 {
     if (recp == NULL && !_is_encrypt0_dec(encrypt)) {
         return COSE_ERR_CRYPTO;
@@ -460,18 +757,10 @@ int cose_encrypt_decrypt(const cose_encrypt_dec_t *encrypt,
     if (aad_len < 0) {
        return (int)aad_len;
     }
-    cose_hdr_t nonce_hdr;
-    if (cose_encrypt_decode_unprotected(encrypt, &nonce_hdr, COSE_HDR_IV) < 0) {
-        return COSE_ERR_CRYPTO;
-    }
-
-    if (nonce_hdr.type != COSE_HDR_TYPE_BSTR) {
-        return COSE_ERR_INVALID_CBOR;
+    if ((size_t)aad_len > len) {
+        return COSE_ERR_NOMEM;
     }
 
-    const uint8_t *nonce = nonce_hdr.v.data;
-
-    cose_algo_t algo = COSE_ALGO_NONE;
     cose_hdr_t algo_hdr;
 
     if (cose_encrypt_decode_protected(encrypt, &algo_hdr, COSE_HDR_ALG) < 0) {
@@ -482,13 +771,241 @@ int cose_encrypt_decrypt(const cose_encrypt_dec_t *encrypt,
         return COSE_ERR_INVALID_CBOR;
     }
 
-    algo = algo_hdr.v.value;
-
-    if (algo != key->algo) {
+    if (algo_hdr.v.value != key->algo) {
         return COSE_ERR_CRYPTO;
     }
 
-    const uint8_t *cek = key->d;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo_hdr.v.value);
+    if (!desc || !desc->decrypt) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+
+    /* A nonce derived from a Partial IV follows the AAD in the scratch
+     * buffer */
+    size_t used = (size_t)aad_len;
+    int res = _encrypt_decode_nonce(encrypt, desc, window, buf + used,
+                                    len - used, &aead->nonce, seq);
+    if (res < 0) {
+        return res;
+    }
+    if (window) {
+        /* Skip the key derivation for replays */
+        res = cose_replay_check(window, *seq);
+        if (res < 0) {
+            return res;
+        }
+        used += desc->nonce_len;
+    }
+
+    /* A derived key is placed behind them */
+    res = _encrypt_decode_cek(recp, key, local, desc, buf + used, len - used,
+                              &aead->cek);
+    if (res < 0) {
+        return res;
+    }
+
+    aead->aad = buf;
+    aead->aad_len = aad_len;
+    aead->ciphertext = encrypt->payload;
+    aead->ciphertext_len = encrypt->payload_len;
+    aead->algo = algo_hdr.v.value;
+    aead->desc = desc;
+    return COSE_OK;
+}
+
+int cose_encrypt_decrypt_prepare_cached(const cose_encrypt_dec_t *encrypt,
+                                        const cose_recp_dec_t *recp,
+                                        const cose_key_t *key,
+                                        const cose_recp_kdf_t *local,
+                                        uint8_t *buf, size_t len,
+                                        cose_encrypt_aead_t *aead)
+{
+    return _encrypt_decrypt_prepare(encrypt, recp, key, local, NULL, buf, len,
+                                    aead, NULL);
+}
+
+int cose_encrypt_decrypt_aead(const cose_encrypt_aead_t *aead,
+                              uint8_t *payload, size_t *payload_len)
+{
+    return aead->desc->decrypt(payload, payload_len, aead->ciphertext,
+                               aead->ciphertext_len, aead->aad, aead->aad_len,
+                               aead->nonce, aead->cek, aead->algo);
+}
+
+/* Try to decrypt a packet */
+int cose_encrypt_decrypt(const cose_encrypt_dec_t *encrypt,
+                         const cose_recp_dec_t *recp,
+                         const cose_key_t *key, uint8_t *buf,
+                         size_t len, uint8_t *payload, size_t *payload_len)
+{
+    cose_encrypt_aead_t aead;
+
+    COSE_TRACE_ENTRY(encrypt_decrypt, key->algo, encrypt->payload_len);
+    int res = cose_encrypt_decrypt_prepare(encrypt, recp, key, buf, len, &aead);
+    if (res == COSE_OK) {
+        res = cose_encrypt_decrypt_aead(&aead, payload, payload_len);
+    }
+    COSE_TRACE_RETURN(encrypt_decrypt, key->algo, encrypt->payload_len, res);
+    return res;
+}
+
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+#define REPLAY_ATOMIC
+#endif
+
+#if (COSE_REPLAY_WINDOW < 64) || (COSE_REPLAY_WINDOW > 1024) || \
+    (COSE_REPLAY_WINDOW % 32)
+#error "COSE_REPLAY_WINDOW must be a multiple of 32 from 64 to 1024"
+#endif
+
+#define REPLAY_BLOCK_SHIFT  5U
+#define REPLAY_BLOCK_MASK   31U
+
+static uint64_t _replay_load(const uint64_t *word)
+{
+#ifdef REPLAY_ATOMIC
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+#else
+    return *word;
+#endif
+}
+
+static bool _replay_cas(uint64_t *word, uint64_t *expected, uint64_t desired)
+{
+#ifdef REPLAY_ATOMIC
+    return __atomic_compare_exchange_n(word, expected, desired, true,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#else
+    if (*word != *expected) {
+        *expected = *word;
+        return false;
+    }
+    *word = desired;
+    return true;
+#endif
+}
+
+static void _replay_lock(const cose_replay_window_t *window)
+{
+#ifndef REPLAY_ATOMIC
+    if (window->lock) {
+        window->lock->lock(window->lock->ctx);
+    }
+#else
+    (void)window;
+#endif
+}
+
+static void _replay_unlock(const cose_replay_window_t *window)
+{
+#ifndef REPLAY_ATOMIC
+    if (window->lock) {
+        window->lock->unlock(window->lock->ctx);
+    }
+#else
+    (void)window;
+#endif
+}
+
+/* Check a sequence number against a block word, computes the updated word
+ * when it is new */
+static int _replay_block(uint64_t word, uint64_t block, uint32_t bit,
+                         uint64_t *update)
+{
+    int32_t diff = (int32_t)((uint32_t)block - (uint32_t)(word >> 32));
+
+    if (diff < 0) {
+        /* Block reused by a newer block number */
+        return COSE_ERR_REPLAY;
+    }
+    if (diff == 0) {
+        if (word & bit) {
+            return COSE_ERR_REPLAY;
+        }
+        *update = word | bit;
+    }
+    else {
+        *update = ((uint64_t)(uint32_t)block << 32) | bit;
+    }
+    return COSE_OK;
+}
+
+void cose_replay_init(cose_replay_window_t *window, const uint8_t *base_iv,
+                      const cose_lock_t *lock)
+{
+    memset(window, 0, sizeof(cose_replay_window_t));
+    window->base_iv = base_iv;
+    window->lock = lock;
+}
 
-    return cose_crypto_aead_decrypt(payload, payload_len, encrypt->payload, encrypt->payload_len, buf, aad_len, nonce, cek, algo);
+int cose_replay_check(cose_replay_window_t *window, uint64_t seq)
+{
+    uint64_t block = seq >> REPLAY_BLOCK_SHIFT;
+    uint32_t bit = 1U << (seq & REPLAY_BLOCK_MASK);
+    uint64_t update;
+
+    _replay_lock(window);
+    int res = COSE_ERR_REPLAY;
+    if (block + COSE_REPLAY_BLOCKS > _replay_load(&window->top)) {
+        uint64_t word =
+            _replay_load(&window->blocks[block % COSE_REPLAY_BLOCKS]);
+        res = _replay_block(word, block, bit, &update);
+    }
+    _replay_unlock(window);
+    return res;
+}
+
+int cose_replay_update(cose_replay_window_t *window, uint64_t seq)
+{
+    uint64_t block = seq >> REPLAY_BLOCK_SHIFT;
+    uint32_t bit = 1U << (seq & REPLAY_BLOCK_MASK);
+    uint64_t *word = &window->blocks[block % COSE_REPLAY_BLOCKS];
+    uint64_t update = 0;
+    int res = COSE_OK;
+
+    _replay_lock(window);
+    uint64_t top = _replay_load(&window->top);
+    if (block + COSE_REPLAY_BLOCKS <= top) {
+        res = COSE_ERR_REPLAY;
+    }
+    for (uint64_t cur = _replay_load(word); res == COSE_OK;) {
+        res = _replay_block(cur, block, bit, &update);
+        if (res == COSE_OK && _replay_cas(word, &cur, update)) {
+            break;
+        }
+    }
+    /* Advance the highest block number, blocks that fall out of the window
+     * are overwritten lazily when their slot is reused */
+    while (res == COSE_OK && block > top &&
+           !_replay_cas(&window->top, &top, block)) {
+    }
+    _replay_unlock(window);
+    return res;
+}
+
+int cose_encrypt_decrypt_replay(const cose_encrypt_dec_t *encrypt,
+                                const cose_recp_dec_t *recp,
+                                const cose_key_t *key,
+                                cose_replay_window_t *window,
+                                uint8_t *buf, size_t len,
+                                uint8_t *payload, size_t *payload_len)
+{
+    cose_encrypt_aead_t aead;
+    uint64_t seq = 0;
+    int res = _encrypt_decrypt_prepare(encrypt, recp, key, NULL, window, buf,
+                                       len, &aead, &seq);
+    if (res != COSE_OK) {
+        return res;
+    }
+    res = cose_encrypt_decrypt_aead(&aead, payload, payload_len);
+    if (res != COSE_OK) {
+        return res;
+    }
+    /* Lost a race against a concurrent copy of the same message */
+    res = cose_replay_update(window, seq);
+    if (res != COSE_OK) {
+        memset(payload, 0, *payload_len);
+        *payload_len = 0;
+    }
+    return res;
 }
@@ -8,6 +8,7 @@
  */
 
 #include "cose_defines.h"
+#include "cose/common.h"
 #include "cose/hdr.h"
 #include <nanocbor/nanocbor.h>
 #include <string.h>
@@ -36,6 +37,18 @@ static int _hdr_encode_to_cbor_map(const cose_hdr_t *hdr, nanocbor_encoder_t *ma
     return res;
 }
 
+/* Store a decoded length, rejecting lengths not fitting the compact layout */
+static bool _hdr_set_len(cose_hdr_t *hdr, size_t len)
+{
+#ifdef COSE_COMPACT_LAYOUT
+    if (len > COSE_HDR_COMPACT_LEN_MAX) {
+        return false;
+    }
+#endif
+    hdr->len = len;
+    return true;
+}
+
 /* Convert a map value to a cose_hdr struct */
 static bool _hdr_decode_from_cbor_map(cose_hdr_t *hdr, int32_t key,
                                       nanocbor_value_t *val)
@@ -43,6 +56,7 @@ static bool _hdr_decode_from_cbor_map(cose_hdr_t *hdr, int32_t key,
     hdr->key = key;
     hdr->type = COSE_HDR_TYPE_UNDEF;
     int type = nanocbor_get_type(val);
+    size_t len = 0;
 
     if (type == NANOCBOR_TYPE_NINT || type == NANOCBOR_TYPE_UINT) {
         hdr->type = COSE_HDR_TYPE_INT;
@@ -51,18 +65,18 @@ static bool _hdr_decode_from_cbor_map(cose_hdr_t *hdr, int32_t key,
     }
     if (type == NANOCBOR_TYPE_TSTR) {
         hdr->type = COSE_HDR_TYPE_TSTR;
-        nanocbor_get_tstr(val, (const uint8_t **)&hdr->v.str, &hdr->len);
-        return true;
+        nanocbor_get_tstr(val, (const uint8_t **)&hdr->v.str, &len);
+        return _hdr_set_len(hdr, len);
     }
     if (type == NANOCBOR_TYPE_BSTR) {
         hdr->type = COSE_HDR_TYPE_BSTR;
-        nanocbor_get_bstr(val, &hdr->v.data, &hdr->len);
-        return true;
+        nanocbor_get_bstr(val, &hdr->v.data, &len);
+        return _hdr_set_len(hdr, len);
     }
     if (type == NANOCBOR_TYPE_MAP || type == NANOCBOR_TYPE_ARR || type == NANOCBOR_TYPE_TAG) {
         hdr->type = COSE_HDR_TYPE_CBOR;
-        nanocbor_get_subcbor(val, &hdr->v.cbor, &hdr->len);
-        return true;
+        nanocbor_get_subcbor(val, &hdr->v.cbor, &len);
+        return _hdr_set_len(hdr, len);
     }
     return false;
 }
@@ -82,12 +96,18 @@ void cose_hdr_format_string(cose_hdr_t *hdr, int32_t key, const char *str)
     hdr->v.str = str;
 }
 
-void cose_hdr_format_data(cose_hdr_t *hdr, int32_t key, const uint8_t *data, size_t len)
+bool cose_hdr_format_data(cose_hdr_t *hdr, int32_t key, const uint8_t *data, size_t len)
 {
-    hdr->type = COSE_HDR_TYPE_BSTR;
     hdr->key = key;
     hdr->v.data = data;
-    hdr->len = len;
+    /* An undefined header fails to encode instead of truncating the data */
+    hdr->type = COSE_HDR_TYPE_UNDEF;
+    if (!_hdr_set_len(hdr, len)) {
+        hdr->len = 0;
+        return false;
+    }
+    hdr->type = COSE_HDR_TYPE_BSTR;
+    return true;
 }
 
 void cose_hdr_insert(cose_hdr_t **hdrs, cose_hdr_t *nhdr)
@@ -99,7 +119,7 @@ void cose_hdr_insert(cose_hdr_t **hdrs, cose_hdr_t *nhdr)
 int cose_hdr_encode_to_map(const cose_hdr_t *hdr, nanocbor_encoder_t *map)
 {
     int err = 0;
-    for (; hdr; hdr = hdr->next) {
+    for (; hdr && err == 0; hdr = hdr->next) {
         err = _hdr_encode_to_cbor_map(hdr, map);
     }
     return err;
@@ -148,6 +168,22 @@ size_t cose_hdr_size(const cose_hdr_t *hdr)
     return res;
 }
 
+static bool _hdr_list_encodable(const cose_hdr_t *hdr)
+{
+    for (; hdr; hdr = hdr->next) {
+        if (hdr->type == COSE_HDR_TYPE_UNDEF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cose_hdr_encodable(const cose_headers_t *headers)
+{
+    return _hdr_list_encodable(headers->prot) &&
+           _hdr_list_encodable(headers->unprot);
+}
+
 bool cose_hdr_decode_from_cbor(const uint8_t *buf, size_t len, cose_hdr_t *hdr, int32_t key)
 {
     nanocbor_value_t it;
@@ -162,12 +198,203 @@ bool cose_hdr_decode_from_cbor(const uint8_t *buf, size_t len, cose_hdr_t *hdr,
             if (ckey == key) {
                 return _hdr_decode_from_cbor_map(hdr, ckey, &map);
             }
-            nanocbor_skip(&map);
         }
-        else {
+        else if (nanocbor_get_type(&map) != NANOCBOR_TYPE_TSTR ||
+                 nanocbor_skip(&map) < 0) {
+            /* Only text string labels are skipped */
+            break;
+        }
+        if (nanocbor_skip(&map) < 0) {
             break;
         }
     }
     return false;
 }
 
+
+/* Locate the unprotected header map of an encoded COSE message */
+static int _hdr_msg_unprot(const uint8_t *msg, size_t msg_len,
+                           const uint8_t **map, size_t *map_len)
+{
+    nanocbor_value_t p;
+    nanocbor_value_t arr;
+
+    nanocbor_decoder_init(&p, msg, msg_len);
+    while (nanocbor_get_type(&p) == NANOCBOR_TYPE_TAG) {
+        if (nanocbor_skip_simple(&p) < 0) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+    }
+    if (nanocbor_enter_array(&p, &arr) < 0 ||
+            nanocbor_container_indefinite(&arr) ||
+            nanocbor_container_remaining(&arr) < 3) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (nanocbor_get_type(&arr) != NANOCBOR_TYPE_BSTR ||
+            nanocbor_skip(&arr) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (nanocbor_get_type(&arr) != NANOCBOR_TYPE_MAP ||
+            nanocbor_get_subcbor(&arr, map, map_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    return COSE_OK;
+}
+
+static bool _hdr_in_list(const cose_hdr_t *hdrs, int32_t key)
+{
+    for (; hdrs; hdrs = hdrs->next) {
+        if (hdrs->key == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Copy the existing entries not replaced by @p hdrs to @p out, returns the
+ * number of entries kept */
+static COSE_ssize_t _hdr_patch_keep(const uint8_t *map, size_t map_len,
+                                    const cose_hdr_t *hdrs, uint8_t *out,
+                                    size_t *len)
+{
+    nanocbor_value_t it;
+    nanocbor_value_t entries;
+    size_t kept = 0;
+
+    *len = 0;
+    nanocbor_decoder_init(&it, map, map_len);
+    if (nanocbor_enter_map(&it, &entries) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (nanocbor_container_indefinite(&entries)) {
+        return COSE_ERR_CBOR_NOTSUP;
+    }
+    while (!nanocbor_at_end(&entries)) {
+        const uint8_t *start = entries.cur;
+        int32_t key = 0;
+        bool replaced = false;
+        int type = nanocbor_get_type(&entries);
+        if ((type == NANOCBOR_TYPE_UINT || type == NANOCBOR_TYPE_NINT) &&
+                nanocbor_get_int32(&entries, &key) >= 0) {
+            replaced = _hdr_in_list(hdrs, key);
+        }
+        else if (nanocbor_skip(&entries) < 0) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        if (nanocbor_skip(&entries) < 0) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        if (!replaced) {
+            size_t entry_len = (size_t)(entries.cur - start);
+            if (out) {
+                memcpy(out + *len, start, entry_len);
+            }
+            *len += entry_len;
+            kept++;
+        }
+    }
+    return kept;
+}
+
+/* Build the patched unprotected map, only the size with a NULL buffer */
+static COSE_ssize_t _hdr_patch_map(const uint8_t *map, size_t map_len,
+                                   const cose_hdr_t *hdrs,
+                                   uint8_t *buf, size_t len)
+{
+    nanocbor_encoder_t enc;
+    size_t added = 0;
+    size_t kept_len = 0;
+
+    nanocbor_encoder_init(&enc, NULL, 0);
+    for (const cose_hdr_t *h = hdrs; h; h = h->next) {
+        if (h->type == COSE_HDR_TYPE_UNDEF) {
+            continue;
+        }
+        if (_hdr_encode_to_cbor_map(h, &enc) < 0) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+        added++;
+    }
+    size_t added_len = nanocbor_encoded_len(&enc);
+    COSE_ssize_t kept = _hdr_patch_keep(map, map_len, hdrs, NULL, &kept_len);
+    if (kept < 0) {
+        return kept;
+    }
+    size_t total = (size_t)kept + added;
+    size_t head_len = COSE_CBOR_HEAD_SIZE(total);
+    if (!buf) {
+        return head_len + kept_len + added_len;
+    }
+    if (head_len + kept_len + added_len > len) {
+        return COSE_ERR_NOMEM;
+    }
+
+    nanocbor_encoder_init(&enc, buf, head_len);
+    nanocbor_fmt_map(&enc, total);
+    _hdr_patch_keep(map, map_len, hdrs, buf + head_len, &kept_len);
+    nanocbor_encoder_init(&enc, buf + head_len + kept_len, added_len);
+    for (const cose_hdr_t *h = hdrs; h; h = h->next) {
+        if (h->type != COSE_HDR_TYPE_UNDEF) {
+            _hdr_encode_to_cbor_map(h, &enc);
+        }
+    }
+    return head_len + kept_len + added_len;
+}
+
+COSE_ssize_t cose_hdr_patch_unprot_head(const uint8_t *msg, size_t msg_len,
+                                        const cose_hdr_t *hdrs,
+                                        uint8_t *buf, size_t len,
+                                        const uint8_t **tail,
+                                        size_t *tail_len)
+{
+    const uint8_t *map = NULL;
+    size_t map_len = 0;
+
+    int res = _hdr_msg_unprot(msg, msg_len, &map, &map_len);
+    if (res < 0) {
+        return res;
+    }
+    size_t prefix_len = (size_t)(map - msg);
+    if (prefix_len > len) {
+        return COSE_ERR_NOMEM;
+    }
+    COSE_ssize_t patched = _hdr_patch_map(map, map_len, hdrs,
+                                          buf + prefix_len, len - prefix_len);
+    if (patched < 0) {
+        return patched;
+    }
+    memcpy(buf, msg, prefix_len);
+    *tail = map + map_len;
+    *tail_len = msg_len - prefix_len - map_len;
+    return prefix_len + (size_t)patched;
+}
+
+COSE_ssize_t cose_hdr_patch_unprot(uint8_t *buf, size_t len, size_t msg_len,
+                                   const cose_hdr_t *hdrs)
+{
+    const uint8_t *map = NULL;
+    size_t map_len = 0;
+
+    int res = _hdr_msg_unprot(buf, msg_len, &map, &map_len);
+    if (res < 0) {
+        return res;
+    }
+    COSE_ssize_t patched = _hdr_patch_map(map, map_len, hdrs, NULL, 0);
+    if (patched < 0) {
+        return patched;
+    }
+    size_t map_pos = (size_t)(map - buf);
+    size_t tail_len = msg_len - map_pos - map_len;
+    size_t new_len = msg_len - map_len + (size_t)patched;
+
+    /* The new map is built behind both the old and the new message */
+    size_t scratch = new_len > msg_len ? new_len : msg_len;
+    if (scratch + (size_t)patched > len) {
+        return COSE_ERR_NOMEM;
+    }
+    _hdr_patch_map(map, map_len, hdrs, buf + scratch, (size_t)patched);
+    memmove(buf + map_pos + (size_t)patched, buf + map_pos + map_len,
+            tail_len);
+    memcpy(buf + map_pos, buf + scratch, (size_t)patched);
+    return new_len;
+}
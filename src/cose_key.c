@@ -7,6 +7,7 @@
  * directory for more details.
  */
 #include "cose.h"
+#include "cose/crypto.h"
 #include "cose/intern.h"
 #include <nanocbor/nanocbor.h>
 #include <stdint.h>
@@ -63,3 +64,620 @@ void cose_key_unprotected_to_map(const cose_key_t *key, nanocbor_encoder_t *map)
     nanocbor_fmt_int(map, COSE_HDR_KID);
     nanocbor_put_bstr(map, key->kid, key->kid_len);
 }
+
+static size_t _key_coord_len(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P256:
+        case COSE_EC_CURVE_X25519:
+        case COSE_EC_CURVE_ED25519:
+            return 32;
+        case COSE_EC_CURVE_P384:
+            return 48;
+        case COSE_EC_CURVE_X448:
+            return 56;
+        case COSE_EC_CURVE_ED448:
+            return 57;
+        case COSE_EC_CURVE_P521:
+            return 66;
+        default:
+            return 0;
+    }
+}
+
+static size_t _key_symm_len(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    return desc ? desc->key_len : 0;
+}
+
+int cose_key_to_cbor(const cose_key_t *key, bool private_key,
+                     nanocbor_encoder_t *enc)
+{
+    size_t len = _key_coord_len(key->crv);
+    size_t offset = 0;
+    const uint8_t *d = private_key ? key->d : NULL;
+    size_t entries = 1 + (key->kid_len > 0) + (key->algo != COSE_ALGO_NONE);
+
+    switch (key->kty) {
+        case COSE_KTY_EC2:
+            /* Coordinates are right aligned in the backend key buffers */
+            if (!len || len > COSE_CRYPTO_EC2_KEYBYTES) {
+                return COSE_ERR_INVALID_PARAM;
+            }
+            offset = COSE_CRYPTO_EC2_KEYBYTES - len;
+            entries += 1 + (key->x != NULL) + (key->y != NULL) + (d != NULL);
+            break;
+        case COSE_KTY_OCTET:
+            if (!len) {
+                return COSE_ERR_INVALID_PARAM;
+            }
+            entries += 1 + (key->x != NULL) + (d != NULL);
+            break;
+        case COSE_KTY_SYMM:
+            len = _key_symm_len(key->algo);
+            if (!len) {
+                return COSE_ERR_INVALID_PARAM;
+            }
+            entries += (d != NULL);
+            break;
+        default:
+            return COSE_ERR_INVALID_PARAM;
+    }
+
+    nanocbor_fmt_map(enc, entries);
+    nanocbor_fmt_int(enc, COSE_KEY_PARAM_KTY);
+    nanocbor_fmt_int(enc, key->kty);
+    if (key->kid_len) {
+        nanocbor_fmt_int(enc, COSE_KEY_PARAM_KID);
+        nanocbor_put_bstr(enc, key->kid, key->kid_len);
+    }
+    if (key->algo != COSE_ALGO_NONE) {
+        nanocbor_fmt_int(enc, COSE_KEY_PARAM_ALGO);
+        nanocbor_fmt_int(enc, key->algo);
+    }
+    if (key->kty == COSE_KTY_SYMM) {
+        if (d) {
+            nanocbor_fmt_int(enc, COSE_KEY_PARAM_K);
+            nanocbor_put_bstr(enc, d, len);
+        }
+        return COSE_OK;
+    }
+    nanocbor_fmt_int(enc, COSE_KEY_PARAM_CRV);
+    nanocbor_fmt_int(enc, key->crv);
+    if (key->x) {
+        nanocbor_fmt_int(enc, COSE_KEY_PARAM_X);
+        nanocbor_put_bstr(enc, key->x + offset, len);
+    }
+    if (key->y && key->kty == COSE_KTY_EC2) {
+        nanocbor_fmt_int(enc, COSE_KEY_PARAM_Y);
+        nanocbor_put_bstr(enc, key->y + offset, len);
+    }
+    if (d) {
+        nanocbor_fmt_int(enc, COSE_KEY_PARAM_D);
+        nanocbor_put_bstr(enc, d + offset, len);
+    }
+    return COSE_OK;
+}
+
+COSE_ssize_t cose_keyset_encode(const cose_key_t *keys, size_t num,
+                                bool private_key, uint8_t *buf, size_t len)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, buf ? len : 0);
+
+    nanocbor_fmt_array(&enc, num);
+    for (size_t i = 0; i < num; i++) {
+        int res = cose_key_to_cbor(&keys[i], private_key, &enc);
+        if (res < 0) {
+            return res;
+        }
+    }
+    size_t size = nanocbor_encoded_len(&enc);
+    if (buf && size > len) {
+        return COSE_ERR_NOMEM;
+    }
+    return (COSE_ssize_t)size;
+}
+
+typedef struct {
+    const cose_key_gen_t *gen;  /* Generation parameters */
+    cose_key_t *keys;           /* First key of the job */
+    uint8_t *buf;               /* Key material of the first key */
+    size_t first;               /* Index of the first key in the batch */
+    size_t num;                 /* Number of keys in the job */
+    int res;                    /* Result of the job */
+} _key_gen_job_t;
+
+static size_t _key_gen_layout(const cose_key_gen_t *gen, size_t *x_len,
+                              size_t *y_len, size_t *d_len)
+{
+    *x_len = *y_len = *d_len = 0;
+    switch (gen->crv) {
+#ifdef HAVE_ALGO_EDDSA
+        case COSE_EC_CURVE_ED25519:
+            *x_len = COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES;
+            *d_len = COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES;
+            break;
+#endif
+#ifdef HAVE_ALGO_ECDSA
+        case COSE_EC_CURVE_P256:
+        case COSE_EC_CURVE_P384:
+        case COSE_EC_CURVE_P521:
+            *x_len = *y_len = *d_len = COSE_CRYPTO_EC2_KEYBYTES;
+            break;
+#endif
+        case COSE_EC_NONE:
+            *d_len = _key_symm_len(gen->algo);
+            break;
+        default:
+            break;
+    }
+    return *x_len + *y_len + *d_len;
+}
+
+static bool _key_gen_kid_valid(const cose_key_gen_t *gen)
+{
+    switch (gen->kid) {
+        case COSE_KEY_KID_NONE:
+            return true;
+        case COSE_KEY_KID_COUNTER:
+            return gen->kid_len > 0 && gen->kid_len <= sizeof(uint64_t);
+        case COSE_KEY_KID_PUBLIC:
+            return gen->kid_len > 0 && gen->kid_len <= _key_coord_len(gen->crv);
+        default:
+            return false;
+    }
+}
+
+size_t cose_key_gen_size(const cose_key_gen_t *gen)
+{
+    size_t x_len, y_len, d_len;
+    size_t size = _key_gen_layout(gen, &x_len, &y_len, &d_len);
+
+    if (!d_len || !_key_gen_kid_valid(gen)) {
+        return 0;
+    }
+    return gen->kid == COSE_KEY_KID_NONE ? size : size + gen->kid_len;
+}
+
+static int _key_gen_one(const cose_key_gen_t *gen, cose_key_t *key,
+                        uint8_t *buf, uint64_t idx)
+{
+    size_t x_len, y_len, d_len;
+    int res = COSE_ERR_NOTIMPLEMENTED;
+
+    _key_gen_layout(gen, &x_len, &y_len, &d_len);
+    uint8_t *x = x_len ? buf : NULL;
+    uint8_t *y = y_len ? buf + x_len : NULL;
+    uint8_t *d = buf + x_len + y_len;
+    uint8_t *kid = d + d_len;
+
+    cose_key_init(key);
+    cose_key_set_keys(key, gen->crv, gen->algo, x, y, d);
+    switch (key->kty) {
+#ifdef HAVE_ALGO_EDDSA
+        case COSE_KTY_OCTET:
+            res = cose_crypto_keypair_ed25519(key);
+            break;
+#endif
+#ifdef HAVE_ALGO_ECDSA
+        case COSE_KTY_EC2:
+            res = cose_crypto_keypair_ecdsa(key, gen->crv);
+            break;
+#endif
+        case COSE_KTY_SYMM:
+        {
+            COSE_ssize_t len = cose_crypto_keygen(d, d_len, gen->algo);
+            res = len < 0 ? (int)len : COSE_OK;
+            break;
+        }
+        default:
+            break;
+    }
+    if (res != COSE_OK) {
+        return res;
+    }
+
+    if (gen->kid == COSE_KEY_KID_COUNTER) {
+        uint64_t counter = gen->kid_base + idx;
+        for (size_t i = gen->kid_len; i > 0; i--) {
+            kid[i - 1] = (uint8_t)counter;
+            counter >>= 8;
+        }
+    }
+    else if (gen->kid == COSE_KEY_KID_PUBLIC) {
+        size_t offset = key->kty == COSE_KTY_EC2 ?
+            COSE_CRYPTO_EC2_KEYBYTES - _key_coord_len(gen->crv) : 0;
+        memcpy(kid, x + offset, gen->kid_len);
+    }
+    if (gen->kid != COSE_KEY_KID_NONE) {
+        cose_key_set_kid(key, kid, gen->kid_len);
+    }
+    return COSE_OK;
+}
+
+static void _key_gen_job(void *arg)
+{
+    _key_gen_job_t *job = arg;
+    size_t size = cose_key_gen_size(job->gen);
+
+    job->res = COSE_OK;
+    for (size_t i = 0; i < job->num && job->res == COSE_OK; i++) {
+        job->res = _key_gen_one(job->gen, &job->keys[i], job->buf + i * size,
+                                job->first + i);
+    }
+}
+
+int cose_key_generate(const cose_key_gen_t *gen, cose_key_t *keys, size_t num,
+                      uint8_t *buf, size_t len, const cose_executor_t *exec)
+{
+    _key_gen_job_t jobs[COSE_KEY_GEN_JOBS_MAX];
+    size_t size = cose_key_gen_size(gen);
+
+    if (!_key_gen_kid_valid(gen)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    if (!size) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (num > len / size) {
+        return COSE_ERR_NOMEM;
+    }
+
+    size_t num_jobs = exec ? COSE_KEY_GEN_JOBS_MAX : 1;
+    if (num_jobs > num) {
+        num_jobs = num;
+    }
+    size_t first = 0;
+    for (size_t i = 0; i < num_jobs; i++) {
+        _key_gen_job_t *job = &jobs[i];
+        job->gen = gen;
+        job->first = first;
+        job->num = (num - first) / (num_jobs - i);
+        job->keys = &keys[first];
+        job->buf = buf + first * size;
+        first += job->num;
+        if (!exec || exec->submit(exec->ctx, _key_gen_job, job) < 0) {
+            _key_gen_job(job);
+        }
+    }
+    if (exec) {
+        exec->wait(exec->ctx);
+    }
+
+    for (size_t i = 0; i < num_jobs; i++) {
+        if (jobs[i].res != COSE_OK) {
+            return jobs[i].res;
+        }
+    }
+    return COSE_OK;
+}
+
+#if COSE_CRYPTO_EC2_KEYBYTES > COSE_KEYSTORE_EC2_BYTES
+#error "EC2 key buffers are larger than the keystore storage size"
+#endif
+
+/* EC2 key parts are right aligned, leading bytes not used by the backend */
+#define KEYSTORE_EC2_SKIP   (COSE_KEYSTORE_EC2_BYTES - COSE_CRYPTO_EC2_KEYBYTES)
+
+static uint16_t _ks_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _ks_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static void _ks_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _ks_put_u32(uint8_t *p, uint32_t v)
+{
+    _ks_put_u16(p, (uint16_t)v);
+    _ks_put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+/* Storage size of the x, y and d parts of a key, 0 for unsupported keys */
+static size_t _keystore_part_len(const cose_key_t *key)
+{
+    size_t len = _key_coord_len(key->crv);
+
+    switch (key->kty) {
+        case COSE_KTY_EC2:
+            return (len && len <= COSE_CRYPTO_EC2_KEYBYTES) ?
+                   COSE_KEYSTORE_EC2_BYTES : 0;
+        case COSE_KTY_OCTET:
+            return len;
+        case COSE_KTY_SYMM:
+            return _key_symm_len(key->algo);
+        default:
+            return 0;
+    }
+}
+
+static int _keystore_kid_cmp(const uint8_t *a, size_t a_len,
+                             const uint8_t *b, size_t b_len)
+{
+    size_t n = a_len < b_len ? a_len : b_len;
+    int res = n ? memcmp(a, b, n) : 0;
+
+    if (res == 0) {
+        res = (a_len > b_len) - (a_len < b_len);
+    }
+    return res;
+}
+
+static int _keystore_entry_cmp(const uint8_t *img, const uint8_t *index,
+                               size_t i, size_t j)
+{
+    const uint8_t *a = index + i * COSE_KEYSTORE_INDEX_SIZE;
+    const uint8_t *b = index + j * COSE_KEYSTORE_INDEX_SIZE;
+
+    return _keystore_kid_cmp(img + _ks_get_u32(a + 4), _ks_get_u16(a + 8),
+                             img + _ks_get_u32(b + 4), _ks_get_u16(b + 8));
+}
+
+static void _keystore_entry_swap(uint8_t *index, size_t i, size_t j)
+{
+    uint8_t tmp[COSE_KEYSTORE_INDEX_SIZE];
+    uint8_t *a = index + i * COSE_KEYSTORE_INDEX_SIZE;
+    uint8_t *b = index + j * COSE_KEYSTORE_INDEX_SIZE;
+
+    memcpy(tmp, a, sizeof(tmp));
+    memcpy(a, b, sizeof(tmp));
+    memcpy(b, tmp, sizeof(tmp));
+}
+
+static void _keystore_sift(const uint8_t *img, uint8_t *index, size_t root,
+                           size_t end)
+{
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= end) {
+            break;
+        }
+        if (child + 1 < end &&
+                _keystore_entry_cmp(img, index, child, child + 1) < 0) {
+            child++;
+        }
+        if (_keystore_entry_cmp(img, index, root, child) >= 0) {
+            break;
+        }
+        _keystore_entry_swap(index, root, child);
+        root = child;
+    }
+}
+
+/* Heapsort, in place and without recursion for large key sets */
+static void _keystore_sort(const uint8_t *img, uint8_t *index, size_t num)
+{
+    for (size_t i = num / 2; i-- > 0;) {
+        _keystore_sift(img, index, i, num);
+    }
+    for (size_t end = num; end-- > 1;) {
+        _keystore_entry_swap(index, 0, end);
+        _keystore_sift(img, index, 0, end);
+    }
+}
+
+/* Copy a key part into the data section, returns its offset */
+static uint32_t _keystore_put_part(const cose_key_t *key, const uint8_t *part,
+                                   size_t len, uint8_t *buf, uint32_t *pos)
+{
+    uint32_t off = *pos;
+
+    if (key->kty == COSE_KTY_EC2) {
+        memset(buf + off, 0, KEYSTORE_EC2_SKIP);
+        memcpy(buf + off + KEYSTORE_EC2_SKIP, part, COSE_CRYPTO_EC2_KEYBYTES);
+    }
+    else {
+        memcpy(buf + off, part, len);
+    }
+    *pos += (uint32_t)len;
+    return off;
+}
+
+COSE_ssize_t cose_keystore_encode(const cose_key_t *keys, size_t num,
+                                  bool private_key, uint8_t *buf, size_t len)
+{
+    uint64_t index = COSE_KEYSTORE_HDR_SIZE;
+    uint64_t records = index + (uint64_t)num * COSE_KEYSTORE_INDEX_SIZE;
+    uint64_t data = records + (uint64_t)num * COSE_KEYSTORE_RECORD_SIZE;
+    uint64_t size = data;
+
+    for (size_t i = 0; i < num; i++) {
+        const cose_key_t *key = &keys[i];
+        size_t part = _keystore_part_len(key);
+        if (!part || key->kid_len > UINT16_MAX) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+        size += key->kid_len;
+        size += (key->x && key->kty != COSE_KTY_SYMM) ? part : 0;
+        size += (key->y && key->kty == COSE_KTY_EC2) ? part : 0;
+        size += (private_key && key->d) ? part : 0;
+    }
+    if (size > UINT32_MAX) {
+        return COSE_ERR_NOMEM;
+    }
+    if (!buf) {
+        return (COSE_ssize_t)size;
+    }
+    if (size > len) {
+        return COSE_ERR_NOMEM;
+    }
+
+    memset(buf, 0, (size_t)data);
+    _ks_put_u32(buf, COSE_KEYSTORE_MAGIC);
+    _ks_put_u16(buf + 4, COSE_KEYSTORE_VERSION);
+    _ks_put_u16(buf + 6, COSE_KEYSTORE_RECORD_SIZE);
+    _ks_put_u32(buf + 8, (uint32_t)num);
+    _ks_put_u32(buf + 12, (uint32_t)index);
+    _ks_put_u32(buf + 16, (uint32_t)records);
+    _ks_put_u32(buf + 20, (uint32_t)data);
+    _ks_put_u32(buf + 24, (uint32_t)(size - data));
+
+    uint32_t pos = (uint32_t)data;
+    for (size_t i = 0; i < num; i++) {
+        const cose_key_t *key = &keys[i];
+        size_t part = _keystore_part_len(key);
+        uint8_t *rec = buf + records + i * COSE_KEYSTORE_RECORD_SIZE;
+        uint8_t *entry = buf + index + i * COSE_KEYSTORE_INDEX_SIZE;
+
+        _ks_put_u32(rec, (uint32_t)key->kty);
+        _ks_put_u32(rec + 4, (uint32_t)key->algo);
+        _ks_put_u32(rec + 8, (uint32_t)key->crv);
+        _ks_put_u32(rec + 12, pos);
+        _ks_put_u16(rec + 28, (uint16_t)key->kid_len);
+        _ks_put_u32(entry, (uint32_t)i);
+        _ks_put_u32(entry + 4, pos);
+        _ks_put_u16(entry + 8, (uint16_t)key->kid_len);
+        if (key->kid_len) {
+            memcpy(buf + pos, key->kid, key->kid_len);
+            pos += (uint32_t)key->kid_len;
+        }
+        if (key->x && key->kty != COSE_KTY_SYMM) {
+            _ks_put_u32(rec + 16, _keystore_put_part(key, key->x, part, buf, &pos));
+        }
+        if (key->y && key->kty == COSE_KTY_EC2) {
+            _ks_put_u32(rec + 20, _keystore_put_part(key, key->y, part, buf, &pos));
+        }
+        if (private_key && key->d) {
+            _ks_put_u32(rec + 24, _keystore_put_part(key, key->d, part, buf, &pos));
+        }
+    }
+
+    _keystore_sort(buf, buf + index, num);
+    for (size_t i = 1; i < num; i++) {
+        if (_keystore_entry_cmp(buf, buf + index, i - 1, i) == 0) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+    }
+    return (COSE_ssize_t)size;
+}
+
+int cose_keystore_open(cose_keystore_t *store, const uint8_t *buf, size_t len)
+{
+    if (len < COSE_KEYSTORE_HDR_SIZE ||
+            _ks_get_u32(buf) != COSE_KEYSTORE_MAGIC ||
+            _ks_get_u16(buf + 4) != COSE_KEYSTORE_VERSION) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    store->buf = buf;
+    store->len = len;
+    store->stride = _ks_get_u16(buf + 6);
+    store->num = _ks_get_u32(buf + 8);
+    store->index = _ks_get_u32(buf + 12);
+    store->records = _ks_get_u32(buf + 16);
+    store->data = _ks_get_u32(buf + 20);
+    store->data_len = _ks_get_u32(buf + 24);
+
+    if (store->stride < COSE_KEYSTORE_RECORD_SIZE ||
+            store->index + (uint64_t)store->num * COSE_KEYSTORE_INDEX_SIZE > len ||
+            store->records + (uint64_t)store->num * store->stride > len ||
+            (uint64_t)store->data + store->data_len > len) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    return COSE_OK;
+}
+
+static bool _keystore_in_data(const cose_keystore_t *store, uint32_t off,
+                              size_t len)
+{
+    return off >= store->data && off - store->data <= store->data_len &&
+           len <= store->data_len - (off - store->data);
+}
+
+static int _keystore_part(const cose_keystore_t *store, const cose_key_t *key,
+                          uint32_t off, size_t len, uint8_t **part)
+{
+    if (!off) {
+        return COSE_OK;
+    }
+    if (!_keystore_in_data(store, off, len)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    /* The key material is only read through the view */
+    *part = (uint8_t *)(uintptr_t)(store->buf + off);
+    if (key->kty == COSE_KTY_EC2) {
+        *part += KEYSTORE_EC2_SKIP;
+    }
+    return COSE_OK;
+}
+
+static int _keystore_view(const cose_keystore_t *store, uint32_t idx,
+                          cose_key_t *key)
+{
+    if (idx >= store->num) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    const uint8_t *rec = store->buf + store->records + (size_t)idx * store->stride;
+    uint32_t kid = _ks_get_u32(rec + 12);
+    size_t kid_len = _ks_get_u16(rec + 28);
+
+    cose_key_init(key);
+    key->kty = (cose_kty_t)(int32_t)_ks_get_u32(rec);
+    key->algo = (cose_algo_t)(int32_t)_ks_get_u32(rec + 4);
+    key->crv = (cose_curve_t)(int32_t)_ks_get_u32(rec + 8);
+
+    size_t part = _keystore_part_len(key);
+    if (!part || !_keystore_in_data(store, kid, kid_len)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    key->kid = (uint8_t *)(uintptr_t)(store->buf + kid);
+    key->kid_len = kid_len;
+
+    int res = _keystore_part(store, key, _ks_get_u32(rec + 16), part, &key->x);
+    if (res == COSE_OK) {
+        res = _keystore_part(store, key, _ks_get_u32(rec + 20), part, &key->y);
+    }
+    if (res == COSE_OK) {
+        res = _keystore_part(store, key, _ks_get_u32(rec + 24), part, &key->d);
+    }
+    return res;
+}
+
+int cose_keystore_get(const cose_keystore_t *store, size_t idx,
+                      cose_key_t *key)
+{
+    if (idx >= store->num) {
+        return COSE_ERR_NOT_FOUND;
+    }
+    return _keystore_view(store, (uint32_t)idx, key);
+}
+
+int cose_keystore_find(const cose_keystore_t *store, const uint8_t *kid,
+                       size_t kid_len, cose_key_t *key)
+{
+    const uint8_t *index = store->buf + store->index;
+    size_t lo = 0;
+    size_t hi = store->num;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint8_t *entry = index + mid * COSE_KEYSTORE_INDEX_SIZE;
+        uint32_t off = _ks_get_u32(entry + 4);
+        size_t len = _ks_get_u16(entry + 8);
+
+        if (!_keystore_in_data(store, off, len)) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+        int cmp = _keystore_kid_cmp(store->buf + off, len, kid, kid_len);
+        if (cmp == 0) {
+            return _keystore_view(store, _ks_get_u32(entry), key);
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return COSE_ERR_NOT_FOUND;
+}
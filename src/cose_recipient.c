@@ -9,6 +9,7 @@
 
 /* Shared recipient handling between MAC and Encrypt structs */
 #include "cose.h"
+#include "cose/crypto.h"
 #include "cose/intern.h"
 #include <nanocbor/nanocbor.h>
 #include <stdbool.h>
@@ -24,8 +25,61 @@ static void _create_unprotected_direct(cose_recp_t *recp, nanocbor_encoder_t *en
     cose_key_unprotected_to_map(recp->key, enc);
 }
 
+static void _put_opt_bstr(nanocbor_encoder_t *enc, int32_t label,
+                          const uint8_t *buf, size_t len)
+{
+    if (buf) {
+        nanocbor_fmt_int(enc, label);
+        nanocbor_put_bstr(enc, buf, len);
+    }
+}
+
+static bool _kdf_is_ecdh(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    return desc && desc->cls == COSE_CRYPTO_ALGO_KDF &&
+           desc->kty == COSE_KTY_EC2;
+}
+
+static void _build_recp_kdf(cose_recp_t *recp, nanocbor_encoder_t *arr)
+{
+    const cose_recp_kdf_t *kdf = recp->kdf;
+    bool ecdh = _kdf_is_ecdh(kdf->algo) && kdf->peer;
+    uint8_t prot[8];
+    COSE_ssize_t prot_len = cose_recp_kdf_protected(kdf, prot, sizeof(prot));
+
+    nanocbor_fmt_array(arr, 3);
+    nanocbor_put_bstr(arr, prot, prot_len > 0 ? (size_t)prot_len : 0);
+
+    /* Key ID, salt and party information in the unprotected headers */
+    nanocbor_fmt_map(arr, 1 + ecdh + (kdf->salt != NULL) +
+                     (kdf->u_id != NULL) + (kdf->u_nonce != NULL) +
+                     (kdf->v_id != NULL) + (kdf->v_nonce != NULL));
+    if (ecdh) {
+        /* Key ID of the recipient and the static key ID of the sender */
+        cose_key_unprotected_to_map(kdf->peer, arr);
+        nanocbor_fmt_int(arr, COSE_HDR_STATIC_KEY_ID);
+        nanocbor_put_bstr(arr, recp->key->kid, recp->key->kid_len);
+    }
+    else {
+        cose_key_unprotected_to_map(recp->key, arr);
+    }
+    _put_opt_bstr(arr, COSE_HDR_SALT, kdf->salt, kdf->salt_len);
+    _put_opt_bstr(arr, COSE_HDR_PARTYU_ID, kdf->u_id, kdf->u_id_len);
+    _put_opt_bstr(arr, COSE_HDR_PARTYU_NONCE, kdf->u_nonce, kdf->u_nonce_len);
+    _put_opt_bstr(arr, COSE_HDR_PARTYV_ID, kdf->v_id, kdf->v_id_len);
+    _put_opt_bstr(arr, COSE_HDR_PARTYV_NONCE, kdf->v_nonce, kdf->v_nonce_len);
+
+    /* The key is derived, no encrypted key */
+    nanocbor_fmt_bstr(arr, 0);
+}
+
 static bool _build_recp_direct(cose_recp_t *recp, nanocbor_encoder_t *arr)
 {
+    if (recp->kdf) {
+        _build_recp_kdf(recp, arr);
+        return true;
+    }
     /* Build an array with:
      * with zero length protected headers
      * Key ID and algo in the unprotected headers
@@ -137,3 +191,496 @@ int cose_recp_decode_recp(const cose_recp_dec_t *recp, const uint8_t **sign, siz
     }
     return COSE_OK;
 }
+
+static int _decode_opt_bstr(const cose_recp_dec_t *recp, int32_t label,
+                            const uint8_t **buf, size_t *len)
+{
+    cose_hdr_t hdr;
+    if (cose_recp_decode_unprotected(recp, &hdr, label) != COSE_OK) {
+        return COSE_OK;
+    }
+    if (hdr.type != COSE_HDR_TYPE_BSTR) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    *buf = hdr.v.data;
+    *len = hdr.len;
+    return COSE_OK;
+}
+
+int cose_recp_decode_kdf(const cose_recp_dec_t *recp, cose_recp_kdf_t *kdf,
+                         const uint8_t **prot, size_t *prot_len)
+{
+    cose_hdr_t hdr;
+    memset(kdf, 0, sizeof(*kdf));
+    if (cose_cbor_decode_get_prot(recp->buf, recp->len, prot, prot_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (!cose_hdr_decode_from_cbor(*prot, *prot_len, &hdr, COSE_HDR_ALG) ||
+            hdr.type != COSE_HDR_TYPE_INT) {
+        return COSE_ERR_NOT_FOUND;
+    }
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(hdr.v.value);
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_KDF) {
+        return COSE_ERR_NOT_FOUND;
+    }
+    kdf->algo = desc->algo;
+
+    int res = _decode_opt_bstr(recp, COSE_HDR_STATIC_KEY_ID, &kdf->skid,
+                               &kdf->skid_len);
+    if (res == COSE_OK) {
+        res = _decode_opt_bstr(recp, COSE_HDR_SALT, &kdf->salt,
+                               &kdf->salt_len);
+    }
+    if (res == COSE_OK) {
+        res = _decode_opt_bstr(recp, COSE_HDR_PARTYU_ID, &kdf->u_id,
+                               &kdf->u_id_len);
+    }
+    if (res == COSE_OK) {
+        res = _decode_opt_bstr(recp, COSE_HDR_PARTYU_NONCE, &kdf->u_nonce,
+                               &kdf->u_nonce_len);
+    }
+    if (res == COSE_OK) {
+        res = _decode_opt_bstr(recp, COSE_HDR_PARTYV_ID, &kdf->v_id,
+                               &kdf->v_id_len);
+    }
+    if (res == COSE_OK) {
+        res = _decode_opt_bstr(recp, COSE_HDR_PARTYV_NONCE, &kdf->v_nonce,
+                               &kdf->v_nonce_len);
+    }
+    return res;
+}
+
+COSE_ssize_t cose_recp_kdf_protected(const cose_recp_kdf_t *kdf, uint8_t *buf,
+                                     size_t len)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_map(&enc, 1);
+    nanocbor_fmt_int(&enc, COSE_HDR_ALG);
+    nanocbor_fmt_int(&enc, kdf->algo);
+    if (nanocbor_encoded_len(&enc) > len) {
+        return COSE_ERR_NOMEM;
+    }
+    return (COSE_ssize_t)nanocbor_encoded_len(&enc);
+}
+
+static void _kdf_party(nanocbor_encoder_t *enc, const uint8_t *id,
+                       size_t id_len, const uint8_t *nonce, size_t nonce_len)
+{
+    /* PartyInfo = [identity, nonce, other] */
+    nanocbor_fmt_array(enc, 3);
+    if (id) {
+        nanocbor_put_bstr(enc, id, id_len);
+    }
+    else {
+        nanocbor_fmt_null(enc);
+    }
+    if (nonce) {
+        nanocbor_put_bstr(enc, nonce, nonce_len);
+    }
+    else {
+        nanocbor_fmt_null(enc);
+    }
+    nanocbor_fmt_null(enc);
+}
+
+COSE_ssize_t cose_recp_kdf_context(const cose_recp_kdf_t *kdf, cose_algo_t algo,
+                                   size_t key_len, const uint8_t *prot,
+                                   size_t prot_len, uint8_t *buf, size_t len)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+
+    /* COSE_KDF_Context = [AlgorithmID, PartyUInfo, PartyVInfo, SuppPubInfo] */
+    nanocbor_fmt_array(&enc, 4);
+    nanocbor_fmt_int(&enc, algo);
+    _kdf_party(&enc, kdf->u_id, kdf->u_id_len, kdf->u_nonce, kdf->u_nonce_len);
+    _kdf_party(&enc, kdf->v_id, kdf->v_id_len, kdf->v_nonce, kdf->v_nonce_len);
+    nanocbor_fmt_array(&enc, 2);
+    nanocbor_fmt_uint(&enc, key_len * 8);
+    nanocbor_put_bstr(&enc, prot, prot_len);
+    if (nanocbor_encoded_len(&enc) > len) {
+        return COSE_ERR_NOMEM;
+    }
+    return (COSE_ssize_t)nanocbor_encoded_len(&enc);
+}
+
+static void _wipe(void *buf, size_t len)
+{
+    /* Not optimized away like a memset on memory that is not read again */
+    volatile uint8_t *p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+static int _ecdh_peer_hash(const cose_key_t *peer, uint8_t *hash)
+{
+#ifdef HAVE_ALGO_HMAC_SHA256
+    static const uint8_t label[] = "libcose ECDH peer";
+    /* EC2 coordinates fill the backend key buffers */
+    bool okp = peer->kty == COSE_KTY_OCTET;
+    uint8_t crv = (uint8_t)peer->crv;
+    uint8_t digest[32];
+    cose_crypto_chunk_t msg[] = {
+        { .buf = &crv, .len = 1 },
+        { .buf = peer->x, .len = okp ? COSE_CRYPTO_ECDH_X25519_BYTES :
+                                       COSE_CRYPTO_EC2_KEYBYTES },
+        { .buf = peer->y, .len = COSE_CRYPTO_EC2_KEYBYTES },
+    };
+    size_t num = (okp || !peer->y) ? 2 : 3;
+
+    if (!peer->x ||
+            cose_crypto_hmac(COSE_CRYPTO_HASH_SHA256, label,
+                             sizeof(label) - 1, msg, num, digest) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    memcpy(hash, digest, COSE_ECDH_PEER_HASH_LEN);
+    return COSE_OK;
+#else
+    (void)peer;
+    (void)hash;
+    return COSE_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+/* Digest of a shared secret, identifies it in the derivation cache */
+static int _hkdf_secret_hash(const uint8_t *secret, size_t len, uint8_t *hash)
+{
+#ifdef HAVE_ALGO_HMAC_SHA256
+    static const uint8_t label[] = "libcose HKDF secret";
+    uint8_t digest[32];
+    cose_crypto_chunk_t msg = { .buf = secret, .len = len };
+
+    if (cose_crypto_hmac(COSE_CRYPTO_HASH_SHA256, label, sizeof(label) - 1,
+                         &msg, 1, digest) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    memcpy(hash, digest, COSE_ECDH_PEER_HASH_LEN);
+    _wipe(digest, sizeof(digest));
+    return COSE_OK;
+#else
+    (void)secret;
+    (void)len;
+    (void)hash;
+    return COSE_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+/* Identify the key material of a derivation by content, not by address */
+static int _hkdf_key_hash(const cose_recp_kdf_t *kdf, const cose_key_t *key,
+                          size_t key_len, uint8_t *key_hash,
+                          uint8_t *peer_hash)
+{
+    if (_kdf_is_ecdh(kdf->algo)) {
+        int res = _ecdh_peer_hash(key, key_hash);
+        if (res == COSE_OK) {
+            res = _ecdh_peer_hash(kdf->peer, peer_hash);
+        }
+        return res;
+    }
+    memset(peer_hash, 0, COSE_ECDH_PEER_HASH_LEN);
+    return _hkdf_secret_hash(key->d, key_len, key_hash);
+}
+
+void cose_hkdf_cache_init(cose_hkdf_cache_t *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+static uint32_t _hkdf_cache_tick(cose_hkdf_cache_t *cache)
+{
+    /* 0 is reserved for empty entries */
+    if (++cache->clock == 0) {
+        cache->clock = 1;
+    }
+    return cache->clock;
+}
+
+static cose_hkdf_prk_t *_hkdf_cache_prk(cose_hkdf_cache_t *cache,
+                                        const cose_recp_kdf_t *kdf,
+                                        const uint8_t *key_hash,
+                                        const uint8_t *peer_hash)
+{
+    for (size_t i = 0; i < COSE_HKDF_CACHE_PRKS; i++) {
+        cose_hkdf_prk_t *entry = &cache->prk[i];
+        if (entry->used &&
+                memcmp(entry->key, key_hash, COSE_ECDH_PEER_HASH_LEN) == 0 &&
+                memcmp(entry->peer, peer_hash, COSE_ECDH_PEER_HASH_LEN) == 0 &&
+                entry->algo == kdf->algo &&
+                entry->salt_len == kdf->salt_len &&
+                (!kdf->salt_len ||
+                 memcmp(entry->salt, kdf->salt, kdf->salt_len) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static cose_hkdf_cek_t *_hkdf_cache_cek(cose_hkdf_cache_t *cache,
+                                        const cose_hkdf_prk_t *prk,
+                                        const uint8_t *context,
+                                        size_t context_len, size_t key_len)
+{
+    size_t idx = (size_t)(prk - cache->prk);
+    for (size_t i = 0; i < COSE_HKDF_CACHE_CEKS; i++) {
+        cose_hkdf_cek_t *entry = &cache->cek[i];
+        if (entry->used && entry->prk == idx && entry->prk_id == prk->id &&
+                entry->cek_len == key_len &&
+                entry->context_len == context_len &&
+                memcmp(entry->context, context, context_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static cose_hkdf_prk_t *_hkdf_cache_prk_lru(cose_hkdf_cache_t *cache)
+{
+    cose_hkdf_prk_t *lru = &cache->prk[0];
+    for (size_t i = 1; i < COSE_HKDF_CACHE_PRKS; i++) {
+        if (cache->prk[i].used < lru->used) {
+            lru = &cache->prk[i];
+        }
+    }
+    return lru;
+}
+
+static cose_hkdf_cek_t *_hkdf_cache_cek_lru(cose_hkdf_cache_t *cache)
+{
+    cose_hkdf_cek_t *lru = &cache->cek[0];
+    for (size_t i = 1; i < COSE_HKDF_CACHE_CEKS; i++) {
+        if (cache->cek[i].used < lru->used) {
+            lru = &cache->cek[i];
+        }
+    }
+    return lru;
+}
+
+int cose_recp_kdf_derive(const cose_recp_kdf_t *kdf, const cose_key_t *key,
+                         cose_algo_t algo, size_t key_len,
+                         const uint8_t *prot, size_t prot_len, uint8_t *cek,
+                         uint8_t *buf, size_t len)
+{
+    cose_hkdf_cache_t *cache = kdf->cache;
+    uint8_t key_hash[COSE_ECDH_PEER_HASH_LEN];
+    uint8_t peer_hash[COSE_ECDH_PEER_HASH_LEN];
+    uint8_t prk_buf[COSE_HKDF_PRK_MAX];
+    uint8_t secret[COSE_ECDH_SECRET_MAX];
+    const uint8_t *prk = prk_buf;
+    cose_hkdf_prk_t *prk_entry = NULL;
+    bool ecdh = _kdf_is_ecdh(kdf->algo);
+    int res = COSE_OK;
+
+    /* ECDH keys may live in a key store, the backend checks the private key */
+    if (!key_len || (ecdh ? !kdf->peer : !key->d)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    COSE_ssize_t context_len = cose_recp_kdf_context(kdf, algo, key_len, prot,
+                                                     prot_len, buf, len);
+    if (context_len < 0) {
+        return (int)context_len;
+    }
+
+    /* Key material that can not be identified is not cached */
+    if (cache && _hkdf_key_hash(kdf, key, key_len, key_hash,
+                                peer_hash) != COSE_OK) {
+        cache = NULL;
+    }
+    if (cache) {
+        prk_entry = _hkdf_cache_prk(cache, kdf, key_hash, peer_hash);
+        if (prk_entry) {
+            cose_hkdf_cek_t *hit = _hkdf_cache_cek(cache, prk_entry, buf,
+                                                   (size_t)context_len,
+                                                   key_len);
+            prk_entry->used = _hkdf_cache_tick(cache);
+            if (hit) {
+                hit->used = prk_entry->used;
+                memcpy(cek, hit->cek, key_len);
+                return COSE_OK;
+            }
+            prk = prk_entry->prk;
+        }
+    }
+
+    if (prk == prk_buf) {
+        const uint8_t *ikm = key->d;
+        size_t ikm_len = key_len;
+        if (ecdh) {
+            res = cose_ecdh_cache_secret(kdf->ecdh, key, kdf->peer, secret,
+                                         &ikm_len);
+            ikm = secret;
+        }
+        if (res == COSE_OK) {
+            res = cose_crypto_hkdf_extract(kdf->algo, kdf->salt,
+                                           kdf->salt_len, ikm, ikm_len,
+                                           prk_buf);
+        }
+        _wipe(secret, sizeof(secret));
+    }
+    if (res == COSE_OK) {
+        res = cose_crypto_hkdf_expand(kdf->algo, prk, buf, (size_t)context_len,
+                                      cek, key_len);
+    }
+
+    if (res == COSE_OK && cache) {
+        if (!prk_entry && kdf->salt_len <= COSE_HKDF_CACHE_SALT_MAX) {
+            prk_entry = _hkdf_cache_prk_lru(cache);
+            memcpy(prk_entry->key, key_hash, COSE_ECDH_PEER_HASH_LEN);
+            memcpy(prk_entry->peer, peer_hash, COSE_ECDH_PEER_HASH_LEN);
+            prk_entry->algo = kdf->algo;
+            prk_entry->salt_len = (uint8_t)kdf->salt_len;
+            if (kdf->salt_len) {
+                memcpy(prk_entry->salt, kdf->salt, kdf->salt_len);
+            }
+            memcpy(prk_entry->prk, prk_buf, sizeof(prk_buf));
+            prk_entry->used = prk_entry->id = _hkdf_cache_tick(cache);
+        }
+        if (prk_entry && key_len <= COSE_HKDF_CEK_MAX &&
+                (size_t)context_len <= COSE_HKDF_CACHE_CONTEXT_MAX) {
+            cose_hkdf_cek_t *entry = _hkdf_cache_cek_lru(cache);
+            entry->prk = (uint8_t)(prk_entry - cache->prk);
+            entry->prk_id = prk_entry->id;
+            entry->cek_len = (uint8_t)key_len;
+            entry->context_len = (uint16_t)context_len;
+            memcpy(entry->cek, cek, key_len);
+            memcpy(entry->context, buf, (size_t)context_len);
+            entry->used = _hkdf_cache_tick(cache);
+        }
+    }
+    _wipe(prk_buf, sizeof(prk_buf));
+    return res;
+}
+
+void cose_ecdh_cache_init(cose_ecdh_cache_t *cache, uint32_t ttl,
+                          cose_clock_fn_t now, void *arg,
+                          const cose_lock_t *lock)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->ttl = ttl;
+    cache->now = now;
+    cache->now_arg = arg;
+    cache->lock = lock;
+}
+
+static void _ecdh_cache_lock(cose_ecdh_cache_t *cache)
+{
+    if (cache->lock) {
+        cache->lock->lock(cache->lock->ctx);
+    }
+}
+
+static void _ecdh_cache_unlock(cose_ecdh_cache_t *cache)
+{
+    if (cache->lock) {
+        cache->lock->unlock(cache->lock->ctx);
+    }
+}
+
+void cose_ecdh_cache_flush(cose_ecdh_cache_t *cache)
+{
+    _ecdh_cache_lock(cache);
+    _wipe(cache->entries, sizeof(cache->entries));
+    cache->clock = 0;
+    _ecdh_cache_unlock(cache);
+}
+
+static bool _ecdh_expired(const cose_ecdh_cache_t *cache,
+                          const cose_ecdh_entry_t *entry, uint32_t now)
+{
+    return cache->now && (int32_t)(now - entry->expires) >= 0;
+}
+
+static cose_ecdh_entry_t *_ecdh_cache_find(cose_ecdh_cache_t *cache,
+                                           const cose_key_t *key,
+                                           const uint8_t *hash, uint32_t now)
+{
+    for (size_t i = 0; i < COSE_ECDH_CACHE_ENTRIES; i++) {
+        cose_ecdh_entry_t *entry = &cache->entries[i];
+        if (!entry->used) {
+            continue;
+        }
+        if (_ecdh_expired(cache, entry, now)) {
+            _wipe(entry, sizeof(*entry));
+            continue;
+        }
+        if (entry->kid_len == key->kid_len &&
+                memcmp(entry->kid, key->kid, key->kid_len) == 0 &&
+                memcmp(entry->peer, hash, COSE_ECDH_PEER_HASH_LEN) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t _ecdh_cache_tick(cose_ecdh_cache_t *cache)
+{
+    /* 0 is reserved for empty entries */
+    if (++cache->clock == 0) {
+        cache->clock = 1;
+    }
+    return cache->clock;
+}
+
+static void _ecdh_cache_insert(cose_ecdh_cache_t *cache,
+                               const cose_key_t *key, const uint8_t *hash,
+                               const uint8_t *secret, size_t secret_len,
+                               uint32_t now)
+{
+    cose_ecdh_entry_t *entry = _ecdh_cache_find(cache, key, hash, now);
+
+    /* Another thread may have inserted the secret in the meantime */
+    if (!entry) {
+        entry = &cache->entries[0];
+        for (size_t i = 1; i < COSE_ECDH_CACHE_ENTRIES; i++) {
+            if (cache->entries[i].used < entry->used) {
+                entry = &cache->entries[i];
+            }
+        }
+        _wipe(entry, sizeof(*entry));
+        entry->kid_len = (uint8_t)key->kid_len;
+        memcpy(entry->kid, key->kid, key->kid_len);
+        memcpy(entry->peer, hash, COSE_ECDH_PEER_HASH_LEN);
+        memcpy(entry->secret, secret, secret_len);
+        entry->secret_len = (uint8_t)secret_len;
+        entry->expires = now + cache->ttl;
+    }
+    entry->used = _ecdh_cache_tick(cache);
+}
+
+int cose_ecdh_cache_secret(cose_ecdh_cache_t *cache, const cose_key_t *key,
+                           const cose_key_t *peer, uint8_t *secret,
+                           size_t *secret_len)
+{
+    uint8_t hash[COSE_ECDH_PEER_HASH_LEN];
+    uint32_t now = 0;
+
+    if (!cache || !key->kid_len || key->kid_len > COSE_ECDH_CACHE_KID_MAX ||
+            _ecdh_peer_hash(peer, hash) != COSE_OK) {
+        return cose_crypto_ecdh(key, peer, secret, secret_len);
+    }
+    if (cache->now) {
+        now = cache->now(cache->now_arg);
+    }
+
+    _ecdh_cache_lock(cache);
+    cose_ecdh_entry_t *entry = _ecdh_cache_find(cache, key, hash, now);
+    if (entry) {
+        entry->used = _ecdh_cache_tick(cache);
+        memcpy(secret, entry->secret, entry->secret_len);
+        *secret_len = entry->secret_len;
+    }
+    _ecdh_cache_unlock(cache);
+    if (entry) {
+        return COSE_OK;
+    }
+
+    /* Scalar multiplication without holding the lock */
+    int res = cose_crypto_ecdh(key, peer, secret, secret_len);
+    if (res == COSE_OK && *secret_len <= COSE_ECDH_SECRET_MAX) {
+        _ecdh_cache_lock(cache);
+        _ecdh_cache_insert(cache, key, hash, secret, *secret_len, now);
+        _ecdh_cache_unlock(cache);
+    }
+    return res;
+}
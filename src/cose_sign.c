@@ -16,6 +16,7 @@
 #include "cose/key.h"
 #include "cose/sign.h"
 #include "cose/signature.h"
+#include "cose/trace.h"
 #include <nanocbor/nanocbor.h>
 #include <stdint.h>
 #include <string.h>
@@ -140,21 +141,47 @@ static int _add_signatures(cose_sign_enc_t *sign, nanocbor_encoder_t *arr)
 
 static int _sign_generate_signature(cose_sign_enc_t *sign, cose_signature_t *sig, uint8_t *buf, size_t len)
 {
-    uint8_t *buf_cbor = buf + cose_crypto_sig_size(sig->signer);
-    size_t cbor_space = len - cose_crypto_sig_size(sig->signer);
-
     if (!sig->signer) {
         return COSE_ERR_NOINIT;
     }
+
+    size_t sig_size = cose_crypto_sig_size(sig->signer);
+    if (sig_size > len) {
+        return COSE_ERR_NOMEM;
+    }
+    uint8_t *buf_cbor = buf + sig_size;
+
     /* Build the data at an offset of the signature size */
-    size_t sig_struct_len = _enc_sign_sig(sign, sig,
-                                           buf_cbor, cbor_space);
+    COSE_ssize_t sig_struct_len = cose_sign_encode_tbs(sign, sig, buf_cbor,
+                                                       len - sig_size);
+    if (sig_struct_len < 0) {
+        return (int)sig_struct_len;
+    }
     int res = cose_crypto_sign(sig->signer, buf, &(sig->signature_len), buf_cbor, sig_struct_len);
     /* Store pointer to the signature */
     sig->signature = buf;
     return res;
 }
 
+static int _sign_prepare(cose_sign_enc_t *sign)
+{
+    sign->flags |= COSE_FLAGS_ENCODE;
+
+    if (!sign->signatures || !cose_hdr_encodable(&sign->hdrs)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    for (cose_signature_t *sig = sign->signatures; sig; sig = sig->next) {
+        if (!cose_hdr_encodable(&sig->hdrs)) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+    }
+    /* Determine if this requires sign or sign1 */
+    if (!sign->signatures->next) {
+        sign->flags |= COSE_FLAGS_SIGN1;
+    }
+    return COSE_OK;
+}
+
 static int _enc_cbor_unprotected(cose_sign_enc_t *sign, nanocbor_encoder_t *enc)
 {
     size_t len = cose_hdr_size(sign->hdrs.unprot);
@@ -198,25 +225,42 @@ void cose_sign_add_signer(cose_sign_enc_t *sign, cose_signature_t *signer, const
     signer->signer = key;
 }
 
-COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, uint8_t **out)
+COSE_ssize_t cose_sign_encode_tbs(cose_sign_enc_t *sign, cose_signature_t *sig,
+                                  uint8_t *buf, size_t len)
 {
-    /* The buffer here is used to contain dummy data a number of times */
-    nanocbor_encoder_t enc;
-
-    sign->flags |= COSE_FLAGS_ENCODE;
+    int res = _sign_prepare(sign);
+    if (res != COSE_OK) {
+        return res;
+    }
+    if (!sig->signer) {
+        return COSE_ERR_NOINIT;
+    }
 
-    if (!sign->signatures) {
-        return COSE_ERR_INVALID_PARAM;
+    size_t tbs_len = _enc_sign_sig(sign, sig, buf, len);
+    if (tbs_len > len) {
+        return COSE_ERR_NOMEM;
     }
-    /* Determine if this requires sign or sign1 */
-    if (!sign->signatures->next) {
-        sign->flags |= COSE_FLAGS_SIGN1;
+    return tbs_len;
+}
+
+/* Algorithm of the first signer, for tracing */
+static inline cose_algo_t _sign_trace_algo(const cose_sign_enc_t *sign)
+{
+    return sign->signatures ? sign->signatures->signer->algo : COSE_ALGO_NONE;
+}
+
+static COSE_ssize_t _sign_encode(cose_sign_enc_t *sign, uint8_t *buf,
+                                 size_t len, uint8_t **out)
+{
+    int res = _sign_prepare(sign);
+    if (res != COSE_OK) {
+        return res;
     }
 
     /* First generate all required signatures */
     for (cose_signature_t *sig = sign->signatures; sig; sig = sig->next) {
         /* Start generating the signature */
-        int res = _sign_generate_signature(sign, sig, buf, len);
+        res = _sign_generate_signature(sign, sig, buf, len);
         if (res != COSE_OK) {
             return res;
         }
@@ -224,6 +268,33 @@ COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, u
         len -= sig->signature_len;
     }
 
+    return cose_sign_encode_signed(sign, buf, len, out);
+}
+
+COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, uint8_t **out)
+{
+    COSE_TRACE_ENTRY(sign_encode, _sign_trace_algo(sign), sign->payload_len);
+    COSE_ssize_t res = _sign_encode(sign, buf, len, out);
+    COSE_TRACE_RETURN(sign_encode, _sign_trace_algo(sign), sign->payload_len,
+                      res);
+    return res;
+}
+
+COSE_ssize_t cose_sign_encode_signed(cose_sign_enc_t *sign, uint8_t *buf,
+                                     size_t len, uint8_t **out)
+{
+    nanocbor_encoder_t enc;
+
+    int res = _sign_prepare(sign);
+    if (res != COSE_OK) {
+        return res;
+    }
+    for (cose_signature_t *sig = sign->signatures; sig; sig = sig->next) {
+        if (!sig->signature || !sig->signature_len) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+    }
+
     nanocbor_encoder_init(&enc, buf, len);
     /* Build tag */
     if (!(cose_flag_isset(sign->flags, COSE_FLAGS_UNTAGGED))) {
@@ -247,7 +318,7 @@ COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, u
         nanocbor_put_bstr(&enc, sign->payload, sign->payload_len);
     }
 
-    /* Now use the signatures to add to the signature array, still nonsense in the protected headers */
+    /* Now use the signatures to add to the signature array */
     if (_is_sign1(sign)) {
         nanocbor_put_bstr(&enc, sign->signatures->signature, sign->signatures->signature_len);
     }
@@ -258,11 +329,11 @@ COSE_ssize_t cose_sign_encode(cose_sign_enc_t *sign, uint8_t *buf, size_t len, u
     }
 
     *out = buf;
-    size_t res = nanocbor_encoded_len(&enc);
-    if (res > len) {
+    size_t enc_len = nanocbor_encoded_len(&enc);
+    if (enc_len > len) {
         return COSE_ERR_NOMEM;
     }
-    return res;
+    return enc_len;
 }
 
 /**********************
@@ -397,6 +468,72 @@ int cose_sign_decode(cose_sign_dec_t *sign, const uint8_t *buf, size_t len)
     return COSE_OK;
 }
 
+/* Validate a COSE_Sign or COSE_Sign1 structure in a single pass */
+static int _sign_validate(cose_cbor_validator_t *v, const uint8_t *buf,
+                          size_t len)
+{
+    nanocbor_value_t p;
+    nanocbor_value_t arr;
+
+    nanocbor_decoder_init(&p, buf, len);
+    int res = cose_cbor_validate_tag(v, &p);
+    if (res < 0) {
+        return res;
+    }
+    res = cose_cbor_validate_array(v, &p, &arr, 4, 4, 0);
+    if (res < 0) {
+        return res;
+    }
+    res = cose_cbor_validate_headers(v, &arr, 1);
+    if (res < 0) {
+        return res;
+    }
+    res = cose_cbor_validate_bstr(v, &arr, true);
+    if (res < 0) {
+        return res;
+    }
+    if (nanocbor_get_type(&arr) == NANOCBOR_TYPE_ARR) {
+        nanocbor_value_t sigs;
+        res = cose_cbor_validate_array(v, &arr, &sigs, 1, UINT32_MAX, 1);
+        while (res == COSE_OK && !nanocbor_at_end(&sigs)) {
+            nanocbor_value_t sig;
+            res = cose_cbor_validate_array(v, &sigs, &sig, 3, 3, 2);
+            if (res == COSE_OK) {
+                res = cose_cbor_validate_headers(v, &sig, 3);
+            }
+            if (res == COSE_OK) {
+                res = cose_cbor_validate_bstr(v, &sig, false);
+                nanocbor_leave_container(&sigs, &sig);
+            }
+        }
+        if (res < 0) {
+            return res;
+        }
+        nanocbor_leave_container(&arr, &sigs);
+    }
+    else {
+        res = cose_cbor_validate_bstr(v, &arr, false);
+        if (res < 0) {
+            return res;
+        }
+    }
+    nanocbor_leave_container(&p, &arr);
+    return nanocbor_at_end(&p) ? COSE_OK : COSE_ERR_INVALID_CBOR;
+}
+
+int cose_sign_decode_validate(cose_sign_dec_t *sign, const uint8_t *buf,
+                              size_t len, const cose_decode_limits_t *limits)
+{
+    cose_cbor_validator_t v;
+
+    cose_cbor_validator_init(&v, limits);
+    int res = _sign_validate(&v, buf, len);
+    if (res < 0) {
+        return res;
+    }
+    return cose_sign_decode(sign, buf, len);
+}
+
 void cose_sign_decode_payload(const cose_sign_dec_t *sign, const uint8_t **payload,
                               size_t *len)
 {
@@ -407,7 +544,11 @@ void cose_sign_decode_payload(const cose_sign_dec_t *sign, const uint8_t **paylo
 bool cose_sign_signature_iter(const cose_sign_dec_t *sign,
                               cose_signature_dec_t *signature)
 {
-    if(_is_sign1_dec(sign) && !signature->buf) {
+    if (_is_sign1_dec(sign)) {
+        /* The single signature is the Sign1 structure itself */
+        if (signature->buf) {
+            return false;
+        }
         cose_signature_decode_init(signature, sign->buf, sign->len);
         return true;
     }
@@ -484,25 +625,60 @@ void cose_sign_decode_set_external_aad(cose_sign_dec_t *sign,
     sign->ext_aad_len = len;
 }
 
-/* Try to verify the structure with a signer and a signature */
-int cose_sign_verify(const cose_sign_dec_t *sign, cose_signature_dec_t *signature, cose_key_t *key, uint8_t *buf, size_t len)
+COSE_ssize_t cose_sign_verify_tbs(const cose_sign_dec_t *sign,
+                                  cose_signature_dec_t *signature,
+                                  uint8_t *buf, size_t len)
+{
+    size_t tbs_len = _dec_sign_sig(sign, signature, buf, len);
+    if (tbs_len > len) {
+        return COSE_ERR_NOMEM;
+    }
+    return tbs_len;
+}
+
+int cose_sign_decode_signature(const cose_sign_dec_t *sign,
+                               const cose_signature_dec_t *signature,
+                               const uint8_t **sig, size_t *len)
+{
+    if (_is_sign1_dec(sign)) {
+        return _sign1_decode_sig(sign, sig, len);
+    }
+    if (cose_signature_decode_signature(signature, sig, len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    return COSE_OK;
+}
+
+static int _sign_verify(const cose_sign_dec_t *sign,
+                        cose_signature_dec_t *signature,
+                        const cose_key_t *key, uint8_t *buf, size_t len)
 {
     const uint8_t *signature_buf = NULL;
     size_t signature_len = 0;
-    int res = COSE_OK;
 
-    size_t sig_len = _dec_sign_sig(sign, signature, buf, len);
-
-    if (_is_sign1_dec(sign)) {
-        _sign1_decode_sig(sign, &signature_buf, &signature_len);
+    COSE_ssize_t tbs_len = cose_sign_verify_tbs(sign, signature, buf, len);
+    if (tbs_len < 0) {
+        return (int)tbs_len;
     }
-    else {
-         cose_signature_decode_signature(signature, &signature_buf, &signature_len);
+
+    int res = cose_sign_decode_signature(sign, signature, &signature_buf,
+                                         &signature_len);
+    if (res != COSE_OK) {
+        return res;
     }
 
-    if (cose_crypto_verify(key, signature_buf, signature_len, buf, sig_len) < 0) {
-        res = COSE_ERR_CRYPTO;
+    if (cose_crypto_verify(key, signature_buf, signature_len, buf, tbs_len) < 0) {
+        return COSE_ERR_CRYPTO;
     }
+    return COSE_OK;
+}
+
+/* Try to verify the structure with a signer and a signature */
+int cose_sign_verify(const cose_sign_dec_t *sign, cose_signature_dec_t *signature, cose_key_t *key, uint8_t *buf, size_t len)
+{
+    COSE_TRACE_ENTRY(sign_verify, key->algo, sign->payload_len);
+    int res = _sign_verify(sign, signature, key, buf, len);
+    COSE_TRACE_RETURN(sign_verify, key->algo, sign->payload_len, res);
     return res;
 }
 
@@ -517,3 +693,638 @@ int cose_sign_verify_first(const cose_sign_dec_t* sign, cose_key_t *key,
     return cose_sign_verify(sign, &signature, key, buf, len);
 }
 
+
+/* Bytes in front of the message array when rewriting @p sign into @p buf.
+ * In place the original tag bytes are kept, else the tag is written again */
+static size_t _sign_head_len(const cose_sign_dec_t *sign, const uint8_t *buf,
+                             size_t len)
+{
+    if (sign->buf >= buf && sign->buf < buf + len) {
+        return (size_t)(sign->buf - buf);
+    }
+    if (cose_flag_isset(sign->flags, COSE_FLAGS_UNTAGGED)) {
+        return 0;
+    }
+    return COSE_CBOR_HEAD_SIZE(_is_sign1_dec(sign) ? COSE_SIGN1 : COSE_SIGN);
+}
+
+static void _sign_put_head(const cose_sign_dec_t *sign, uint8_t *buf,
+                           size_t head_len)
+{
+    if (buf + head_len != sign->buf && head_len) {
+        nanocbor_encoder_t enc;
+        nanocbor_encoder_init(&enc, buf, head_len);
+        nanocbor_fmt_tag(&enc, _is_sign1_dec(sign) ? COSE_SIGN1 : COSE_SIGN);
+    }
+}
+
+/* Encode a new COSE_Signature or COSE_Countersignature, the signature is
+ * moved in from @p sig */
+static size_t _sign_put_entry(cose_signature_t *signer, size_t prot_len,
+                              const uint8_t *sig, uint8_t *buf, size_t len)
+{
+    nanocbor_encoder_t enc;
+
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_array(&enc, 3);
+    nanocbor_put_bstr(&enc, enc.cur, prot_len);
+    cose_signature_serialize_protected(signer, true, enc.cur - prot_len,
+                                       prot_len);
+    cose_signature_unprot_cbor(signer, &enc);
+    nanocbor_fmt_bstr(&enc, signer->signature_len);
+    signer->signature = enc.cur;
+    memmove(enc.cur, sig, signer->signature_len);
+    return nanocbor_encoded_len(&enc) + signer->signature_len;
+}
+
+/* Sig_structure for a new signer of an already encoded COSE_Sign */
+static size_t _sign_sig_cbor_append(const cose_sign_dec_t *sign,
+                                    const cose_signature_t *sig,
+                                    uint8_t *buf, size_t buflen)
+{
+    nanocbor_encoder_t enc;
+    const uint8_t *prot = NULL;
+    size_t prot_len = 0;
+
+    nanocbor_encoder_init(&enc, buf, buflen);
+    _sign_sig_cbor_start(&enc, false);
+
+    _sign_decode_get_prot(sign, &prot, &prot_len);
+    nanocbor_put_bstr(&enc, prot, prot_len);
+
+    size_t slen = cose_signature_serialize_protected(sig, true, NULL, 0);
+    nanocbor_put_bstr(&enc, enc.cur, slen);
+    cose_signature_serialize_protected(sig, true, enc.cur - slen, slen);
+
+    nanocbor_put_bstr(&enc, sign->ext_aad, sign->ext_aad_len);
+    nanocbor_put_bstr(&enc, sign->payload, sign->payload_len);
+    return nanocbor_encoded_len(&enc);
+}
+
+COSE_ssize_t cose_sign_append_signer(const cose_sign_dec_t *sign,
+                                     cose_signature_t *signer,
+                                     const cose_key_t *key,
+                                     uint8_t *buf, size_t len, uint8_t **out)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_value_t it;
+    nanocbor_value_t sigs;
+    const uint8_t *sigs_buf = NULL;
+    size_t sigs_len = 0;
+
+    if (_is_sign1_dec(sign)) {
+        /* The Signature1 context of the existing signature does not
+         * survive conversion to a COSE_Sign */
+        return COSE_ERR_INVALID_PARAM;
+    }
+    if (_sign_decode_get_sigs(sign, &sigs_buf, &sigs_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    nanocbor_decoder_init(&it, sigs_buf, sigs_len);
+    if (nanocbor_enter_array(&it, &sigs) < 0 ||
+            nanocbor_container_indefinite(&sigs)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    signer->signer = key;
+
+    /* Existing bytes, the headers and payload in front of the signatures
+     * array and the signatures following its header */
+    const uint8_t *body = sign->buf;
+    size_t body_len = (size_t)(sigs_buf - body);
+    const uint8_t *tail = sigs.cur;
+    size_t tail_len = sigs_len - (size_t)(sigs.cur - sigs_buf);
+    size_t num = nanocbor_container_remaining(&sigs) + 1;
+
+    size_t sig_size = cose_crypto_sig_size(key);
+    size_t prot_len = cose_signature_serialize_protected(signer, true, NULL, 0);
+    nanocbor_encoder_init(&enc, NULL, 0);
+    cose_signature_unprot_cbor(signer, &enc);
+    size_t unprot_len = nanocbor_encoded_len(&enc);
+
+    size_t head_len = _sign_head_len(sign, buf, len);
+    size_t tail_pos = head_len + body_len + COSE_CBOR_HEAD_SIZE(num);
+    size_t entry_pos = tail_pos + tail_len;
+    size_t out_max = entry_pos +
+        COSE_SIGNATURE_SIZE(prot_len, unprot_len, sig_size);
+
+    /* The signature and Sig_structure are built behind the output */
+    uint8_t *sig_buf = buf + out_max;
+    uint8_t *tbs = sig_buf + sig_size;
+    if (out_max + sig_size > len) {
+        return COSE_ERR_NOMEM;
+    }
+    size_t tbs_len = _sign_sig_cbor_append(sign, signer, tbs,
+                                           len - out_max - sig_size);
+    if (tbs_len > len - out_max - sig_size) {
+        return COSE_ERR_NOMEM;
+    }
+    int res = cose_crypto_sign(key, sig_buf, &signer->signature_len, tbs,
+                               tbs_len);
+    if (res < 0) {
+        return res;
+    }
+
+    /* Either in place, only moving the existing signatures when the array
+     * header grows, or into a separate buffer */
+    memmove(buf + tail_pos, tail, tail_len);
+    if (buf + head_len != body) {
+        memmove(buf + head_len, body, body_len);
+    }
+    _sign_put_head(sign, buf, head_len);
+    nanocbor_encoder_init(&enc, buf + head_len + body_len,
+                          tail_pos - head_len - body_len);
+    nanocbor_fmt_array(&enc, num);
+
+    /* New COSE_Signature at the end of the array */
+    *out = buf;
+    return entry_pos + _sign_put_entry(signer, prot_len, sig_buf,
+                                       buf + entry_pos, out_max - entry_pos);
+}
+
+/* Countersign_structure, RFC 9338. The signature of a COSE_Sign1 is the
+ * only further byte string field of the target structure, which requires
+ * the CounterSignatureV2 context */
+static size_t _sign_countersign_cbor(const cose_sign_dec_t *sign,
+                                     const uint8_t *cs_prot,
+                                     size_t cs_prot_len,
+                                     uint8_t *buf, size_t buflen)
+{
+    nanocbor_encoder_t enc;
+    const uint8_t *prot = NULL;
+    size_t prot_len = 0;
+    bool sign1 = _is_sign1_dec(sign);
+
+    nanocbor_encoder_init(&enc, buf, buflen);
+    nanocbor_fmt_array(&enc, sign1 ? 6 : 5);
+    nanocbor_put_tstr(&enc, sign1 ? SIG_TYPE_COUNTERSIGNATURE_V2
+                                  : SIG_TYPE_COUNTERSIGNATURE);
+
+    _sign_decode_get_prot(sign, &prot, &prot_len);
+    nanocbor_put_bstr(&enc, prot, prot_len);
+    nanocbor_put_bstr(&enc, cs_prot, cs_prot_len);
+    nanocbor_put_bstr(&enc, sign->ext_aad, sign->ext_aad_len);
+    nanocbor_put_bstr(&enc, sign->payload, sign->payload_len);
+
+    if (sign1) {
+        const uint8_t *sig = NULL;
+        size_t sig_len = 0;
+        _sign1_decode_sig(sign, &sig, &sig_len);
+        nanocbor_fmt_array(&enc, 1);
+        nanocbor_put_bstr(&enc, sig, sig_len);
+    }
+    return nanocbor_encoded_len(&enc);
+}
+
+COSE_ssize_t cose_sign_countersign(const cose_sign_dec_t *sign,
+                                   cose_signature_t *signer,
+                                   const cose_key_t *key,
+                                   uint8_t *buf, size_t len, uint8_t **out)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_value_t it;
+    nanocbor_value_t map;
+    const uint8_t *unprot = NULL;
+    size_t unprot_len = 0;
+    cose_hdr_t hdr;
+    uint8_t ins[COSE_CBOR_HEAD_SIZE(UINT32_MAX)];
+    size_t ins_len = 0;
+
+    if (cose_cbor_decode_get_unprot(sign->buf, sign->len, &unprot,
+                                    &unprot_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    nanocbor_decoder_init(&it, unprot, unprot_len);
+    if (nanocbor_enter_map(&it, &map) < 0 ||
+            nanocbor_container_indefinite(&map)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    size_t entries = nanocbor_container_remaining(&map) / 2;
+    const uint8_t *unprot_end = unprot + unprot_len;
+
+    /* The message is split in the part up to the insertion point, the
+     * existing countersignatures and everything following them */
+    const uint8_t *ins_at = unprot_end;
+    const uint8_t *cs_start = unprot_end;
+    const uint8_t *cs_end = unprot_end;
+    nanocbor_encoder_init(&enc, ins, sizeof(ins));
+    if (cose_hdr_decode_from_cbor(unprot, unprot_len, &hdr,
+                                  COSE_HDR_COUNTERSIG_V2)) {
+        nanocbor_value_t val;
+        nanocbor_value_t arr;
+        nanocbor_decoder_init(&val, hdr.v.cbor, hdr.len);
+        if (hdr.type != COSE_HDR_TYPE_CBOR ||
+                nanocbor_enter_array(&val, &arr) < 0 ||
+                nanocbor_container_indefinite(&arr)) {
+            return COSE_ERR_INVALID_CBOR;
+        }
+        ins_at = hdr.v.cbor;
+        cs_end = hdr.v.cbor + hdr.len;
+        if (nanocbor_get_type(&arr) == NANOCBOR_TYPE_BSTR) {
+            /* Single countersignature becomes an array of two */
+            cs_start = hdr.v.cbor;
+            nanocbor_fmt_array(&enc, 2);
+        }
+        else if (nanocbor_get_type(&arr) == NANOCBOR_TYPE_ARR) {
+            cs_start = arr.cur;
+            nanocbor_fmt_array(&enc, nanocbor_container_remaining(&arr) + 1);
+        }
+        else {
+            return COSE_ERR_INVALID_CBOR;
+        }
+    }
+    else {
+        nanocbor_fmt_uint(&enc, COSE_HDR_COUNTERSIG_V2);
+        entries++;
+    }
+    ins_len = nanocbor_encoded_len(&enc);
+    signer->signer = key;
+
+    size_t sig_size = cose_crypto_sig_size(key);
+    size_t prot_len = cose_signature_serialize_protected(signer, true, NULL, 0);
+    nanocbor_encoder_init(&enc, NULL, 0);
+    cose_signature_unprot_cbor(signer, &enc);
+    size_t entry_max = COSE_SIGNATURE_SIZE(prot_len,
+                                           nanocbor_encoded_len(&enc),
+                                           sig_size);
+
+    /* Output positions of the copied parts */
+    size_t head_len = _sign_head_len(sign, buf, len);
+    size_t body_len = (size_t)(unprot - sign->buf);
+    size_t map_pos = head_len + body_len;
+    size_t pre_pos = map_pos + COSE_CBOR_HEAD_SIZE(entries);
+    const uint8_t *pre = map.cur;
+    size_t pre_len = (size_t)(ins_at - pre);
+    size_t cs_pos = pre_pos + pre_len + ins_len;
+    size_t entry_pos = cs_pos + (size_t)(cs_end - cs_start);
+    size_t rest_len = sign->len - (size_t)(cs_end - sign->buf);
+    size_t out_max = entry_pos + entry_max + rest_len;
+
+    /* Signature, countersigner protected headers and Countersign_structure
+     * are built behind the output */
+    uint8_t *sig_buf = buf + out_max;
+    uint8_t *cs_prot = sig_buf + sig_size;
+    uint8_t *tbs = cs_prot + prot_len;
+    if (out_max + sig_size + prot_len > len) {
+        return COSE_ERR_NOMEM;
+    }
+    cose_signature_serialize_protected(signer, true, cs_prot, prot_len);
+    size_t tbs_max = len - out_max - sig_size - prot_len;
+    size_t tbs_len = _sign_countersign_cbor(sign, cs_prot, prot_len, tbs,
+                                            tbs_max);
+    if (tbs_len > tbs_max) {
+        return COSE_ERR_NOMEM;
+    }
+    int res = cose_crypto_sign(key, sig_buf, &signer->signature_len, tbs,
+                               tbs_len);
+    if (res < 0) {
+        return res;
+    }
+
+    /* Parts only move towards the end, moving the last part first makes
+     * this work in place */
+    size_t entry_len = entry_max - COSE_CBOR_BSTR_SIZE(sig_size) +
+        COSE_CBOR_BSTR_SIZE(signer->signature_len);
+    memmove(buf + entry_pos + entry_len, cs_end, rest_len);
+    memmove(buf + cs_pos, cs_start, (size_t)(cs_end - cs_start));
+    memmove(buf + pre_pos, pre, pre_len);
+    memmove(buf + head_len, sign->buf, body_len);
+    _sign_put_head(sign, buf, head_len);
+
+    nanocbor_encoder_init(&enc, buf + map_pos, pre_pos - map_pos);
+    nanocbor_fmt_map(&enc, entries);
+    memcpy(buf + pre_pos + pre_len, ins, ins_len);
+    _sign_put_entry(signer, prot_len, sig_buf, buf + entry_pos, entry_len);
+
+    *out = buf;
+    return entry_pos + entry_len + rest_len;
+}
+
+bool cose_sign_countersignature_iter(const cose_sign_dec_t *sign,
+                                     cose_signature_dec_t *signature)
+{
+    cose_hdr_t hdr;
+    nanocbor_value_t val;
+    nanocbor_value_t arr;
+
+    if (cose_sign_decode_unprotected(sign, &hdr,
+                                     COSE_HDR_COUNTERSIG_V2) < 0 ||
+            hdr.type != COSE_HDR_TYPE_CBOR) {
+        return false;
+    }
+    nanocbor_decoder_init(&val, hdr.v.cbor, hdr.len);
+    if (nanocbor_enter_array(&val, &arr) < 0) {
+        return false;
+    }
+    if (nanocbor_get_type(&arr) == NANOCBOR_TYPE_BSTR) {
+        /* Single countersignature */
+        if (signature->buf) {
+            return false;
+        }
+        cose_signature_decode_init(signature, hdr.v.cbor, hdr.len);
+        return true;
+    }
+    while ((signature->buf >= arr.cur) && !nanocbor_at_end(&arr)) {
+        nanocbor_skip(&arr);
+    }
+    if (!nanocbor_at_end(&arr)) {
+        const uint8_t *cs_buf = NULL;
+        size_t cs_len = 0;
+        if (nanocbor_get_subcbor(&arr, &cs_buf, &cs_len) < 0) {
+            return false;
+        }
+        cose_signature_decode_init(signature, cs_buf, cs_len);
+        return true;
+    }
+    return false;
+}
+
+COSE_ssize_t cose_sign_countersign_tbs(const cose_sign_dec_t *sign,
+                                       const cose_signature_dec_t *signature,
+                                       uint8_t *buf, size_t len)
+{
+    const uint8_t *cs_prot = NULL;
+    size_t cs_prot_len = 0;
+
+    if (!cose_signature_decode_protected_buf(signature, &cs_prot,
+                                             &cs_prot_len)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    size_t tbs_len = _sign_countersign_cbor(sign, cs_prot, cs_prot_len,
+                                            buf, len);
+    if (tbs_len > len) {
+        return COSE_ERR_NOMEM;
+    }
+    return tbs_len;
+}
+
+int cose_sign_verify_countersignature(const cose_sign_dec_t *sign,
+                                      const cose_signature_dec_t *signature,
+                                      const cose_key_t *key,
+                                      uint8_t *buf, size_t len)
+{
+    const uint8_t *signature_buf = NULL;
+    size_t signature_len = 0;
+
+    COSE_ssize_t tbs_len = cose_sign_countersign_tbs(sign, signature, buf,
+                                                     len);
+    if (tbs_len < 0) {
+        return (int)tbs_len;
+    }
+    if (cose_signature_decode_signature(signature, &signature_buf,
+                                        &signature_len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (cose_crypto_verify(key, signature_buf, signature_len, buf,
+                           tbs_len) < 0) {
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+
+static void _sign_verify_job(void *arg)
+{
+    cose_sign_verify_job_t *job = arg;
+
+    if (job->counter) {
+        job->res = cose_sign_verify_countersignature(job->sign,
+                                                     &job->signature,
+                                                     job->key, job->buf,
+                                                     job->len);
+    }
+    else {
+        job->res = _sign_verify(job->sign, &job->signature, job->key,
+                                job->buf, job->len);
+    }
+}
+
+int cose_sign_verify_concurrent(const cose_sign_dec_t *sign,
+                                const cose_key_t *key,
+                                const cose_key_t *const *cs_keys,
+                                size_t num_cs, cose_sign_verify_job_t *jobs,
+                                const cose_executor_t *exec,
+                                uint8_t *buf, size_t len)
+{
+    size_t num = num_cs + 1;
+    size_t slice = len / num;
+
+    /* Collect all jobs before starting any */
+    cose_signature_decode_init(&jobs[0].signature, NULL, 0);
+    if (!cose_sign_signature_iter(sign, &jobs[0].signature)) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    jobs[0].key = key;
+    jobs[0].counter = false;
+
+    cose_signature_dec_t cs;
+    cose_sign_countersignature_iter_init(&cs);
+    for (size_t i = 1; i < num; i++) {
+        if (!cose_sign_countersignature_iter(sign, &cs)) {
+            return COSE_ERR_NOT_FOUND;
+        }
+        jobs[i].signature = cs;
+        jobs[i].key = cs_keys[i - 1];
+        jobs[i].counter = true;
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        jobs[i].sign = sign;
+        jobs[i].buf = buf + i * slice;
+        jobs[i].len = slice;
+        jobs[i].res = COSE_ERR_NOINIT;
+        if (!exec || exec->submit(exec->ctx, _sign_verify_job, &jobs[i]) < 0) {
+            _sign_verify_job(&jobs[i]);
+        }
+    }
+    if (exec) {
+        exec->wait(exec->ctx);
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        if (jobs[i].res != COSE_OK) {
+            return jobs[i].res;
+        }
+    }
+    return COSE_OK;
+}
+
+/**************************
+ * verification scheduler *
+ **************************/
+typedef struct {
+    cose_sign_sched_req_t *first;   /* First request of the job */
+    size_t num;                     /* Number of requests in the job */
+} _sched_job_t;
+
+void cose_sign_sched_cfg_init(cose_sign_sched_cfg_t *cfg)
+{
+    cfg->deadline = COSE_SIGN_SCHED_DEADLINE;
+    cfg->batch = COSE_SIGN_SCHED_BATCH;
+    cfg->linger = false;
+}
+
+void cose_sign_sched_init(cose_sign_sched_t *sched,
+                          const cose_sign_sched_cfg_t *cfg,
+                          cose_clock_fn_t now, void *arg,
+                          const cose_lock_t *lock,
+                          const cose_executor_t *exec)
+{
+    memset(sched, 0, sizeof(*sched));
+    if (cfg) {
+        sched->cfg = *cfg;
+    }
+    else {
+        cose_sign_sched_cfg_init(&sched->cfg);
+    }
+    if (!sched->cfg.batch) {
+        sched->cfg.batch = 1;
+    }
+    sched->now = now;
+    sched->now_arg = arg;
+    sched->lock = lock;
+    sched->exec = exec;
+}
+
+static void _sched_lock(cose_sign_sched_t *sched)
+{
+    if (sched->lock) {
+        sched->lock->lock(sched->lock->ctx);
+    }
+}
+
+static void _sched_unlock(cose_sign_sched_t *sched)
+{
+    if (sched->lock) {
+        sched->lock->unlock(sched->lock->ctx);
+    }
+}
+
+static uint32_t _sched_now(const cose_sign_sched_t *sched)
+{
+    return sched->now ? sched->now(sched->now_arg) : 0;
+}
+
+static bool _sched_due(const cose_sign_sched_t *sched, bool all)
+{
+    if (!sched->head) {
+        return false;
+    }
+    if (all || sched->queued >= sched->cfg.batch ||
+            (!sched->cfg.linger && !sched->running)) {
+        return true;
+    }
+    /* Wrapping difference, the clock may overflow */
+    return sched->now &&
+           (uint32_t)(_sched_now(sched) - sched->head->submitted) >=
+           sched->cfg.deadline;
+}
+
+static void _sched_job(void *arg)
+{
+    _sched_job_t *job = arg;
+    cose_sign_sched_req_t *req = job->first;
+
+    for (size_t i = 0; i < job->num; i++) {
+        /* The callback may reuse the request */
+        cose_sign_sched_req_t *next = req->next;
+        req->res = cose_sign_verify_first(req->sign, req->key, req->buf,
+                                          req->len);
+        if (req->done) {
+            req->done(req);
+        }
+        req = next;
+    }
+}
+
+static void _sched_run(const cose_sign_sched_t *sched,
+                       cose_sign_sched_req_t *req, size_t num)
+{
+    _sched_job_t jobs[COSE_SIGN_SCHED_JOBS_MAX];
+    const cose_executor_t *exec = sched->exec;
+    size_t num_jobs = exec ? COSE_SIGN_SCHED_JOBS_MAX : 1;
+
+    if (num_jobs > num) {
+        num_jobs = num;
+    }
+    /* Split the list before any job can complete and reuse a request */
+    size_t first = 0;
+    for (size_t i = 0; i < num_jobs; i++) {
+        jobs[i].first = req;
+        jobs[i].num = (num - first) / (num_jobs - i);
+        first += jobs[i].num;
+        for (size_t j = 0; j < jobs[i].num; j++) {
+            req = req->next;
+        }
+    }
+    for (size_t i = 0; i < num_jobs; i++) {
+        if (!exec || exec->submit(exec->ctx, _sched_job, &jobs[i]) < 0) {
+            _sched_job(&jobs[i]);
+        }
+    }
+    if (exec) {
+        exec->wait(exec->ctx);
+    }
+}
+
+/* Called with the lock held, returns with the lock released */
+static size_t _sched_dispatch(cose_sign_sched_t *sched, bool all)
+{
+    size_t done = 0;
+
+    while (_sched_due(sched, all)) {
+        cose_sign_sched_req_t *first = sched->head;
+        cose_sign_sched_req_t *last = first;
+        size_t num = 1;
+
+        while (num < sched->cfg.batch && last->next) {
+            last = last->next;
+            num++;
+        }
+        sched->head = last->next;
+        if (!sched->head) {
+            sched->tail = NULL;
+        }
+        last->next = NULL;
+        sched->queued -= num;
+        sched->running++;
+        _sched_unlock(sched);
+
+        _sched_run(sched, first, num);
+        done += num;
+
+        _sched_lock(sched);
+        sched->running--;
+    }
+    _sched_unlock(sched);
+    return done;
+}
+
+size_t cose_sign_sched_submit(cose_sign_sched_t *sched,
+                              cose_sign_sched_req_t *req)
+{
+    req->res = COSE_ERR_NOINIT;
+    req->next = NULL;
+
+    _sched_lock(sched);
+    req->submitted = _sched_now(sched);
+    if (sched->tail) {
+        sched->tail->next = req;
+    }
+    else {
+        sched->head = req;
+    }
+    sched->tail = req;
+    sched->queued++;
+    return _sched_dispatch(sched, false);
+}
+
+size_t cose_sign_sched_poll(cose_sign_sched_t *sched)
+{
+    _sched_lock(sched);
+    return _sched_dispatch(sched, !sched->now);
+}
+
+size_t cose_sign_sched_flush(cose_sign_sched_t *sched)
+{
+    _sched_lock(sched);
+    return _sched_dispatch(sched, true);
+}
@@ -0,0 +1,1074 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Built-in AES-GCM and AES-CCM implementation
+ *
+ * The AES-NI path processes eight GCM counter blocks per iteration and folds
+ * four GHASH blocks per reduction. CCM runs the CBC-MAC and the CTR
+ * keystream as two interleaved block chains. The portable path uses a
+ * bitsliced S-box and a bitwise GHASH, both without secret dependent table
+ * lookups or branches.
+ */
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(COSE_CRYPTO_AES_PORTABLE) && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define AES_NI
+#include <immintrin.h>
+#endif
+
+#define AES_BLOCKSIZE       16U
+#define AES_ROUNDS_MAX      14U
+#define AES_SOFT_BATCH      4U  /**< Blocks per bitsliced S-box pass */
+
+#define GCM_TAGSIZE         COSE_CRYPTO_AEAD_AESGCM_ABYTES
+#define GCM_NONCESIZE       COSE_CRYPTO_AEAD_AESGCM_NONCEBYTES
+#define GCM_MAXLEN          ((UINT64_C(1) << 36) - 32) /**< NIST SP 800-38D */
+
+extern cose_crypt_rng cose_crypt_get_random;
+extern void *cose_crypt_rng_arg;
+
+typedef struct {
+    uint8_t rk[(AES_ROUNDS_MAX + 1) * AES_BLOCKSIZE];
+    unsigned rounds;
+} _aes_soft_t;
+
+typedef struct {
+    size_t keylen;
+    size_t taglen;
+    size_t lenbytes;    /**< CCM length field size, L */
+} _aes_params_t;
+
+static void _memzero(void *buf, size_t len)
+{
+    volatile uint8_t *p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+static int _ct_compare(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff;
+}
+
+static uint8_t _xtime(uint8_t a)
+{
+    return (uint8_t)((a << 1) ^ (0x1b & (uint8_t)-(a >> 7)));
+}
+
+static void _store_be64(uint8_t *buf, uint64_t val)
+{
+    for (unsigned i = 0; i < 8; i++) {
+        buf[7 - i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+static uint64_t _load_be64(const uint8_t *buf)
+{
+    uint64_t val = 0;
+    for (unsigned i = 0; i < 8; i++) {
+        val = (val << 8) | buf[i];
+    }
+    return val;
+}
+
+static int _params(cose_algo_t algo, _aes_params_t *params)
+{
+    switch(algo) {
+        case COSE_ALGO_A128GCM:
+            *params = (_aes_params_t){ 16, GCM_TAGSIZE, 0 };
+            return COSE_OK;
+        case COSE_ALGO_A192GCM:
+            *params = (_aes_params_t){ 24, GCM_TAGSIZE, 0 };
+            return COSE_OK;
+        case COSE_ALGO_A256GCM:
+            *params = (_aes_params_t){ 32, GCM_TAGSIZE, 0 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_16_64_128:
+            *params = (_aes_params_t){ 16, 8, 2 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_64_64_128:
+            *params = (_aes_params_t){ 16, 8, 8 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_16_128_128:
+            *params = (_aes_params_t){ 16, 16, 2 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_64_128_128:
+            *params = (_aes_params_t){ 16, 16, 8 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_16_64_256:
+            *params = (_aes_params_t){ 32, 8, 2 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_64_64_256:
+            *params = (_aes_params_t){ 32, 8, 8 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_16_128_256:
+            *params = (_aes_params_t){ 32, 16, 2 };
+            return COSE_OK;
+        case COSE_ALGO_AESCCM_64_128_256:
+            *params = (_aes_params_t){ 32, 16, 8 };
+            return COSE_OK;
+        default:
+            return COSE_ERR_NOTIMPLEMENTED;
+    }
+}
+
+/*
+ * Portable implementation
+ */
+
+/* Multiplication in GF(2^8) on 64 bitsliced bytes */
+static void _gf8_mul(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+    uint64_t t[15] = { 0 };
+
+    for (unsigned i = 0; i < 8; i++) {
+        for (unsigned j = 0; j < 8; j++) {
+            t[i + j] ^= a[i] & b[j];
+        }
+    }
+    /* Reduce with x^8 = x^4 + x^3 + x + 1 */
+    for (unsigned i = 14; i >= 8; i--) {
+        t[i - 4] ^= t[i];
+        t[i - 5] ^= t[i];
+        t[i - 7] ^= t[i];
+        t[i - 8] ^= t[i];
+    }
+    memcpy(r, t, 8 * sizeof(uint64_t));
+}
+
+/* Squaring in GF(2^8) is linear, spread the bits and reduce */
+static void _gf8_sqr(uint64_t *r, const uint64_t *a)
+{
+    uint64_t t[15] = { 0 };
+
+    for (unsigned i = 0; i < 8; i++) {
+        t[2 * i] = a[i];
+    }
+    for (unsigned i = 14; i >= 8; i--) {
+        t[i - 4] ^= t[i];
+        t[i - 5] ^= t[i];
+        t[i - 7] ^= t[i];
+        t[i - 8] ^= t[i];
+    }
+    memcpy(r, t, 8 * sizeof(uint64_t));
+}
+
+/* S-box as inversion (x^254) followed by the affine transformation */
+static void _sbox_bitsliced(uint64_t *x)
+{
+    uint64_t x2[8], x3[8], x12[8], t[8];
+
+    _gf8_sqr(x2, x);
+    _gf8_mul(x3, x2, x);
+    _gf8_sqr(t, x3);            /* x^6 */
+    _gf8_sqr(x12, t);
+    _gf8_mul(t, x12, x3);       /* x^15 */
+    _gf8_sqr(t, t);             /* x^30 */
+    _gf8_sqr(t, t);             /* x^60 */
+    _gf8_sqr(t, t);             /* x^120 */
+    _gf8_sqr(t, t);             /* x^240 */
+    _gf8_mul(t, t, x12);        /* x^252 */
+    _gf8_mul(t, t, x2);         /* x^254 */
+
+    for (unsigned i = 0; i < 8; i++) {
+        x[i] = t[i] ^ t[(i + 4) % 8] ^ t[(i + 5) % 8] ^
+               t[(i + 6) % 8] ^ t[(i + 7) % 8] ^
+               (((0x63 >> i) & 1) ? UINT64_MAX : 0);
+    }
+}
+
+/* Transpose the 8x8 bit matrix held in a word, byte i being row i */
+static uint64_t _transpose8(uint64_t x)
+{
+    uint64_t t;
+
+    t = (x ^ (x >> 7)) & UINT64_C(0x00aa00aa00aa00aa);
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & UINT64_C(0x0000cccc0000cccc);
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & UINT64_C(0x00000000f0f0f0f0);
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+/* Substitute up to 64 bytes in place, bit b of byte i in lane i of x[b] */
+static void _sbox_bytes(uint8_t *bytes, size_t len)
+{
+    uint8_t buf[64] = { 0 };
+    uint64_t w[8];
+    uint64_t x[8] = { 0 };
+
+    memcpy(buf, bytes, len);
+    for (unsigned i = 0; i < 8; i++) {
+        w[i] = 0;
+        for (unsigned j = 0; j < 8; j++) {
+            w[i] |= (uint64_t)buf[8 * i + j] << (8 * j);
+        }
+        w[i] = _transpose8(w[i]);
+        for (unsigned b = 0; b < 8; b++) {
+            x[b] |= ((w[i] >> (8 * b)) & 0xff) << (8 * i);
+        }
+    }
+    _sbox_bitsliced(x);
+    for (unsigned i = 0; i < 8; i++) {
+        w[i] = 0;
+        for (unsigned b = 0; b < 8; b++) {
+            w[i] |= ((x[b] >> (8 * i)) & 0xff) << (8 * b);
+        }
+        w[i] = _transpose8(w[i]);
+        for (unsigned j = 0; j < 8; j++) {
+            buf[8 * i + j] = (uint8_t)(w[i] >> (8 * j));
+        }
+    }
+    memcpy(bytes, buf, len);
+}
+
+static void _aes_soft_setkey(_aes_soft_t *ctx, const uint8_t *key, size_t keylen)
+{
+    size_t nk = keylen / 4;
+    size_t words = 4 * (nk + 7);
+    uint8_t rcon = 1;
+
+    ctx->rounds = (unsigned)nk + 6;
+    memcpy(ctx->rk, key, keylen);
+    for (size_t i = nk; i < words; i++) {
+        uint8_t t[4];
+        memcpy(t, &ctx->rk[4 * (i - 1)], 4);
+        if (i % nk == 0) {
+            uint8_t first = t[0];
+            t[0] = t[1];
+            t[1] = t[2];
+            t[2] = t[3];
+            t[3] = first;
+            _sbox_bytes(t, 4);
+            t[0] ^= rcon;
+            rcon = _xtime(rcon);
+        }
+        else if (nk > 6 && i % nk == 4) {
+            _sbox_bytes(t, 4);
+        }
+        for (unsigned j = 0; j < 4; j++) {
+            ctx->rk[4 * i + j] = ctx->rk[4 * (i - nk) + j] ^ t[j];
+        }
+    }
+}
+
+static void _shift_rows(uint8_t *s)
+{
+    uint8_t t[AES_BLOCKSIZE];
+
+    for (unsigned c = 0; c < 4; c++) {
+        for (unsigned r = 0; r < 4; r++) {
+            t[4 * c + r] = s[4 * ((c + r) % 4) + r];
+        }
+    }
+    memcpy(s, t, AES_BLOCKSIZE);
+}
+
+static void _mix_columns(uint8_t *s)
+{
+    for (unsigned c = 0; c < 4; c++) {
+        uint8_t *col = &s[4 * c];
+        uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+        uint8_t first = col[0];
+        col[0] ^= all ^ _xtime(col[0] ^ col[1]);
+        col[1] ^= all ^ _xtime(col[1] ^ col[2]);
+        col[2] ^= all ^ _xtime(col[2] ^ col[3]);
+        col[3] ^= all ^ _xtime(col[3] ^ first);
+    }
+}
+
+/* Encrypt up to AES_SOFT_BATCH independent blocks in place */
+static void _aes_soft_encrypt(const _aes_soft_t *ctx, uint8_t *blocks,
+                              size_t num)
+{
+    size_t len = num * AES_BLOCKSIZE;
+
+    for (size_t i = 0; i < len; i++) {
+        blocks[i] ^= ctx->rk[i % AES_BLOCKSIZE];
+    }
+    for (unsigned round = 1; round <= ctx->rounds; round++) {
+        const uint8_t *rk = &ctx->rk[round * AES_BLOCKSIZE];
+        _sbox_bytes(blocks, len);
+        for (size_t b = 0; b < num; b++) {
+            uint8_t *s = &blocks[b * AES_BLOCKSIZE];
+            _shift_rows(s);
+            if (round != ctx->rounds) {
+                _mix_columns(s);
+            }
+            for (unsigned i = 0; i < AES_BLOCKSIZE; i++) {
+                s[i] ^= rk[i];
+            }
+        }
+    }
+}
+
+/* GHASH multiplication X * H, with both as big endian 64 bit halves */
+static void _ghash_soft_mul(uint64_t *x, const uint64_t *h)
+{
+    uint64_t z[2] = { 0, 0 };
+    uint64_t v[2] = { h[0], h[1] };
+
+    for (unsigned i = 0; i < 128; i++) {
+        uint64_t bit = (x[i / 64] >> (63 - (i % 64))) & 1;
+        uint64_t mask = (uint64_t)0 - bit;
+        z[0] ^= v[0] & mask;
+        z[1] ^= v[1] & mask;
+        uint64_t carry = (uint64_t)0 - (v[1] & 1);
+        v[1] = (v[1] >> 1) | (v[0] << 63);
+        v[0] = (v[0] >> 1) ^ (UINT64_C(0xe100000000000000) & carry);
+    }
+    x[0] = z[0];
+    x[1] = z[1];
+}
+
+static void _ghash_soft(uint64_t *x, const uint64_t *h,
+                        const uint8_t *data, size_t len)
+{
+    while (len) {
+        uint8_t block[AES_BLOCKSIZE] = { 0 };
+        size_t chunk = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        memcpy(block, data, chunk);
+        x[0] ^= _load_be64(block);
+        x[1] ^= _load_be64(block + 8);
+        _ghash_soft_mul(x, h);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+static void _ctr_block(uint8_t *block, const uint8_t *iv, uint32_t ctr)
+{
+    memcpy(block, iv, GCM_NONCESIZE);
+    block[12] = (uint8_t)(ctr >> 24);
+    block[13] = (uint8_t)(ctr >> 16);
+    block[14] = (uint8_t)(ctr >> 8);
+    block[15] = (uint8_t)ctr;
+}
+
+static void _gcm_soft(const uint8_t *key, size_t keylen, const uint8_t *iv,
+                      const uint8_t *aad, size_t aadlen,
+                      const uint8_t *in, size_t len, uint8_t *out,
+                      uint8_t *tag, bool encrypt)
+{
+    _aes_soft_t ctx;
+    uint8_t ks[AES_SOFT_BATCH * AES_BLOCKSIZE];
+    uint64_t h[2];
+    uint64_t x[2] = { 0, 0 };
+    uint32_t ctr = 2;
+
+    _aes_soft_setkey(&ctx, key, keylen);
+
+    /* H and the tag mask E(J0) share one batch */
+    memset(ks, 0, AES_BLOCKSIZE);
+    _ctr_block(ks + AES_BLOCKSIZE, iv, 1);
+    _aes_soft_encrypt(&ctx, ks, 2);
+    h[0] = _load_be64(ks);
+    h[1] = _load_be64(ks + 8);
+    memcpy(tag, ks + AES_BLOCKSIZE, GCM_TAGSIZE);
+
+    _ghash_soft(x, h, aad, aadlen);
+    for (size_t pos = 0; pos < len;) {
+        size_t chunk = len - pos;
+        if (chunk > sizeof(ks)) {
+            chunk = sizeof(ks);
+        }
+        size_t blocks = (chunk + AES_BLOCKSIZE - 1) / AES_BLOCKSIZE;
+        for (size_t b = 0; b < blocks; b++) {
+            _ctr_block(ks + b * AES_BLOCKSIZE, iv, ctr++);
+        }
+        _aes_soft_encrypt(&ctx, ks, blocks);
+        if (!encrypt) {
+            _ghash_soft(x, h, in + pos, chunk);
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            out[pos + i] = in[pos + i] ^ ks[i];
+        }
+        if (encrypt) {
+            _ghash_soft(x, h, out + pos, chunk);
+        }
+        pos += chunk;
+    }
+
+    x[0] ^= (uint64_t)aadlen * 8;
+    x[1] ^= (uint64_t)len * 8;
+    _ghash_soft_mul(x, h);
+    _store_be64(ks, x[0]);
+    _store_be64(ks + 8, x[1]);
+    for (unsigned i = 0; i < GCM_TAGSIZE; i++) {
+        tag[i] ^= ks[i];
+    }
+
+    _memzero(&ctx, sizeof(ctx));
+    _memzero(ks, sizeof(ks));
+    _memzero(h, sizeof(h));
+}
+
+/*
+ * CCM formatting, RFC 3610
+ */
+
+/* Fill B0 and A0 and return the encoded AAD length prefix size in hdr */
+static size_t _ccm_init(uint8_t *b0, uint8_t *a0, uint8_t *hdr,
+                        const _aes_params_t *params, const uint8_t *nonce,
+                        size_t aadlen, size_t len)
+{
+    size_t noncelen = 15 - params->lenbytes;
+    size_t hdrlen = 0;
+
+    b0[0] = (uint8_t)(((aadlen > 0) << 6) |
+                      (((params->taglen - 2) / 2) << 3) |
+                      (params->lenbytes - 1));
+    a0[0] = (uint8_t)(params->lenbytes - 1);
+    memcpy(b0 + 1, nonce, noncelen);
+    memcpy(a0 + 1, nonce, noncelen);
+    for (size_t i = 0; i < params->lenbytes; i++) {
+        b0[15 - i] = (uint8_t)((uint64_t)len >> (8 * i));
+        a0[15 - i] = 0;
+    }
+
+    if (aadlen == 0) {
+        return 0;
+    }
+    if (aadlen < 0xff00) {
+        hdr[hdrlen++] = (uint8_t)(aadlen >> 8);
+        hdr[hdrlen++] = (uint8_t)aadlen;
+    }
+    else {
+        hdr[hdrlen++] = 0xff;
+        hdr[hdrlen++] = 0xfe;
+        for (int i = 3; i >= 0; i--) {
+            hdr[hdrlen++] = (uint8_t)((uint64_t)aadlen >> (8 * i));
+        }
+    }
+    return hdrlen;
+}
+
+static bool _ccm_length_valid(const _aes_params_t *params, size_t aadlen,
+                              size_t len)
+{
+    if ((uint64_t)aadlen > UINT32_MAX) {
+        return false;
+    }
+    if (params->lenbytes < 8 &&
+            (uint64_t)len >> (8 * params->lenbytes)) {
+        return false;
+    }
+    return true;
+}
+
+static void _ccm_counter(uint8_t *block, const uint8_t *a0,
+                         const _aes_params_t *params, uint64_t ctr)
+{
+    memcpy(block, a0, AES_BLOCKSIZE);
+    for (size_t i = 0; i < params->lenbytes; i++) {
+        block[15 - i] = (uint8_t)(ctr >> (8 * i));
+    }
+}
+
+/* Absorb the AAD with its length prefix into the CBC-MAC state */
+static void _ccm_mac_aad_soft(const _aes_soft_t *ctx, uint8_t *mac,
+                              const uint8_t *hdr, size_t hdrlen,
+                              const uint8_t *aad, size_t aadlen)
+{
+    size_t fill = 0;
+
+    for (size_t i = 0; i < hdrlen; i++) {
+        mac[fill++] ^= hdr[i];
+    }
+    for (size_t i = 0; i < aadlen; i++) {
+        mac[fill++] ^= aad[i];
+        if (fill == AES_BLOCKSIZE) {
+            _aes_soft_encrypt(ctx, mac, 1);
+            fill = 0;
+        }
+    }
+    if (fill) {
+        _aes_soft_encrypt(ctx, mac, 1);
+    }
+}
+
+/*
+ * Run CTR and CBC-MAC with both chains in one batch per block. The MAC
+ * absorbs the plaintext, which lags one block behind when decrypting.
+ */
+static void _ccm_soft(const uint8_t *key, const _aes_params_t *params,
+                      const uint8_t *nonce, const uint8_t *aad, size_t aadlen,
+                      const uint8_t *in, size_t len, uint8_t *out,
+                      uint8_t *tag, bool encrypt)
+{
+    _aes_soft_t ctx;
+    uint8_t a0[AES_BLOCKSIZE];
+    uint8_t hdr[6];
+    /* [0] CBC-MAC state, [1] keystream */
+    uint8_t blocks[2 * AES_BLOCKSIZE];
+    uint8_t *mac = blocks;
+    uint8_t *ks = blocks + AES_BLOCKSIZE;
+    uint64_t ctr = 1;
+
+    _aes_soft_setkey(&ctx, key, params->keylen);
+    size_t hdrlen = _ccm_init(mac, a0, hdr, params, nonce, aadlen, len);
+
+    /* B0 MAC block and S0 for the tag */
+    memcpy(ks, a0, AES_BLOCKSIZE);
+    _aes_soft_encrypt(&ctx, blocks, 2);
+    memcpy(tag, ks, params->taglen);
+
+    _ccm_mac_aad_soft(&ctx, mac, hdr, hdrlen, aad, aadlen);
+
+    if (!encrypt && len) {
+        _ccm_counter(ks, a0, params, ctr++);
+        _aes_soft_encrypt(&ctx, ks, 1);
+    }
+    for (size_t pos = 0; pos < len; pos += AES_BLOCKSIZE) {
+        size_t chunk = len - pos < AES_BLOCKSIZE ? len - pos : AES_BLOCKSIZE;
+        const uint8_t *plain = encrypt ? in + pos : out + pos;
+        bool last = pos + chunk == len;
+        if (encrypt) {
+            _ccm_counter(ks, a0, params, ctr++);
+        }
+        else {
+            for (size_t i = 0; i < chunk; i++) {
+                out[pos + i] = in[pos + i] ^ ks[i];
+            }
+            if (!last) {
+                _ccm_counter(ks, a0, params, ctr++);
+            }
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            mac[i] ^= plain[i];
+        }
+        _aes_soft_encrypt(&ctx, blocks, (encrypt || !last) ? 2 : 1);
+        if (encrypt) {
+            for (size_t i = 0; i < chunk; i++) {
+                out[pos + i] = in[pos + i] ^ ks[i];
+            }
+        }
+    }
+    for (size_t i = 0; i < params->taglen; i++) {
+        tag[i] ^= mac[i];
+    }
+
+    _memzero(&ctx, sizeof(ctx));
+    _memzero(blocks, sizeof(blocks));
+}
+
+/*
+ * AES-NI implementation
+ */
+#ifdef AES_NI
+
+#define AES_NI_TARGET   __attribute__((target("aes,pclmul,sse4.1,ssse3")))
+#define GCM_NI_BATCH    8U
+
+typedef struct {
+    __m128i rk[AES_ROUNDS_MAX + 1];
+    unsigned rounds;
+} _aes_ni_t;
+
+AES_NI_TARGET static uint32_t _ni_subword(uint32_t word)
+{
+    __m128i t = _mm_set_epi32(0, 0, (int)word, 0);
+    t = _mm_aeskeygenassist_si128(t, 0);
+    return (uint32_t)_mm_cvtsi128_si32(t);
+}
+
+AES_NI_TARGET static void _aes_ni_setkey(_aes_ni_t *ctx, const uint8_t *key,
+                                         size_t keylen)
+{
+    uint32_t w[4 * (AES_ROUNDS_MAX + 1)];
+    size_t nk = keylen / 4;
+    size_t words = 4 * (nk + 7);
+    uint32_t rcon = 1;
+
+    ctx->rounds = (unsigned)nk + 6;
+    memcpy(w, key, keylen);
+    for (size_t i = nk; i < words; i++) {
+        uint32_t t = w[i - 1];
+        if (i % nk == 0) {
+            t = _ni_subword(t);
+            t = ((t >> 8) | (t << 24)) ^ rcon;
+            rcon = _xtime((uint8_t)rcon);
+        }
+        else if (nk > 6 && i % nk == 4) {
+            t = _ni_subword(t);
+        }
+        w[i] = w[i - nk] ^ t;
+    }
+    for (unsigned r = 0; r <= ctx->rounds; r++) {
+        ctx->rk[r] = _mm_loadu_si128((const __m128i *)&w[4 * r]);
+    }
+    _memzero(w, sizeof(w));
+}
+
+AES_NI_TARGET static inline __m128i _aes_ni_encrypt(const _aes_ni_t *ctx,
+                                                    __m128i block)
+{
+    block = _mm_xor_si128(block, ctx->rk[0]);
+    for (unsigned r = 1; r < ctx->rounds; r++) {
+        block = _mm_aesenc_si128(block, ctx->rk[r]);
+    }
+    return _mm_aesenclast_si128(block, ctx->rk[ctx->rounds]);
+}
+
+AES_NI_TARGET static inline __m128i _bswap128(__m128i x)
+{
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                      8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(x, mask);
+}
+
+/* Carry-less 256 bit product of byte reflected operands */
+AES_NI_TARGET static inline void _clmul(__m128i a, __m128i b,
+                                        __m128i *lo, __m128i *hi)
+{
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t1 = _mm_xor_si128(t1, t2);
+    *lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+    *hi = _mm_xor_si128(t3, _mm_srli_si128(t1, 8));
+}
+
+/* Reduce a 256 bit product modulo the GHASH polynomial */
+AES_NI_TARGET static inline __m128i _ghash_reduce(__m128i lo, __m128i hi)
+{
+    /* Shift left by one to account for the reflected bit order */
+    __m128i t3 = _mm_srli_epi32(lo, 31);
+    __m128i t4 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t5 = _mm_srli_si128(t3, 12);
+    t4 = _mm_slli_si128(t4, 4);
+    t3 = _mm_slli_si128(t3, 4);
+    lo = _mm_or_si128(lo, t3);
+    hi = _mm_or_si128(_mm_or_si128(hi, t4), t5);
+
+    __m128i a = _mm_slli_epi32(lo, 31);
+    __m128i b = _mm_slli_epi32(lo, 30);
+    __m128i c = _mm_slli_epi32(lo, 25);
+    a = _mm_xor_si128(_mm_xor_si128(a, b), c);
+    b = _mm_srli_si128(a, 4);
+    a = _mm_slli_si128(a, 12);
+    lo = _mm_xor_si128(lo, a);
+
+    __m128i d = _mm_srli_epi32(lo, 1);
+    __m128i e = _mm_srli_epi32(lo, 2);
+    __m128i f = _mm_srli_epi32(lo, 7);
+    d = _mm_xor_si128(_mm_xor_si128(d, e), f);
+    d = _mm_xor_si128(_mm_xor_si128(d, b), lo);
+    return _mm_xor_si128(hi, d);
+}
+
+AES_NI_TARGET static inline __m128i _ghash_ni_mul(__m128i a, __m128i b)
+{
+    __m128i lo, hi;
+    _clmul(a, b, &lo, &hi);
+    return _ghash_reduce(lo, hi);
+}
+
+/*
+ * Absorb full blocks into the GHASH state. Four blocks share a single
+ * reduction using the powers H^4..H^1.
+ */
+AES_NI_TARGET static __m128i _ghash_ni_blocks(__m128i x, const __m128i *hpow,
+                                              const __m128i *blocks,
+                                              size_t num)
+{
+    while (num >= 4) {
+        __m128i lo, hi, tlo, thi;
+        _clmul(_mm_xor_si128(x, blocks[0]), hpow[3], &lo, &hi);
+        for (unsigned i = 1; i < 4; i++) {
+            _clmul(blocks[i], hpow[3 - i], &tlo, &thi);
+            lo = _mm_xor_si128(lo, tlo);
+            hi = _mm_xor_si128(hi, thi);
+        }
+        x = _ghash_reduce(lo, hi);
+        blocks += 4;
+        num -= 4;
+    }
+    while (num--) {
+        x = _ghash_ni_mul(_mm_xor_si128(x, *blocks++), hpow[0]);
+    }
+    return x;
+}
+
+/* Absorb a byte string, zero padding the final block */
+AES_NI_TARGET static __m128i _ghash_ni(__m128i x, const __m128i *hpow,
+                                       const uint8_t *data, size_t len)
+{
+    __m128i blocks[4];
+
+    while (len >= AES_BLOCKSIZE) {
+        size_t num = 0;
+        for (; num < 4 && len >= AES_BLOCKSIZE; num++) {
+            blocks[num] = _bswap128(_mm_loadu_si128((const __m128i *)data));
+            data += AES_BLOCKSIZE;
+            len -= AES_BLOCKSIZE;
+        }
+        x = _ghash_ni_blocks(x, hpow, blocks, num);
+    }
+    if (len) {
+        uint8_t last[AES_BLOCKSIZE] = { 0 };
+        memcpy(last, data, len);
+        blocks[0] = _bswap128(_mm_loadu_si128((const __m128i *)last));
+        x = _ghash_ni_blocks(x, hpow, blocks, 1);
+    }
+    return x;
+}
+
+AES_NI_TARGET static inline __m128i _ni_ctr(__m128i base, uint32_t ctr)
+{
+    return _mm_insert_epi32(base, (int)__builtin_bswap32(ctr), 3);
+}
+
+AES_NI_TARGET static void _gcm_ni(const uint8_t *key, size_t keylen,
+                                  const uint8_t *iv,
+                                  const uint8_t *aad, size_t aadlen,
+                                  const uint8_t *in, size_t len, uint8_t *out,
+                                  uint8_t *tag, bool encrypt)
+{
+    _aes_ni_t ctx;
+    __m128i hpow[4];
+    uint8_t ivblock[AES_BLOCKSIZE] = { 0 };
+    uint32_t ctr = 2;
+    size_t total = len;
+
+    _aes_ni_setkey(&ctx, key, keylen);
+    hpow[0] = _bswap128(_aes_ni_encrypt(&ctx, _mm_setzero_si128()));
+    for (unsigned i = 1; i < 4; i++) {
+        hpow[i] = _ghash_ni_mul(hpow[i - 1], hpow[0]);
+    }
+    memcpy(ivblock, iv, GCM_NONCESIZE);
+    __m128i base = _mm_loadu_si128((const __m128i *)ivblock);
+
+    __m128i x = _ghash_ni(_mm_setzero_si128(), hpow, aad, aadlen);
+
+    while (len >= GCM_NI_BATCH * AES_BLOCKSIZE) {
+        __m128i b[GCM_NI_BATCH];
+        for (unsigned i = 0; i < GCM_NI_BATCH; i++) {
+            b[i] = _mm_xor_si128(_ni_ctr(base, ctr++), ctx.rk[0]);
+        }
+        for (unsigned r = 1; r < ctx.rounds; r++) {
+            for (unsigned i = 0; i < GCM_NI_BATCH; i++) {
+                b[i] = _mm_aesenc_si128(b[i], ctx.rk[r]);
+            }
+        }
+        for (unsigned i = 0; i < GCM_NI_BATCH; i++) {
+            __m128i data = _mm_loadu_si128((const __m128i *)in + i);
+            b[i] = _mm_aesenclast_si128(b[i], ctx.rk[ctx.rounds]);
+            b[i] = _mm_xor_si128(b[i], data);
+            _mm_storeu_si128((__m128i *)out + i, b[i]);
+            b[i] = _bswap128(encrypt ? b[i] : data);
+        }
+        x = _ghash_ni_blocks(x, hpow, b, GCM_NI_BATCH);
+        in += GCM_NI_BATCH * AES_BLOCKSIZE;
+        out += GCM_NI_BATCH * AES_BLOCKSIZE;
+        len -= GCM_NI_BATCH * AES_BLOCKSIZE;
+    }
+    while (len) {
+        uint8_t block[AES_BLOCKSIZE] = { 0 };
+        size_t chunk = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        __m128i ks = _aes_ni_encrypt(&ctx, _ni_ctr(base, ctr++));
+        memcpy(block, in, chunk);
+        __m128i data = _mm_loadu_si128((const __m128i *)block);
+        _mm_storeu_si128((__m128i *)block, _mm_xor_si128(data, ks));
+        memcpy(out, block, chunk);
+        if (encrypt) {
+            memset(block + chunk, 0, AES_BLOCKSIZE - chunk);
+            data = _mm_loadu_si128((const __m128i *)block);
+        }
+        data = _bswap128(data);
+        x = _ghash_ni_blocks(x, hpow, &data, 1);
+        in += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+
+    __m128i lens = _mm_set_epi64x((long long)((uint64_t)aadlen * 8),
+                                  (long long)((uint64_t)total * 8));
+    x = _ghash_ni_mul(_mm_xor_si128(x, lens), hpow[0]);
+    x = _mm_xor_si128(_bswap128(x), _aes_ni_encrypt(&ctx, _ni_ctr(base, 1)));
+    _mm_storeu_si128((__m128i *)tag, x);
+
+    _memzero(&ctx, sizeof(ctx));
+    _memzero(hpow, sizeof(hpow));
+}
+
+AES_NI_TARGET static void _ccm_ni(const uint8_t *key,
+                                  const _aes_params_t *params,
+                                  const uint8_t *nonce,
+                                  const uint8_t *aad, size_t aadlen,
+                                  const uint8_t *in, size_t len, uint8_t *out,
+                                  uint8_t *tag, bool encrypt)
+{
+    _aes_ni_t ctx;
+    uint8_t b0[AES_BLOCKSIZE];
+    uint8_t a0[AES_BLOCKSIZE];
+    uint8_t hdr[6];
+    uint8_t block[AES_BLOCKSIZE];
+    uint64_t ctr = 1;
+
+    _aes_ni_setkey(&ctx, key, params->keylen);
+    size_t hdrlen = _ccm_init(b0, a0, hdr, params, nonce, aadlen, len);
+    __m128i mac = _aes_ni_encrypt(&ctx, _mm_loadu_si128((const __m128i *)b0));
+    __m128i s0 = _aes_ni_encrypt(&ctx, _mm_loadu_si128((const __m128i *)a0));
+
+    if (aadlen) {
+        size_t fill = hdrlen;
+        memcpy(block, hdr, hdrlen);
+        for (size_t i = 0; i < aadlen;) {
+            size_t chunk = aadlen - i;
+            if (chunk > AES_BLOCKSIZE - fill) {
+                chunk = AES_BLOCKSIZE - fill;
+            }
+            memcpy(block + fill, aad + i, chunk);
+            fill += chunk;
+            i += chunk;
+            memset(block + fill, 0, AES_BLOCKSIZE - fill);
+            mac = _mm_xor_si128(mac, _mm_loadu_si128((const __m128i *)block));
+            mac = _aes_ni_encrypt(&ctx, mac);
+            fill = 0;
+        }
+    }
+
+    while (len) {
+        size_t chunk = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        _ccm_counter(block, a0, params, ctr++);
+        __m128i counter = _mm_loadu_si128((const __m128i *)block);
+        memset(block, 0, AES_BLOCKSIZE);
+        memcpy(block, in, chunk);
+        __m128i data = _mm_loadu_si128((const __m128i *)block);
+        __m128i ks;
+        if (encrypt) {
+            /* MAC and keystream are independent, interleave both chains */
+            __m128i m = _mm_xor_si128(_mm_xor_si128(mac, data), ctx.rk[0]);
+            ks = _mm_xor_si128(counter, ctx.rk[0]);
+            for (unsigned r = 1; r < ctx.rounds; r++) {
+                m = _mm_aesenc_si128(m, ctx.rk[r]);
+                ks = _mm_aesenc_si128(ks, ctx.rk[r]);
+            }
+            mac = _mm_aesenclast_si128(m, ctx.rk[ctx.rounds]);
+            ks = _mm_aesenclast_si128(ks, ctx.rk[ctx.rounds]);
+            _mm_storeu_si128((__m128i *)block, _mm_xor_si128(data, ks));
+        }
+        else {
+            ks = _aes_ni_encrypt(&ctx, counter);
+            _mm_storeu_si128((__m128i *)block, _mm_xor_si128(data, ks));
+            memset(block + chunk, 0, AES_BLOCKSIZE - chunk);
+            mac = _aes_ni_encrypt(&ctx, _mm_xor_si128(mac,
+                                  _mm_loadu_si128((const __m128i *)block)));
+        }
+        memcpy(out, block, chunk);
+        in += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+    _mm_storeu_si128((__m128i *)block, _mm_xor_si128(mac, s0));
+    memcpy(tag, block, params->taglen);
+
+    _memzero(&ctx, sizeof(ctx));
+    _memzero(block, sizeof(block));
+}
+
+static bool _use_ni(void)
+{
+    static volatile int ni = -1;
+    if (ni < 0) {
+        __builtin_cpu_init();
+        ni = __builtin_cpu_supports("aes") &&
+             __builtin_cpu_supports("pclmul") &&
+             __builtin_cpu_supports("sse4.1") &&
+             __builtin_cpu_supports("ssse3");
+    }
+    return ni;
+}
+#else
+static bool _use_ni(void)
+{
+    return false;
+}
+#endif /* AES_NI */
+
+static void _gcm(const uint8_t *key, size_t keylen, const uint8_t *iv,
+                 const uint8_t *aad, size_t aadlen,
+                 const uint8_t *in, size_t len, uint8_t *out,
+                 uint8_t *tag, bool encrypt)
+{
+#ifdef AES_NI
+    if (_use_ni()) {
+        _gcm_ni(key, keylen, iv, aad, aadlen, in, len, out, tag, encrypt);
+        return;
+    }
+#endif
+    _gcm_soft(key, keylen, iv, aad, aadlen, in, len, out, tag, encrypt);
+}
+
+static void _ccm(const uint8_t *key, const _aes_params_t *params,
+                 const uint8_t *nonce, const uint8_t *aad, size_t aadlen,
+                 const uint8_t *in, size_t len, uint8_t *out,
+                 uint8_t *tag, bool encrypt)
+{
+#ifdef AES_NI
+    if (_use_ni()) {
+        _ccm_ni(key, params, nonce, aad, aadlen, in, len, out, tag, encrypt);
+        return;
+    }
+#endif
+    _ccm_soft(key, params, nonce, aad, aadlen, in, len, out, tag, encrypt);
+}
+
+bool cose_crypto_aes_accelerated(void)
+{
+    return _use_ni();
+}
+
+#ifdef CRYPTO_AES_INCLUDE_AESGCM
+COSE_ssize_t cose_crypto_keygen_aesgcm(uint8_t *buf, size_t len, cose_algo_t algo)
+{
+    _aes_params_t params;
+
+    if (_params(algo, &params) != COSE_OK || params.lenbytes) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (len < params.keylen) {
+        return COSE_ERR_NOMEM;
+    }
+    if (cose_crypt_get_random(cose_crypt_rng_arg, buf, params.keylen)) {
+        return COSE_ERR_CRYPTO;
+    }
+    return (COSE_ssize_t)params.keylen;
+}
+
+int cose_crypto_aead_encrypt_aesgcm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    _aes_params_t params;
+
+    if (_params(algo, &params) != COSE_OK || params.lenbytes) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if ((uint64_t)msglen > GCM_MAXLEN) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _gcm(k, params.keylen, npub, aad, aadlen, msg, msglen, c, c + msglen,
+         true);
+    *clen = msglen + GCM_TAGSIZE;
+    return COSE_OK;
+}
+
+int cose_crypto_aead_decrypt_aesgcm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    _aes_params_t params;
+    uint8_t tag[GCM_TAGSIZE];
+
+    if (_params(algo, &params) != COSE_OK || params.lenbytes) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (clen < GCM_TAGSIZE) {
+        return COSE_ERR_CRYPTO;
+    }
+    *msglen = clen - GCM_TAGSIZE;
+    if ((uint64_t)*msglen > GCM_MAXLEN) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _gcm(k, params.keylen, npub, aad, aadlen, c, *msglen, msg, tag, false);
+    if (_ct_compare(tag, c + *msglen, GCM_TAGSIZE)) {
+        _memzero(msg, *msglen);
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+#endif /* CRYPTO_AES_INCLUDE_AESGCM */
+
+#ifdef CRYPTO_AES_INCLUDE_AESCCM
+int cose_crypto_aead_encrypt_aesccm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    _aes_params_t params;
+
+    if (_params(algo, &params) != COSE_OK || !params.lenbytes) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!_ccm_length_valid(&params, aadlen, msglen)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _ccm(k, &params, npub, aad, aadlen, msg, msglen, c, c + msglen, true);
+    *clen = msglen + params.taglen;
+    return COSE_OK;
+}
+
+int cose_crypto_aead_decrypt_aesccm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    _aes_params_t params;
+    uint8_t tag[AES_BLOCKSIZE];
+
+    if (_params(algo, &params) != COSE_OK || !params.lenbytes) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (clen < params.taglen) {
+        return COSE_ERR_CRYPTO;
+    }
+    *msglen = clen - params.taglen;
+    if (!_ccm_length_valid(&params, aadlen, *msglen)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _ccm(k, &params, npub, aad, aadlen, c, *msglen, msg, tag, false);
+    if (_ct_compare(tag, c + *msglen, params.taglen)) {
+        _memzero(msg, *msglen);
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+#endif /* CRYPTO_AES_INCLUDE_AESCCM */
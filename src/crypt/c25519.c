@@ -36,10 +36,11 @@ int cose_crypto_verify_ed25519(const cose_key_t *key, const uint8_t *sign, size_
 
 }
 
-void cose_crypto_keypair_ed25519(cose_key_t *key)
+int cose_crypto_keypair_ed25519(cose_key_t *key)
 {
     randombytes(key->d, EDSIGN_SECRET_KEY_SIZE);
     edsign_sec_to_pub(key->x, key->d);
+    return COSE_OK;
 }
 
 size_t cose_crypto_sig_size_ed25519(void)
@@ -0,0 +1,851 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Built-in ChaCha20-Poly1305 implementation (RFC 8439)
+ *
+ * ChaCha20 processes multiple blocks in parallel with one block per vector
+ * lane: 4 with SSE2 or NEON, 8 with AVX2 and 16 with AVX-512. Poly1305 uses
+ * 26 bit limbs, the AVX2 variant runs four interleaved accumulators with
+ * r^4 and combines them with r^4..r^1 at the end. The x86 implementations
+ * are selected at runtime from the CPU features.
+ */
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(COSE_CRYPTO_CHACHAPOLY_PORTABLE) && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define CHACHAPOLY_X86
+#include <immintrin.h>
+#elif !defined(COSE_CRYPTO_CHACHAPOLY_PORTABLE) && defined(__aarch64__) && \
+    defined(__ARM_NEON) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CHACHAPOLY_NEON
+#include <arm_neon.h>
+#endif
+
+#define CHACHA_BLOCKSIZE    64U
+#define CHACHA_KEYSIZE      COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES
+#define CHACHA_NONCESIZE    COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES
+#define POLY_BLOCKSIZE      16U
+#define POLY_TAGSIZE        COSE_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES
+#define POLY_MASK26         0x3ffffffU
+/** Chunk size for encrypting and authenticating while the data is in cache */
+#define CHACHAPOLY_CHUNK    4096U
+/** Maximum message size with the 32 bit block counter starting at 1 */
+#define CHACHAPOLY_MAXLEN   (((uint64_t)UINT32_MAX) * CHACHA_BLOCKSIZE)
+
+extern cose_crypt_rng cose_crypt_get_random;
+extern void *cose_crypt_rng_arg;
+
+typedef enum {
+    CHACHAPOLY_PORTABLE,
+    CHACHAPOLY_SSE2,
+    CHACHAPOLY_NEON_4WAY,
+    CHACHAPOLY_AVX2,
+    CHACHAPOLY_AVX512,
+} _chachapoly_impl_t;
+
+typedef struct {
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+    uint32_t rpow[3][5];    /**< r^2, r^3 and r^4 for the vector path */
+} _poly1305_t;
+
+static void _memzero(void *buf, size_t len)
+{
+    volatile uint8_t *p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+static uint32_t _load32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _store32_le(uint8_t *p, uint32_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+    p[2] = (uint8_t)(val >> 16);
+    p[3] = (uint8_t)(val >> 24);
+}
+
+/*
+ * ChaCha20
+ */
+
+#define CHACHA_QR(ADD, XOR, ROTL, a, b, c, d) \
+    a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 16); \
+    c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 12); \
+    a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 8);  \
+    c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 7)
+
+/*
+ * The working state lives in the named variables x0..x15 so that it stays in
+ * registers without relying on loop unrolling
+ */
+#define CHACHA_DOUBLEROUND(ADD, XOR, ROTL) do { \
+        CHACHA_QR(ADD, XOR, ROTL, x0, x4, x8, x12); \
+        CHACHA_QR(ADD, XOR, ROTL, x1, x5, x9, x13); \
+        CHACHA_QR(ADD, XOR, ROTL, x2, x6, x10, x14); \
+        CHACHA_QR(ADD, XOR, ROTL, x3, x7, x11, x15); \
+        CHACHA_QR(ADD, XOR, ROTL, x0, x5, x10, x15); \
+        CHACHA_QR(ADD, XOR, ROTL, x1, x6, x11, x12); \
+        CHACHA_QR(ADD, XOR, ROTL, x2, x7, x8, x13); \
+        CHACHA_QR(ADD, XOR, ROTL, x3, x4, x9, x14); \
+} while (0)
+
+#define CHACHA_ROUNDS(ADD, XOR, ROTL) \
+    for (unsigned round = 0; round < 10; round++) { \
+        CHACHA_DOUBLEROUND(ADD, XOR, ROTL); \
+    }
+
+/* Declare x0..x15 with every word of the state broadcast */
+#define CHACHA_LOAD(T, SET1, state) \
+    T x0 = SET1(state[0]), x1 = SET1(state[1]), x2 = SET1(state[2]), \
+      x3 = SET1(state[3]), x4 = SET1(state[4]), x5 = SET1(state[5]), \
+      x6 = SET1(state[6]), x7 = SET1(state[7]), x8 = SET1(state[8]), \
+      x9 = SET1(state[9]), x10 = SET1(state[10]), x11 = SET1(state[11]), \
+      x12 = SET1(state[12]), x13 = SET1(state[13]), x14 = SET1(state[14]), \
+      x15 = SET1(state[15])
+
+#define CHACHA_COLLECT { x0, x1, x2, x3, x4, x5, x6, x7, \
+                         x8, x9, x10, x11, x12, x13, x14, x15 }
+
+#define SCALAR_ADD(a, b)    ((a) + (b))
+#define SCALAR_XOR(a, b)    ((a) ^ (b))
+#define SCALAR_ROTL(a, n)   (((a) << (n)) | ((a) >> (32 - (n))))
+#define SCALAR_SET1(a)      (a)
+
+static void _chacha_init(uint32_t *state, const uint8_t *key,
+                         const uint8_t *nonce, uint32_t counter)
+{
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (unsigned i = 0; i < 8; i++) {
+        state[4 + i] = _load32_le(key + 4 * i);
+    }
+    state[12] = counter;
+    for (unsigned i = 0; i < 3; i++) {
+        state[13 + i] = _load32_le(nonce + 4 * i);
+    }
+}
+
+static void _chacha_block(uint32_t *state, uint8_t *out)
+{
+    CHACHA_LOAD(uint32_t, SCALAR_SET1, state);
+
+    CHACHA_ROUNDS(SCALAR_ADD, SCALAR_XOR, SCALAR_ROTL);
+    uint32_t x[16] = CHACHA_COLLECT;
+    for (unsigned i = 0; i < 16; i++) {
+        _store32_le(out + 4 * i, x[i] + state[i]);
+    }
+    state[12]++;
+    _memzero(x, sizeof(x));
+}
+
+static void _chacha_xor_portable(uint32_t *state, const uint8_t *in,
+                                 uint8_t *out, size_t len)
+{
+    uint8_t ks[CHACHA_BLOCKSIZE];
+
+    while (len) {
+        size_t chunk = len < CHACHA_BLOCKSIZE ? len : CHACHA_BLOCKSIZE;
+        _chacha_block(state, ks);
+        for (size_t i = 0; i < chunk; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+        in += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+    _memzero(ks, sizeof(ks));
+}
+
+#ifdef CHACHAPOLY_X86
+#define CHACHA_AVX2_TARGET      __attribute__((target("avx2")))
+#define CHACHA_AVX512_TARGET    __attribute__((target("avx512f")))
+
+#define SSE2_SET1(a)        _mm_set1_epi32((int)(a))
+#define SSE2_ADD(a, b)      _mm_add_epi32(a, b)
+#define SSE2_XOR(a, b)      _mm_xor_si128(a, b)
+#define SSE2_ROTL(a, n)     _mm_or_si128(_mm_slli_epi32(a, n), \
+                                         _mm_srli_epi32(a, 32 - (n)))
+
+/* Transpose four words of four blocks and xor them into the output */
+#define SSE2_XOR4(in, out, x0, x1, x2, x3) do { \
+        __m128i t0 = _mm_unpacklo_epi32(x0, x1); \
+        __m128i t1 = _mm_unpackhi_epi32(x0, x1); \
+        __m128i t2 = _mm_unpacklo_epi32(x2, x3); \
+        __m128i t3 = _mm_unpackhi_epi32(x2, x3); \
+        __m128i b[4] = { _mm_unpacklo_epi64(t0, t2), \
+                         _mm_unpackhi_epi64(t0, t2), \
+                         _mm_unpacklo_epi64(t1, t3), \
+                         _mm_unpackhi_epi64(t1, t3) }; \
+        for (unsigned j = 0; j < 4; j++) { \
+            __m128i m = _mm_loadu_si128((const __m128i *)((in) + j * CHACHA_BLOCKSIZE)); \
+            _mm_storeu_si128((__m128i *)((out) + j * CHACHA_BLOCKSIZE), \
+                             _mm_xor_si128(m, b[j])); \
+        } \
+} while (0)
+
+static size_t _chacha_xor_sse2(uint32_t *state, const uint8_t *in,
+                               uint8_t *out, size_t len)
+{
+    size_t done = 0;
+
+    for (; len - done >= 4 * CHACHA_BLOCKSIZE; done += 4 * CHACHA_BLOCKSIZE) {
+        const __m128i ctr = _mm_set_epi32(3, 2, 1, 0);
+        CHACHA_LOAD(__m128i, SSE2_SET1, state);
+        x12 = _mm_add_epi32(x12, ctr);
+        CHACHA_ROUNDS(SSE2_ADD, SSE2_XOR, SSE2_ROTL);
+        __m128i x[16] = CHACHA_COLLECT;
+        for (unsigned i = 0; i < 16; i++) {
+            x[i] = _mm_add_epi32(x[i], SSE2_SET1(state[i]));
+        }
+        x[12] = _mm_add_epi32(x[12], ctr);
+        for (unsigned g = 0; g < 4; g++) {
+            SSE2_XOR4(in + done + 16 * g, out + done + 16 * g,
+                      x[4 * g], x[4 * g + 1], x[4 * g + 2], x[4 * g + 3]);
+        }
+        state[12] += 4;
+    }
+    return done;
+}
+
+#define AVX2_SET1(a)        _mm256_set1_epi32((int)(a))
+#define AVX2_ADD(a, b)      _mm256_add_epi32(a, b)
+#define AVX2_XOR(a, b)      _mm256_xor_si256(a, b)
+#define AVX2_ROTL(a, n) \
+    ((n) == 16 ? _mm256_shuffle_epi8(a, rot16) : \
+     (n) == 8 ? _mm256_shuffle_epi8(a, rot8) : \
+     _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - (n))))
+
+CHACHA_AVX2_TARGET static size_t _chacha_xor_avx2(uint32_t *state,
+                                                  const uint8_t *in,
+                                                  uint8_t *out, size_t len)
+{
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5,
+                                           10, 11, 8, 9, 14, 15, 12, 13,
+                                           2, 3, 0, 1, 6, 7, 4, 5,
+                                           10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6,
+                                          11, 8, 9, 10, 15, 12, 13, 14,
+                                          3, 0, 1, 2, 7, 4, 5, 6,
+                                          11, 8, 9, 10, 15, 12, 13, 14);
+    size_t done = 0;
+
+    for (; len - done >= 8 * CHACHA_BLOCKSIZE; done += 8 * CHACHA_BLOCKSIZE) {
+        const __m256i ctr = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        CHACHA_LOAD(__m256i, AVX2_SET1, state);
+        x12 = _mm256_add_epi32(x12, ctr);
+        CHACHA_ROUNDS(AVX2_ADD, AVX2_XOR, AVX2_ROTL);
+        __m256i x[16] = CHACHA_COLLECT;
+        for (unsigned i = 0; i < 16; i++) {
+            x[i] = _mm256_add_epi32(x[i], AVX2_SET1(state[i]));
+        }
+        x[12] = _mm256_add_epi32(x[12], ctr);
+        /* 8x8 word transposes, half h holds words 8h..8h+7 of each block */
+        for (unsigned h = 0; h < 2; h++) {
+            __m256i *v = &x[8 * h];
+            __m256i t[8], u[8];
+            for (unsigned i = 0; i < 4; i++) {
+                t[2 * i] = _mm256_unpacklo_epi32(v[2 * i], v[2 * i + 1]);
+                t[2 * i + 1] = _mm256_unpackhi_epi32(v[2 * i], v[2 * i + 1]);
+            }
+            for (unsigned i = 0; i < 2; i++) {
+                u[4 * i] = _mm256_unpacklo_epi64(t[4 * i], t[4 * i + 2]);
+                u[4 * i + 1] = _mm256_unpackhi_epi64(t[4 * i], t[4 * i + 2]);
+                u[4 * i + 2] = _mm256_unpacklo_epi64(t[4 * i + 1], t[4 * i + 3]);
+                u[4 * i + 3] = _mm256_unpackhi_epi64(t[4 * i + 1], t[4 * i + 3]);
+            }
+            for (unsigned b = 0; b < 4; b++) {
+                __m256i lo = _mm256_permute2x128_si256(u[b], u[b + 4], 0x20);
+                __m256i hi = _mm256_permute2x128_si256(u[b], u[b + 4], 0x31);
+                size_t off_lo = done + b * CHACHA_BLOCKSIZE + 32 * h;
+                size_t off_hi = off_lo + 4 * CHACHA_BLOCKSIZE;
+                __m256i m_lo = _mm256_loadu_si256((const __m256i *)(in + off_lo));
+                __m256i m_hi = _mm256_loadu_si256((const __m256i *)(in + off_hi));
+                _mm256_storeu_si256((__m256i *)(out + off_lo), _mm256_xor_si256(m_lo, lo));
+                _mm256_storeu_si256((__m256i *)(out + off_hi), _mm256_xor_si256(m_hi, hi));
+            }
+        }
+        state[12] += 8;
+    }
+    return done;
+}
+
+#define AVX512_SET1(a)      _mm512_set1_epi32((int)(a))
+#define AVX512_ADD(a, b)    _mm512_add_epi32(a, b)
+#define AVX512_XOR(a, b)    _mm512_xor_si512(a, b)
+#define AVX512_ROTL(a, n)   _mm512_rol_epi32(a, n)
+
+CHACHA_AVX512_TARGET static size_t _chacha_xor_avx512(uint32_t *state,
+                                                      const uint8_t *in,
+                                                      uint8_t *out,
+                                                      size_t len)
+{
+    size_t done = 0;
+
+    for (; len - done >= 16 * CHACHA_BLOCKSIZE; done += 16 * CHACHA_BLOCKSIZE) {
+        const __m512i ctr = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                              8, 9, 10, 11, 12, 13, 14, 15);
+        __m512i q[16];
+        CHACHA_LOAD(__m512i, AVX512_SET1, state);
+        x12 = _mm512_add_epi32(x12, ctr);
+        CHACHA_ROUNDS(AVX512_ADD, AVX512_XOR, AVX512_ROTL);
+        __m512i x[16] = CHACHA_COLLECT;
+        for (unsigned i = 0; i < 16; i++) {
+            x[i] = _mm512_add_epi32(x[i], AVX512_SET1(state[i]));
+        }
+        x[12] = _mm512_add_epi32(x[12], ctr);
+        /*
+         * Transpose four words at a time so that each 128 bit lane of
+         * q[4 * g + j] holds words 4g..4g+3 of blocks j, j+4, j+8, j+12
+         */
+        for (unsigned g = 0; g < 4; g++) {
+            __m512i *v = &x[4 * g];
+            __m512i t0 = _mm512_unpacklo_epi32(v[0], v[1]);
+            __m512i t1 = _mm512_unpackhi_epi32(v[0], v[1]);
+            __m512i t2 = _mm512_unpacklo_epi32(v[2], v[3]);
+            __m512i t3 = _mm512_unpackhi_epi32(v[2], v[3]);
+            q[4 * g] = _mm512_unpacklo_epi64(t0, t2);
+            q[4 * g + 1] = _mm512_unpackhi_epi64(t0, t2);
+            q[4 * g + 2] = _mm512_unpacklo_epi64(t1, t3);
+            q[4 * g + 3] = _mm512_unpackhi_epi64(t1, t3);
+        }
+        /* Then transpose the 128 bit lanes into full blocks */
+        for (unsigned j = 0; j < 4; j++) {
+            __m512i a = _mm512_shuffle_i32x4(q[j], q[4 + j], 0x88);
+            __m512i b = _mm512_shuffle_i32x4(q[j], q[4 + j], 0xdd);
+            __m512i c = _mm512_shuffle_i32x4(q[8 + j], q[12 + j], 0x88);
+            __m512i d = _mm512_shuffle_i32x4(q[8 + j], q[12 + j], 0xdd);
+            __m512i blk[4] = {
+                _mm512_shuffle_i32x4(a, c, 0x88),   /* block j */
+                _mm512_shuffle_i32x4(b, d, 0x88),   /* block j + 4 */
+                _mm512_shuffle_i32x4(a, c, 0xdd),   /* block j + 8 */
+                _mm512_shuffle_i32x4(b, d, 0xdd),   /* block j + 12 */
+            };
+            for (unsigned k = 0; k < 4; k++) {
+                size_t off = done + (j + 4 * k) * CHACHA_BLOCKSIZE;
+                __m512i m = _mm512_loadu_si512((const void *)(in + off));
+                _mm512_storeu_si512((void *)(out + off), _mm512_xor_si512(m, blk[k]));
+            }
+        }
+        state[12] += 16;
+    }
+    return done;
+}
+#endif /* CHACHAPOLY_X86 */
+
+#ifdef CHACHAPOLY_NEON
+#define NEON_ADD(a, b)      vaddq_u32(a, b)
+#define NEON_XOR(a, b)      veorq_u32(a, b)
+#define NEON_ROTL(a, n)     vsriq_n_u32(vshlq_n_u32(a, n), a, 32 - (n))
+
+static size_t _chacha_xor_neon(uint32_t *state, const uint8_t *in,
+                               uint8_t *out, size_t len)
+{
+    static const uint32_t offsets[4] = { 0, 1, 2, 3 };
+    size_t done = 0;
+
+    for (; len - done >= 4 * CHACHA_BLOCKSIZE; done += 4 * CHACHA_BLOCKSIZE) {
+        const uint32x4_t ctr = vld1q_u32(offsets);
+        CHACHA_LOAD(uint32x4_t, vdupq_n_u32, state);
+        x12 = vaddq_u32(x12, ctr);
+        CHACHA_ROUNDS(NEON_ADD, NEON_XOR, NEON_ROTL);
+        uint32x4_t x[16] = CHACHA_COLLECT;
+        for (unsigned i = 0; i < 16; i++) {
+            x[i] = vaddq_u32(x[i], vdupq_n_u32(state[i]));
+        }
+        x[12] = vaddq_u32(x[12], ctr);
+        for (unsigned g = 0; g < 4; g++) {
+            uint32x4x2_t t01 = vtrnq_u32(x[4 * g], x[4 * g + 1]);
+            uint32x4x2_t t23 = vtrnq_u32(x[4 * g + 2], x[4 * g + 3]);
+            uint32x4_t b[4] = {
+                vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])),
+                vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])),
+                vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])),
+                vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])),
+            };
+            for (unsigned j = 0; j < 4; j++) {
+                size_t off = done + j * CHACHA_BLOCKSIZE + 16 * g;
+                uint8x16_t m = vld1q_u8(in + off);
+                vst1q_u8(out + off, veorq_u8(m, vreinterpretq_u8_u32(b[j])));
+            }
+        }
+        state[12] += 4;
+    }
+    return done;
+}
+#endif /* CHACHAPOLY_NEON */
+
+static void _chacha_xor(_chachapoly_impl_t impl, uint32_t *state,
+                        const uint8_t *in, uint8_t *out, size_t len)
+{
+    size_t done = 0;
+
+#ifdef CHACHAPOLY_X86
+    if (impl >= CHACHAPOLY_AVX512) {
+        done += _chacha_xor_avx512(state, in, out, len);
+    }
+    if (impl >= CHACHAPOLY_AVX2) {
+        done += _chacha_xor_avx2(state, in + done, out + done, len - done);
+    }
+    done += _chacha_xor_sse2(state, in + done, out + done, len - done);
+#elif defined(CHACHAPOLY_NEON)
+    done += _chacha_xor_neon(state, in, out, len);
+#endif
+    (void)impl;
+    _chacha_xor_portable(state, in + done, out + done, len - done);
+}
+
+/*
+ * Poly1305
+ */
+
+/* h = h * r mod 2^130 - 5, with partially reduced 26 bit limbs */
+static void _poly1305_mul(uint32_t *h, const uint32_t *r)
+{
+    uint32_t s1 = r[1] * 5, s2 = r[2] * 5, s3 = r[3] * 5, s4 = r[4] * 5;
+    uint64_t d[5];
+    uint32_t c;
+
+    d[0] = (uint64_t)h[0] * r[0] + (uint64_t)h[1] * s4 + (uint64_t)h[2] * s3 +
+           (uint64_t)h[3] * s2 + (uint64_t)h[4] * s1;
+    d[1] = (uint64_t)h[0] * r[1] + (uint64_t)h[1] * r[0] + (uint64_t)h[2] * s4 +
+           (uint64_t)h[3] * s3 + (uint64_t)h[4] * s2;
+    d[2] = (uint64_t)h[0] * r[2] + (uint64_t)h[1] * r[1] + (uint64_t)h[2] * r[0] +
+           (uint64_t)h[3] * s4 + (uint64_t)h[4] * s3;
+    d[3] = (uint64_t)h[0] * r[3] + (uint64_t)h[1] * r[2] + (uint64_t)h[2] * r[1] +
+           (uint64_t)h[3] * r[0] + (uint64_t)h[4] * s4;
+    d[4] = (uint64_t)h[0] * r[4] + (uint64_t)h[1] * r[3] + (uint64_t)h[2] * r[2] +
+           (uint64_t)h[3] * r[1] + (uint64_t)h[4] * r[0];
+
+    c = (uint32_t)(d[0] >> 26); h[0] = (uint32_t)d[0] & POLY_MASK26;
+    d[1] += c; c = (uint32_t)(d[1] >> 26); h[1] = (uint32_t)d[1] & POLY_MASK26;
+    d[2] += c; c = (uint32_t)(d[2] >> 26); h[2] = (uint32_t)d[2] & POLY_MASK26;
+    d[3] += c; c = (uint32_t)(d[3] >> 26); h[3] = (uint32_t)d[3] & POLY_MASK26;
+    d[4] += c; c = (uint32_t)(d[4] >> 26); h[4] = (uint32_t)d[4] & POLY_MASK26;
+    h[0] += c * 5; c = h[0] >> 26; h[0] &= POLY_MASK26;
+    h[1] += c;
+}
+
+static void _poly1305_limbs(uint32_t *limbs, const uint8_t *block)
+{
+    limbs[0] = _load32_le(block) & POLY_MASK26;
+    limbs[1] = (_load32_le(block + 3) >> 2) & POLY_MASK26;
+    limbs[2] = (_load32_le(block + 6) >> 4) & POLY_MASK26;
+    limbs[3] = (_load32_le(block + 9) >> 6) & POLY_MASK26;
+    limbs[4] = (_load32_le(block + 12) >> 8) | (1U << 24);
+}
+
+static void _poly1305_init(_poly1305_t *ctx, const uint8_t *key,
+                           _chachapoly_impl_t impl)
+{
+    ctx->r[0] = _load32_le(key) & 0x3ffffff;
+    ctx->r[1] = (_load32_le(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (_load32_le(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (_load32_le(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (_load32_le(key + 12) >> 8) & 0x00fffff;
+    memset(ctx->h, 0, sizeof(ctx->h));
+    for (unsigned i = 0; i < 4; i++) {
+        ctx->pad[i] = _load32_le(key + 16 + 4 * i);
+    }
+    if (impl >= CHACHAPOLY_AVX2) {
+        memcpy(ctx->rpow[0], ctx->r, sizeof(ctx->r));
+        _poly1305_mul(ctx->rpow[0], ctx->r);
+        memcpy(ctx->rpow[1], ctx->rpow[0], sizeof(ctx->r));
+        _poly1305_mul(ctx->rpow[1], ctx->r);
+        memcpy(ctx->rpow[2], ctx->rpow[1], sizeof(ctx->r));
+        _poly1305_mul(ctx->rpow[2], ctx->r);
+    }
+}
+
+static void _poly1305_blocks(_poly1305_t *ctx, const uint8_t *m, size_t num)
+{
+    uint32_t limbs[5];
+
+    while (num--) {
+        _poly1305_limbs(limbs, m);
+        for (unsigned i = 0; i < 5; i++) {
+            ctx->h[i] += limbs[i];
+        }
+        _poly1305_mul(ctx->h, ctx->r);
+        m += POLY_BLOCKSIZE;
+    }
+}
+
+#ifdef CHACHAPOLY_X86
+/* Four lane multiply of h by r, followed by a partial carry */
+/* Four lane multiplication of h with r, s holding 5 * r */
+#define POLY_MUL_AVX2(h, r, s) do { \
+        __m256i d0, d1, d2, d3, d4, c; \
+        d0 = POLY_ADD5(POLY_MUL(h##0, r##0), POLY_MUL(h##1, s##4), POLY_MUL(h##2, s##3), \
+                       POLY_MUL(h##3, s##2), POLY_MUL(h##4, s##1)); \
+        d1 = POLY_ADD5(POLY_MUL(h##0, r##1), POLY_MUL(h##1, r##0), POLY_MUL(h##2, s##4), \
+                       POLY_MUL(h##3, s##3), POLY_MUL(h##4, s##2)); \
+        d2 = POLY_ADD5(POLY_MUL(h##0, r##2), POLY_MUL(h##1, r##1), POLY_MUL(h##2, r##0), \
+                       POLY_MUL(h##3, s##4), POLY_MUL(h##4, s##3)); \
+        d3 = POLY_ADD5(POLY_MUL(h##0, r##3), POLY_MUL(h##1, r##2), POLY_MUL(h##2, r##1), \
+                       POLY_MUL(h##3, r##0), POLY_MUL(h##4, s##4)); \
+        d4 = POLY_ADD5(POLY_MUL(h##0, r##4), POLY_MUL(h##1, r##3), POLY_MUL(h##2, r##2), \
+                       POLY_MUL(h##3, r##1), POLY_MUL(h##4, r##0)); \
+        c = _mm256_srli_epi64(d0, 26); h##0 = _mm256_and_si256(d0, mask); \
+        d1 = _mm256_add_epi64(d1, c); \
+        c = _mm256_srli_epi64(d1, 26); h##1 = _mm256_and_si256(d1, mask); \
+        d2 = _mm256_add_epi64(d2, c); \
+        c = _mm256_srli_epi64(d2, 26); h##2 = _mm256_and_si256(d2, mask); \
+        d3 = _mm256_add_epi64(d3, c); \
+        c = _mm256_srli_epi64(d3, 26); h##3 = _mm256_and_si256(d3, mask); \
+        d4 = _mm256_add_epi64(d4, c); \
+        c = _mm256_srli_epi64(d4, 26); h##4 = _mm256_and_si256(d4, mask); \
+        h##0 = _mm256_add_epi64(h##0, _mm256_add_epi64(c, _mm256_slli_epi64(c, 2))); \
+        c = _mm256_srli_epi64(h##0, 26); h##0 = _mm256_and_si256(h##0, mask); \
+        h##1 = _mm256_add_epi64(h##1, c); \
+} while (0)
+
+#define POLY_MUL(a, b) _mm256_mul_epu32(a, b)
+#define POLY_ADD5(a, b, c, d, e) \
+    _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(a, b), \
+                                      _mm256_add_epi64(c, d)), e)
+
+/* Split four blocks into limbs, lane j holding block j, and add them to h */
+#define POLY_LOAD4_AVX2(h, blocks) do { \
+        __m256i a = _mm256_loadu_si256((const __m256i *)(const void *)(blocks)); \
+        __m256i b = _mm256_loadu_si256((const __m256i *)(const void *)((blocks) + 32)); \
+        __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8); \
+        __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8); \
+        h##0 = _mm256_add_epi64(h##0, _mm256_and_si256(lo, mask)); \
+        h##1 = _mm256_add_epi64(h##1, _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask)); \
+        h##2 = _mm256_add_epi64(h##2, _mm256_and_si256( \
+                   _mm256_or_si256(_mm256_srli_epi64(lo, 52), \
+                                   _mm256_slli_epi64(hi, 12)), mask)); \
+        h##3 = _mm256_add_epi64(h##3, _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask)); \
+        h##4 = _mm256_add_epi64(h##4, _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit)); \
+} while (0)
+
+/*
+ * Process groups of four blocks, lane j accumulating blocks 4i + j. All
+ * but the last group are multiplied with r^4, the last one with
+ * r^4, r^3, r^2 and r, which leaves the sum of the lanes equal to the
+ * sequential result.
+ */
+CHACHA_AVX2_TARGET static size_t _poly1305_blocks_avx2(_poly1305_t *ctx,
+                                                       const uint8_t *m,
+                                                       size_t num)
+{
+    const __m256i mask = _mm256_set1_epi64x(POLY_MASK26);
+    const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+    const uint32_t *rp = ctx->rpow[2];
+    size_t groups = num / 4;
+
+    if (groups < 2) {
+        return 0;
+    }
+
+    __m256i h0 = _mm256_setr_epi64x(ctx->h[0], 0, 0, 0);
+    __m256i h1 = _mm256_setr_epi64x(ctx->h[1], 0, 0, 0);
+    __m256i h2 = _mm256_setr_epi64x(ctx->h[2], 0, 0, 0);
+    __m256i h3 = _mm256_setr_epi64x(ctx->h[3], 0, 0, 0);
+    __m256i h4 = _mm256_setr_epi64x(ctx->h[4], 0, 0, 0);
+    __m256i r0 = _mm256_set1_epi64x(rp[0]), r1 = _mm256_set1_epi64x(rp[1]);
+    __m256i r2 = _mm256_set1_epi64x(rp[2]), r3 = _mm256_set1_epi64x(rp[3]);
+    __m256i r4 = _mm256_set1_epi64x(rp[4]);
+    __m256i s1 = _mm256_set1_epi64x(rp[1] * 5), s2 = _mm256_set1_epi64x(rp[2] * 5);
+    __m256i s3 = _mm256_set1_epi64x(rp[3] * 5), s4 = _mm256_set1_epi64x(rp[4] * 5);
+
+    for (size_t i = 0; i + 1 < groups; i++) {
+        POLY_LOAD4_AVX2(h, m + i * 4 * POLY_BLOCKSIZE);
+        POLY_MUL_AVX2(h, r, s);
+    }
+
+    /* Final group with r^4, r^3, r^2, r */
+    POLY_LOAD4_AVX2(h, m + (groups - 1) * 4 * POLY_BLOCKSIZE);
+#define POLY_RPOW(k) _mm256_setr_epi64x(ctx->rpow[2][k], ctx->rpow[1][k], \
+                                        ctx->rpow[0][k], ctx->r[k])
+    r0 = POLY_RPOW(0); r1 = POLY_RPOW(1); r2 = POLY_RPOW(2);
+    r3 = POLY_RPOW(3); r4 = POLY_RPOW(4);
+#undef POLY_RPOW
+    s1 = _mm256_add_epi64(r1, _mm256_slli_epi64(r1, 2));
+    s2 = _mm256_add_epi64(r2, _mm256_slli_epi64(r2, 2));
+    s3 = _mm256_add_epi64(r3, _mm256_slli_epi64(r3, 2));
+    s4 = _mm256_add_epi64(r4, _mm256_slli_epi64(r4, 2));
+    POLY_MUL_AVX2(h, r, s);
+
+    /* Sum the lanes and carry */
+    __m256i v[5] = { h0, h1, h2, h3, h4 };
+    uint64_t d[5];
+    for (unsigned k = 0; k < 5; k++) {
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v[k]),
+                                    _mm256_extracti128_si256(v[k], 1));
+        d[k] = (uint64_t)_mm_cvtsi128_si64(sum) +
+               (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum));
+    }
+    for (unsigned k = 0; k < 4; k++) {
+        d[k + 1] += d[k] >> 26;
+        ctx->h[k] = (uint32_t)d[k] & POLY_MASK26;
+    }
+    ctx->h[4] = (uint32_t)d[4] & POLY_MASK26;
+    ctx->h[0] += (uint32_t)(d[4] >> 26) * 5;
+    ctx->h[1] += ctx->h[0] >> 26;
+    ctx->h[0] &= POLY_MASK26;
+    return groups * 4;
+}
+#undef POLY_MUL
+#undef POLY_ADD5
+#undef POLY_LOAD4_AVX2
+#undef POLY_MUL_AVX2
+#endif /* CHACHAPOLY_X86 */
+
+/* Authenticate data zero padded to a multiple of the block size */
+static void _poly1305_update(_poly1305_t *ctx, _chachapoly_impl_t impl,
+                             const uint8_t *m, size_t len)
+{
+    size_t num = len / POLY_BLOCKSIZE;
+    size_t done = 0;
+
+#ifdef CHACHAPOLY_X86
+    if (impl >= CHACHAPOLY_AVX2) {
+        done = _poly1305_blocks_avx2(ctx, m, num);
+    }
+#endif
+    (void)impl;
+    _poly1305_blocks(ctx, m + done * POLY_BLOCKSIZE, num - done);
+    if (len % POLY_BLOCKSIZE) {
+        uint8_t block[POLY_BLOCKSIZE] = { 0 };
+        memcpy(block, m + num * POLY_BLOCKSIZE, len % POLY_BLOCKSIZE);
+        _poly1305_blocks(ctx, block, 1);
+    }
+}
+
+static void _poly1305_finish(_poly1305_t *ctx, uint8_t *tag)
+{
+    uint32_t *h = ctx->h;
+    uint32_t g[5], c, mask;
+    uint64_t f;
+
+    /* Fully carry h */
+    c = h[1] >> 26; h[1] &= POLY_MASK26;
+    h[2] += c; c = h[2] >> 26; h[2] &= POLY_MASK26;
+    h[3] += c; c = h[3] >> 26; h[3] &= POLY_MASK26;
+    h[4] += c; c = h[4] >> 26; h[4] &= POLY_MASK26;
+    h[0] += c * 5; c = h[0] >> 26; h[0] &= POLY_MASK26;
+    h[1] += c;
+
+    /* g = h + -p, select h if negative */
+    g[0] = h[0] + 5; c = g[0] >> 26; g[0] &= POLY_MASK26;
+    g[1] = h[1] + c; c = g[1] >> 26; g[1] &= POLY_MASK26;
+    g[2] = h[2] + c; c = g[2] >> 26; g[2] &= POLY_MASK26;
+    g[3] = h[3] + c; c = g[3] >> 26; g[3] &= POLY_MASK26;
+    g[4] = h[4] + c - (1U << 26);
+    mask = (g[4] >> 31) - 1;
+    for (unsigned i = 0; i < 5; i++) {
+        h[i] = (h[i] & ~mask) | (g[i] & mask);
+    }
+
+    /* h = h + pad mod 2^128 */
+    uint32_t w[4] = {
+        h[0] | (h[1] << 26),
+        (h[1] >> 6) | (h[2] << 20),
+        (h[2] >> 12) | (h[3] << 14),
+        (h[3] >> 18) | (h[4] << 8),
+    };
+    f = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        f = (uint64_t)w[i] + ctx->pad[i] + (f >> 32);
+        _store32_le(tag + 4 * i, (uint32_t)f);
+    }
+    _memzero(ctx, sizeof(*ctx));
+}
+
+/*
+ * AEAD construction
+ */
+
+static _chachapoly_impl_t _impl(void)
+{
+#ifdef CHACHAPOLY_X86
+    static volatile int impl = -1;
+    if (impl < 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            impl = CHACHAPOLY_AVX512;
+        }
+        else if (__builtin_cpu_supports("avx2")) {
+            impl = CHACHAPOLY_AVX2;
+        }
+        else {
+            impl = CHACHAPOLY_SSE2;
+        }
+    }
+    return (_chachapoly_impl_t)impl;
+#elif defined(CHACHAPOLY_NEON)
+    return CHACHAPOLY_NEON_4WAY;
+#else
+    return CHACHAPOLY_PORTABLE;
+#endif
+}
+
+const char *cose_crypto_chachapoly_impl(void)
+{
+    static const char *const names[] = {
+        [CHACHAPOLY_PORTABLE] = "portable",
+        [CHACHAPOLY_SSE2] = "sse2",
+        [CHACHAPOLY_NEON_4WAY] = "neon",
+        [CHACHAPOLY_AVX2] = "avx2",
+        [CHACHAPOLY_AVX512] = "avx512",
+    };
+    return names[_impl()];
+}
+
+static void _chachapoly_setup(_chachapoly_impl_t impl, uint32_t *state,
+                              _poly1305_t *poly, const uint8_t *npub,
+                              const uint8_t *k, const uint8_t *aad,
+                              size_t aadlen)
+{
+    uint8_t otk[CHACHA_BLOCKSIZE];
+
+    /* Block 0 provides the one-time Poly1305 key, data starts at block 1 */
+    _chacha_init(state, k, npub, 0);
+    _chacha_block(state, otk);
+    _poly1305_init(poly, otk, impl);
+    _poly1305_update(poly, impl, aad, aadlen);
+    _memzero(otk, sizeof(otk));
+}
+
+static void _chachapoly_tag(_poly1305_t *poly, _chachapoly_impl_t impl,
+                            size_t aadlen, size_t msglen, uint8_t *tag)
+{
+    uint8_t lengths[POLY_BLOCKSIZE];
+
+    _store32_le(lengths, (uint32_t)aadlen);
+    _store32_le(lengths + 4, (uint32_t)((uint64_t)aadlen >> 32));
+    _store32_le(lengths + 8, (uint32_t)msglen);
+    _store32_le(lengths + 12, (uint32_t)((uint64_t)msglen >> 32));
+    _poly1305_update(poly, impl, lengths, sizeof(lengths));
+    _poly1305_finish(poly, tag);
+}
+
+static int _encrypt(_chachapoly_impl_t impl, uint8_t *c, size_t *clen,
+                    const uint8_t *msg, size_t msglen,
+                    const uint8_t *aad, size_t aadlen,
+                    const uint8_t *npub, const uint8_t *k)
+{
+    uint32_t state[16];
+    _poly1305_t poly;
+
+    if ((uint64_t)msglen > CHACHAPOLY_MAXLEN) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _chachapoly_setup(impl, state, &poly, npub, k, aad, aadlen);
+    /* Authenticate each chunk while it is still in the cache */
+    for (size_t pos = 0; pos < msglen; pos += CHACHAPOLY_CHUNK) {
+        size_t chunk = msglen - pos;
+        if (chunk > CHACHAPOLY_CHUNK) {
+            chunk = CHACHAPOLY_CHUNK;
+        }
+        _chacha_xor(impl, state, msg + pos, c + pos, chunk);
+        _poly1305_update(&poly, impl, c + pos, chunk);
+    }
+    _chachapoly_tag(&poly, impl, aadlen, msglen, c + msglen);
+    *clen = msglen + POLY_TAGSIZE;
+    _memzero(state, sizeof(state));
+    return COSE_OK;
+}
+
+static int _decrypt(_chachapoly_impl_t impl, uint8_t *msg, size_t *msglen,
+                    const uint8_t *c, size_t clen,
+                    const uint8_t *aad, size_t aadlen,
+                    const uint8_t *npub, const uint8_t *k)
+{
+    uint32_t state[16];
+    _poly1305_t poly;
+    uint8_t tag[POLY_TAGSIZE];
+    uint8_t diff = 0;
+
+    if (clen < POLY_TAGSIZE) {
+        return COSE_ERR_CRYPTO;
+    }
+    *msglen = clen - POLY_TAGSIZE;
+    if ((uint64_t)*msglen > CHACHAPOLY_MAXLEN) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    _chachapoly_setup(impl, state, &poly, npub, k, aad, aadlen);
+    _poly1305_update(&poly, impl, c, *msglen);
+    _chachapoly_tag(&poly, impl, aadlen, *msglen, tag);
+    for (size_t i = 0; i < POLY_TAGSIZE; i++) {
+        diff |= tag[i] ^ c[*msglen + i];
+    }
+    /* Only release plaintext after successful verification */
+    if (diff == 0) {
+        _chacha_xor(impl, state, c, msg, *msglen);
+    }
+    _memzero(state, sizeof(state));
+    return diff ? COSE_ERR_CRYPTO : COSE_OK;
+}
+
+#ifdef CRYPTO_CHACHAPOLY_INCLUDE_CHACHAPOLY
+int cose_crypto_aead_encrypt_chachapoly(uint8_t *c,
+                                        size_t *clen,
+                                        const uint8_t *msg,
+                                        size_t msglen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _encrypt(_impl(), c, clen, msg, msglen, aad, aadlen, npub, k);
+}
+
+int cose_crypto_aead_decrypt_chachapoly(uint8_t *msg,
+                                        size_t *msglen,
+                                        const uint8_t *c,
+                                        size_t clen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _decrypt(_impl(), msg, msglen, c, clen, aad, aadlen, npub, k);
+}
+
+COSE_ssize_t cose_crypto_keygen_chachapoly(uint8_t *sk, size_t len)
+{
+    if (len < CHACHA_KEYSIZE) {
+        return COSE_ERR_NOMEM;
+    }
+    if (cose_crypt_get_random(cose_crypt_rng_arg, sk, CHACHA_KEYSIZE)) {
+        return COSE_ERR_CRYPTO;
+    }
+    return (COSE_ssize_t)CHACHA_KEYSIZE;
+}
+
+size_t cose_crypto_aead_nonce_chachapoly(uint8_t *nonce, size_t len)
+{
+    if (len < CHACHA_NONCESIZE) {
+        return 0;
+    }
+    if (cose_crypt_get_random(cose_crypt_rng_arg, nonce, CHACHA_NONCESIZE)) {
+        return 0;
+    }
+    return CHACHA_NONCESIZE;
+}
+#endif /* CRYPTO_CHACHAPOLY_INCLUDE_CHACHAPOLY */
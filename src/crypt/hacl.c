@@ -106,12 +106,13 @@ int cose_crypto_verify_ed25519(const cose_key_t *key, const uint8_t *sign, size_
     return COSE_ERR_CRYPTO;
 }
 
-void cose_crypto_keypair_ed25519(cose_key_t *key)
+int cose_crypto_keypair_ed25519(cose_key_t *key)
 {
     uint8_t skey[COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES +
         COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES];
     crypto_sign_keypair(key->x, skey);
     memcpy(key->d, skey, COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES);
+    return COSE_OK;
 }
 
 size_t cose_crypto_sig_size_ed25519(void)
@@ -15,46 +15,64 @@
 #include "cose/intern.h"
 #include "cose/crypto.h"
 #include "cose/crypto/selectors.h"
+#include <mbedtls/ecdh.h>
 #include <mbedtls/ecp.h>
 #include <mbedtls/ecdsa.h>
 #include <mbedtls/gcm.h>
+#include <mbedtls/md.h>
+#ifdef HAVE_ALGO_RSA_PSS
+#include <mbedtls/rsa.h>
+#endif
 #include <mbedtls/sha256.h>
 #include <mbedtls/sha512.h>
 #include <mbedtls/version.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
 
 extern cose_crypt_rng cose_crypt_get_random;
 extern void *cose_crypt_rng_arg;
 
+#if defined(COSE_ECDSA_DETERMINISTIC) && !defined(MBEDTLS_ECDSA_DETERMINISTIC)
+#error "COSE_ECDSA_DETERMINISTIC requires MBEDTLS_ECDSA_DETERMINISTIC"
+#endif
+
+#if MBEDTLS_ECP_MAX_BYTES != COSE_CRYPTO_EC2_KEYBYTES
+#error "COSE_CRYPTO_EC2_KEYBYTES must match MBEDTLS_ECP_MAX_BYTES"
+#endif
+
+#if defined(HAVE_ALGO_RSA_PSS) && !defined(MBEDTLS_PKCS1_V21)
+#error "RSA-PSS requires MBEDTLS_PKCS1_V21, define COSE_CRYPTO_MBEDTLS_NO_RSA"
+#endif
+
+#ifdef CRYPTO_MBEDTLS_INCLUDE_AESGCM
 static size_t _key_bits(cose_algo_t algo)
 {
-    switch(algo) {
-        case COSE_ALGO_A128GCM:
-            return 8 * COSE_CRYPTO_AEAD_AES128GCM_KEYBYTES;
-        case COSE_ALGO_A192GCM:
-            return 8 * COSE_CRYPTO_AEAD_AES192GCM_KEYBYTES;
-        case COSE_ALGO_A256GCM:
-            return 8 * COSE_CRYPTO_AEAD_AES256GCM_KEYBYTES;
-        default:
-            return 0;
-    }
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    return desc ? 8 * (size_t)desc->key_len : 0;
+}
+#endif /* CRYPTO_MBEDTLS_INCLUDE_AESGCM */
+
+static cose_crypto_hash_t _algo_hash(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    return desc ? desc->hash : COSE_CRYPTO_HASH_NONE;
+}
+
+static mbedtls_md_type_t _translate_hash(cose_crypto_hash_t hash)
+{
+    static const mbedtls_md_type_t md[] = {
+        [COSE_CRYPTO_HASH_NONE] = MBEDTLS_MD_NONE,
+        [COSE_CRYPTO_HASH_SHA256] = MBEDTLS_MD_SHA256,
+        [COSE_CRYPTO_HASH_SHA384] = MBEDTLS_MD_SHA384,
+        [COSE_CRYPTO_HASH_SHA512] = MBEDTLS_MD_SHA512,
+    };
+    return md[hash];
 }
 
 static mbedtls_md_type_t _translate_md(cose_algo_t algo)
 {
-    switch(algo) {
-        case COSE_ALGO_ES256:
-            return MBEDTLS_MD_SHA256;
-        case COSE_ALGO_ES384:
-            return MBEDTLS_MD_SHA384;
-        case COSE_ALGO_ES512:
-            return MBEDTLS_MD_SHA512;
-        default:
-            return MBEDTLS_MD_NONE;
-    }
+    return _translate_hash(_algo_hash(algo));
 }
 
 static mbedtls_ecp_group_id _translate_curve(cose_curve_t algo)
@@ -94,11 +112,11 @@ static int _get_key_params(mbedtls_ecdsa_context *ctx, const cose_key_t *key)
     (void)len;
     mbedtls_ecp_point *pt = &ctx->Q;
     /* Construct key from cose_key_t */
-    mbedtls_mpi_read_binary( &pt->X, key->x, MBEDTLS_ECP_MAX_BYTES);
-    mbedtls_mpi_read_binary( &pt->Y, key->y, MBEDTLS_ECP_MAX_BYTES);
+    mbedtls_mpi_read_binary( &pt->X, key->x, COSE_CRYPTO_EC2_KEYBYTES);
+    mbedtls_mpi_read_binary( &pt->Y, key->y, COSE_CRYPTO_EC2_KEYBYTES);
     mbedtls_mpi_lset( &pt->Z, 1 );
     if (key->d) {
-        mbedtls_mpi_read_binary( &ctx->d, key->d, MBEDTLS_ECP_MAX_BYTES);
+        mbedtls_mpi_read_binary( &ctx->d, key->d, COSE_CRYPTO_EC2_KEYBYTES);
         if (mbedtls_ecp_check_privkey( &ctx->grp, &ctx->d ) != 0 ) {
             return COSE_ERR_INVALID_PARAM;
         }
@@ -115,8 +133,8 @@ static int _get_key_params(mbedtls_ecdsa_context *ctx, const cose_key_t *key)
 size_t _hash(cose_algo_t algo, const uint8_t *msg, size_t msglen, uint8_t *hash)
 {
     /* Algo determines hash function, curve determines ECDSA curve */
-    switch(algo) {
-        case COSE_ALGO_ES256:
+    switch(_algo_hash(algo)) {
+        case COSE_CRYPTO_HASH_SHA256:
             {
                 mbedtls_sha256_context ctx;
                 mbedtls_sha256_init(&ctx);
@@ -132,7 +150,7 @@ size_t _hash(cose_algo_t algo, const uint8_t *msg, size_t msglen, uint8_t *hash)
                 return 32;
                 break;
             }
-        case COSE_ALGO_ES384:
+        case COSE_CRYPTO_HASH_SHA384:
             {
                 mbedtls_sha512_context ctx;
                 mbedtls_sha512_init(&ctx);
@@ -148,7 +166,7 @@ size_t _hash(cose_algo_t algo, const uint8_t *msg, size_t msglen, uint8_t *hash)
                 return 48;
                 break;
             }
-        case COSE_ALGO_ES512:
+        case COSE_CRYPTO_HASH_SHA512:
             {
                 mbedtls_sha512_context ctx;
                 mbedtls_sha512_init(&ctx);
@@ -169,37 +187,20 @@ size_t _hash(cose_algo_t algo, const uint8_t *msg, size_t msglen, uint8_t *hash)
     }
 }
 
+#ifdef CRYPTO_MBEDTLS_INCLUDE_AESGCM
 COSE_ssize_t cose_crypto_keygen_aesgcm(uint8_t *buf, size_t len, cose_algo_t algo)
 {
-    (void)len;
-    switch(algo) {
-        case COSE_ALGO_A128GCM:
-            if (len < COSE_CRYPTO_AEAD_AES128GCM_KEYBYTES) {
-                return COSE_ERR_NOMEM;
-            }
-            if (!cose_crypt_get_random(cose_crypt_rng_arg, buf, COSE_CRYPTO_AEAD_AES128GCM_KEYBYTES)) {
-                return COSE_CRYPTO_AEAD_AES128GCM_KEYBYTES;
-            }
-            return COSE_ERR_CRYPTO;
-        case COSE_ALGO_A192GCM:
-            if (len < COSE_CRYPTO_AEAD_AES192GCM_KEYBYTES) {
-                return COSE_ERR_NOMEM;
-            }
-            if (!cose_crypt_get_random(cose_crypt_rng_arg, buf, COSE_CRYPTO_AEAD_AES192GCM_KEYBYTES)) {
-                return COSE_CRYPTO_AEAD_AES192GCM_KEYBYTES;
-            }
-            return COSE_ERR_CRYPTO;
-        case COSE_ALGO_A256GCM:
-            if (len < COSE_CRYPTO_AEAD_AES256GCM_KEYBYTES) {
-                return COSE_ERR_NOMEM;
-            }
-            if (!cose_crypt_get_random(cose_crypt_rng_arg, buf, COSE_CRYPTO_AEAD_AES256GCM_KEYBYTES)) {
-                return COSE_CRYPTO_AEAD_AES256GCM_KEYBYTES;
-            }
-            return COSE_ERR_CRYPTO;
-        default:
-            return COSE_ERR_NOTIMPLEMENTED;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
     }
+    if (!cose_crypt_get_random(cose_crypt_rng_arg, buf, desc->key_len)) {
+        return desc->key_len;
+    }
+    return COSE_ERR_CRYPTO;
 }
 
 int cose_crypto_aead_encrypt_aesgcm(uint8_t *c,
@@ -255,8 +256,7 @@ int cose_crypto_aead_decrypt_aesgcm(uint8_t *msg,
     return res ? COSE_ERR_CRYPTO : COSE_OK;
 
 }
-
-
+#endif /* CRYPTO_MBEDTLS_INCLUDE_AESGCM */
 
 size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
 {
@@ -264,18 +264,21 @@ size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
     return MBEDTLS_ECDSA_MAX_LEN;
 }
 
-void cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
+int cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
 {
     mbedtls_ecdsa_context ctx;
     mbedtls_ecdsa_init(&ctx);
     if (mbedtls_ecp_gen_key(_translate_curve(curve), &ctx, cose_crypt_get_random, cose_crypt_rng_arg) != 0) {
-        assert(false);
+        mbedtls_ecdsa_free(&ctx);
+        return COSE_ERR_CRYPTO;
     }
 
-    mbedtls_mpi_write_binary(&ctx.Q.X, key->x, MBEDTLS_ECP_MAX_BYTES);
-    mbedtls_mpi_write_binary(&ctx.Q.Y, key->y, MBEDTLS_ECP_MAX_BYTES);
-    mbedtls_mpi_write_binary( &ctx.d, key->d, MBEDTLS_ECP_MAX_BYTES);
+    mbedtls_mpi_write_binary(&ctx.Q.X, key->x, COSE_CRYPTO_EC2_KEYBYTES);
+    mbedtls_mpi_write_binary(&ctx.Q.Y, key->y, COSE_CRYPTO_EC2_KEYBYTES);
+    mbedtls_mpi_write_binary( &ctx.d, key->d, COSE_CRYPTO_EC2_KEYBYTES);
+    mbedtls_ecdsa_free(&ctx);
     key->crv = curve;
+    return COSE_OK;
 }
 
 int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg,  size_t msglen)
@@ -294,7 +297,20 @@ int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen
         return COSE_ERR_INVALID_PARAM;
     }
 
-    if ( mbedtls_ecdsa_write_signature(&ctx, _translate_md(key->algo), hash, hashlen, (unsigned char *)sign, signlen, NULL, NULL) != 0) {
+#ifdef COSE_ECDSA_DETERMINISTIC
+    /* RFC 6979 nonce, without an RNG mbedtls blinds with its HMAC-DRBG */
+    int res = mbedtls_ecdsa_write_signature(&ctx, _translate_md(key->algo),
+                                            hash, hashlen,
+                                            (unsigned char *)sign, signlen,
+                                            NULL, NULL);
+#else
+    int res = mbedtls_ecdsa_write_signature(&ctx, _translate_md(key->algo),
+                                            hash, hashlen,
+                                            (unsigned char *)sign, signlen,
+                                            cose_crypt_get_random,
+                                            cose_crypt_rng_arg);
+#endif
+    if (res != 0) {
         return COSE_ERR_CRYPTO;
     }
     return COSE_OK;
@@ -321,3 +337,253 @@ int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t
     }
     return COSE_OK;
 }
+
+#ifdef HAVE_ALGO_RSA_PSS
+static int _rsa_init(mbedtls_rsa_context *rsa, const cose_key_t *key)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+
+    if (!desc || desc->kty != COSE_KTY_RSA) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    /* RFC 8230: MGF1 with the hash of the algorithm */
+#if MBEDTLS_VERSION_MAJOR >= 3
+    mbedtls_rsa_init(rsa);
+    if (mbedtls_rsa_set_padding(rsa, MBEDTLS_RSA_PKCS_V21,
+                                _translate_hash(desc->hash)) != 0) {
+        mbedtls_rsa_free(rsa);
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+#else
+    mbedtls_rsa_init(rsa, MBEDTLS_RSA_PKCS_V21, _translate_hash(desc->hash));
+#endif
+    return COSE_OK;
+}
+
+static int _rsa_finish(cose_key_t *key, mbedtls_rsa_context *rsa)
+{
+    uint8_t buf[COSE_CRYPTO_SIGN_RSA_MAXBYTES];
+    size_t len = mbedtls_rsa_get_len(rsa);
+
+    if (len < COSE_CRYPTO_SIGN_RSA_MINBYTES ||
+            len > COSE_CRYPTO_SIGN_RSA_MAXBYTES) {
+        mbedtls_rsa_free(rsa);
+        return COSE_ERR_INVALID_PARAM;
+    }
+    /* The first public operation caches R^2 mod N in the context, run it
+     * here so that verifications only read the context */
+    memset(buf, 0, len);
+    buf[len - 1] = 1;
+    if (mbedtls_rsa_public(rsa, buf, buf) != 0) {
+        mbedtls_rsa_free(rsa);
+        return COSE_ERR_INVALID_PARAM;
+    }
+    key->kty = COSE_KTY_RSA;
+    key->rsa = rsa;
+    return COSE_OK;
+}
+
+int cose_crypto_mbedtls_rsa_prepare(cose_key_t *key,
+                                    mbedtls_rsa_context *rsa,
+                                    const uint8_t *n, size_t n_len,
+                                    const uint8_t *e, size_t e_len,
+                                    const uint8_t *d, size_t d_len)
+{
+    int res = _rsa_init(rsa, key);
+
+    if (res != COSE_OK) {
+        return res;
+    }
+    if (!d) {
+        d_len = 0;
+    }
+    /* mbedtls derives the primes and the CRT parameters from N, E and D */
+    if (mbedtls_rsa_import_raw(rsa, n, n_len, NULL, 0, NULL, 0,
+                               d, d_len, e, e_len) != 0 ||
+            mbedtls_rsa_complete(rsa) != 0 ||
+            (d ? mbedtls_rsa_check_privkey(rsa) :
+                 mbedtls_rsa_check_pubkey(rsa)) != 0) {
+        mbedtls_rsa_free(rsa);
+        return COSE_ERR_INVALID_PARAM;
+    }
+    return _rsa_finish(key, rsa);
+}
+
+int cose_crypto_mbedtls_rsa_generate(cose_key_t *key,
+                                     mbedtls_rsa_context *rsa, unsigned bits)
+{
+    int res = COSE_OK;
+
+    if (bits < 8 * COSE_CRYPTO_SIGN_RSA_MINBYTES ||
+            bits > 8 * COSE_CRYPTO_SIGN_RSA_MAXBYTES) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    res = _rsa_init(rsa, key);
+    if (res != COSE_OK) {
+        return res;
+    }
+    if (mbedtls_rsa_gen_key(rsa, cose_crypt_get_random, cose_crypt_rng_arg,
+                            bits, 65537) != 0) {
+        mbedtls_rsa_free(rsa);
+        return COSE_ERR_CRYPTO;
+    }
+    return _rsa_finish(key, rsa);
+}
+
+void cose_crypto_mbedtls_rsa_release(cose_key_t *key)
+{
+    if (key->rsa) {
+        mbedtls_rsa_free(key->rsa);
+        key->rsa = NULL;
+    }
+}
+
+size_t cose_crypto_sig_size_rsa(const cose_key_t *key)
+{
+    return key->rsa ? mbedtls_rsa_get_len(key->rsa) : 0;
+}
+
+int cose_crypto_sign_rsa_pss(const cose_key_t *key, uint8_t *sign,
+                             size_t *signlen, uint8_t *msg, size_t msglen)
+{
+    unsigned char hash[64];
+    size_t hashlen = 0;
+    int res = 0;
+
+    if (!key->rsa) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    hashlen = _hash(key->algo, msg, msglen, hash);
+    if (hashlen == 0) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    /* Salt length equal to the hash length as required by RFC 8230 */
+#if MBEDTLS_VERSION_MAJOR >= 3
+    res = mbedtls_rsa_rsassa_pss_sign_ext(key->rsa, cose_crypt_get_random,
+                                          cose_crypt_rng_arg,
+                                          _translate_md(key->algo),
+                                          (unsigned)hashlen, hash,
+                                          (int)hashlen, sign);
+#else
+    res = mbedtls_rsa_rsassa_pss_sign(key->rsa, cose_crypt_get_random,
+                                      cose_crypt_rng_arg, MBEDTLS_RSA_PRIVATE,
+                                      _translate_md(key->algo),
+                                      (unsigned)hashlen, hash, sign);
+#endif
+    if (res != 0) {
+        return COSE_ERR_CRYPTO;
+    }
+    *signlen = mbedtls_rsa_get_len(key->rsa);
+    return COSE_OK;
+}
+
+int cose_crypto_verify_rsa_pss(const cose_key_t *key, const uint8_t *sign,
+                               size_t signlen, uint8_t *msg, size_t msglen)
+{
+    unsigned char hash[64];
+    size_t hashlen = 0;
+    int res = 0;
+
+    if (!key->rsa) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    if (signlen != mbedtls_rsa_get_len(key->rsa)) {
+        return COSE_ERR_CRYPTO;
+    }
+    hashlen = _hash(key->algo, msg, msglen, hash);
+    if (hashlen == 0) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+#if MBEDTLS_VERSION_MAJOR >= 3
+    res = mbedtls_rsa_rsassa_pss_verify_ext(key->rsa, _translate_md(key->algo),
+                                            (unsigned)hashlen, hash,
+                                            _translate_md(key->algo),
+                                            (int)hashlen, sign);
+#else
+    res = mbedtls_rsa_rsassa_pss_verify_ext(key->rsa, NULL, NULL,
+                                            MBEDTLS_RSA_PUBLIC,
+                                            _translate_md(key->algo),
+                                            (unsigned)hashlen, hash,
+                                            _translate_md(key->algo),
+                                            (int)hashlen, sign);
+#endif
+    return res == 0 ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif /* HAVE_ALGO_RSA_PSS */
+
+#ifdef CRYPTO_MBEDTLS_INCLUDE_HMAC
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac)
+{
+    const mbedtls_md_info_t *info =
+        mbedtls_md_info_from_type(_translate_hash(hash));
+    mbedtls_md_context_t ctx;
+    int res = 0;
+
+    if (hash == COSE_CRYPTO_HASH_NONE || !info) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    mbedtls_md_init(&ctx);
+    res = mbedtls_md_setup(&ctx, info, 1);
+    if (res == 0) {
+        res = mbedtls_md_hmac_starts(&ctx, key, key_len);
+    }
+    for (size_t i = 0; i < num && res == 0; i++) {
+        res = mbedtls_md_hmac_update(&ctx, msg[i].buf, msg[i].len);
+    }
+    if (res == 0) {
+        res = mbedtls_md_hmac_finish(&ctx, mac);
+    }
+    mbedtls_md_free(&ctx);
+    return res == 0 ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif /* CRYPTO_MBEDTLS_INCLUDE_HMAC */
+
+#ifdef CRYPTO_MBEDTLS_INCLUDE_ECDH
+static size_t _curve_len(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P256:
+            return 32;
+        case COSE_EC_CURVE_P384:
+            return 48;
+        case COSE_EC_CURVE_P521:
+            return 66;
+        default:
+            return 0;
+    }
+}
+
+int cose_crypto_ecdh_ecp(const cose_key_t *key, const cose_key_t *peer,
+                         uint8_t *secret, size_t *secret_len)
+{
+    mbedtls_ecdsa_context ours;
+    mbedtls_ecdsa_context theirs;
+    mbedtls_mpi z;
+    size_t len = _curve_len(key->crv);
+    int res = COSE_ERR_INVALID_PARAM;
+
+    if (!key->d) {
+        return res;
+    }
+    mbedtls_ecdsa_init(&ours);
+    mbedtls_ecdsa_init(&theirs);
+    mbedtls_mpi_init(&z);
+    if (_get_key_params(&ours, key) == COSE_OK &&
+            _get_key_params(&theirs, peer) == COSE_OK) {
+        res = COSE_ERR_CRYPTO;
+        if (mbedtls_ecdh_compute_shared(&ours.grp, &z, &theirs.Q, &ours.d,
+                                        cose_crypt_get_random,
+                                        cose_crypt_rng_arg) == 0 &&
+                mbedtls_mpi_write_binary(&z, secret, len) == 0) {
+            *secret_len = len;
+            res = COSE_OK;
+        }
+    }
+    mbedtls_mpi_free(&z);
+    mbedtls_ecdsa_free(&theirs);
+    mbedtls_ecdsa_free(&ours);
+    return res;
+}
+#endif /* CRYPTO_MBEDTLS_INCLUDE_ECDH */
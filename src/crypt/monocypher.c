@@ -135,11 +135,12 @@ static void _ed25519_clamp(uint8_t *key)
     key[31] |= 0x40;
 }
 
-void cose_crypto_keypair_ed25519(cose_key_t *key)
+int cose_crypto_keypair_ed25519(cose_key_t *key)
 {
     randombytes(key->d, COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES);
     _ed25519_clamp(key->d);
     crypto_ed25519_public_key(key->x, key->d);
+    return COSE_OK;
 }
 
 size_t cose_crypto_sig_size_ed25519(void)
@@ -0,0 +1,833 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Glue layer between libcose and OpenSSL 3
+ */
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+#include <openssl/rand.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if OPENSSL_VERSION_MAJOR < 3
+#error "The OpenSSL backend requires OpenSSL 3"
+#endif
+
+#if defined(COSE_ECDSA_DETERMINISTIC) && \
+    !defined(OSSL_SIGNATURE_PARAM_NONCE_TYPE)
+#error "COSE_ECDSA_DETERMINISTIC requires OpenSSL 3.2 or newer"
+#endif
+
+/* Uncompressed EC point, 0x04 || x || y */
+#define OPENSSL_EC_POINT_MAXBYTES   (1 + 2 * COSE_CRYPTO_EC2_KEYBYTES)
+/* DER encoded ECDSA signature, two integers in a sequence */
+#define OPENSSL_ECDSA_DER_MAXBYTES  (2 * COSE_CRYPTO_EC2_KEYBYTES + 16)
+
+typedef struct {
+    const uint8_t *k;       /* Raw key pointer the AEAD functions receive */
+    cose_algo_t algo;
+    EVP_CIPHER_CTX *ctx;    /* Cipher context with the expanded key */
+    atomic_bool busy;       /* Context in use by an operation */
+} _openssl_symm_t;
+
+/* Prepared symmetric keys, modified by prepare/release only */
+static _openssl_symm_t _symm[COSE_CRYPTO_OPENSSL_SYMM_KEYS];
+
+/* Algorithms fetched once from the default library context */
+static struct {
+    EVP_CIPHER *chachapoly;
+    EVP_CIPHER *gcm[3];
+    EVP_CIPHER *ccm[2];
+    EVP_MD *md[COSE_CRYPTO_HASH_SHA512 + 1];
+    EVP_MAC *hmac;
+} _evp;
+
+static CRYPTO_ONCE _evp_once = CRYPTO_ONCE_STATIC_INIT;
+
+static void _evp_fetch(void)
+{
+    _evp.chachapoly = EVP_CIPHER_fetch(NULL, "ChaCha20-Poly1305", NULL);
+    _evp.gcm[0] = EVP_CIPHER_fetch(NULL, "AES-128-GCM", NULL);
+    _evp.gcm[1] = EVP_CIPHER_fetch(NULL, "AES-192-GCM", NULL);
+    _evp.gcm[2] = EVP_CIPHER_fetch(NULL, "AES-256-GCM", NULL);
+    _evp.ccm[0] = EVP_CIPHER_fetch(NULL, "AES-128-CCM", NULL);
+    _evp.ccm[1] = EVP_CIPHER_fetch(NULL, "AES-256-CCM", NULL);
+    _evp.md[COSE_CRYPTO_HASH_SHA256] = EVP_MD_fetch(NULL, "SHA256", NULL);
+    _evp.md[COSE_CRYPTO_HASH_SHA384] = EVP_MD_fetch(NULL, "SHA384", NULL);
+    _evp.md[COSE_CRYPTO_HASH_SHA512] = EVP_MD_fetch(NULL, "SHA512", NULL);
+    _evp.hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+}
+
+static void _init(void)
+{
+    CRYPTO_THREAD_run_once(&_evp_once, _evp_fetch);
+}
+
+static size_t _curve_len(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P256:
+        case COSE_EC_CURVE_X25519:
+        case COSE_EC_CURVE_ED25519:
+            return 32;
+        case COSE_EC_CURVE_P384:
+            return 48;
+        case COSE_EC_CURVE_P521:
+            return 66;
+        default:
+            return 0;
+    }
+}
+
+static const char *_curve_name(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P256:
+            return "prime256v1";
+        case COSE_EC_CURVE_P384:
+            return "secp384r1";
+        case COSE_EC_CURVE_P521:
+            return "secp521r1";
+        default:
+            return NULL;
+    }
+}
+
+static const EVP_CIPHER *_cipher(const cose_crypto_algo_t *desc)
+{
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return NULL;
+    }
+    _init();
+    switch (desc->algo) {
+        case COSE_ALGO_CHACHA20POLY1305:
+            return _evp.chachapoly;
+        case COSE_ALGO_A128GCM:
+            return _evp.gcm[0];
+        case COSE_ALGO_A192GCM:
+            return _evp.gcm[1];
+        case COSE_ALGO_A256GCM:
+            return _evp.gcm[2];
+        default:
+            return _evp.ccm[desc->key_len == 16 ? 0 : 1];
+    }
+}
+
+static EVP_PKEY *_pkey_new_ec(const cose_key_t *key, bool priv)
+{
+    uint8_t point[OPENSSL_EC_POINT_MAXBYTES];
+    size_t clen = _curve_len(key->crv);
+    size_t pad = COSE_CRYPTO_EC2_KEYBYTES - clen;
+    OSSL_PARAM_BLD *bld = OSSL_PARAM_BLD_new();
+    OSSL_PARAM *params = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    BIGNUM *d = NULL;
+    int ok = bld != NULL;
+
+    if (ok) {
+        ok = OSSL_PARAM_BLD_push_utf8_string(bld, OSSL_PKEY_PARAM_GROUP_NAME,
+                                             _curve_name(key->crv), 0);
+    }
+    if (ok && key->x && key->y) {
+        point[0] = 0x04;
+        memcpy(point + 1, key->x + pad, clen);
+        memcpy(point + 1 + clen, key->y + pad, clen);
+        ok = OSSL_PARAM_BLD_push_octet_string(bld, OSSL_PKEY_PARAM_PUB_KEY,
+                                              point, 1 + 2 * clen);
+    }
+    else if (!priv) {
+        ok = 0;
+    }
+    if (ok && priv) {
+        d = BN_secure_new();
+        ok = d && BN_bin2bn(key->d + pad, (int)clen, d) &&
+             OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_PRIV_KEY, d);
+    }
+    if (ok) {
+        params = OSSL_PARAM_BLD_to_param(bld);
+        ctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+        ok = params && ctx && EVP_PKEY_fromdata_init(ctx) == 1;
+    }
+    if (ok) {
+        EVP_PKEY_fromdata(ctx, &pkey,
+                          priv ? EVP_PKEY_KEYPAIR : EVP_PKEY_PUBLIC_KEY,
+                          params);
+    }
+    EVP_PKEY_CTX_free(ctx);
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+    BN_clear_free(d);
+    return pkey;
+}
+
+/* Construct the EVP_PKEY from the private or public part of a key */
+static EVP_PKEY *_pkey_new(const cose_key_t *key, bool priv)
+{
+    if (priv && !key->d) {
+        return NULL;
+    }
+    if (_curve_name(key->crv)) {
+        return _pkey_new_ec(key, priv);
+    }
+    if (key->crv == COSE_EC_CURVE_X25519 || key->crv == COSE_EC_CURVE_ED25519) {
+        int type = key->crv == COSE_EC_CURVE_X25519 ? EVP_PKEY_X25519 :
+            EVP_PKEY_ED25519;
+        if (priv) {
+            return EVP_PKEY_new_raw_private_key(type, NULL, key->d, 32);
+        }
+        return key->x ? EVP_PKEY_new_raw_public_key(type, NULL, key->x, 32) :
+            NULL;
+    }
+    return NULL;
+}
+
+/* Prepared key when available, constructed for this operation otherwise */
+static EVP_PKEY *_pkey(const cose_key_t *key, bool priv, bool *tmp)
+{
+    *tmp = key->evp_pkey == NULL;
+    return *tmp ? _pkey_new(key, priv) : key->evp_pkey;
+}
+
+static void _pkey_done(EVP_PKEY *pkey, bool tmp)
+{
+    if (tmp) {
+        EVP_PKEY_free(pkey);
+    }
+}
+
+static int _symm_prepare(const cose_key_t *key)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+    const EVP_CIPHER *cipher = _cipher(desc);
+    _openssl_symm_t *slot = NULL;
+    EVP_CIPHER_CTX *ctx = NULL;
+    bool ccm = false;
+    int ok = 0;
+
+    if (!cipher) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!key->d) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < COSE_CRYPTO_OPENSSL_SYMM_KEYS && !slot; i++) {
+        if (_symm[i].k == key->d) {
+            slot = &_symm[i];
+        }
+    }
+    for (size_t i = 0; i < COSE_CRYPTO_OPENSSL_SYMM_KEYS && !slot; i++) {
+        if (!_symm[i].k) {
+            slot = &_symm[i];
+        }
+    }
+    if (!slot) {
+        return COSE_ERR_NOMEM;
+    }
+
+    /* The CCM parameters are fixed when the key is expanded */
+    ccm = EVP_CIPHER_get_mode(cipher) == EVP_CIPH_CCM_MODE;
+    ctx = EVP_CIPHER_CTX_new();
+    ok = ctx && EVP_CipherInit_ex2(ctx, cipher, NULL, NULL, 1, NULL) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                             (int)desc->nonce_len, NULL) == 1;
+    if (ok && ccm) {
+        ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                 (int)desc->tag_len, NULL) == 1;
+    }
+    ok = ok && EVP_CipherInit_ex2(ctx, NULL, key->d, NULL, 1, NULL) == 1;
+    if (!ok) {
+        EVP_CIPHER_CTX_free(ctx);
+        return COSE_ERR_CRYPTO;
+    }
+    EVP_CIPHER_CTX_free(slot->ctx);
+    slot->ctx = ctx;
+    slot->k = key->d;
+    slot->algo = key->algo;
+    atomic_store(&slot->busy, false);
+    return COSE_OK;
+}
+
+int cose_crypto_openssl_prepare(cose_key_t *key)
+{
+    EVP_PKEY *pkey = NULL;
+
+    _init();
+    if (key->kty == COSE_KTY_SYMM) {
+        return _symm_prepare(key);
+    }
+    if (!_curve_len(key->crv)) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    pkey = _pkey_new(key, key->d != NULL);
+    if (!pkey) {
+        return COSE_ERR_CRYPTO;
+    }
+    EVP_PKEY_free(key->evp_pkey);
+    key->evp_pkey = pkey;
+    return COSE_OK;
+}
+
+void cose_crypto_openssl_release(cose_key_t *key)
+{
+    if (key->kty == COSE_KTY_SYMM) {
+        for (size_t i = 0; i < COSE_CRYPTO_OPENSSL_SYMM_KEYS; i++) {
+            if (key->d && _symm[i].k == key->d) {
+                EVP_CIPHER_CTX_free(_symm[i].ctx);
+                _symm[i].ctx = NULL;
+                _symm[i].k = NULL;
+            }
+        }
+    }
+    EVP_PKEY_free(key->evp_pkey);
+    key->evp_pkey = NULL;
+}
+
+#if defined(CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY) || \
+    defined(CRYPTO_OPENSSL_INCLUDE_AESGCM) || \
+    defined(CRYPTO_OPENSSL_INCLUDE_AESCCM)
+static _openssl_symm_t *_symm_acquire(const uint8_t *k, cose_algo_t algo)
+{
+    for (size_t i = 0; i < COSE_CRYPTO_OPENSSL_SYMM_KEYS; i++) {
+        _openssl_symm_t *slot = &_symm[i];
+        if (slot->k == k && slot->algo == algo && slot->ctx) {
+            /* Busy with another operation, use a temporary context */
+            return atomic_exchange(&slot->busy, true) ? NULL : slot;
+        }
+    }
+    return NULL;
+}
+
+static int _aead(int enc, uint8_t *out, size_t *out_len,
+                 const uint8_t *in, size_t in_len,
+                 const uint8_t *aad, size_t aadlen,
+                 const uint8_t *npub, const uint8_t *k, cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    const EVP_CIPHER *cipher = _cipher(desc);
+    _openssl_symm_t *slot = NULL;
+    EVP_CIPHER_CTX *ctx = NULL;
+    size_t len = 0;
+    int outl = 0;
+    int finl = 0;
+    int ok = 0;
+
+    if (!cipher) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!enc && in_len < desc->tag_len) {
+        return COSE_ERR_CRYPTO;
+    }
+    len = enc ? in_len : in_len - desc->tag_len;
+    if (len > INT_MAX || aadlen > INT_MAX) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    bool ccm = EVP_CIPHER_get_mode(cipher) == EVP_CIPH_CCM_MODE;
+    const uint8_t *tag = in + len;
+
+    slot = _symm_acquire(k, algo);
+    ctx = slot ? slot->ctx : EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return COSE_ERR_NOMEM;
+    }
+    /* A prepared context keeps its expanded key, only the nonce is set */
+    ok = EVP_CipherInit_ex2(ctx, slot ? NULL : cipher, NULL, NULL, enc,
+                            NULL) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                             (int)desc->nonce_len, NULL) == 1;
+    if (ok && ccm) {
+        ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                 (int)desc->tag_len,
+                                 enc ? NULL : (void *)tag) == 1;
+    }
+    ok = ok && EVP_CipherInit_ex2(ctx, NULL, slot ? NULL : k, npub, enc,
+                                  NULL) == 1;
+    if (ok && ccm) {
+        ok = EVP_CipherUpdate(ctx, NULL, &outl, NULL, (int)len) == 1;
+    }
+    if (ok && aadlen) {
+        ok = EVP_CipherUpdate(ctx, NULL, &outl, aad, (int)aadlen) == 1;
+    }
+    ok = ok && EVP_CipherUpdate(ctx, out, &outl, in, (int)len) == 1;
+    if (ok && !enc && !ccm) {
+        ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                 (int)desc->tag_len, (void *)tag) == 1;
+    }
+    if (ok && !ccm) {
+        ok = EVP_CipherFinal_ex(ctx, out + outl, &finl) == 1;
+    }
+    if (ok && enc) {
+        ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,
+                                 (int)desc->tag_len, out + len) == 1;
+    }
+
+    if (slot) {
+        atomic_store(&slot->busy, false);
+    }
+    else {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+    *out_len = enc ? len + desc->tag_len : len;
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif
+
+#if defined(CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY) || \
+    defined(CRYPTO_OPENSSL_INCLUDE_AESGCM)
+static int _random(uint8_t *buf, size_t len)
+{
+    return RAND_bytes(buf, (int)len) == 1 ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY
+int cose_crypto_aead_encrypt_chachapoly(uint8_t *c,
+                                        size_t *clen,
+                                        const uint8_t *msg,
+                                        size_t msglen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _aead(1, c, clen, msg, msglen, aad, aadlen, npub, k,
+                 COSE_ALGO_CHACHA20POLY1305);
+}
+
+int cose_crypto_aead_decrypt_chachapoly(uint8_t *msg,
+                                        size_t *msglen,
+                                        const uint8_t *c,
+                                        size_t clen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _aead(0, msg, msglen, c, clen, aad, aadlen, npub, k,
+                 COSE_ALGO_CHACHA20POLY1305);
+}
+
+COSE_ssize_t cose_crypto_keygen_chachapoly(uint8_t *sk, size_t len)
+{
+    if (len < COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES) {
+        return COSE_ERR_NOMEM;
+    }
+    if (_random(sk, COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    return (COSE_ssize_t)COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES;
+}
+
+size_t cose_crypto_aead_nonce_chachapoly(uint8_t *nonce, size_t len)
+{
+    if (len < COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES ||
+            _random(nonce, COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES) !=
+            COSE_OK) {
+        return 0;
+    }
+    return COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES;
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY */
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_AESGCM
+COSE_ssize_t cose_crypto_keygen_aesgcm(uint8_t *buf, size_t len, cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
+    }
+    if (_random(buf, desc->key_len) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    return desc->key_len;
+}
+
+int cose_crypto_aead_encrypt_aesgcm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(1, c, clen, msg, msglen, aad, aadlen, npub, k, algo);
+}
+
+int cose_crypto_aead_decrypt_aesgcm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(0, msg, msglen, c, clen, aad, aadlen, npub, k, algo);
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_AESGCM */
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_AESCCM
+int cose_crypto_aead_encrypt_aesccm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(1, c, clen, msg, msglen, aad, aadlen, npub, k, algo);
+}
+
+int cose_crypto_aead_decrypt_aesccm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(0, msg, msglen, c, clen, aad, aadlen, npub, k, algo);
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_AESCCM */
+
+static int _digest_sign(EVP_PKEY *pkey, const EVP_MD *md, uint8_t *sig,
+                        size_t *sig_len, const uint8_t *msg, size_t msglen)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_PKEY_CTX *pctx = NULL;
+    int ok = ctx && EVP_DigestSignInit(ctx, &pctx, md, NULL, pkey) == 1;
+
+#ifdef COSE_ECDSA_DETERMINISTIC
+    if (ok && md) {
+        unsigned int nonce_type = 1;
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_uint(OSSL_SIGNATURE_PARAM_NONCE_TYPE,
+                                      &nonce_type),
+            OSSL_PARAM_construct_end(),
+        };
+        ok = EVP_PKEY_CTX_set_params(pctx, params) == 1;
+    }
+#endif
+    ok = ok && EVP_DigestSign(ctx, sig, sig_len, msg, msglen) == 1;
+    EVP_MD_CTX_free(ctx);
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+
+static int _digest_verify(EVP_PKEY *pkey, const EVP_MD *md,
+                          const uint8_t *sig, size_t sig_len,
+                          const uint8_t *msg, size_t msglen)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    int ok = ctx && EVP_DigestVerifyInit(ctx, NULL, md, NULL, pkey) == 1 &&
+             EVP_DigestVerify(ctx, sig, sig_len, msg, msglen) == 1;
+
+    EVP_MD_CTX_free(ctx);
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_ED25519
+/* The Ed25519 functions don't require the curve to be set in the key */
+static EVP_PKEY *_pkey_ed25519(const cose_key_t *key, bool priv, bool *tmp)
+{
+    const uint8_t *raw = priv ? key->d : key->x;
+
+    *tmp = key->evp_pkey == NULL;
+    if (!*tmp) {
+        return key->evp_pkey;
+    }
+    if (!raw) {
+        return NULL;
+    }
+    return priv ?
+        EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL, raw, 32) :
+        EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, NULL, raw, 32);
+}
+
+int cose_crypto_sign_ed25519(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg, unsigned long long int msglen)
+{
+    bool tmp = false;
+    EVP_PKEY *pkey = _pkey_ed25519(key, true, &tmp);
+    int res = COSE_ERR_INVALID_PARAM;
+
+    *signlen = COSE_CRYPTO_SIGN_ED25519_SIGNBYTES;
+    if (pkey) {
+        res = _digest_sign(pkey, NULL, sign, signlen, msg, (size_t)msglen);
+    }
+    _pkey_done(pkey, tmp);
+    return res;
+}
+
+int cose_crypto_verify_ed25519(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, uint64_t msglen)
+{
+    bool tmp = false;
+    EVP_PKEY *pkey = _pkey_ed25519(key, false, &tmp);
+    int res = COSE_ERR_INVALID_PARAM;
+
+    if (pkey) {
+        res = _digest_verify(pkey, NULL, sign, signlen, msg, (size_t)msglen);
+    }
+    _pkey_done(pkey, tmp);
+    return res;
+}
+
+int cose_crypto_keypair_ed25519(cose_key_t *key)
+{
+    EVP_PKEY *pkey = EVP_PKEY_Q_keygen(NULL, NULL, "ED25519");
+    size_t d_len = COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES;
+    size_t x_len = COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES;
+    int ok = pkey &&
+             EVP_PKEY_get_raw_private_key(pkey, key->d, &d_len) == 1 &&
+             EVP_PKEY_get_raw_public_key(pkey, key->x, &x_len) == 1;
+
+    EVP_PKEY_free(pkey);
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+
+size_t cose_crypto_sig_size_ed25519(void)
+{
+    return COSE_CRYPTO_SIGN_ED25519_SIGNBYTES;
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_ED25519 */
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_ECDSA
+static const EVP_MD *_ecdsa_md(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_SIGN ||
+            desc->kty != COSE_KTY_EC2) {
+        return NULL;
+    }
+    _init();
+    return _evp.md[desc->hash];
+}
+
+size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
+{
+    /* Raw r || s */
+    return 2 * _curve_len(curve);
+}
+
+int cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
+{
+    uint8_t point[OPENSSL_EC_POINT_MAXBYTES];
+    const char *name = _curve_name(curve);
+    size_t clen = _curve_len(curve);
+    size_t pad = COSE_CRYPTO_EC2_KEYBYTES - clen;
+    size_t len = 0;
+    EVP_PKEY *pkey = NULL;
+    BIGNUM *d = NULL;
+    int ok = 0;
+
+    if (!name) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    pkey = EVP_EC_gen(name);
+    ok = pkey && EVP_PKEY_get_bn_param(pkey, OSSL_PKEY_PARAM_PRIV_KEY, &d) &&
+         BN_bn2binpad(d, key->d, COSE_CRYPTO_EC2_KEYBYTES) ==
+         COSE_CRYPTO_EC2_KEYBYTES &&
+         EVP_PKEY_get_octet_string_param(pkey, OSSL_PKEY_PARAM_PUB_KEY, point,
+                                         sizeof(point), &len) &&
+         len == 1 + 2 * clen;
+    if (ok) {
+        memset(key->x, 0, pad);
+        memset(key->y, 0, pad);
+        memcpy(key->x + pad, point + 1, clen);
+        memcpy(key->y + pad, point + 1 + clen, clen);
+        key->crv = curve;
+    }
+    BN_clear_free(d);
+    EVP_PKEY_free(pkey);
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+
+int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg,  size_t msglen)
+{
+    uint8_t der[OPENSSL_ECDSA_DER_MAXBYTES];
+    size_t der_len = sizeof(der);
+    size_t clen = _curve_len(key->crv);
+    const EVP_MD *md = _ecdsa_md(key->algo);
+    bool tmp = false;
+    EVP_PKEY *pkey = NULL;
+    int res = COSE_ERR_INVALID_PARAM;
+
+    if (!md || !_curve_name(key->crv)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    pkey = _pkey(key, true, &tmp);
+    if (pkey) {
+        res = _digest_sign(pkey, md, der, &der_len, msg, msglen);
+    }
+    _pkey_done(pkey, tmp);
+
+    /* COSE uses the raw r || s form instead of the DER encoding */
+    if (res == COSE_OK) {
+        const unsigned char *p = der;
+        ECDSA_SIG *sig = d2i_ECDSA_SIG(NULL, &p, (long)der_len);
+        if (!sig ||
+                BN_bn2binpad(ECDSA_SIG_get0_r(sig), sign, (int)clen) < 0 ||
+                BN_bn2binpad(ECDSA_SIG_get0_s(sig), sign + clen,
+                             (int)clen) < 0) {
+            res = COSE_ERR_CRYPTO;
+        }
+        ECDSA_SIG_free(sig);
+        *signlen = 2 * clen;
+    }
+    return res;
+}
+
+int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, size_t msglen)
+{
+    uint8_t der[OPENSSL_ECDSA_DER_MAXBYTES];
+    unsigned char *p = der;
+    size_t clen = _curve_len(key->crv);
+    const EVP_MD *md = _ecdsa_md(key->algo);
+    ECDSA_SIG *sig = NULL;
+    BIGNUM *r = NULL;
+    BIGNUM *s = NULL;
+    bool tmp = false;
+    EVP_PKEY *pkey = NULL;
+    int der_len = 0;
+    int res = COSE_ERR_CRYPTO;
+
+    if (!md || !_curve_name(key->crv)) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    if (signlen != 2 * clen) {
+        return COSE_ERR_CRYPTO;
+    }
+    sig = ECDSA_SIG_new();
+    r = BN_bin2bn(sign, (int)clen, NULL);
+    s = BN_bin2bn(sign + clen, (int)clen, NULL);
+    if (!sig || !r || !s || ECDSA_SIG_set0(sig, r, s) != 1) {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return COSE_ERR_NOMEM;
+    }
+    der_len = i2d_ECDSA_SIG(sig, NULL);
+    if (der_len > 0 && (size_t)der_len <= sizeof(der)) {
+        der_len = i2d_ECDSA_SIG(sig, &p);
+        pkey = _pkey(key, false, &tmp);
+        res = pkey ? _digest_verify(pkey, md, der, (size_t)der_len, msg,
+                                    msglen) :
+            COSE_ERR_INVALID_PARAM;
+        _pkey_done(pkey, tmp);
+    }
+    ECDSA_SIG_free(sig);
+    return res;
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_ECDSA */
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_HMAC
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac)
+{
+    /* HMAC pads short keys with zeros, an empty key equals a zero byte */
+    static const uint8_t zero = 0;
+    EVP_MAC_CTX *ctx = NULL;
+    const EVP_MD *md = NULL;
+    size_t mac_len = 0;
+    int ok = 0;
+
+    if (hash == COSE_CRYPTO_HASH_NONE) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    _init();
+    md = _evp.md[hash];
+    if (!md || !_evp.hmac) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!key_len) {
+        key = &zero;
+        key_len = 1;
+    }
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                         (char *)EVP_MD_get0_name(md), 0),
+        OSSL_PARAM_construct_end(),
+    };
+    ctx = EVP_MAC_CTX_new(_evp.hmac);
+    ok = ctx && EVP_MAC_init(ctx, key, key_len, params) == 1;
+    for (size_t i = 0; i < num && ok; i++) {
+        ok = EVP_MAC_update(ctx, msg[i].buf, msg[i].len) == 1;
+    }
+    ok = ok && EVP_MAC_final(ctx, mac, &mac_len,
+                             cose_crypto_hash_len(hash)) == 1;
+    EVP_MAC_CTX_free(ctx);
+    return ok ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_HMAC */
+
+#if defined(CRYPTO_OPENSSL_INCLUDE_X25519) || \
+    defined(CRYPTO_OPENSSL_INCLUDE_ECDH)
+static int _derive(const cose_key_t *key, const cose_key_t *peer,
+                   uint8_t *secret, size_t *secret_len)
+{
+    bool tmp_ours = false;
+    bool tmp_theirs = false;
+    EVP_PKEY *ours = _pkey(key, true, &tmp_ours);
+    EVP_PKEY *theirs = _pkey(peer, false, &tmp_theirs);
+    EVP_PKEY_CTX *ctx = NULL;
+    int res = COSE_ERR_INVALID_PARAM;
+
+    *secret_len = COSE_CRYPTO_ECDH_MAXBYTES;
+    if (ours && theirs) {
+        ctx = EVP_PKEY_CTX_new_from_pkey(NULL, ours, NULL);
+        res = ctx && EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_derive_set_peer(ctx, theirs) == 1 &&
+              EVP_PKEY_derive(ctx, secret, secret_len) == 1 ?
+            COSE_OK : COSE_ERR_CRYPTO;
+        EVP_PKEY_CTX_free(ctx);
+    }
+    _pkey_done(theirs, tmp_theirs);
+    _pkey_done(ours, tmp_ours);
+    return res;
+}
+#endif
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_X25519
+int cose_crypto_ecdh_x25519(const cose_key_t *key, const cose_key_t *peer,
+                            uint8_t *secret)
+{
+    size_t secret_len = 0;
+    return _derive(key, peer, secret, &secret_len);
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_X25519 */
+
+#ifdef CRYPTO_OPENSSL_INCLUDE_ECDH
+int cose_crypto_ecdh_ecp(const cose_key_t *key, const cose_key_t *peer,
+                         uint8_t *secret, size_t *secret_len)
+{
+    return _derive(key, peer, secret, secret_len);
+}
+#endif /* CRYPTO_OPENSSL_INCLUDE_ECDH */
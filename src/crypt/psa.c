@@ -0,0 +1,771 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Glue layer between libcose and the PSA Crypto API
+ */
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include <psa/crypto.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Uncompressed EC point, 0x04 || x || y */
+#define PSA_EC_POINT_MAXBYTES   (1 + 2 * COSE_CRYPTO_EC2_KEYBYTES)
+
+/* Truncated SHA-256 of the key buffer contents at registration */
+#define PSA_SYMM_DIGEST_LEN     16
+
+typedef struct {
+    const uint8_t *k;       /* Raw key pointer the AEAD functions receive */
+    cose_algo_t algo;
+    psa_key_id_t id;
+    bool opened;            /* Attached persistent key, k is no key material */
+    uint8_t digest[PSA_SYMM_DIGEST_LEN];
+} _psa_symm_t;
+
+/* Registered symmetric keys, modified by import/open/close only */
+static _psa_symm_t _symm[COSE_CRYPTO_PSA_SYMM_KEYS];
+static const cose_lock_t *_symm_lock;
+
+static void _lock(void)
+{
+    if (_symm_lock) {
+        _symm_lock->lock(_symm_lock->ctx);
+    }
+}
+
+static void _unlock(void)
+{
+    if (_symm_lock) {
+        _symm_lock->unlock(_symm_lock->ctx);
+    }
+}
+
+static size_t _curve_len(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P256:
+        case COSE_EC_CURVE_X25519:
+            return 32;
+        case COSE_EC_CURVE_P384:
+            return 48;
+        case COSE_EC_CURVE_P521:
+            return 66;
+        default:
+            return 0;
+    }
+}
+
+static size_t _curve_bits(cose_curve_t crv)
+{
+    switch (crv) {
+        case COSE_EC_CURVE_P521:
+            return 521;
+        case COSE_EC_CURVE_X25519:
+            return 255;
+        default:
+            return 8 * _curve_len(crv);
+    }
+}
+
+static psa_key_type_t _ecc_type(cose_curve_t crv, bool pair)
+{
+    psa_ecc_family_t family = crv == COSE_EC_CURVE_X25519 ?
+        PSA_ECC_FAMILY_MONTGOMERY : PSA_ECC_FAMILY_SECP_R1;
+    return pair ? PSA_KEY_TYPE_ECC_KEY_PAIR(family) :
+        PSA_KEY_TYPE_ECC_PUBLIC_KEY(family);
+}
+
+static psa_algorithm_t _hash_alg(cose_crypto_hash_t hash)
+{
+    switch (hash) {
+        case COSE_CRYPTO_HASH_SHA256:
+            return PSA_ALG_SHA_256;
+        case COSE_CRYPTO_HASH_SHA384:
+            return PSA_ALG_SHA_384;
+        case COSE_CRYPTO_HASH_SHA512:
+            return PSA_ALG_SHA_512;
+        default:
+            return 0;
+    }
+}
+
+static psa_algorithm_t _ecdsa_alg(cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_SIGN ||
+            desc->kty != COSE_KTY_EC2) {
+        return 0;
+    }
+#ifdef COSE_ECDSA_DETERMINISTIC
+    return PSA_ALG_DETERMINISTIC_ECDSA(_hash_alg(desc->hash));
+#else
+    return PSA_ALG_ECDSA(_hash_alg(desc->hash));
+#endif
+}
+
+static psa_algorithm_t _aead_alg(const cose_crypto_algo_t *desc,
+                                 psa_key_type_t *type)
+{
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return 0;
+    }
+    switch (desc->algo) {
+        case COSE_ALGO_CHACHA20POLY1305:
+            *type = PSA_KEY_TYPE_CHACHA20;
+            return PSA_ALG_CHACHA20_POLY1305;
+        case COSE_ALGO_A128GCM:
+        case COSE_ALGO_A192GCM:
+        case COSE_ALGO_A256GCM:
+            *type = PSA_KEY_TYPE_AES;
+            return PSA_ALG_GCM;
+        default:
+            *type = PSA_KEY_TYPE_AES;
+            return PSA_ALG_AEAD_WITH_SHORTENED_TAG(PSA_ALG_CCM, desc->tag_len);
+    }
+}
+
+/* Digest of the key buffer, detects keys rotated in place */
+static int _symm_digest(const uint8_t *k, cose_algo_t algo, uint8_t *digest)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    uint8_t hash[32];
+    size_t len = 0;
+
+    if (!desc || psa_hash_compute(PSA_ALG_SHA_256, k, desc->key_len, hash,
+                                  sizeof(hash), &len) != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    memcpy(digest, hash, PSA_SYMM_DIGEST_LEN);
+    return COSE_OK;
+}
+
+/* Must be called with the table locked */
+static _psa_symm_t *_symm_slot(const uint8_t *k)
+{
+    for (size_t i = 0; i < COSE_CRYPTO_PSA_SYMM_KEYS; i++) {
+        if (_symm[i].k == k) {
+            return &_symm[i];
+        }
+    }
+    return NULL;
+}
+
+static int _symm_register(const cose_key_t *key, bool opened)
+{
+    uint8_t digest[PSA_SYMM_DIGEST_LEN];
+    int res = _symm_digest(key->d, key->algo, digest);
+
+    if (res < 0) {
+        return res;
+    }
+    _lock();
+    _psa_symm_t *slot = _symm_slot(key->d);
+    if (!slot) {
+        slot = _symm_slot(NULL);
+    }
+    if (slot) {
+        slot->k = key->d;
+        slot->algo = key->algo;
+        slot->id = key->psa_key;
+        slot->opened = opened;
+        memcpy(slot->digest, digest, sizeof(digest));
+    }
+    _unlock();
+    return slot ? COSE_OK : COSE_ERR_NOMEM;
+}
+
+void cose_crypto_psa_set_lock(const cose_lock_t *lock)
+{
+    _symm_lock = lock;
+}
+
+/* Public key in the PSA import format, raw u-coordinate for X25519 */
+static const uint8_t *_public(const cose_key_t *key, uint8_t *buf,
+                              size_t *len)
+{
+    size_t clen = _curve_len(key->crv);
+
+    if (!key->x) {
+        return NULL;
+    }
+    if (key->crv == COSE_EC_CURVE_X25519) {
+        *len = clen;
+        return key->x;
+    }
+    if (!key->y) {
+        return NULL;
+    }
+    buf[0] = 0x04;
+    memcpy(buf + 1, key->x + COSE_CRYPTO_EC2_KEYBYTES - clen, clen);
+    memcpy(buf + 1 + clen, key->y + COSE_CRYPTO_EC2_KEYBYTES - clen, clen);
+    *len = 1 + 2 * clen;
+    return buf;
+}
+
+/* Import the private or public part of a key with a policy matching its use */
+static int _import(const cose_key_t *key, bool pair,
+                   psa_key_attributes_t *attr, psa_key_id_t *id)
+{
+    uint8_t point[PSA_EC_POINT_MAXBYTES];
+    const uint8_t *data = NULL;
+    size_t len = 0;
+
+    if (key->kty == COSE_KTY_SYMM) {
+        const cose_crypto_algo_t *desc = cose_crypto_algo_get(key->algo);
+        psa_key_type_t type = 0;
+        psa_algorithm_t alg = _aead_alg(desc, &type);
+        if (!alg) {
+            return COSE_ERR_NOTIMPLEMENTED;
+        }
+        psa_set_key_type(attr, type);
+        psa_set_key_usage_flags(attr, PSA_KEY_USAGE_ENCRYPT |
+                                      PSA_KEY_USAGE_DECRYPT);
+        psa_set_key_algorithm(attr, alg);
+        data = key->d;
+        len = desc->key_len;
+    }
+    else {
+        size_t clen = _curve_len(key->crv);
+        psa_algorithm_t alg = _ecdsa_alg(key->algo);
+        if (!clen) {
+            return COSE_ERR_NOTIMPLEMENTED;
+        }
+        psa_set_key_type(attr, _ecc_type(key->crv, pair));
+        psa_set_key_bits(attr, _curve_bits(key->crv));
+        if (alg && key->kty == COSE_KTY_EC2) {
+            psa_set_key_usage_flags(attr, PSA_KEY_USAGE_VERIFY_MESSAGE |
+                                    (pair ? PSA_KEY_USAGE_SIGN_MESSAGE : 0));
+            psa_set_key_algorithm(attr, alg);
+        }
+        else {
+            psa_set_key_usage_flags(attr, PSA_KEY_USAGE_DERIVE);
+            psa_set_key_algorithm(attr, PSA_ALG_ECDH);
+        }
+        if (!pair) {
+            data = _public(key, point, &len);
+        }
+        else if (key->d) {
+            data = key->kty == COSE_KTY_EC2 ?
+                key->d + COSE_CRYPTO_EC2_KEYBYTES - clen : key->d;
+            len = clen;
+        }
+    }
+    if (!data) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    return psa_import_key(attr, data, len, id) == PSA_SUCCESS ?
+        COSE_OK : COSE_ERR_CRYPTO;
+}
+
+/* Handle of the key, imported as temporary volatile key without handle */
+static int _key_id(const cose_key_t *key, bool pair, psa_key_id_t *id,
+                   bool *tmp)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+
+    *tmp = key->psa_key == PSA_KEY_ID_NULL;
+    if (!*tmp) {
+        *id = key->psa_key;
+        return COSE_OK;
+    }
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    return _import(key, pair, &attr, id);
+}
+
+int cose_crypto_psa_import(cose_key_t *key, psa_key_lifetime_t lifetime,
+                           psa_key_id_t id)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    int res = COSE_OK;
+
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    if (key->kty == COSE_KTY_SYMM) {
+        _lock();
+        bool full = !_symm_slot(NULL) && !_symm_slot(key->d);
+        _unlock();
+        if (full) {
+            return COSE_ERR_NOMEM;
+        }
+    }
+    if (lifetime != PSA_KEY_LIFETIME_VOLATILE) {
+        psa_set_key_id(&attr, id);
+    }
+    psa_set_key_lifetime(&attr, lifetime);
+    res = _import(key, key->d != NULL, &attr, &key->psa_key);
+    if (res == COSE_OK && key->kty == COSE_KTY_SYMM) {
+        res = _symm_register(key, false);
+        if (res < 0) {
+            /* The last slot was taken concurrently */
+            psa_destroy_key(key->psa_key);
+            key->psa_key = PSA_KEY_ID_NULL;
+        }
+    }
+    return res;
+}
+
+int cose_crypto_psa_open(cose_key_t *key, psa_key_id_t id)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    psa_status_t status = PSA_SUCCESS;
+
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    status = psa_get_key_attributes(id, &attr);
+    psa_reset_key_attributes(&attr);
+    if (status != PSA_SUCCESS) {
+        return COSE_ERR_NOT_FOUND;
+    }
+    if (key->kty == COSE_KTY_SYMM) {
+        if (!key->d) {
+            return COSE_ERR_INVALID_PARAM;
+        }
+        key->psa_key = id;
+        return _symm_register(key, true);
+    }
+    if (key->x) {
+        uint8_t point[PSA_EC_POINT_MAXBYTES];
+        size_t clen = _curve_len(key->crv);
+        size_t len = 0;
+        if (psa_export_public_key(id, point, sizeof(point), &len) !=
+                PSA_SUCCESS) {
+            return COSE_ERR_CRYPTO;
+        }
+        if (key->kty != COSE_KTY_EC2 && len == clen) {
+            memcpy(key->x, point, clen);
+        }
+        else if (key->y && len == 1 + 2 * clen) {
+            size_t pad = COSE_CRYPTO_EC2_KEYBYTES - clen;
+            memset(key->x, 0, pad);
+            memset(key->y, 0, pad);
+            memcpy(key->x + pad, point + 1, clen);
+            memcpy(key->y + pad, point + 1 + clen, clen);
+        }
+        else {
+            return COSE_ERR_INVALID_PARAM;
+        }
+    }
+    key->psa_key = id;
+    return COSE_OK;
+}
+
+void cose_crypto_psa_close(cose_key_t *key)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+
+    if (key->psa_key == PSA_KEY_ID_NULL) {
+        return;
+    }
+    _lock();
+    for (size_t i = 0; i < COSE_CRYPTO_PSA_SYMM_KEYS; i++) {
+        if (_symm[i].k && _symm[i].id == key->psa_key) {
+            memset(&_symm[i], 0, sizeof(_symm[i]));
+        }
+    }
+    _unlock();
+    if (psa_get_key_attributes(key->psa_key, &attr) == PSA_SUCCESS &&
+            PSA_KEY_LIFETIME_IS_VOLATILE(psa_get_key_lifetime(&attr))) {
+        psa_destroy_key(key->psa_key);
+    }
+    psa_reset_key_attributes(&attr);
+    key->psa_key = PSA_KEY_ID_NULL;
+}
+
+#if defined(CRYPTO_PSA_INCLUDE_CHACHAPOLY) || \
+    defined(CRYPTO_PSA_INCLUDE_AESGCM) || \
+    defined(CRYPTO_PSA_INCLUDE_AESCCM)
+static int _aead(bool encrypt, uint8_t *out, size_t *out_len,
+                 const uint8_t *in, size_t in_len,
+                 const uint8_t *aad, size_t aadlen,
+                 const uint8_t *npub, const uint8_t *k, cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    psa_key_type_t type = 0;
+    psa_algorithm_t alg = _aead_alg(desc, &type);
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    psa_status_t status = PSA_SUCCESS;
+    uint8_t digest[PSA_SYMM_DIGEST_LEN];
+    bool stale = false;
+    bool tmp = true;
+
+    if (!alg) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!encrypt && in_len < desc->tag_len) {
+        return COSE_ERR_CRYPTO;
+    }
+    if (psa_crypto_init() != PSA_SUCCESS ||
+            _symm_digest(k, algo, digest) < 0) {
+        return COSE_ERR_CRYPTO;
+    }
+    _lock();
+    for (size_t i = 0; i < COSE_CRYPTO_PSA_SYMM_KEYS; i++) {
+        if (_symm[i].k == k && _symm[i].algo == algo) {
+            /* A buffer refilled since registration holds another key */
+            if (memcmp(_symm[i].digest, digest, sizeof(digest)) == 0) {
+                id = _symm[i].id;
+                tmp = false;
+            }
+            stale = tmp && _symm[i].opened;
+            break;
+        }
+    }
+    _unlock();
+    if (stale) {
+        /* The buffer of an attached key only identifies it */
+        return COSE_ERR_INVALID_PARAM;
+    }
+    if (tmp) {
+        psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+        psa_set_key_type(&attr, type);
+        psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_ENCRYPT |
+                                       PSA_KEY_USAGE_DECRYPT);
+        psa_set_key_algorithm(&attr, alg);
+        if (psa_import_key(&attr, k, desc->key_len, &id) != PSA_SUCCESS) {
+            return COSE_ERR_CRYPTO;
+        }
+    }
+    if (encrypt) {
+        status = psa_aead_encrypt(id, alg, npub, desc->nonce_len, aad, aadlen,
+                                  in, in_len, out, in_len + desc->tag_len,
+                                  out_len);
+    }
+    else {
+        status = psa_aead_decrypt(id, alg, npub, desc->nonce_len, aad, aadlen,
+                                  in, in_len, out, in_len - desc->tag_len,
+                                  out_len);
+    }
+    if (tmp) {
+        psa_destroy_key(id);
+    }
+    return status == PSA_SUCCESS ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif
+
+#if defined(CRYPTO_PSA_INCLUDE_CHACHAPOLY) || \
+    defined(CRYPTO_PSA_INCLUDE_AESGCM)
+static int _random(uint8_t *buf, size_t len)
+{
+    if (psa_crypto_init() != PSA_SUCCESS ||
+            psa_generate_random(buf, len) != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+#endif
+
+#ifdef CRYPTO_PSA_INCLUDE_CHACHAPOLY
+int cose_crypto_aead_encrypt_chachapoly(uint8_t *c,
+                                        size_t *clen,
+                                        const uint8_t *msg,
+                                        size_t msglen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _aead(true, c, clen, msg, msglen, aad, aadlen, npub, k,
+                 COSE_ALGO_CHACHA20POLY1305);
+}
+
+int cose_crypto_aead_decrypt_chachapoly(uint8_t *msg,
+                                        size_t *msglen,
+                                        const uint8_t *c,
+                                        size_t clen,
+                                        const uint8_t *aad,
+                                        size_t aadlen,
+                                        const uint8_t *npub,
+                                        const uint8_t *k)
+{
+    return _aead(false, msg, msglen, c, clen, aad, aadlen, npub, k,
+                 COSE_ALGO_CHACHA20POLY1305);
+}
+
+COSE_ssize_t cose_crypto_keygen_chachapoly(uint8_t *sk, size_t len)
+{
+    if (len < COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES) {
+        return COSE_ERR_NOMEM;
+    }
+    if (_random(sk, COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    return (COSE_ssize_t)COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES;
+}
+
+size_t cose_crypto_aead_nonce_chachapoly(uint8_t *nonce, size_t len)
+{
+    if (len < COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES ||
+            _random(nonce, COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES) !=
+            COSE_OK) {
+        return 0;
+    }
+    return COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES;
+}
+#endif /* CRYPTO_PSA_INCLUDE_CHACHAPOLY */
+
+#ifdef CRYPTO_PSA_INCLUDE_AESGCM
+COSE_ssize_t cose_crypto_keygen_aesgcm(uint8_t *buf, size_t len, cose_algo_t algo)
+{
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (len < desc->key_len) {
+        return COSE_ERR_NOMEM;
+    }
+    if (_random(buf, desc->key_len) != COSE_OK) {
+        return COSE_ERR_CRYPTO;
+    }
+    return desc->key_len;
+}
+
+int cose_crypto_aead_encrypt_aesgcm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(true, c, clen, msg, msglen, aad, aadlen, npub, k, algo);
+}
+
+int cose_crypto_aead_decrypt_aesgcm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(false, msg, msglen, c, clen, aad, aadlen, npub, k, algo);
+}
+#endif /* CRYPTO_PSA_INCLUDE_AESGCM */
+
+#ifdef CRYPTO_PSA_INCLUDE_AESCCM
+int cose_crypto_aead_encrypt_aesccm(uint8_t *c,
+                                    size_t *clen,
+                                    const uint8_t *msg,
+                                    size_t msglen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(true, c, clen, msg, msglen, aad, aadlen, npub, k, algo);
+}
+
+int cose_crypto_aead_decrypt_aesccm(uint8_t *msg,
+                                    size_t *msglen,
+                                    const uint8_t *c,
+                                    size_t clen,
+                                    const uint8_t *aad,
+                                    size_t aadlen,
+                                    const uint8_t *npub,
+                                    const uint8_t *k,
+                                    cose_algo_t algo)
+{
+    return _aead(false, msg, msglen, c, clen, aad, aadlen, npub, k, algo);
+}
+#endif /* CRYPTO_PSA_INCLUDE_AESCCM */
+
+#ifdef CRYPTO_PSA_INCLUDE_ECDSA
+size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
+{
+    /* Raw r || s */
+    return 2 * _curve_len(curve);
+}
+
+int cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    uint8_t point[PSA_EC_POINT_MAXBYTES];
+    size_t clen = _curve_len(curve);
+    size_t pad = COSE_CRYPTO_EC2_KEYBYTES - clen;
+    size_t len = 0;
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    int res = COSE_ERR_CRYPTO;
+
+    if (!clen || curve == COSE_EC_CURVE_X25519) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    psa_set_key_type(&attr, _ecc_type(curve, true));
+    psa_set_key_bits(&attr, _curve_bits(curve));
+    psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_EXPORT);
+    if (psa_generate_key(&attr, &id) != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    memset(key->d, 0, pad);
+    if (psa_export_key(id, key->d + pad, clen, &len) == PSA_SUCCESS &&
+            len == clen &&
+            psa_export_public_key(id, point, sizeof(point), &len) ==
+            PSA_SUCCESS && len == 1 + 2 * clen) {
+        memset(key->x, 0, pad);
+        memset(key->y, 0, pad);
+        memcpy(key->x + pad, point + 1, clen);
+        memcpy(key->y + pad, point + 1 + clen, clen);
+        key->crv = curve;
+        res = COSE_OK;
+    }
+    psa_destroy_key(id);
+    return res;
+}
+
+int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg,  size_t msglen)
+{
+    psa_algorithm_t alg = _ecdsa_alg(key->algo);
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    psa_status_t status = PSA_SUCCESS;
+    bool tmp = false;
+
+    if (!alg) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    int res = _key_id(key, true, &id, &tmp);
+    if (res != COSE_OK) {
+        return res;
+    }
+    status = psa_sign_message(id, alg, msg, msglen, sign,
+                              cose_crypto_sig_size_ecdsa(key->crv), signlen);
+    if (tmp) {
+        psa_destroy_key(id);
+    }
+    return status == PSA_SUCCESS ? COSE_OK : COSE_ERR_CRYPTO;
+}
+
+int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, size_t msglen)
+{
+    psa_algorithm_t alg = _ecdsa_alg(key->algo);
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    psa_status_t status = PSA_SUCCESS;
+    bool tmp = false;
+
+    if (!alg) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    int res = _key_id(key, false, &id, &tmp);
+    if (res != COSE_OK) {
+        return res;
+    }
+    status = psa_verify_message(id, alg, msg, msglen, sign, signlen);
+    if (tmp) {
+        psa_destroy_key(id);
+    }
+    return status == PSA_SUCCESS ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif /* CRYPTO_PSA_INCLUDE_ECDSA */
+
+#ifdef CRYPTO_PSA_INCLUDE_HMAC
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac)
+{
+    /* HMAC pads short keys with zeros, an empty key equals a zero byte */
+    static const uint8_t zero = 0;
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    psa_mac_operation_t op = PSA_MAC_OPERATION_INIT;
+    psa_algorithm_t alg = _hash_alg(hash);
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    psa_status_t status = PSA_SUCCESS;
+    size_t mac_len = 0;
+
+    if (!alg) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!key_len) {
+        key = &zero;
+        key_len = 1;
+    }
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    psa_set_key_type(&attr, PSA_KEY_TYPE_HMAC);
+    psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_SIGN_MESSAGE);
+    psa_set_key_algorithm(&attr, PSA_ALG_HMAC(alg));
+    if (psa_import_key(&attr, key, key_len, &id) != PSA_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    status = psa_mac_sign_setup(&op, id, PSA_ALG_HMAC(alg));
+    for (size_t i = 0; i < num && status == PSA_SUCCESS; i++) {
+        status = psa_mac_update(&op, msg[i].buf, msg[i].len);
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_mac_sign_finish(&op, mac, cose_crypto_hash_len(hash),
+                                     &mac_len);
+    }
+    if (status != PSA_SUCCESS) {
+        psa_mac_abort(&op);
+    }
+    psa_destroy_key(id);
+    return status == PSA_SUCCESS ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif /* CRYPTO_PSA_INCLUDE_HMAC */
+
+#if defined(CRYPTO_PSA_INCLUDE_X25519) || defined(CRYPTO_PSA_INCLUDE_ECDH)
+static int _ecdh(const cose_key_t *key, const cose_key_t *peer,
+                 uint8_t *secret, size_t *secret_len)
+{
+    uint8_t point[PSA_EC_POINT_MAXBYTES];
+    const uint8_t *pub = NULL;
+    size_t len = 0;
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    psa_status_t status = PSA_SUCCESS;
+    bool tmp = false;
+
+    pub = _public(peer, point, &len);
+    if (!pub) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    int res = _key_id(key, true, &id, &tmp);
+    if (res != COSE_OK) {
+        return res;
+    }
+    status = psa_raw_key_agreement(PSA_ALG_ECDH, id, pub, len, secret,
+                                   COSE_CRYPTO_ECDH_MAXBYTES, secret_len);
+    if (tmp) {
+        psa_destroy_key(id);
+    }
+    return status == PSA_SUCCESS ? COSE_OK : COSE_ERR_CRYPTO;
+}
+#endif
+
+#ifdef CRYPTO_PSA_INCLUDE_X25519
+int cose_crypto_ecdh_x25519(const cose_key_t *key, const cose_key_t *peer,
+                            uint8_t *secret)
+{
+    size_t secret_len = 0;
+    return _ecdh(key, peer, secret, &secret_len);
+}
+#endif /* CRYPTO_PSA_INCLUDE_X25519 */
+
+#ifdef CRYPTO_PSA_INCLUDE_ECDH
+int cose_crypto_ecdh_ecp(const cose_key_t *key, const cose_key_t *peer,
+                         uint8_t *secret, size_t *secret_len)
+{
+    return _ecdh(key, peer, secret, secret_len);
+}
+#endif /* CRYPTO_PSA_INCLUDE_ECDH */
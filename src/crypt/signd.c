@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Signing daemon client and request ring
+ *
+ * The ring is a bounded multi-producer single-consumer queue with a sequence
+ * number per slot. Slot i passes through the sequence numbers pos (free),
+ * pos + 3 (claimed, request being written), pos + 1 (request written),
+ * pos + 2 (signature written) and pos + SLOTS (released by the client, free
+ * for the next lap). Clients claim a position with a CAS on the head, the
+ * daemon owns the tail. A slot is only reused after the client collected the
+ * signature, so clients can wait on their own slot without copying the result
+ * out elsewhere.
+ *
+ * Clients give up after the wait timeout of the ring. The daemon recovers the
+ * slots of clients that stopped after the reclaim timeout: a claimed slot
+ * that is never published is released with a CAS and skipped, an answered
+ * slot that is never collected is released with a CAS as well. Clients
+ * publish and release with a CAS too, so a client that was only slow finds
+ * its slot taken and fails instead of overwriting the next request.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if ATOMIC_INT_LOCK_FREE != 2
+#error "The signd backend requires lock-free atomics to share them between processes"
+#endif
+
+#if (COSE_CRYPTO_SIGND_SLOTS < 4) || \
+    (COSE_CRYPTO_SIGND_SLOTS & (COSE_CRYPTO_SIGND_SLOTS - 1))
+#error "COSE_CRYPTO_SIGND_SLOTS must be a power of two of at least 4"
+#endif
+
+#define SIGND_MAGIC         0x434f5344U     /* "COSD" */
+#define SIGND_CACHELINE     64U
+#define SIGND_MASK          (COSE_CRYPTO_SIGND_SLOTS - 1U)
+
+typedef struct {
+    _Alignas(SIGND_CACHELINE) _Atomic uint32_t seq;
+    int32_t algo;
+    int32_t res;
+    uint16_t kid_len;
+    uint16_t sig_len;
+    uint32_t msg_len;
+    uint32_t done;              /* Time the daemon answered, in ms */
+    uint8_t kid[COSE_CRYPTO_SIGND_KID_MAX];
+    uint8_t sig[COSE_CRYPTO_SIGND_SIG_MAX];
+    uint8_t msg[COSE_CRYPTO_SIGND_MSG_MAX];
+} _signd_slot_t;
+
+struct cose_signd_ring {
+    _Atomic uint32_t magic;     /* Written last when the ring is set up */
+    uint32_t slots;
+    uint32_t slot_size;
+    uint32_t msg_max;
+    _Atomic uint32_t wait_ms;
+    _Atomic uint32_t reclaim_ms;
+    /* Claimed slot at the tail that is not published yet, daemon only */
+    bool stalled;
+    uint32_t stall_since;
+    _Alignas(SIGND_CACHELINE) _Atomic uint32_t head;    /* Next position to claim */
+    _Alignas(SIGND_CACHELINE) _Atomic uint32_t tail;    /* Next position to serve */
+    _signd_slot_t slot[COSE_CRYPTO_SIGND_SLOTS];
+};
+
+typedef struct {
+    _signd_slot_t *slot;
+    const cose_key_t *keys;
+    size_t num;
+    uint32_t pos;
+} _signd_job_t;
+
+static uint32_t _now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000U + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+static bool _expired(uint32_t since, uint32_t timeout)
+{
+    return _now_ms() - since >= timeout;
+}
+
+/* Spin first, then yield until the wait timeout of the ring expires. The
+ * clock is only read once the client starts yielding. */
+static bool _backoff(const cose_signd_ring_t *ring, unsigned *spin,
+                     uint32_t *start)
+{
+    if (*spin < COSE_CRYPTO_SIGND_SPIN) {
+        (*spin)++;
+        return true;
+    }
+    if (*spin == COSE_CRYPTO_SIGND_SPIN) {
+        (*spin)++;
+        *start = _now_ms();
+    }
+    uint32_t timeout = atomic_load_explicit(&ring->wait_ms,
+                                            memory_order_relaxed);
+    if (timeout && _expired(*start, timeout)) {
+        return false;
+    }
+    sched_yield();
+    return true;
+}
+
+static void _ring_init(cose_signd_ring_t *ring)
+{
+    ring->slots = COSE_CRYPTO_SIGND_SLOTS;
+    ring->slot_size = sizeof(_signd_slot_t);
+    ring->msg_max = COSE_CRYPTO_SIGND_MSG_MAX;
+    atomic_init(&ring->wait_ms, COSE_CRYPTO_SIGND_WAIT_MS);
+    atomic_init(&ring->reclaim_ms, COSE_CRYPTO_SIGND_RECLAIM_MS);
+    ring->stalled = false;
+    ring->stall_since = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    for (uint32_t i = 0; i < COSE_CRYPTO_SIGND_SLOTS; i++) {
+        atomic_init(&ring->slot[i].seq, i);
+    }
+    atomic_store_explicit(&ring->magic, SIGND_MAGIC, memory_order_release);
+}
+
+static bool _ring_valid(const cose_signd_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->magic, memory_order_acquire) == SIGND_MAGIC &&
+           ring->slots == COSE_CRYPTO_SIGND_SLOTS &&
+           ring->slot_size == sizeof(_signd_slot_t) &&
+           ring->msg_max == COSE_CRYPTO_SIGND_MSG_MAX;
+}
+
+cose_signd_ring_t *cose_crypto_signd_open(const char *name, bool create)
+{
+    int flags = create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR;
+    int fd = shm_open(name, flags, 0600);
+    struct stat st;
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (create) {
+        if (ftruncate(fd, sizeof(cose_signd_ring_t)) < 0) {
+            close(fd);
+            return NULL;
+        }
+    }
+    else if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(cose_signd_ring_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, sizeof(cose_signd_ring_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+
+    cose_signd_ring_t *ring = mem;
+    if (create) {
+        _ring_init(ring);
+    }
+    else if (!_ring_valid(ring)) {
+        munmap(mem, sizeof(cose_signd_ring_t));
+        errno = EINVAL;
+        return NULL;
+    }
+    return ring;
+}
+
+void cose_crypto_signd_close(cose_signd_ring_t *ring)
+{
+    munmap(ring, sizeof(cose_signd_ring_t));
+}
+
+void cose_crypto_signd_set_timeout(cose_signd_ring_t *ring, uint32_t wait_ms,
+                                   uint32_t reclaim_ms)
+{
+    atomic_store_explicit(&ring->wait_ms, wait_ms, memory_order_relaxed);
+    atomic_store_explicit(&ring->reclaim_ms, reclaim_ms, memory_order_relaxed);
+}
+
+void cose_crypto_signd_attach(cose_key_t *key, cose_signd_ring_t *ring)
+{
+    key->signd = ring;
+}
+
+int cose_crypto_signd_request(cose_signd_ring_t *ring, const cose_key_t *key,
+                              const uint8_t *msg, size_t msglen,
+                              uint32_t *ticket)
+{
+    if (msglen > COSE_CRYPTO_SIGND_MSG_MAX ||
+            key->kid_len > COSE_CRYPTO_SIGND_KID_MAX) {
+        return COSE_ERR_NOMEM;
+    }
+
+    unsigned spin = 0;
+    uint32_t start = 0;
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    _signd_slot_t *slot;
+    for (;;) {
+        slot = &ring->slot[pos & SIGND_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        if (diff < 0) {
+            /* Ring full, the slot is still used by the previous lap */
+            if (!_backoff(ring, &spin, &start)) {
+                return COSE_ERR_CRYPTO;
+            }
+        }
+        pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+
+    /* Mark the slot as being written, fails when the daemon already
+     * reclaimed the claim */
+    uint32_t seq = pos;
+    if (!atomic_compare_exchange_strong_explicit(&slot->seq, &seq, pos + 3,
+                                                 memory_order_acquire,
+                                                 memory_order_relaxed)) {
+        return COSE_ERR_CRYPTO;
+    }
+    slot->algo = key->algo;
+    slot->kid_len = (uint16_t)key->kid_len;
+    if (key->kid_len) {
+        memcpy(slot->kid, key->kid, key->kid_len);
+    }
+    slot->msg_len = (uint32_t)msglen;
+    memcpy(slot->msg, msg, msglen);
+    seq = pos + 3;
+    if (!atomic_compare_exchange_strong_explicit(&slot->seq, &seq, pos + 1,
+                                                 memory_order_release,
+                                                 memory_order_relaxed)) {
+        return COSE_ERR_CRYPTO;
+    }
+    *ticket = pos;
+    return COSE_OK;
+}
+
+bool cose_crypto_signd_ready(const cose_signd_ring_t *ring, uint32_t ticket)
+{
+    const _signd_slot_t *slot = &ring->slot[ticket & SIGND_MASK];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) == ticket + 2;
+}
+
+int cose_crypto_signd_result(cose_signd_ring_t *ring, uint32_t ticket,
+                             uint8_t *sign, size_t *signlen)
+{
+    _signd_slot_t *slot = &ring->slot[ticket & SIGND_MASK];
+    unsigned spin = 0;
+    uint32_t start = 0;
+
+    while (!cose_crypto_signd_ready(ring, ticket)) {
+        if (!_backoff(ring, &spin, &start)) {
+            return COSE_ERR_CRYPTO;
+        }
+    }
+    int res = slot->res;
+    size_t sig_len = slot->sig_len;
+    if (res == COSE_OK && sig_len <= COSE_CRYPTO_SIGND_SIG_MAX) {
+        memcpy(sign, slot->sig, sig_len);
+    }
+    /* The daemon may have reclaimed the slot while it was copied, the copy
+     * is only valid when the release succeeds */
+    uint32_t seq = ticket + 2;
+    if (!atomic_compare_exchange_strong_explicit(&slot->seq, &seq,
+                                                 ticket + COSE_CRYPTO_SIGND_SLOTS,
+                                                 memory_order_acq_rel,
+                                                 memory_order_relaxed)) {
+        return COSE_ERR_CRYPTO;
+    }
+    if (res == COSE_OK) {
+        if (sig_len > COSE_CRYPTO_SIGND_SIG_MAX) {
+            return COSE_ERR_CRYPTO;
+        }
+        *signlen = sig_len;
+    }
+    return res;
+}
+
+int cose_crypto_signd_sign(const cose_key_t *key, uint8_t *sign,
+                           size_t *signlen, const uint8_t *msg, size_t msglen)
+{
+    uint32_t ticket;
+    int res = cose_crypto_signd_request(key->signd, key, msg, msglen, &ticket);
+
+    if (res < 0) {
+        return res;
+    }
+    return cose_crypto_signd_result(key->signd, ticket, sign, signlen);
+}
+
+static const cose_key_t *_find_key(const cose_key_t *keys, size_t num,
+                                   cose_algo_t algo, const uint8_t *kid,
+                                   size_t kid_len)
+{
+    for (size_t i = 0; i < num; i++) {
+        if (keys[i].algo == algo && keys[i].kid_len == kid_len &&
+                (kid_len == 0 || memcmp(keys[i].kid, kid, kid_len) == 0)) {
+            return &keys[i];
+        }
+    }
+    return NULL;
+}
+
+static void _serve_job(void *arg)
+{
+    _signd_job_t *job = arg;
+    _signd_slot_t *slot = job->slot;
+    uint8_t sig[COSE_CRYPTO_SIGND_SIG_MAX];
+    uint8_t msg[COSE_CRYPTO_SIGND_MSG_MAX];
+    uint8_t kid[COSE_CRYPTO_SIGND_KID_MAX];
+
+    /* Work on a private copy, a client modifying the request while it is
+     * signed must not get the same nonce for two different messages */
+    cose_algo_t algo = (cose_algo_t)slot->algo;
+    size_t kid_len = slot->kid_len;
+    size_t msg_len = slot->msg_len;
+    int res = COSE_ERR_INVALID_PARAM;
+
+    if (kid_len <= sizeof(kid) && msg_len <= sizeof(msg)) {
+        memcpy(kid, slot->kid, kid_len);
+        memcpy(msg, slot->msg, msg_len);
+        const cose_key_t *key = _find_key(job->keys, job->num, algo, kid,
+                                          kid_len);
+        size_t sig_len = 0;
+        if (!key) {
+            res = COSE_ERR_NOT_FOUND;
+        }
+        else if (cose_crypto_sig_size(key) > sizeof(sig)) {
+            res = COSE_ERR_NOMEM;
+        }
+        else {
+            res = cose_crypto_sign(key, sig, &sig_len, msg, msg_len);
+        }
+        if (res == COSE_OK) {
+            memcpy(slot->sig, sig, sig_len);
+            slot->sig_len = (uint16_t)sig_len;
+        }
+    }
+    slot->res = res;
+    slot->done = _now_ms();
+    atomic_store_explicit(&slot->seq, job->pos + 2, memory_order_release);
+}
+
+/* Release the claim at the tail when its client stopped before publishing
+ * the request, returns true when the tail moved past it */
+static bool _reclaim_stalled(cose_signd_ring_t *ring, uint32_t tail,
+                             uint32_t timeout)
+{
+    _signd_slot_t *slot = &ring->slot[tail & SIGND_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+    if (atomic_load_explicit(&ring->head, memory_order_relaxed) == tail ||
+            (seq != tail && seq != tail + 3)) {
+        ring->stalled = false;
+        return false;
+    }
+    if (!ring->stalled) {
+        ring->stalled = true;
+        ring->stall_since = _now_ms();
+        return false;
+    }
+    if (!_expired(ring->stall_since, timeout) ||
+            !atomic_compare_exchange_strong_explicit(&slot->seq, &seq,
+                                                     tail + COSE_CRYPTO_SIGND_SLOTS,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed)) {
+        return false;
+    }
+    ring->stalled = false;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_relaxed);
+    return true;
+}
+
+/* Release answered slots that their clients never collected */
+static void _reclaim_answered(cose_signd_ring_t *ring, uint32_t timeout)
+{
+    for (uint32_t i = 0; i < COSE_CRYPTO_SIGND_SLOTS; i++) {
+        _signd_slot_t *slot = &ring->slot[i];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (((seq - 2U) & SIGND_MASK) != i || !_expired(slot->done, timeout)) {
+            continue;
+        }
+        atomic_compare_exchange_strong_explicit(&slot->seq, &seq,
+                                                seq - 2U + COSE_CRYPTO_SIGND_SLOTS,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed);
+    }
+}
+
+size_t cose_crypto_signd_serve(cose_signd_ring_t *ring, const cose_key_t *keys,
+                               size_t num, const cose_executor_t *exec)
+{
+    _signd_job_t jobs[COSE_CRYPTO_SIGND_BATCH];
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t count = 0;
+
+    for (; count < COSE_CRYPTO_SIGND_BATCH; count++) {
+        uint32_t pos = tail + (uint32_t)count;
+        _signd_slot_t *slot = &ring->slot[pos & SIGND_MASK];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+            break;
+        }
+        jobs[count].slot = slot;
+        jobs[count].keys = keys;
+        jobs[count].num = num;
+        jobs[count].pos = pos;
+    }
+    if (count == 0) {
+        uint32_t timeout = atomic_load_explicit(&ring->reclaim_ms,
+                                                memory_order_relaxed);
+        if (timeout) {
+            _reclaim_stalled(ring, tail, timeout);
+            _reclaim_answered(ring, timeout);
+        }
+        return 0;
+    }
+
+    ring->stalled = false;
+    bool queued = false;
+    for (size_t i = 0; i < count; i++) {
+        if (exec && exec->submit(exec->ctx, _serve_job, &jobs[i]) >= 0) {
+            queued = true;
+        }
+        else {
+            _serve_job(&jobs[i]);
+        }
+    }
+    if (queued) {
+        exec->wait(exec->ctx);
+    }
+    atomic_store_explicit(&ring->tail, tail + (uint32_t)count,
+                          memory_order_relaxed);
+    return count;
+}
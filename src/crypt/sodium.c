@@ -15,6 +15,9 @@
 #include "cose/crypto.h"
 #include "cose/crypto/selectors.h"
 #include <sodium/crypto_aead_chacha20poly1305.h>
+#include <sodium/crypto_auth_hmacsha256.h>
+#include <sodium/crypto_auth_hmacsha512.h>
+#include <sodium/crypto_scalarmult.h>
 #include <sodium/crypto_sign.h>
 #include <sodium/randombytes.h>
 #include <stdint.h>
@@ -99,11 +102,14 @@ int cose_crypto_verify_ed25519(const cose_key_t *key, const uint8_t *sign, size_
     return crypto_sign_verify_detached(sign, msg, msglen, key->x);
 }
 
-void cose_crypto_keypair_ed25519(cose_key_t *key)
+int cose_crypto_keypair_ed25519(cose_key_t *key)
 {
     uint8_t skey[crypto_sign_SECRETKEYBYTES];
-    crypto_sign_keypair(key->x, skey);
+    if (crypto_sign_keypair(key->x, skey) != 0) {
+        return COSE_ERR_CRYPTO;
+    }
     memcpy(key->d, skey, COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES);
+    return COSE_OK;
 }
 
 size_t cose_crypto_sig_size_ed25519(void)
@@ -111,3 +117,45 @@ size_t cose_crypto_sig_size_ed25519(void)
     return crypto_sign_BYTES;
 }
 #endif /* CRYPTO_SODIUM_INCLUDE_ED25519 */
+
+#ifdef CRYPTO_SODIUM_INCLUDE_HMAC
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac)
+{
+    if (hash == COSE_CRYPTO_HASH_SHA256) {
+        crypto_auth_hmacsha256_state state;
+        crypto_auth_hmacsha256_init(&state, key, key_len);
+        for (size_t i = 0; i < num; i++) {
+            crypto_auth_hmacsha256_update(&state, msg[i].buf, msg[i].len);
+        }
+        crypto_auth_hmacsha256_final(&state, mac);
+        return COSE_OK;
+    }
+    if (hash == COSE_CRYPTO_HASH_SHA512) {
+        crypto_auth_hmacsha512_state state;
+        crypto_auth_hmacsha512_init(&state, key, key_len);
+        for (size_t i = 0; i < num; i++) {
+            crypto_auth_hmacsha512_update(&state, msg[i].buf, msg[i].len);
+        }
+        crypto_auth_hmacsha512_final(&state, mac);
+        return COSE_OK;
+    }
+    return COSE_ERR_NOTIMPLEMENTED;
+}
+#endif /* CRYPTO_SODIUM_INCLUDE_HMAC */
+
+#ifdef CRYPTO_SODIUM_INCLUDE_X25519
+int cose_crypto_ecdh_x25519(const cose_key_t *key, const cose_key_t *peer,
+                            uint8_t *secret)
+{
+    if (!key->d) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    /* Fails on an all zero output from a low order point */
+    if (crypto_scalarmult(secret, key->d, peer->x) != 0) {
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+#endif /* CRYPTO_SODIUM_INCLUDE_X25519 */
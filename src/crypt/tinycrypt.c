@@ -20,6 +20,10 @@
 #include <tinycrypt/ecc_dh.h>
 #include <tinycrypt/ecc_dsa.h>
 #include <tinycrypt/sha256.h>
+#if defined(COSE_ECDSA_DETERMINISTIC) || \
+    defined(CRYPTO_TINYCRYPT_INCLUDE_HMAC)
+#include <tinycrypt/hmac.h>
+#endif
 
 extern cose_crypt_rng cose_crypt_get_random;
 extern void *cose_crypt_rng_arg;
@@ -31,49 +35,25 @@ int default_CSPRNG(uint8_t *dest, unsigned size)
     return 1;
 }
 
-static int _mac_len(cose_algo_t algo) {
-    switch(algo) {
-        case COSE_ALGO_AESCCM_16_64_128:
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_64_256:
-            return COSE_CRYPTO_AEAD_AESCCM_16_64_128_ABYTES;
-        case COSE_ALGO_AESCCM_16_128_128:
-        case COSE_ALGO_AESCCM_16_128_256:
-        case COSE_ALGO_AESCCM_64_128_128:
-        case COSE_ALGO_AESCCM_64_128_256:
-            return COSE_CRYPTO_AEAD_AESCCM_16_128_128_ABYTES;
-        default:
-            return 0;
-    }
-}
-
+#ifdef CRYPTO_TINYCRYPT_INCLUDE_AESCCM
 static int _set_config(struct tc_ccm_mode_struct *ctx,
                        struct tc_aes_key_sched_struct *key,
-                       cose_algo_t algo,
+                       const cose_crypto_algo_t *desc,
                        const uint8_t *npub,
                        const uint8_t *k)
 {
-    int res = 0;
+    if (!desc || desc->cls != COSE_CRYPTO_ALGO_AEAD) {
+        return COSE_ERR_CRYPTO;
+    }
+    /* tinycrypt only provides AES-128 with the 13 byte nonce (L = 2) */
+    if (desc->key_len != 16 ||
+            desc->nonce_len != COSE_CRYPTO_AEAD_AESCCM_16_64_128_NONCEBYTES) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
     tc_aes128_set_encrypt_key(key, k); /* Set the key */
 
-    switch(algo) {
-        case COSE_ALGO_AESCCM_16_64_256:
-        case COSE_ALGO_AESCCM_64_64_256:
-        case COSE_ALGO_AESCCM_16_128_256:
-        case COSE_ALGO_AESCCM_64_128_256:
-        case COSE_ALGO_AESCCM_64_64_128:
-        case COSE_ALGO_AESCCM_64_128_128:
-            return COSE_ERR_NOTIMPLEMENTED;
-        case COSE_ALGO_AESCCM_16_64_128:
-            res = tc_ccm_config(ctx, key, (uint8_t*)npub, 13, 8);
-            break;
-        case COSE_ALGO_AESCCM_16_128_128:
-            res = tc_ccm_config(ctx, key, (uint8_t*)npub, 13, 16);
-            break;
-        default:
-            return COSE_ERR_CRYPTO;
-    }
+    int res = tc_ccm_config(ctx, key, (uint8_t*)npub, desc->nonce_len,
+                            desc->tag_len);
     return res == TC_CRYPTO_FAIL ? COSE_ERR_CRYPTO : COSE_OK;
 }
 
@@ -91,13 +71,14 @@ int cose_crypto_aead_encrypt_aesccm(uint8_t *c,
 {
     struct tc_ccm_mode_struct ctx;
     struct tc_aes_key_sched_struct key;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
 
-    int res = _set_config(&ctx, &key, algo, npub, k);
+    int res = _set_config(&ctx, &key, desc, npub, k);
     if (res != COSE_OK) {
         return res;
     }
 
-    *clen = msglen + _mac_len(algo);
+    *clen = msglen + desc->tag_len;
 
     res = tc_ccm_generation_encryption(c, *clen, aad, aadlen, msg, msglen, &ctx);
 
@@ -116,18 +97,23 @@ int cose_crypto_aead_decrypt_aesccm(uint8_t *msg,
 {
     struct tc_ccm_mode_struct ctx;
     struct tc_aes_key_sched_struct key;
+    const cose_crypto_algo_t *desc = cose_crypto_algo_get(algo);
 
-    int res = _set_config(&ctx, &key, algo, npub, k);
+    int res = _set_config(&ctx, &key, desc, npub, k);
     if (res != COSE_OK) {
         return res;
     }
-    *msglen = clen - _mac_len(algo);
+    if (clen < desc->tag_len) {
+        return COSE_ERR_CRYPTO;
+    }
+    *msglen = clen - desc->tag_len;
 
     res = tc_ccm_decryption_verification(msg, *msglen,
                                          aad, aadlen, c, clen, &ctx);
 
     return res ? COSE_OK : COSE_ERR_CRYPTO;
 }
+#endif /* CRYPTO_TINYCRYPT_INCLUDE_AESCCM */
 
 size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
 {
@@ -135,35 +121,128 @@ size_t cose_crypto_sig_size_ecdsa(cose_curve_t curve)
     return COSE_CRYPTO_SIGN_P256_SIGNBYTES;
 }
 
-void cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
+int cose_crypto_keypair_ecdsa(cose_key_t *key, cose_curve_t curve)
 {
-    (void)curve; /* Only COSE_EC_CURVE_P256 supported */
     uint8_t public[64];
 
+    if (curve != COSE_EC_CURVE_P256) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+
     uECC_set_rng(default_CSPRNG);
 
-    uECC_make_key(public, key->d, uECC_secp256r1());
+    if (uECC_make_key(public, key->d, uECC_secp256r1()) != 1) {
+        return COSE_ERR_CRYPTO;
+    }
 
     memcpy(key->x, public, 32);
     memcpy(key->y, public + 32, 32);
 
     key->crv = COSE_EC_CURVE_P256;
+    return COSE_OK;
+}
+
+#ifdef COSE_ECDSA_DETERMINISTIC
+/* Not part of the public tinycrypt headers */
+int uECC_sign_with_k(const uint8_t *private_key, const uint8_t *message_hash,
+                     unsigned hash_size, uECC_word_t *k, uint8_t *signature,
+                     uECC_Curve curve);
+
+/* Order of the P-256 group */
+static const uint8_t _p256_n[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xBC, 0xE6, 0xFA, 0xAD, 0xA7, 0x17, 0x9E, 0x84,
+    0xF3, 0xB9, 0xCA, 0xC2, 0xFC, 0x63, 0x25, 0x51,
+};
+
+/* HMAC_K(V [|| sep [|| x || h]]) */
+static void _hmac_sha256(uint8_t *out, const uint8_t *k, const uint8_t *v,
+                         const uint8_t *sep, const uint8_t *x,
+                         const uint8_t *h)
+{
+    struct tc_hmac_state_struct ctx;
+
+    tc_hmac_set_key(&ctx, k, 32);
+    tc_hmac_init(&ctx);
+    tc_hmac_update(&ctx, v, 32);
+    if (sep) {
+        tc_hmac_update(&ctx, sep, 1);
+    }
+    if (x) {
+        tc_hmac_update(&ctx, x, 32);
+        tc_hmac_update(&ctx, h, 32);
+    }
+    tc_hmac_final(out, 32, &ctx);
 }
 
+/* RFC 6979 section 3.2, with qlen and hlen both 256 bit */
+static int _sign_deterministic(const uint8_t *d, const uint8_t *hash,
+                               uint8_t *sign)
+{
+    uint8_t h1[32];
+    uint8_t v[32];
+    uint8_t k[32];
+    uECC_word_t kw[NUM_ECC_WORDS];
+    int res = COSE_ERR_CRYPTO;
+
+    /* bits2octets(), the hash reduced modulo n */
+    memcpy(h1, hash, sizeof(h1));
+    if (memcmp(h1, _p256_n, sizeof(h1)) >= 0) {
+        unsigned borrow = 0;
+        for (size_t i = sizeof(h1); i-- > 0;) {
+            unsigned diff = (unsigned)h1[i] - _p256_n[i] - borrow;
+            h1[i] = (uint8_t)diff;
+            borrow = (diff >> 8) & 1;
+        }
+    }
+
+    memset(v, 0x01, sizeof(v));
+    memset(k, 0x00, sizeof(k));
+    for (uint8_t sep = 0; sep < 2; sep++) {
+        _hmac_sha256(k, k, v, &sep, d, h1);
+        _hmac_sha256(v, k, v, NULL, NULL, NULL);
+    }
+
+    /* Candidates outside [1, n - 1] are rejected by uECC_sign_with_k, the
+     * chance of needing a second round is negligible */
+    for (unsigned i = 0; i < 4; i++) {
+        _hmac_sha256(v, k, v, NULL, NULL, NULL);
+        uECC_vli_bytesToNative(kw, v, sizeof(v));
+        if (uECC_sign_with_k(d, hash, 32, kw, sign, uECC_secp256r1())) {
+            res = COSE_OK;
+            break;
+        }
+        const uint8_t zero = 0;
+        _hmac_sha256(k, k, v, &zero, NULL, NULL);
+        _hmac_sha256(v, k, v, NULL, NULL, NULL);
+    }
+    memset(k, 0, sizeof(k));
+    memset(v, 0, sizeof(v));
+    memset(kw, 0, sizeof(kw));
+    return res;
+}
+#endif /* COSE_ECDSA_DETERMINISTIC */
+
 int cose_crypto_sign_ecdsa(const cose_key_t *key, uint8_t *sign, size_t *signlen, uint8_t *msg,  size_t msglen)
 {
     struct tc_sha256_state_struct ctx;
     uint8_t hash[32];
 
-    uECC_set_rng(default_CSPRNG);
-
     tc_sha256_init(&ctx);
     tc_sha256_update(&ctx, msg, msglen);
     tc_sha256_final(hash, &ctx);
 
-    int res = uECC_sign(key->d, hash, sizeof(hash), sign, uECC_secp256r1());
     *signlen = COSE_CRYPTO_SIGN_P256_SIGNBYTES;
+#ifdef COSE_ECDSA_DETERMINISTIC
+    /* The RNG is only used for blinding when key generation registered it */
+    return _sign_deterministic(key->d, hash, sign);
+#else
+    uECC_set_rng(default_CSPRNG);
+
+    int res = uECC_sign(key->d, hash, sizeof(hash), sign, uECC_secp256r1());
     return res ? COSE_OK : COSE_ERR_CRYPTO;
+#endif
 }
 
 int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t signlen, uint8_t *msg, size_t msglen)
@@ -188,3 +267,56 @@ int cose_crypto_verify_ecdsa(const cose_key_t *key, const uint8_t *sign, size_t
     int res = uECC_verify(pubkey, hash, sizeof(hash), (uint8_t*)sign, uECC_secp256r1());
     return res ? COSE_OK : COSE_ERR_CRYPTO;
 }
+
+#ifdef CRYPTO_TINYCRYPT_INCLUDE_HMAC
+int cose_crypto_hmac(cose_crypto_hash_t hash, const uint8_t *key,
+                     size_t key_len, const cose_crypto_chunk_t *msg,
+                     size_t num, uint8_t *mac)
+{
+    struct tc_hmac_state_struct state;
+
+    if (hash != COSE_CRYPTO_HASH_SHA256) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (tc_hmac_set_key(&state, key, key_len) != TC_CRYPTO_SUCCESS ||
+            tc_hmac_init(&state) != TC_CRYPTO_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (msg[i].len &&
+                tc_hmac_update(&state, msg[i].buf, msg[i].len) !=
+                TC_CRYPTO_SUCCESS) {
+            return COSE_ERR_CRYPTO;
+        }
+    }
+    if (tc_hmac_final(mac, TC_SHA256_DIGEST_SIZE, &state) !=
+            TC_CRYPTO_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    return COSE_OK;
+}
+#endif /* CRYPTO_TINYCRYPT_INCLUDE_HMAC */
+
+#ifdef CRYPTO_TINYCRYPT_INCLUDE_ECDH
+int cose_crypto_ecdh_ecp(const cose_key_t *key, const cose_key_t *peer,
+                         uint8_t *secret, size_t *secret_len)
+{
+    uint8_t pubkey[64];
+
+    if (key->crv != COSE_EC_CURVE_P256) {
+        return COSE_ERR_NOTIMPLEMENTED;
+    }
+    if (!key->d) {
+        return COSE_ERR_INVALID_PARAM;
+    }
+    memcpy(pubkey, peer->x, 32);
+    memcpy(pubkey + 32, peer->y, 32);
+    if (uECC_valid_public_key(pubkey, uECC_secp256r1()) < 0 ||
+            uECC_shared_secret(pubkey, key->d, secret, uECC_secp256r1()) !=
+            TC_CRYPTO_SUCCESS) {
+        return COSE_ERR_CRYPTO;
+    }
+    *secret_len = 32;
+    return COSE_OK;
+}
+#endif /* CRYPTO_TINYCRYPT_INCLUDE_ECDH */
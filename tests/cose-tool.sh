@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Copyright (C) 2021 Inria
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+#
+# End-to-end checks of cose-tool, run with `make test-tool`.
+#
+# usage: cose-tool.sh PATH-TO-COSE-TOOL
+
+TOOL=$(realpath "$1")
+DIR=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$DIR"' EXIT
+cd "$DIR" || exit 1
+
+fail() {
+    echo "FAIL $1"
+    FAILED=1
+}
+
+# Run the tool, killing it when it hangs
+tool() {
+    timeout 10 "$TOOL" -q "$@" > out.txt 2>&1
+}
+
+tool keygen key || fail "keygen"
+tool -n 4 keyset fleet || fail "keyset"
+[ "$(stat -c %a key.key)" = 600 ] || fail "secret key file mode"
+[ "$(stat -c %a fleet.keys)" = 600 ] || fail "private key set file mode"
+
+echo "payload" > msg
+tool -k key.key -i unknown sign msg || fail "sign"
+tool -k key.pub verify msg.cose || fail "verify"
+
+# Key ID not in the keystore
+tool -K fleet.kst verify msg.cose
+[ $? -eq 1 ] && grep -q "not found" out.txt || fail "verify with unknown key ID"
+
+# Signature without a key ID
+echo "payload" > nokid
+tool -k key.key sign nokid || fail "sign without key ID"
+tool -K fleet.kst verify nokid.cose
+[ $? -eq 1 ] && grep -q "not found" out.txt || fail "verify without key ID"
+
+if [ $FAILED -ne 0 ]; then
+    exit 1
+fi
+echo "cose-tool: all checks passed"
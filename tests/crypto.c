@@ -24,6 +24,7 @@ void test_crypto1(void)
 
     size_t signaturelen = 0;
     cose_key_t key;
+    cose_key_init(&key);
     key.d = sk;
     key.x = pk;
     cose_crypto_keypair_ed25519(&key);
@@ -111,6 +112,51 @@ void test_crypto_chacha_vector(void)
     CU_ASSERT_EQUAL(msglen, sizeof(msg_1));
     CU_ASSERT_EQUAL(memcmp(msg_1, plaintext, sizeof(msg_1)), 0);
 }
+
+/* Long message to exercise the multi block vector paths */
+static const uint8_t chacha_long_tag[] = {
+    0x9d, 0x5e, 0x54, 0x2e, 0x73, 0x32, 0xe9, 0x3b,
+    0x4b, 0xe2, 0xf1, 0x01, 0x50, 0x9c, 0xf9, 0x52,
+};
+
+void test_crypto_chacha_long(void)
+{
+    static uint8_t msg[5000];
+    static uint8_t ciphertext[sizeof(msg) + COSE_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES];
+    static uint8_t plaintext[sizeof(msg)];
+    uint8_t key[COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES];
+    uint8_t nonce[COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES];
+    uint8_t aad[37];
+    size_t cipherlen = 0;
+    size_t msglen = 0;
+
+    for (size_t i = 0; i < sizeof(msg); i++) {
+        msg[i] = (uint8_t)(i * 7 + 1);
+    }
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)i;
+    }
+    for (size_t i = 0; i < sizeof(nonce); i++) {
+        nonce[i] = (uint8_t)(0xa0 + i);
+    }
+    for (size_t i = 0; i < sizeof(aad); i++) {
+        aad[i] = (uint8_t)(0x55 ^ i);
+    }
+    CU_ASSERT_EQUAL(cose_crypto_aead_encrypt_chachapoly(ciphertext, &cipherlen, msg, sizeof(msg), aad, sizeof(aad), nonce, key), 0);
+    CU_ASSERT_EQUAL(cipherlen, sizeof(ciphertext));
+    CU_ASSERT_EQUAL(memcmp(ciphertext + sizeof(msg), chacha_long_tag, sizeof(chacha_long_tag)), 0);
+    CU_ASSERT_EQUAL(
+        cose_crypto_aead_decrypt_chachapoly(plaintext, &msglen, ciphertext, cipherlen, aad, sizeof(aad), nonce, key),
+        0 );
+    CU_ASSERT_EQUAL(msglen, sizeof(msg));
+    CU_ASSERT_EQUAL(memcmp(msg, plaintext, sizeof(msg)), 0);
+
+    /* Tampering anywhere in the ciphertext must be detected */
+    ciphertext[3000] ^= 0x01;
+    CU_ASSERT_NOT_EQUAL(
+        cose_crypto_aead_decrypt_chachapoly(plaintext, &msglen, ciphertext, cipherlen, aad, sizeof(aad), nonce, key),
+        0 );
+}
 #endif
 
 #ifdef HAVE_ALGO_AES128GCM
@@ -186,7 +232,721 @@ void test_crypto_aes256(void)
 }
 #endif
 
+#ifdef HAVE_ALGO_AES256GCM
+/* McGrew and Viega, GCM test case 14 */
+static const uint8_t gcm_key_14[32] = { 0 };
+static const uint8_t gcm_nonce_14[12] = { 0 };
+static const uint8_t gcm_msg_14[16] = { 0 };
+static const uint8_t gcm_ciphertext_14[] = {
+    0xce, 0xa7, 0x40, 0x3d, 0x4d, 0x60, 0x6b, 0x6e, 0x07, 0x4e, 0xc5, 0xd3,
+    0xba, 0xf3, 0x9d, 0x18, 0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0,
+    0x26, 0x5b, 0x98, 0xb5, 0xd4, 0x8a, 0xb9, 0x19,
+};
+
+void test_crypto_aesgcm_vector(void)
+{
+    unsigned char ciphertext[sizeof(gcm_msg_14) + COSE_CRYPTO_AEAD_AES256GCM_ABYTES];
+    unsigned char plaintext[sizeof(gcm_msg_14)];
+    size_t cipherlen = 0;
+    size_t msglen = 0;
+
+    CU_ASSERT_EQUAL(cose_crypto_aead_encrypt_aesgcm(ciphertext, &cipherlen, gcm_msg_14, sizeof(gcm_msg_14), NULL, 0, gcm_nonce_14, gcm_key_14, COSE_ALGO_A256GCM), 0);
+    CU_ASSERT_EQUAL(cipherlen, sizeof(gcm_ciphertext_14));
+    CU_ASSERT_EQUAL(memcmp(ciphertext, gcm_ciphertext_14, sizeof(gcm_ciphertext_14)), 0);
+    CU_ASSERT_EQUAL(
+        cose_crypto_aead_decrypt_aesgcm(plaintext, &msglen, ciphertext, cipherlen, NULL, 0, gcm_nonce_14, gcm_key_14, COSE_ALGO_A256GCM),
+        0 );
+    CU_ASSERT_EQUAL(msglen, sizeof(gcm_msg_14));
+    CU_ASSERT_EQUAL(memcmp(gcm_msg_14, plaintext, sizeof(gcm_msg_14)), 0);
+    /* Tampered tag */
+    ciphertext[cipherlen - 1] ^= 0x01;
+    CU_ASSERT_EQUAL(
+        cose_crypto_aead_decrypt_aesgcm(plaintext, &msglen, ciphertext, cipherlen, NULL, 0, gcm_nonce_14, gcm_key_14, COSE_ALGO_A256GCM),
+        COSE_ERR_CRYPTO );
+}
+#endif
+
+#ifdef HAVE_ALGO_AESCCM_16_64_128
+/* RFC 3610 packet vector #1 */
+static const uint8_t ccm_key_1[16] = {
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf
+};
+static const uint8_t ccm_nonce_1[13] = {
+    0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5
+};
+static const uint8_t ccm_aad_1[] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+};
+static const uint8_t ccm_msg_1[] = {
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e
+};
+static const uint8_t ccm_ciphertext_1[] = {
+    0x58, 0x8c, 0x97, 0x9a, 0x61, 0xc6, 0x63, 0xd2, 0xf0, 0x66, 0xd0, 0xc2,
+    0xc0, 0xf9, 0x89, 0x80, 0x6d, 0x5f, 0x6b, 0x61, 0xda, 0xc3, 0x84, 0x17,
+    0xe8, 0xd1, 0x2c, 0xfd, 0xf9, 0x26, 0xe0
+};
+
+void test_crypto_aesccm_vector(void)
+{
+    unsigned char ciphertext[sizeof(ccm_msg_1) + COSE_CRYPTO_AEAD_AESCCM_16_64_128_ABYTES];
+    unsigned char plaintext[sizeof(ccm_msg_1)];
+    size_t cipherlen = 0;
+    size_t msglen = 0;
+
+    CU_ASSERT_EQUAL(cose_crypto_aead_encrypt_aesccm(ciphertext, &cipherlen, ccm_msg_1, sizeof(ccm_msg_1), ccm_aad_1, sizeof(ccm_aad_1), ccm_nonce_1, ccm_key_1, COSE_ALGO_AESCCM_16_64_128), 0);
+    CU_ASSERT_EQUAL(cipherlen, sizeof(ccm_ciphertext_1));
+    CU_ASSERT_EQUAL(memcmp(ciphertext, ccm_ciphertext_1, sizeof(ccm_ciphertext_1)), 0);
+    CU_ASSERT_EQUAL(
+        cose_crypto_aead_decrypt_aesccm(plaintext, &msglen, ciphertext, cipherlen, ccm_aad_1, sizeof(ccm_aad_1), ccm_nonce_1, ccm_key_1, COSE_ALGO_AESCCM_16_64_128),
+        0 );
+    CU_ASSERT_EQUAL(msglen, sizeof(ccm_msg_1));
+    CU_ASSERT_EQUAL(memcmp(ccm_msg_1, plaintext, sizeof(ccm_msg_1)), 0);
+}
+#endif
+
+#if defined(HAVE_ALGO_AESCCM_64_128_256)
+void test_crypto_aesccm(void)
+{
+    static const cose_algo_t algos[] = {
+        COSE_ALGO_AESCCM_16_64_128, COSE_ALGO_AESCCM_64_64_128,
+        COSE_ALGO_AESCCM_16_128_128, COSE_ALGO_AESCCM_64_128_128,
+        COSE_ALGO_AESCCM_16_64_256, COSE_ALGO_AESCCM_64_64_256,
+        COSE_ALGO_AESCCM_16_128_256, COSE_ALGO_AESCCM_64_128_256,
+    };
+    uint8_t payload[] = "Input string";
+    uint8_t additional_data[] = "Extra signed data";
+    uint8_t sk[32];
+    uint8_t nonce[COSE_CRYPTO_AEAD_AESCCM_16_64_128_NONCEBYTES] = { 0 };
+    unsigned char ciphertext[sizeof(payload) + 16];
+    unsigned char plaintext[sizeof(payload)];
+
+    for (size_t i = 0; i < sizeof(algos) / sizeof(algos[0]); i++) {
+        size_t cipherlen = 0;
+        size_t msglen = 0;
+        memset(sk, (int)i + 1, sizeof(sk));
+        CU_ASSERT_EQUAL(cose_crypto_aead_encrypt(ciphertext, &cipherlen, payload, sizeof(payload), additional_data, sizeof(additional_data), NULL, nonce, sk, algos[i]), 0);
+        CU_ASSERT_EQUAL(cipherlen, sizeof(payload) + (i & 2 ? 16 : 8));
+        CU_ASSERT_EQUAL(
+            cose_crypto_aead_decrypt(plaintext, &msglen, ciphertext, cipherlen, additional_data, sizeof(additional_data), nonce, sk, algos[i]),
+            0 );
+        CU_ASSERT_EQUAL(msglen, sizeof(payload));
+        CU_ASSERT_EQUAL(memcmp(payload, plaintext, sizeof(payload)), 0);
+    }
+}
+#endif
+
+#if defined(HAVE_ALGO_ECDSA) && defined(COSE_ECDSA_DETERMINISTIC)
+void test_crypto_ecdsa_deterministic(void)
+{
+    const uint8_t payload[] = "Input string";
+    uint8_t x[66];
+    uint8_t y[66];
+    uint8_t d[66];
+    unsigned char sig1[COSE_CRYPTO_SIGN_P521_SIGNBYTES * 2];
+    unsigned char sig2[sizeof(sig1)];
+    size_t sig1_len = 0;
+    size_t sig2_len = 0;
+    cose_key_t key;
+
+    cose_key_init(&key);
+    cose_key_set_keys(&key, COSE_EC_CURVE_P256, COSE_ALGO_ES256, x, y, d);
+    cose_crypto_keypair_ecdsa(&key, COSE_EC_CURVE_P256);
+
+    CU_ASSERT_EQUAL(cose_crypto_sign_ecdsa(&key, sig1, &sig1_len,
+                                           (uint8_t*)payload,
+                                           sizeof(payload)), COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_sign_ecdsa(&key, sig2, &sig2_len,
+                                           (uint8_t*)payload,
+                                           sizeof(payload)), COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(sig1_len, sig2_len);
+    CU_ASSERT_EQUAL(memcmp(sig1, sig2, sig1_len), 0);
+    CU_ASSERT_EQUAL(cose_crypto_verify_ecdsa(&key, sig1, sig1_len,
+                                             (uint8_t*)payload,
+                                             sizeof(payload)), COSE_OK);
+
+#if defined(CRYPTO_TINYCRYPT) || defined(CRYPTO_PSA)
+    /* RFC 6979 A.2.5, P-256 with SHA-256, message "sample" */
+    static const uint8_t sk[32] = {
+        0xC9, 0xAF, 0xA9, 0xD8, 0x45, 0xBA, 0x75, 0x16,
+        0x6B, 0x5C, 0x21, 0x57, 0x67, 0xB1, 0xD6, 0x93,
+        0x4E, 0x50, 0xC3, 0xDB, 0x36, 0xE8, 0x9B, 0x12,
+        0x7B, 0x8A, 0x62, 0x2B, 0x12, 0x0F, 0x67, 0x21,
+    };
+    static const uint8_t rs[64] = {
+        0xEF, 0xD4, 0x8B, 0x2A, 0xAC, 0xB6, 0xA8, 0xFD,
+        0x11, 0x40, 0xDD, 0x9C, 0xD4, 0x5E, 0x81, 0xD6,
+        0x9D, 0x2C, 0x87, 0x7B, 0x56, 0xAA, 0xF9, 0x91,
+        0xC3, 0x4D, 0x0E, 0xA8, 0x4E, 0xAF, 0x37, 0x16,
+        0xF7, 0xCB, 0x1C, 0x94, 0x2D, 0x65, 0x7C, 0x41,
+        0xD4, 0x36, 0xC7, 0xA1, 0xB6, 0xE2, 0x9F, 0x65,
+        0xF3, 0xE9, 0x00, 0xDB, 0xB9, 0xAF, 0xF4, 0x06,
+        0x4D, 0xC4, 0xAB, 0x2F, 0x84, 0x3A, 0xCD, 0xA8,
+    };
+    memcpy(d + COSE_CRYPTO_EC2_KEYBYTES - sizeof(sk), sk, sizeof(sk));
+    CU_ASSERT_EQUAL(cose_crypto_sign_ecdsa(&key, sig1, &sig1_len,
+                                           (uint8_t*)"sample", 6), COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(sig1_len, sizeof(rs));
+    CU_ASSERT_EQUAL(memcmp(sig1, rs, sizeof(rs)), 0);
+#endif
+}
+#endif
+
+#ifdef HAVE_ALGO_HMAC_SHA256
+/* RFC 5869 test cases 1 and 3 */
+void test_crypto_hkdf_vector(void)
+{
+    static const uint8_t salt[] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c,
+    };
+    static const uint8_t info[] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+    };
+    static const uint8_t prk1[] = {
+        0x07, 0x77, 0x09, 0x36, 0x2c, 0x2e, 0x32, 0xdf,
+        0x0d, 0xdc, 0x3f, 0x0d, 0xc4, 0x7b, 0xba, 0x63,
+        0x90, 0xb6, 0xc7, 0x3b, 0xb5, 0x0f, 0x9c, 0x31,
+        0x22, 0xec, 0x84, 0x4a, 0xd7, 0xc2, 0xb3, 0xe5,
+    };
+    static const uint8_t okm1[] = {
+        0x3c, 0xb2, 0x5f, 0x25, 0xfa, 0xac, 0xd5, 0x7a,
+        0x90, 0x43, 0x4f, 0x64, 0xd0, 0x36, 0x2f, 0x2a,
+        0x2d, 0x2d, 0x0a, 0x90, 0xcf, 0x1a, 0x5a, 0x4c,
+        0x5d, 0xb0, 0x2d, 0x56, 0xec, 0xc4, 0xc5, 0xbf,
+        0x34, 0x00, 0x72, 0x08, 0xd5, 0xb8, 0x87, 0x18,
+        0x58, 0x65,
+    };
+    static const uint8_t okm3[] = {
+        0x8d, 0xa4, 0xe7, 0x75, 0xa5, 0x63, 0xc1, 0x8f,
+        0x71, 0x5f, 0x80, 0x2a, 0x06, 0x3c, 0x5a, 0x31,
+        0xb8, 0xa1, 0x1f, 0x5c, 0x5e, 0xe1, 0x87, 0x9e,
+        0xc3, 0x45, 0x4e, 0x5f, 0x3c, 0x73, 0x8d, 0x2d,
+        0x9d, 0x20, 0x13, 0x95, 0xfa, 0xa4, 0xb6, 0x1a,
+        0x96, 0xc8,
+    };
+    uint8_t ikm[22];
+    uint8_t prk[COSE_CRYPTO_HASH_MAXBYTES];
+    uint8_t okm[sizeof(okm1)];
+
+    memset(ikm, 0x0b, sizeof(ikm));
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_extract(COSE_ALGO_DIRECT_HKDF_SHA256,
+                                             salt, sizeof(salt), ikm,
+                                             sizeof(ikm), prk), COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(prk, prk1, sizeof(prk1)), 0);
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_expand(COSE_ALGO_DIRECT_HKDF_SHA256,
+                                            prk, info, sizeof(info), okm,
+                                            sizeof(okm)), COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(okm, okm1, sizeof(okm1)), 0);
+
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_extract(COSE_ALGO_DIRECT_HKDF_SHA256,
+                                             NULL, 0, ikm, sizeof(ikm), prk),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_expand(COSE_ALGO_DIRECT_HKDF_SHA256,
+                                            prk, NULL, 0, okm, sizeof(okm)),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(okm, okm3, sizeof(okm3)), 0);
+
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_expand(COSE_ALGO_DIRECT_HKDF_SHA256,
+                                            prk, NULL, 0, okm, 255 * 32 + 1),
+                    COSE_ERR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(cose_crypto_hkdf_extract(COSE_ALGO_A128GCM, NULL, 0, ikm,
+                                             sizeof(ikm), prk),
+                    COSE_ERR_NOTIMPLEMENTED);
+}
+#endif
+
+#ifdef HAVE_CURVE_X25519
+/* RFC 7748 section 6.1 */
+static const uint8_t x25519_a_priv[] = {
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+    0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+    0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a,
+};
+static const uint8_t x25519_a_pub[] = {
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+    0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+    0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a,
+};
+static const uint8_t x25519_b_priv[] = {
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+    0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+    0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb,
+};
+static const uint8_t x25519_b_pub[] = {
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+    0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+    0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f,
+};
+
+void test_crypto_x25519_vector(void)
+{
+    static const uint8_t shared[] = {
+        0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1,
+        0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+        0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33,
+        0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42,
+    };
+    uint8_t secret[COSE_CRYPTO_ECDH_MAXBYTES];
+    size_t secret_len = 0;
+    cose_key_t a, b;
+
+    cose_key_init(&a);
+    cose_key_init(&b);
+    cose_key_set_keys(&a, COSE_EC_CURVE_X25519, COSE_ALGO_NONE,
+                      (uint8_t *)x25519_a_pub, NULL, (uint8_t *)x25519_a_priv);
+    cose_key_set_keys(&b, COSE_EC_CURVE_X25519, COSE_ALGO_NONE,
+                      (uint8_t *)x25519_b_pub, NULL, (uint8_t *)x25519_b_priv);
+
+    CU_ASSERT_EQUAL(cose_crypto_ecdh(&a, &b, secret, &secret_len), COSE_OK);
+    CU_ASSERT_EQUAL(secret_len, sizeof(shared));
+    CU_ASSERT_EQUAL(memcmp(secret, shared, sizeof(shared)), 0);
+    memset(secret, 0, sizeof(secret));
+    CU_ASSERT_EQUAL(cose_crypto_ecdh(&b, &a, secret, &secret_len), COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(secret, shared, sizeof(shared)), 0);
+
+    /* Mismatching curves and missing private keys */
+    b.crv = COSE_EC_CURVE_P256;
+    CU_ASSERT_EQUAL(cose_crypto_ecdh(&a, &b, secret, &secret_len),
+                    COSE_ERR_INVALID_PARAM);
+    a.d = NULL;
+    CU_ASSERT_EQUAL(cose_crypto_ecdh(&a, &a, secret, &secret_len),
+                    COSE_ERR_INVALID_PARAM);
+}
+#endif
+
+#ifdef CRYPTO_PSA
+void test_crypto_psa_handles(void)
+{
+    const uint8_t payload[] = "Input string";
+    const uint8_t aad[] = "Additional data";
+    uint8_t x[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t y[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t d[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t sk[COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES];
+    uint8_t nonce[COSE_CRYPTO_AEAD_CHACHA20POLY1305_NONCEBYTES] = { 0 };
+    uint8_t sig[COSE_CRYPTO_SIGN_P256_SIGNBYTES];
+    uint8_t ciphertext[sizeof(payload) +
+                       COSE_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES];
+    uint8_t plaintext[sizeof(payload)];
+    size_t sig_len = 0;
+    size_t len = 0;
+    cose_key_t key, pub, symm;
+
+    /* Sign with the handle, verify with the raw public key */
+    cose_key_init(&key);
+    cose_key_set_keys(&key, COSE_EC_CURVE_P256, COSE_ALGO_ES256, x, y, d);
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_keypair_ecdsa(&key, COSE_EC_CURVE_P256),
+                          COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_psa_import(&key,
+                                                 PSA_KEY_LIFETIME_VOLATILE,
+                                                 PSA_KEY_ID_NULL), COSE_OK);
+    CU_ASSERT_NOT_EQUAL(key.psa_key, PSA_KEY_ID_NULL);
+    memset(d, 0, sizeof(d));
+    CU_ASSERT_EQUAL(cose_crypto_sign_ecdsa(&key, sig, &sig_len,
+                                           (uint8_t *)payload,
+                                           sizeof(payload)), COSE_OK);
+    CU_ASSERT_EQUAL(sig_len, sizeof(sig));
+    cose_key_init(&pub);
+    cose_key_set_keys(&pub, COSE_EC_CURVE_P256, COSE_ALGO_ES256, x, y, NULL);
+    CU_ASSERT_EQUAL(cose_crypto_verify_ecdsa(&pub, sig, sig_len,
+                                             (uint8_t *)payload,
+                                             sizeof(payload)), COSE_OK);
+    sig[0] ^= 1;
+    CU_ASSERT_EQUAL(cose_crypto_verify_ecdsa(&key, sig, sig_len,
+                                             (uint8_t *)payload,
+                                             sizeof(payload)),
+                    COSE_ERR_CRYPTO);
+    cose_crypto_psa_close(&key);
+    CU_ASSERT_EQUAL(key.psa_key, PSA_KEY_ID_NULL);
+
+    /* Registered symmetric keys are used by the AEAD functions */
+    memset(sk, 0x42, sizeof(sk));
+    cose_key_init(&symm);
+    cose_key_set_keys(&symm, 0, COSE_ALGO_CHACHA20POLY1305, NULL, NULL, sk);
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_psa_import(&symm,
+                                                 PSA_KEY_LIFETIME_VOLATILE,
+                                                 PSA_KEY_ID_NULL), COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_aead_encrypt(ciphertext, &len, payload,
+                                             sizeof(payload), aad, sizeof(aad),
+                                             NULL, nonce, sk,
+                                             COSE_ALGO_CHACHA20POLY1305),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                             sizeof(ciphertext), aad,
+                                             sizeof(aad), nonce, sk,
+                                             COSE_ALGO_CHACHA20POLY1305),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(plaintext, payload, sizeof(payload)), 0);
+
+    /* A key rotated in the same buffer does not use the stale handle */
+    memset(sk, 0x17, sizeof(sk));
+    CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                             sizeof(ciphertext), aad,
+                                             sizeof(aad), nonce, sk,
+                                             COSE_ALGO_CHACHA20POLY1305),
+                    COSE_ERR_CRYPTO);
+    CU_ASSERT_EQUAL(cose_crypto_aead_encrypt(ciphertext, &len, payload,
+                                             sizeof(payload), aad, sizeof(aad),
+                                             NULL, nonce, sk,
+                                             COSE_ALGO_CHACHA20POLY1305),
+                    COSE_OK);
+    cose_crypto_psa_close(&symm);
+    CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                             sizeof(ciphertext), aad,
+                                             sizeof(aad), nonce, sk,
+                                             COSE_ALGO_CHACHA20POLY1305),
+                    COSE_OK);
+}
+#endif
+
+#ifdef CRYPTO_OPENSSL
+void test_crypto_openssl_prepared(void)
+{
+    /* Only the AEADs routed to this backend by the selectors */
+    static const cose_algo_t algos[] = {
+#ifdef CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY
+        COSE_ALGO_CHACHA20POLY1305,
+#endif
+#ifdef CRYPTO_OPENSSL_INCLUDE_AESGCM
+        COSE_ALGO_A128GCM,
+#endif
+#ifdef CRYPTO_OPENSSL_INCLUDE_AESCCM
+        COSE_ALGO_AESCCM_16_64_128, COSE_ALGO_AESCCM_64_128_256,
+#endif
+        COSE_ALGO_NONE,
+    };
+    const uint8_t payload[] = "Input string";
+    const uint8_t aad[] = "Additional data";
+    uint8_t x[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t y[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t d[COSE_CRYPTO_EC2_KEYBYTES];
+    uint8_t sk[32];
+    uint8_t nonce[13] = { 0 };
+    uint8_t sig[COSE_CRYPTO_SIGN_P384_SIGNBYTES];
+    uint8_t ciphertext[sizeof(payload) + 16];
+    uint8_t plaintext[sizeof(payload)];
+    size_t sig_len = 0;
+    size_t clen = 0;
+    size_t len = 0;
+    cose_key_t key, pub, symm;
+
+    /* Sign with the prepared key, verify with the raw public key */
+    cose_key_init(&key);
+    cose_key_set_keys(&key, COSE_EC_CURVE_P384, COSE_ALGO_ES384, x, y, d);
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_keypair_ecdsa(&key, COSE_EC_CURVE_P384),
+                          COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_openssl_prepare(&key), COSE_OK);
+    memset(d, 0, sizeof(d));
+    CU_ASSERT_EQUAL(cose_crypto_sign_ecdsa(&key, sig, &sig_len,
+                                           (uint8_t *)payload,
+                                           sizeof(payload)), COSE_OK);
+    CU_ASSERT_EQUAL(sig_len, sizeof(sig));
+    cose_key_init(&pub);
+    cose_key_set_keys(&pub, COSE_EC_CURVE_P384, COSE_ALGO_ES384, x, y, NULL);
+    CU_ASSERT_EQUAL(cose_crypto_verify_ecdsa(&pub, sig, sig_len,
+                                             (uint8_t *)payload,
+                                             sizeof(payload)), COSE_OK);
+    sig[sig_len - 1] ^= 1;
+    CU_ASSERT_EQUAL(cose_crypto_verify_ecdsa(&key, sig, sig_len,
+                                             (uint8_t *)payload,
+                                             sizeof(payload)),
+                    COSE_ERR_CRYPTO);
+    cose_crypto_openssl_release(&key);
+    CU_ASSERT_PTR_NULL(key.evp_pkey);
+
+    /* Prepared symmetric keys keep the expanded key in their context */
+    for (size_t i = 0; algos[i] != COSE_ALGO_NONE; i++) {
+        memset(sk, (int)i + 1, sizeof(sk));
+        cose_key_init(&symm);
+        cose_key_set_keys(&symm, 0, algos[i], NULL, NULL, sk);
+        CU_ASSERT_EQUAL_FATAL(cose_crypto_openssl_prepare(&symm), COSE_OK);
+        CU_ASSERT_EQUAL(cose_crypto_aead_encrypt(ciphertext, &clen, payload,
+                                                 sizeof(payload), aad,
+                                                 sizeof(aad), NULL, nonce, sk,
+                                                 algos[i]), COSE_OK);
+        memset(sk, 0, sizeof(sk));
+        CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                                 clen, aad, sizeof(aad),
+                                                 nonce, sk, algos[i]),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(len, sizeof(payload));
+        CU_ASSERT_EQUAL(memcmp(plaintext, payload, sizeof(payload)), 0);
+        ciphertext[0] ^= 1;
+        CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                                 clen, aad, sizeof(aad),
+                                                 nonce, sk, algos[i]),
+                        COSE_ERR_CRYPTO);
+        ciphertext[0] ^= 1;
+
+        /* Without the prepared context the wiped key no longer decrypts */
+        cose_crypto_openssl_release(&symm);
+        CU_ASSERT_EQUAL(cose_crypto_aead_decrypt(plaintext, &len, ciphertext,
+                                                 clen, aad, sizeof(aad),
+                                                 nonce, sk, algos[i]),
+                        COSE_ERR_CRYPTO);
+    }
+}
+#endif
+
+#ifdef HAVE_ALGO_RSA_PSS
+#include <mbedtls/rsa.h>
+
+void test_crypto_rsa_pss(void)
+{
+    static const cose_algo_t algos[] = {
+        COSE_ALGO_PS256, COSE_ALGO_PS384, COSE_ALGO_PS512,
+    };
+    const uint8_t payload[] = "Input string";
+    uint8_t n[256];
+    uint8_t e[3];
+    uint8_t d[256];
+    uint8_t sig[256];
+    size_t sig_len = 0;
+    mbedtls_rsa_context gen_ctx, priv_ctx, pub_ctx;
+    cose_key_t gen, key, pub;
+
+    cose_key_init(&gen);
+    gen.algo = COSE_ALGO_PS256;
+    CU_ASSERT_EQUAL_FATAL(cose_crypto_mbedtls_rsa_generate(&gen, &gen_ctx,
+                                                           8 * sizeof(n)),
+                          COSE_OK);
+    CU_ASSERT_EQUAL(gen.kty, COSE_KTY_RSA);
+    CU_ASSERT_EQUAL_FATAL(mbedtls_rsa_export_raw(&gen_ctx, n, sizeof(n),
+                                                 NULL, 0, NULL, 0,
+                                                 d, sizeof(d), e, sizeof(e)),
+                          0);
+    cose_crypto_mbedtls_rsa_release(&gen);
+
+    /* RFC 8230 keys are at least 2048 bit */
+    cose_key_init(&pub);
+    pub.algo = COSE_ALGO_PS256;
+    CU_ASSERT_EQUAL(cose_crypto_mbedtls_rsa_prepare(&pub, &pub_ctx, n,
+                                                    sizeof(n) / 2, e,
+                                                    sizeof(e), NULL, 0),
+                    COSE_ERR_INVALID_PARAM);
+    pub.algo = COSE_ALGO_ES256;
+    CU_ASSERT_EQUAL(cose_crypto_mbedtls_rsa_prepare(&pub, &pub_ctx, n,
+                                                    sizeof(n), e, sizeof(e),
+                                                    NULL, 0),
+                    COSE_ERR_NOTIMPLEMENTED);
+
+    for (size_t i = 0; i < sizeof(algos) / sizeof(algos[0]); i++) {
+        cose_key_init(&key);
+        key.algo = algos[i];
+        CU_ASSERT_EQUAL_FATAL(cose_crypto_mbedtls_rsa_prepare(&key, &priv_ctx,
+                                                              n, sizeof(n),
+                                                              e, sizeof(e),
+                                                              d, sizeof(d)),
+                              COSE_OK);
+        cose_key_init(&pub);
+        pub.algo = algos[i];
+        CU_ASSERT_EQUAL_FATAL(cose_crypto_mbedtls_rsa_prepare(&pub, &pub_ctx,
+                                                              n, sizeof(n),
+                                                              e, sizeof(e),
+                                                              NULL, 0),
+                              COSE_OK);
+        CU_ASSERT_EQUAL(cose_crypto_sig_size(&pub), sizeof(sig));
+
+        CU_ASSERT_EQUAL(cose_crypto_sign(&key, sig, &sig_len,
+                                         (uint8_t *)payload, sizeof(payload)),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(sig_len, sizeof(sig));
+        /* The prepared public key is reused across verifications */
+        for (unsigned j = 0; j < 2; j++) {
+            CU_ASSERT_EQUAL(cose_crypto_verify(&pub, sig, sig_len,
+                                               (uint8_t *)payload,
+                                               sizeof(payload)), COSE_OK);
+        }
+        CU_ASSERT_EQUAL(cose_crypto_verify(&pub, sig, sig_len - 1,
+                                           (uint8_t *)payload,
+                                           sizeof(payload)), COSE_ERR_CRYPTO);
+        sig[0] ^= 1;
+        CU_ASSERT_EQUAL(cose_crypto_verify(&pub, sig, sig_len,
+                                           (uint8_t *)payload,
+                                           sizeof(payload)), COSE_ERR_CRYPTO);
+
+        cose_crypto_mbedtls_rsa_release(&pub);
+        cose_crypto_mbedtls_rsa_release(&key);
+        CU_ASSERT_PTR_NULL(pub.rsa);
+        CU_ASSERT_EQUAL(cose_crypto_verify(&pub, sig, sig_len,
+                                           (uint8_t *)payload,
+                                           sizeof(payload)),
+                        COSE_ERR_INVALID_PARAM);
+    }
+}
+#endif
+
+#if defined(CRYPTO_SIGND) && defined(HAVE_ALGO_EDDSA)
+#include <sys/mman.h>
+#include <time.h>
+
+void test_crypto_signd_ring(void)
+{
+    static const char ring_name[] = "/cose-signd-test";
+    const uint8_t msg1[] = "First Sig_structure";
+    const uint8_t msg2[] = "Second Sig_structure";
+    uint8_t pk[COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES];
+    uint8_t sk[COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES];
+    uint8_t kid[] = "signd";
+    uint8_t sig[COSE_CRYPTO_SIGN_ED25519_SIGNBYTES];
+    static uint8_t large[COSE_CRYPTO_SIGND_MSG_MAX + 1];
+    size_t sig_len = 0;
+    uint32_t t1, t2;
+    cose_key_t key, pub;
+
+    cose_key_init(&key);
+    cose_key_set_keys(&key, COSE_EC_CURVE_ED25519, COSE_ALGO_EDDSA, pk, NULL, sk);
+    cose_key_set_kid(&key, kid, sizeof(kid) - 1);
+    CU_ASSERT_EQUAL(cose_crypto_keypair_ed25519(&key), COSE_OK);
+    cose_key_init(&pub);
+    cose_key_set_keys(&pub, COSE_EC_CURVE_ED25519, COSE_ALGO_EDDSA, pk, NULL, NULL);
+    cose_key_set_kid(&pub, kid, sizeof(kid) - 1);
+
+    shm_unlink(ring_name);
+    cose_signd_ring_t *ring = cose_crypto_signd_open(ring_name, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ring);
+    CU_ASSERT_PTR_NULL(cose_crypto_signd_open(ring_name, true));
+    cose_signd_ring_t *client = cose_crypto_signd_open(ring_name, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    cose_crypto_signd_attach(&pub, client);
+
+    CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 0U);
+
+    /* Two pending requests are signed in one batch */
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1), &t1),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg2, sizeof(msg2), &t2),
+                    COSE_OK);
+    CU_ASSERT_FALSE(cose_crypto_signd_ready(client, t1));
+    CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 2U);
+    CU_ASSERT_TRUE(cose_crypto_signd_ready(client, t1));
+    CU_ASSERT_TRUE(cose_crypto_signd_ready(client, t2));
+
+    CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t2, sig, &sig_len), COSE_OK);
+    CU_ASSERT_EQUAL(sig_len, sizeof(sig));
+    CU_ASSERT_EQUAL(cose_crypto_verify_ed25519(&pub, sig, sig_len,
+                                               (uint8_t *)msg2, sizeof(msg2)), 0);
+    CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t1, sig, &sig_len), COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_verify_ed25519(&pub, sig, sig_len,
+                                               (uint8_t *)msg1, sizeof(msg1)), 0);
+
+    /* Slots are reused after wrapping around the ring */
+    for (unsigned i = 0; i < 2 * COSE_CRYPTO_SIGND_SLOTS; i++) {
+        CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1),
+                                                  &t1), COSE_OK);
+        CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 1U);
+        CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t1, sig, &sig_len), COSE_OK);
+    }
+
+    /* Unknown key identifier */
+    pub.kid_len = 1;
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1), &t1),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 1U);
+    CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t1, sig, &sig_len),
+                    COSE_ERR_NOT_FOUND);
+
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, large, sizeof(large), &t1),
+                    COSE_ERR_NOMEM);
+
+    /* Clients give up on a daemon that does not answer */
+    pub.kid_len = sizeof(kid) - 1;
+    cose_crypto_signd_set_timeout(ring, 20, 50);
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1), &t1),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t1, sig, &sig_len),
+                    COSE_ERR_CRYPTO);
+    for (unsigned i = 1; i < COSE_CRYPTO_SIGND_SLOTS; i++) {
+        CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1),
+                                                  &t2), COSE_OK);
+    }
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg1, sizeof(msg1), &t2),
+                    COSE_ERR_CRYPTO);
+
+    /* Answered requests that are never collected are reclaimed */
+    size_t served = 0;
+    while (served < COSE_CRYPTO_SIGND_SLOTS) {
+        served += cose_crypto_signd_serve(ring, &key, 1, NULL);
+    }
+    CU_ASSERT_TRUE(cose_crypto_signd_ready(client, t1));
+    struct timespec ts = { 0, 60 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 0U);
+    CU_ASSERT_FALSE(cose_crypto_signd_ready(client, t1));
+    CU_ASSERT_EQUAL(cose_crypto_signd_request(client, &pub, msg2, sizeof(msg2), &t1),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_signd_serve(ring, &key, 1, NULL), 1U);
+    CU_ASSERT_EQUAL(cose_crypto_signd_result(client, t1, sig, &sig_len), COSE_OK);
+    CU_ASSERT_EQUAL(cose_crypto_verify_ed25519(&pub, sig, sig_len,
+                                               (uint8_t *)msg2, sizeof(msg2)), 0);
+
+    cose_crypto_signd_close(client);
+    cose_crypto_signd_close(ring);
+    shm_unlink(ring_name);
+}
+#endif
+
+void test_crypto_algo_registry(void)
+{
+    static const cose_algo_t algos[] = {
+        COSE_ALGO_CHACHA20POLY1305, COSE_ALGO_A128GCM, COSE_ALGO_A192GCM,
+        COSE_ALGO_A256GCM, COSE_ALGO_AESCCM_16_64_128,
+        COSE_ALGO_AESCCM_64_128_256, COSE_ALGO_EDDSA, COSE_ALGO_ES256,
+        COSE_ALGO_PS256,
+    };
+    uint8_t key[32];
+
+    CU_ASSERT_PTR_NULL(cose_crypto_algo_get(COSE_ALGO_NONE));
+    CU_ASSERT_FALSE(cose_crypto_is_aead(COSE_ALGO_NONE));
+
+    for (size_t i = 0; i < sizeof(algos) / sizeof(algos[0]); i++) {
+        const cose_crypto_algo_t *desc = cose_crypto_algo_get(algos[i]);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(desc);
+        CU_ASSERT_EQUAL(desc->algo, algos[i]);
+        if (desc->cls == COSE_CRYPTO_ALGO_SIGN) {
+            CU_ASSERT_FALSE(cose_crypto_is_aead(algos[i]));
+            continue;
+        }
+        CU_ASSERT_TRUE(cose_crypto_is_aead(algos[i]));
+        CU_ASSERT_TRUE(desc->key_len <= sizeof(key));
+        if (!desc->encrypt) {
+            /* Not provided by the selected crypto backends */
+            CU_ASSERT_EQUAL(cose_crypto_keygen(key, sizeof(key), algos[i]),
+                            COSE_ERR_NOTIMPLEMENTED);
+            continue;
+        }
+        CU_ASSERT_EQUAL(cose_crypto_aead_nonce_size(algos[i]), desc->nonce_len);
+        CU_ASSERT_EQUAL(cose_crypto_keygen(key, desc->key_len - 1, algos[i]),
+                        COSE_ERR_NOMEM);
+        CU_ASSERT_EQUAL(cose_crypto_keygen(key, sizeof(key), algos[i]),
+                        desc->key_len);
+    }
+}
+
 const test_t tests_crypto[] = {
+#if defined(CRYPTO_SIGND) && defined(HAVE_ALGO_EDDSA)
+    {
+        .f = test_crypto_signd_ring,
+        .n = "Signing daemon request ring",
+    },
+#endif
+#ifdef HAVE_ALGO_HMAC_SHA256
+    {
+        .f = test_crypto_hkdf_vector,
+        .n = "HKDF-SHA-256 with RFC 5869 test vectors",
+    },
+#endif
+#ifdef HAVE_CURVE_X25519
+    {
+        .f = test_crypto_x25519_vector,
+        .n = "X25519 with RFC 7748 test vectors",
+    },
+#endif
 #ifdef HAVE_ALGO_EDDSA
     {
         .f = test_crypto1,
@@ -202,6 +962,10 @@ const test_t tests_crypto[] = {
         .f = test_crypto_chacha_vector,
         .n = "AEAD Chacha20poly1305 encrypt/decrypt with IETF test vector",
     },
+    {
+        .f = test_crypto_chacha_long,
+        .n = "AEAD Chacha20poly1305 encrypt/decrypt long message",
+    },
 #endif
 #ifdef HAVE_ALGO_AES128GCM
     {
@@ -220,7 +984,51 @@ const test_t tests_crypto[] = {
         .f = test_crypto_aes256,
         .n = "AEAD aes256gcm encrypt/decrypt",
     },
+    {
+        .f = test_crypto_aesgcm_vector,
+        .n = "AEAD aes256gcm encrypt/decrypt with test vector",
+    },
+#endif
+#ifdef HAVE_ALGO_AESCCM_16_64_128
+    {
+        .f = test_crypto_aesccm_vector,
+        .n = "AEAD aesccm encrypt/decrypt with RFC3610 test vector",
+    },
 #endif
+#if defined(HAVE_ALGO_AESCCM_64_128_256)
+    {
+        .f = test_crypto_aesccm,
+        .n = "AEAD aesccm encrypt/decrypt all variants",
+    },
+#endif
+#if defined(HAVE_ALGO_ECDSA) && defined(COSE_ECDSA_DETERMINISTIC)
+    {
+        .f = test_crypto_ecdsa_deterministic,
+        .n = "Deterministic ECDSA signatures",
+    },
+#endif
+#ifdef HAVE_ALGO_RSA_PSS
+    {
+        .f = test_crypto_rsa_pss,
+        .n = "RSA-PSS sign and verify with prepared keys",
+    },
+#endif
+#ifdef CRYPTO_OPENSSL
+    {
+        .f = test_crypto_openssl_prepared,
+        .n = "OpenSSL prepared keys for signing and AEAD",
+    },
+#endif
+#ifdef CRYPTO_PSA
+    {
+        .f = test_crypto_psa_handles,
+        .n = "PSA key handles for signing and AEAD",
+    },
+#endif
+    {
+        .f = test_crypto_algo_registry,
+        .n = "Algorithm descriptor lookup and key generation",
+    },
     {
         .f = NULL,
         .n = NULL,
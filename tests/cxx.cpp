@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Compile and run check of the C++20 wrapper, run with `make test-cxx`
+ */
+
+#include <array>
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include "cose/cose.hpp"
+
+#if defined(HAVE_ALGO_EDDSA)
+#define TEST_CURVE  COSE_EC_CURVE_ED25519
+#define TEST_ALGO   COSE_ALGO_EDDSA
+#else
+#define TEST_CURVE  COSE_EC_CURVE_P256
+#define TEST_ALGO   COSE_ALGO_ES256
+#endif
+
+static const uint8_t payload[] = "Input string";
+static const uint8_t kid[] = { 'k', 'i', 'd', '1' };
+
+/* Sizes match the C macros used by the C tests */
+static_assert(cose::algo_prot_size(COSE_ALGO_EDDSA) == 3);
+static_assert(cose::algo_prot_size(COSE_ALGO_ES512) == 4);
+static_assert(cose::kid_unprot_size(0) == 1);
+static_assert(cose::kid_unprot_size(4) == 7);
+static_assert(cose::cbor_head_size(0x100000000ULL) == 9);
+
+constexpr size_t buf_size = cose::sign1_buffer_size(TEST_ALGO,
+                                                    sizeof(payload),
+                                                    sizeof(kid));
+constexpr size_t verify_size = cose::sign1_verify_size(TEST_ALGO,
+                                                       sizeof(payload));
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/* Eagerly started coroutine without a result */
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/* Executor holding a single job until it is run by the test */
+struct deferred_executor {
+    cose_job_fn_t fn = nullptr;
+    void *arg = nullptr;
+
+    int submit(cose_job_fn_t job, void *job_arg) noexcept
+    {
+        fn = job;
+        arg = job_arg;
+        return 0;
+    }
+
+    bool run() noexcept
+    {
+        cose_job_fn_t job = fn;
+        fn = nullptr;
+        if (job) {
+            job(arg);
+        }
+        return job != nullptr;
+    }
+};
+
+static_assert(cose::executor<deferred_executor>);
+static_assert(cose::executor<cose::inline_executor>);
+static_assert(cose::executor<cose::executor_ref>);
+
+static int _refuse(void *, cose_job_fn_t, void *)
+{
+    return -1;
+}
+
+static void _wait(void *)
+{
+}
+
+template <cose::executor Executor>
+static task sign_verify_async(Executor &exec, cose::key &signer, cose::key &pub,
+                              std::span<uint8_t> buf, std::span<uint8_t> scratch,
+                              int &steps)
+{
+    cose::sign_encoder<> sign;
+    sign.set_payload(payload);
+    sign.add_signer(signer);
+
+    try {
+        (void)co_await sign.async_encode(exec, buf.first(8));
+        CHECK(false);
+    }
+    catch (const cose::error &e) {
+        CHECK(e.code() == COSE_ERR_NOMEM);
+    }
+
+    std::span<const uint8_t> msg = co_await sign.async_encode(exec, buf);
+    steps++;
+    cose::sign_decoder verify(msg);
+    CHECK(std::memcmp(verify.payload().data(), payload, sizeof(payload)) == 0);
+    CHECK(verify.verify(pub, scratch));
+    CHECK(co_await verify.async_verify(exec, pub, scratch));
+    steps++;
+
+    buf[msg.data() + msg.size() - 1 - buf.data()] ^= 1;
+    cose::sign_decoder tampered(msg);
+    CHECK(!co_await tampered.async_verify(exec, pub, scratch));
+    steps++;
+}
+
+#if defined(HAVE_ALGO_CHACHA20POLY1305)
+template <cose::executor Executor>
+static task decrypt_async(Executor &exec, const cose::key &k,
+                          std::span<const uint8_t> msg, int &steps)
+{
+    std::array<uint8_t, 128> scratch;
+    std::array<uint8_t, sizeof(payload)> plaintext;
+
+    cose::encrypt_decoder dec(msg);
+    std::span<const uint8_t> out = co_await dec.async_decrypt(exec, k, scratch,
+                                                              plaintext);
+    CHECK(out.size() == sizeof(payload));
+    CHECK(std::memcmp(out.data(), payload, sizeof(payload)) == 0);
+    steps++;
+
+    try {
+        (void)co_await dec.async_decrypt(exec, k, scratch,
+                                         std::span<uint8_t>(plaintext).first(4));
+        CHECK(false);
+    }
+    catch (const cose::error &e) {
+        CHECK(e.code() == COSE_ERR_NOMEM);
+    }
+    steps++;
+}
+#endif
+
+int main()
+{
+    static uint8_t x[COSE_CRYPTO_EC2_KEYBYTES];
+#if !defined(HAVE_ALGO_EDDSA)
+    static uint8_t y[COSE_CRYPTO_EC2_KEYBYTES];
+#endif
+    static uint8_t d[COSE_CRYPTO_EC2_KEYBYTES];
+    std::array<uint8_t, buf_size> buf;
+    std::array<uint8_t, verify_size> scratch;
+
+#if defined(HAVE_ALGO_EDDSA)
+    cose::key signer(TEST_CURVE, TEST_ALGO, x, {}, d);
+    CHECK(cose_crypto_keypair_ed25519(signer.get()) == COSE_OK);
+#else
+    cose::key signer(TEST_CURVE, TEST_ALGO, x, y, d);
+    CHECK(cose_crypto_keypair_ecdsa(signer.get(), TEST_CURVE) == COSE_OK);
+#endif
+    signer.set_kid(kid);
+
+    cose::sign_encoder<> sign;
+    sign.set_payload(payload);
+    sign.add_signer(signer);
+    cose::sign_encoder<> moved = std::move(sign);
+
+    try {
+        (void)moved.encode(std::span<uint8_t>(buf).first(buf_size / 2));
+        CHECK(false);
+    }
+    catch (const cose::error &e) {
+        CHECK(e.code() == COSE_ERR_NOMEM);
+    }
+
+    /* Encodes into the exactly sized array */
+    std::span<const uint8_t> msg = moved.encode(buf);
+    CHECK(msg.data() >= buf.data() && msg.data() + msg.size() <= buf.end());
+    try {
+        moved.add_signer(signer);
+        CHECK(false);
+    }
+    catch (const cose::error &e) {
+        CHECK(e.code() == COSE_ERR_NOMEM);
+    }
+
+    cose::sign_decoder verify(msg);
+    CHECK(verify.payload().size() == sizeof(payload));
+    CHECK(std::memcmp(verify.payload().data(), payload, sizeof(payload)) == 0);
+    CHECK(verify.verify(signer, scratch));
+
+    /* Verification with the public key only */
+#if defined(HAVE_ALGO_EDDSA)
+    cose::key pub(TEST_CURVE, TEST_ALGO, x);
+#else
+    cose::key pub(TEST_CURVE, TEST_ALGO, x, y);
+#endif
+    CHECK(verify.verify(pub, scratch));
+
+    /* Tampered signature */
+    std::array<uint8_t, buf_size> copy;
+    std::memcpy(copy.data(), msg.data(), msg.size());
+    copy[msg.size() - 1] ^= 1;
+    cose::sign_decoder tampered(std::span<const uint8_t>(copy).first(msg.size()));
+    CHECK(!tampered.verify(pub, scratch));
+
+    try {
+        cose::sign_decoder invalid{ std::span<const uint8_t>(payload) };
+        CHECK(false);
+    }
+    catch (const cose::error &e) {
+        CHECK(e.code() != COSE_OK);
+    }
+
+    /* Awaitables suspend until the executor ran the crypto step */
+    deferred_executor deferred;
+    std::array<uint8_t, buf_size> async_buf;
+    int steps = 0;
+    sign_verify_async(deferred, signer, pub, async_buf, scratch, steps);
+    CHECK(steps == 0);
+    for (int expect = 1; deferred.run(); expect++) {
+        CHECK(steps == expect);
+    }
+    CHECK(steps == 3);
+
+    /* And run directly on an executor that does not take jobs */
+    cose::inline_executor direct;
+    steps = 0;
+    sign_verify_async(direct, signer, pub, async_buf, scratch, steps);
+    CHECK(steps == 3);
+    const cose_executor_t c_exec = { _refuse, _wait, nullptr };
+    cose::executor_ref ref(c_exec);
+    steps = 0;
+    sign_verify_async(ref, signer, pub, async_buf, scratch, steps);
+    CHECK(steps == 3);
+
+#if defined(HAVE_ALGO_CHACHA20POLY1305)
+    static uint8_t secret[32] = { 0x0F, 0x1E, 0x2D, 0x3C };
+    static uint8_t nonce[12] = { 0x26, 0x68, 0x23, 0x06 };
+    std::array<uint8_t, 128> enc_buf;
+    cose::key chacha(COSE_ALGO_CHACHA20POLY1305, secret);
+    cose_encrypt_t crypt;
+    cose_recp_t recps[1];
+    uint8_t *out = nullptr;
+    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
+    cose_encrypt_add_recipient(&crypt, chacha.get());
+    cose_encrypt_set_payload(&crypt, payload, sizeof(payload));
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    COSE_ssize_t enc_len = cose_encrypt_encode(&crypt, enc_buf.data(),
+                                               enc_buf.size(), nonce, &out);
+    CHECK(enc_len > 0);
+    std::span<const uint8_t> enc_msg(out, static_cast<size_t>(enc_len));
+
+    std::array<uint8_t, 128> dec_scratch;
+    std::array<uint8_t, sizeof(payload)> plaintext;
+    cose::encrypt_decoder dec(enc_msg);
+    CHECK(dec.decrypt(chacha, dec_scratch, plaintext).size() == sizeof(payload));
+
+    steps = 0;
+    decrypt_async(deferred, chacha, enc_msg, steps);
+    CHECK(steps == 0);
+    CHECK(deferred.run());
+    CHECK(steps == 2);
+#endif
+
+    std::printf("cxx: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -91,8 +91,10 @@ void test_encrypt1(void)
     print_bytestr(nonce, sizeof(nonce));
     printf("\n");
     cose_encrypt_t crypt;
+    cose_recp_t recps[1];
     cose_key_t key;
     cose_encrypt_init(&crypt, 0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
     cose_key_init(&key);
     cose_key_set_kid(&key, kid, sizeof(kid) - 1);
     cose_key_set_keys(&key, 0, COSE_ALGO_CHACHA20POLY1305, NULL, NULL, chachakey);
@@ -124,8 +126,10 @@ void test_encrypt2(void)
     print_bytestr(nonce, sizeof(nonce));
     printf("\n");
     cose_encrypt_t crypt;
+    cose_recp_t recps[1];
     cose_key_t key;
     cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
     cose_key_init(&key);
     cose_key_set_kid(&key, kid, sizeof(kid) - 1);
     cose_key_set_keys(&key, 0, COSE_ALGO_CHACHA20POLY1305, NULL, NULL, chachakey);
@@ -166,12 +170,15 @@ void test_encrypt_generic(void)
         uint8_t key_bytes[64];
         static const uint8_t nonce_bytes[32] = { 0 };
         cose_encrypt_t crypt;
+        cose_recp_t recps[1];
         cose_key_t key;
 
         cose_crypto_keygen(key_bytes, sizeof(key_bytes), algo);
 
         cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
 
+        cose_encrypt_set_recipients(&crypt, recps, 1);
+
         cose_key_init(&key); /* Generate key */
         cose_key_set_kid(&key, kid, sizeof(kid) - 1);
         cose_key_set_keys(&key, 0, algo, NULL, NULL, key_bytes);
@@ -197,6 +204,655 @@ void test_encrypt_generic(void)
     }
 }
 
+/* Round trip over the algos through the validating decoder */
+void test_encrypt_generic_validate(void)
+{
+    for (size_t i = 0; i < algo_count; i++) {
+        cose_algo_t algo = algos[i];
+
+        if (algo == COSE_ALGO_NONE) {
+            continue;
+        }
+
+        uint8_t *out;
+        uint8_t key_bytes[64];
+        static const uint8_t nonce_bytes[32] = { 0 };
+        cose_encrypt_t crypt;
+        cose_recp_t recps[1];
+        cose_key_t key;
+
+        cose_crypto_keygen(key_bytes, sizeof(key_bytes), algo);
+
+        cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+        cose_encrypt_set_recipients(&crypt, recps, 1);
+
+        cose_key_init(&key);
+        cose_key_set_kid(&key, kid, sizeof(kid) - 1);
+        cose_key_set_keys(&key, 0, algo, NULL, NULL, key_bytes);
+
+        cose_encrypt_add_recipient(&crypt, &key);
+        cose_encrypt_set_payload(&crypt, payload, sizeof(payload)-1);
+        cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+        COSE_ssize_t len = cose_encrypt_encode(&crypt, buf, sizeof(buf), nonce_bytes, &out);
+        CU_ASSERT_FATAL(len > 0);
+
+        cose_encrypt_dec_t decrypt;
+
+        CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, out, len - 1,
+                                                     NULL),
+                        COSE_ERR_INVALID_CBOR);
+        CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, out, len, NULL), 0);
+        size_t plaintext_len = 0;
+
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt(&decrypt, NULL, &key, buf, sizeof(buf), plaintext, &plaintext_len), 0);
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload)-1);
+        CU_ASSERT_EQUAL(memcmp(plaintext, payload, plaintext_len), 0);
+    }
+}
+
+/* Decryption with the AEAD operation split from the decoding */
+void test_encrypt_split(void)
+{
+    for (size_t i = 0; i < algo_count; i++) {
+        cose_algo_t algo = algos[i];
+
+        if (algo == COSE_ALGO_NONE) {
+            continue;
+        }
+
+        uint8_t *out;
+        uint8_t key_bytes[64];
+        static const uint8_t nonce_bytes[32] = { 0 };
+        cose_encrypt_t crypt;
+        cose_recp_t recps[1];
+        cose_key_t key;
+
+        cose_crypto_keygen(key_bytes, sizeof(key_bytes), algo);
+        cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+        cose_encrypt_set_recipients(&crypt, recps, 1);
+        cose_key_init(&key);
+        cose_key_set_kid(&key, kid, sizeof(kid) - 1);
+        cose_key_set_keys(&key, 0, algo, NULL, NULL, key_bytes);
+
+        cose_encrypt_add_recipient(&crypt, &key);
+        cose_encrypt_set_payload(&crypt, payload, sizeof(payload)-1);
+        cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+        COSE_ssize_t len = cose_encrypt_encode(&crypt, buf, sizeof(buf), nonce_bytes, &out);
+        CU_ASSERT_FATAL(len > 0);
+
+        cose_encrypt_dec_t decrypt;
+        cose_encrypt_aead_t aead;
+        CU_ASSERT_EQUAL(cose_encrypt_decode(&decrypt, out, len), 0);
+
+        /* Scratch buffer too small for the Enc_structure */
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare(&decrypt, NULL, &key,
+                                                     plaintext, 4, &aead),
+                        COSE_ERR_NOMEM);
+
+        CU_ASSERT_EQUAL_FATAL(cose_encrypt_decrypt_prepare(&decrypt, NULL, &key,
+                                                           plaintext, 256,
+                                                           &aead), COSE_OK);
+        CU_ASSERT_EQUAL(aead.algo, algo);
+
+        uint8_t *result = plaintext + 256;
+        size_t plaintext_len = 0;
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, result,
+                                                  &plaintext_len), 0);
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload)-1);
+        CU_ASSERT_EQUAL(memcmp(result, payload, sizeof(payload) - 1), 0);
+    }
+}
+
+void test_encrypt_recipients(void)
+{
+    cose_encrypt_t crypt;
+    cose_recp_t recps[COSE_RECIPIENTS_MAX];
+    cose_key_t key;
+
+    cose_key_init(&key);
+    cose_encrypt_init(&crypt, 0);
+    CU_ASSERT_EQUAL(cose_encrypt_get_algo(&crypt), COSE_ALGO_NONE);
+    cose_encrypt_set_recipients(&crypt, recps, COSE_RECIPIENTS_MAX);
+    for (int i = 0; i < COSE_RECIPIENTS_MAX; i++) {
+        CU_ASSERT_EQUAL(cose_encrypt_add_recipient(&crypt, &key), i);
+    }
+    CU_ASSERT_EQUAL(cose_encrypt_add_recipient(&crypt, &key), COSE_ERR_NOMEM);
+}
+
+#if defined(HAVE_ALGO_CHACHA20POLY1305) && defined(HAVE_ALGO_HMAC)
+void test_encrypt_hkdf(void)
+{
+    static const cose_algo_t kdf_algos[] = {
+#ifdef HAVE_ALGO_HMAC_SHA256
+        COSE_ALGO_DIRECT_HKDF_SHA256,
+#endif
+#ifdef HAVE_ALGO_HMAC_SHA512
+        COSE_ALGO_DIRECT_HKDF_SHA512,
+#endif
+    };
+    static const uint8_t salt[] = "aabbccddeeffgghh";
+    static const uint8_t u_id[] = "lighting-client";
+    static const uint8_t v_id[] = "lighting-server";
+    static cose_hkdf_cache_t send_cache;
+    static cose_hkdf_cache_t recv_cache;
+    const cose_recp_kdf_t local = { .cache = &recv_cache };
+
+    for (size_t i = 0; i < sizeof(kdf_algos) / sizeof(kdf_algos[0]); i++) {
+        uint8_t *out;
+        cose_encrypt_t crypt;
+        cose_recp_t recps[1];
+        cose_key_t key;
+        cose_recp_kdf_t kdf = {
+            .algo = kdf_algos[i],
+            .salt = salt,
+            .salt_len = sizeof(salt) - 1,
+            .u_id = u_id,
+            .u_id_len = sizeof(u_id) - 1,
+            .v_id = v_id,
+            .v_id_len = sizeof(v_id) - 1,
+            .cache = &send_cache,
+        };
+
+        cose_hkdf_cache_init(&send_cache);
+        cose_hkdf_cache_init(&recv_cache);
+        cose_key_init(&key);
+        cose_key_set_kid(&key, kid, sizeof(kid) - 1);
+        cose_key_set_keys(&key, 0, COSE_ALGO_CHACHA20POLY1305, NULL, NULL,
+                          chachakey);
+
+        cose_encrypt_init(&crypt, 0);
+        cose_encrypt_set_recipients(&crypt, recps, 1);
+        CU_ASSERT_EQUAL(cose_encrypt_add_recipient_kdf(&crypt, &key, &kdf), 0);
+        cose_encrypt_set_payload(&crypt, payload, sizeof(payload) - 1);
+        cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+        COSE_ssize_t len = cose_encrypt_encode(&crypt, buf, sizeof(buf),
+                                               nonce, &out);
+        CU_ASSERT_FATAL(len > 0);
+        CU_ASSERT_EQUAL(send_cache.clock, 2);
+
+        cose_encrypt_dec_t decrypt;
+        cose_recp_dec_t recp;
+        cose_recp_kdf_t dkdf;
+        cose_encrypt_aead_t aead;
+        const uint8_t *prot = NULL;
+        size_t prot_len = 0;
+        size_t plaintext_len = 0;
+
+        CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode_validate(&decrypt, out, len,
+                                                           NULL), COSE_OK);
+        cose_recp_decode_init(&recp, NULL, 0);
+        CU_ASSERT_FATAL(cose_encrypt_recp_iter(&decrypt, &recp));
+        CU_ASSERT_EQUAL_FATAL(cose_recp_decode_kdf(&recp, &dkdf, &prot,
+                                                   &prot_len), COSE_OK);
+        CU_ASSERT_EQUAL(dkdf.algo, kdf_algos[i]);
+        CU_ASSERT_EQUAL(dkdf.salt_len, sizeof(salt) - 1);
+        CU_ASSERT_EQUAL(memcmp(dkdf.v_id, v_id, sizeof(v_id) - 1), 0);
+        CU_ASSERT_PTR_NULL(dkdf.u_nonce);
+
+        /* Derived key differs from the shared secret */
+        CU_ASSERT_EQUAL_FATAL(cose_encrypt_decrypt_prepare_cached(&decrypt,
+                                                                  &recp, &key,
+                                                                  &local,
+                                                                  plaintext,
+                                                                  512, &aead),
+                              COSE_OK);
+        CU_ASSERT_NOT_EQUAL(memcmp(aead.cek, chachakey, sizeof(chachakey)), 0);
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                                  &plaintext_len), 0);
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload) - 1);
+        CU_ASSERT_EQUAL(memcmp(plaintext + 512, payload, plaintext_len), 0);
+
+        /* Second message under the same context is served from the cache */
+        uint32_t clock = recv_cache.clock;
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp,
+                                                            &key, &local,
+                                                            plaintext, 512,
+                                                            &aead), COSE_OK);
+        CU_ASSERT_EQUAL(recv_cache.clock, clock + 1);
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                                  &plaintext_len), 0);
+
+        /* And without a cache */
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt(&decrypt, &recp, &key, plaintext,
+                                             512, plaintext + 512,
+                                             &plaintext_len), 0);
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload) - 1);
+
+        /* A different party identity derives a different key */
+        kdf.v_id_len--;
+        kdf.cache = NULL;
+        cose_encrypt_init(&crypt, 0);
+        cose_encrypt_set_recipients(&crypt, recps, 1);
+        cose_encrypt_add_recipient_kdf(&crypt, &key, &kdf);
+        cose_encrypt_set_payload(&crypt, payload, sizeof(payload) - 1);
+        cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+        len = cose_encrypt_encode(&crypt, buf, sizeof(buf), nonce, &out);
+        CU_ASSERT_FATAL(len > 0);
+        CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode(&decrypt, out, len), COSE_OK);
+        cose_recp_decode_init(&recp, NULL, 0);
+        CU_ASSERT_FATAL(cose_encrypt_recp_iter(&decrypt, &recp));
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp,
+                                                            &key, &local,
+                                                            plaintext, 512,
+                                                            &aead), COSE_OK);
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                                  &plaintext_len), 0);
+        CU_ASSERT_EQUAL(recv_cache.cek[1].used, recv_cache.clock);
+    }
+}
+#endif
+
+#if defined(HAVE_ALGO_CHACHA20POLY1305) && defined(HAVE_ALGO_HMAC_SHA256) && \
+    defined(HAVE_CURVE_X25519)
+/* RFC 7748 section 6.1 key pairs */
+static const uint8_t x25519_a_priv[] = {
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+    0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+    0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a,
+};
+static const uint8_t x25519_a_pub[] = {
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+    0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+    0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a,
+};
+static const uint8_t x25519_b_priv[] = {
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+    0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+    0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb,
+};
+static const uint8_t x25519_b_pub[] = {
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+    0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+    0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f,
+};
+
+static uint32_t test_now;
+static unsigned test_locked;
+static unsigned test_locks;
+
+static uint32_t _test_clock(void *arg)
+{
+    (void)arg;
+    return test_now;
+}
+
+static void _test_lock(void *ctx)
+{
+    (void)ctx;
+    CU_ASSERT_EQUAL(test_locked, 0);
+    test_locked++;
+    test_locks++;
+}
+
+static void _test_unlock(void *ctx)
+{
+    (void)ctx;
+    CU_ASSERT_EQUAL(test_locked, 1);
+    test_locked--;
+}
+
+static COSE_ssize_t _encrypt_ecdh_ss(cose_key_t *sender, cose_recp_kdf_t *kdf,
+                                     uint8_t **out)
+{
+    cose_encrypt_t crypt;
+    cose_recp_t recps[1];
+
+    cose_encrypt_init(&crypt, 0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
+    cose_encrypt_add_recipient_kdf(&crypt, sender, kdf);
+    cose_encrypt_set_payload(&crypt, payload, sizeof(payload) - 1);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    return cose_encrypt_encode(&crypt, buf, sizeof(buf), nonce, out);
+}
+
+void test_encrypt_ecdh_ss(void)
+{
+    static uint8_t alice_kid[] = "alice";
+    static uint8_t bob_kid[] = "bob";
+    static cose_ecdh_cache_t send_ecdh;
+    static cose_ecdh_cache_t recv_ecdh;
+    const cose_lock_t lock = {
+        .lock = _test_lock,
+        .unlock = _test_unlock,
+    };
+    cose_key_t alice, alice_pub, bob, bob_pub;
+    uint8_t u_nonce[8] = { 0 };
+    cose_recp_kdf_t kdf = {
+        .algo = COSE_ALGO_ECDH_SS_HKDF_SHA256,
+        .u_nonce = u_nonce,
+        .u_nonce_len = sizeof(u_nonce),
+        .peer = &bob_pub,
+        .ecdh = &send_ecdh,
+    };
+    cose_recp_kdf_t local = {
+        .peer = &alice_pub,
+        .ecdh = &recv_ecdh,
+    };
+    uint8_t *out;
+
+    cose_key_init(&alice);
+    cose_key_set_keys(&alice, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_a_pub,
+                      NULL, (uint8_t *)x25519_a_priv);
+    cose_key_set_kid(&alice, alice_kid, sizeof(alice_kid) - 1);
+    alice_pub = alice;
+    alice_pub.d = NULL;
+    cose_key_init(&bob);
+    cose_key_set_keys(&bob, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_b_pub,
+                      NULL, (uint8_t *)x25519_b_priv);
+    cose_key_set_kid(&bob, bob_kid, sizeof(bob_kid) - 1);
+    bob_pub = bob;
+    bob_pub.d = NULL;
+
+    test_now = 1000;
+    cose_ecdh_cache_init(&send_ecdh, 60, NULL, NULL, NULL);
+    cose_ecdh_cache_init(&recv_ecdh, 60, _test_clock, NULL, &lock);
+
+    /* A fresh PartyU nonce per message, the shared secret stays the same */
+    for (uint8_t i = 0; i < 3; i++) {
+        cose_encrypt_dec_t decrypt;
+        cose_recp_dec_t recp;
+        cose_recp_kdf_t dkdf;
+        cose_encrypt_aead_t aead;
+        const uint8_t *prot = NULL;
+        size_t prot_len = 0;
+        size_t plaintext_len = 0;
+
+        u_nonce[0] = i;
+        COSE_ssize_t len = _encrypt_ecdh_ss(&alice, &kdf, &out);
+        CU_ASSERT_FATAL(len > 0);
+        CU_ASSERT_EQUAL(send_ecdh.clock, i + 1U);
+
+        CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode(&decrypt, out, len), COSE_OK);
+        cose_recp_decode_init(&recp, NULL, 0);
+        CU_ASSERT_FATAL(cose_encrypt_recp_iter(&decrypt, &recp));
+        CU_ASSERT_EQUAL_FATAL(cose_recp_decode_kdf(&recp, &dkdf, &prot,
+                                                   &prot_len), COSE_OK);
+        CU_ASSERT_EQUAL(dkdf.algo, COSE_ALGO_ECDH_SS_HKDF_SHA256);
+        CU_ASSERT_EQUAL(dkdf.skid_len, sizeof(alice_kid) - 1);
+        CU_ASSERT_EQUAL(memcmp(dkdf.skid, alice_kid, dkdf.skid_len), 0);
+        CU_ASSERT_EQUAL(dkdf.u_nonce[0], i);
+
+        test_locks = 0;
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp,
+                                                            &bob, &local,
+                                                            plaintext, 512,
+                                                            &aead), COSE_OK);
+        /* Only the first message inserts a secret */
+        CU_ASSERT_EQUAL(test_locks, i == 0 ? 2U : 1U);
+        CU_ASSERT_EQUAL(test_locked, 0);
+        CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                                  &plaintext_len), 0);
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload) - 1);
+        CU_ASSERT_EQUAL(memcmp(plaintext + 512, payload, plaintext_len), 0);
+        CU_ASSERT_EQUAL(recv_ecdh.clock, i + 1U);
+    }
+    CU_ASSERT_EQUAL(recv_ecdh.entries[0].secret_len,
+                    COSE_CRYPTO_ECDH_X25519_BYTES);
+
+    /* Expired secrets are wiped and agreed again */
+    test_now += 60;
+    test_locks = 0;
+    COSE_ssize_t len = _encrypt_ecdh_ss(&alice, &kdf, &out);
+    CU_ASSERT_FATAL(len > 0);
+    cose_encrypt_dec_t decrypt;
+    cose_recp_dec_t recp;
+    size_t plaintext_len = 0;
+    CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode(&decrypt, out, len), COSE_OK);
+    cose_recp_decode_init(&recp, NULL, 0);
+    CU_ASSERT_FATAL(cose_encrypt_recp_iter(&decrypt, &recp));
+    cose_encrypt_aead_t aead;
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp, &bob,
+                                                        &local, plaintext, 512,
+                                                        &aead), COSE_OK);
+    CU_ASSERT_EQUAL(test_locks, 2);
+    CU_ASSERT_EQUAL(recv_ecdh.entries[0].expires, test_now + 60);
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                              &plaintext_len), 0);
+
+    /* The wrong peer key agrees on a different secret */
+    local.peer = &bob_pub;
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp, &bob,
+                                                        &local, plaintext, 512,
+                                                        &aead), COSE_OK);
+    CU_ASSERT_NOT_EQUAL(cose_encrypt_decrypt_aead(&aead, plaintext + 512,
+                                                  &plaintext_len), 0);
+    local.peer = NULL;
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt_prepare_cached(&decrypt, &recp, &bob,
+                                                        &local, plaintext, 512,
+                                                        &aead),
+                    COSE_ERR_INVALID_PARAM);
+
+    cose_ecdh_cache_flush(&recv_ecdh);
+    for (size_t i = 0; i < COSE_ECDH_CACHE_ENTRIES; i++) {
+        CU_ASSERT_EQUAL(recv_ecdh.entries[i].used, 0);
+        CU_ASSERT_EQUAL(recv_ecdh.entries[i].secret[0], 0);
+    }
+}
+
+/* One peer key struct refilled for different peers, as with a key store */
+void test_encrypt_ecdh_ss_peer(void)
+{
+    static cose_hkdf_cache_t cache;
+    cose_key_t alice, peer;
+    uint8_t cek_b[32], cek_a[32], cek[32];
+    cose_recp_kdf_t kdf = {
+        .algo = COSE_ALGO_ECDH_SS_HKDF_SHA256,
+        .peer = &peer,
+        .cache = &cache,
+    };
+    cose_recp_kdf_t uncached = kdf;
+
+    uncached.cache = NULL;
+    cose_hkdf_cache_init(&cache);
+    cose_key_init(&alice);
+    cose_key_set_keys(&alice, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_a_pub,
+                      NULL, (uint8_t *)x25519_a_priv);
+
+    cose_key_init(&peer);
+    cose_key_set_keys(&peer, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_b_pub,
+                      NULL, NULL);
+    CU_ASSERT_EQUAL_FATAL(cose_recp_kdf_derive(&kdf, &alice,
+                                               COSE_ALGO_CHACHA20POLY1305,
+                                               sizeof(cek), NULL, 0, cek_b,
+                                               buf, sizeof(buf)), COSE_OK);
+
+    /* Same struct, other peer */
+    cose_key_set_keys(&peer, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_a_pub,
+                      NULL, NULL);
+    CU_ASSERT_EQUAL_FATAL(cose_recp_kdf_derive(&kdf, &alice,
+                                               COSE_ALGO_CHACHA20POLY1305,
+                                               sizeof(cek), NULL, 0, cek_a,
+                                               buf, sizeof(buf)), COSE_OK);
+    CU_ASSERT_NOT_EQUAL(memcmp(cek_a, cek_b, sizeof(cek)), 0);
+    CU_ASSERT_EQUAL(cose_recp_kdf_derive(&uncached, &alice,
+                                         COSE_ALGO_CHACHA20POLY1305,
+                                         sizeof(cek), NULL, 0, cek, buf,
+                                         sizeof(buf)), COSE_OK);
+    CU_ASSERT_EQUAL(memcmp(cek, cek_a, sizeof(cek)), 0);
+
+    /* Back to the first peer, served from the cache */
+    uint32_t clock = cache.clock;
+    cose_key_set_keys(&peer, COSE_EC_CURVE_X25519,
+                      COSE_ALGO_CHACHA20POLY1305, (uint8_t *)x25519_b_pub,
+                      NULL, NULL);
+    CU_ASSERT_EQUAL(cose_recp_kdf_derive(&kdf, &alice,
+                                         COSE_ALGO_CHACHA20POLY1305,
+                                         sizeof(cek), NULL, 0, cek, buf,
+                                         sizeof(buf)), COSE_OK);
+    CU_ASSERT_EQUAL(cache.clock, clock + 1);
+    CU_ASSERT_EQUAL(memcmp(cek, cek_b, sizeof(cek)), 0);
+}
+#endif
+
+/* Build a COSE_Encrypt with @p levels of nested recipients */
+static size_t _nested_recipients(uint8_t *out, unsigned levels)
+{
+    static const uint8_t top[] = { 0x84, 0x40, 0xA0, 0x40, 0x81 };
+    static const uint8_t recp[] = { 0x84, 0x40, 0xA0, 0xF6, 0x81 };
+    static const uint8_t last[] = { 0x83, 0x40, 0xA0, 0xF6 };
+    size_t len = sizeof(top);
+
+    memcpy(out, top, sizeof(top));
+    for (unsigned i = 1; i < levels; i++) {
+        memcpy(out + len, recp, sizeof(recp));
+        len += sizeof(recp);
+    }
+    memcpy(out + len, last, sizeof(last));
+    return len + sizeof(last);
+}
+
+void test_encrypt_validate(void)
+{
+    cose_encrypt_dec_t decrypt;
+    cose_recp_dec_t recp;
+    /* COSE_Encrypt with an empty recipients array */
+    static uint8_t norecps[] = { 0x84, 0x40, 0xA0, 0x40, 0x80 };
+
+    size_t len = _nested_recipients(buf, 3);
+    CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, buf, len, NULL),
+                    COSE_OK);
+    cose_recp_decode_init(&recp, NULL, 0);
+    CU_ASSERT(cose_encrypt_recp_iter(&decrypt, &recp));
+    CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, buf, len - 1, NULL),
+                    COSE_ERR_INVALID_CBOR);
+
+    /* Recipient nesting beyond the depth limit */
+    len = _nested_recipients(buf, 4);
+    CU_ASSERT_EQUAL(cose_encrypt_decode(&decrypt, buf, len), COSE_OK);
+    CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, buf, len, NULL),
+                    COSE_ERR_CBOR_NOTSUP);
+    CU_ASSERT_EQUAL(cose_encrypt_decode_validate(&decrypt, norecps,
+                                                 sizeof(norecps), NULL),
+                    COSE_ERR_INVALID_CBOR);
+}
+
+#ifdef HAVE_ALGO_CHACHA20POLY1305
+static COSE_ssize_t _encrypt_piv(const cose_key_t *key, uint64_t seq,
+                                 uint8_t **out)
+{
+    uint8_t piv[sizeof(seq)];
+    uint8_t iv[sizeof(nonce)];
+    size_t piv_len = 0;
+    cose_encrypt_t crypt;
+    cose_recp_t recps[1];
+
+    /* Shortest big endian encoding of the sequence number */
+    do {
+        memmove(piv + 1, piv, piv_len++);
+        piv[0] = (uint8_t)seq;
+        seq >>= 8;
+    } while (seq);
+    cose_encrypt_partial_iv_nonce(iv, sizeof(iv), nonce, piv, piv_len);
+
+    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
+    cose_encrypt_add_recipient(&crypt, key);
+    cose_encrypt_set_payload(&crypt, payload, sizeof(payload) - 1);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    cose_encrypt_set_partial_iv(&crypt, piv, piv_len);
+    return cose_encrypt_encode(&crypt, buf, sizeof(buf), iv, out);
+}
+
+static int _decrypt_piv(const cose_key_t *key, cose_replay_window_t *window,
+                        uint64_t seq, bool tamper)
+{
+    cose_encrypt_dec_t decrypt;
+    uint8_t *out;
+    size_t plaintext_len = 0;
+    COSE_ssize_t len = _encrypt_piv(key, seq, &out);
+
+    if (len <= 0 || cose_encrypt_decode(&decrypt, out, (size_t)len) < 0) {
+        return COSE_ERR_INVALID_CBOR;
+    }
+    if (tamper) {
+        out[len - 1] ^= 0x01;
+    }
+    int res = cose_encrypt_decrypt_replay(&decrypt, NULL, key, window,
+                                          plaintext, 256, plaintext + 256,
+                                          &plaintext_len);
+    if (res == COSE_OK) {
+        CU_ASSERT_EQUAL(plaintext_len, sizeof(payload) - 1);
+        CU_ASSERT_EQUAL(memcmp(plaintext + 256, payload, plaintext_len), 0);
+    }
+    return res;
+}
+
+void test_encrypt_replay(void)
+{
+    cose_replay_window_t window;
+    cose_encrypt_dec_t decrypt;
+    cose_key_t key;
+    uint8_t *out;
+    size_t plaintext_len = 0;
+
+    cose_key_init(&key);
+    cose_key_set_keys(&key, 0, COSE_ALGO_CHACHA20POLY1305, NULL, NULL, chachakey);
+    cose_replay_init(&window, nonce, NULL);
+
+    /* The Partial IV is combined with the base IV to the full nonce */
+    COSE_ssize_t len = _encrypt_piv(&key, 5, &out);
+    CU_ASSERT_FATAL(len > 0);
+    CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode(&decrypt, out, (size_t)len), 0);
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt(&decrypt, NULL, &key, plaintext, 256,
+                                         plaintext + 256, &plaintext_len),
+                    COSE_ERR_CRYPTO);
+
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 5, false), COSE_OK);
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 5, false), COSE_ERR_REPLAY);
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 4, false), COSE_OK);
+
+    /* Forged messages don't advance the window */
+    CU_ASSERT_NOT_EQUAL(_decrypt_piv(&key, &window, 1000, true), COSE_OK);
+    CU_ASSERT_EQUAL(cose_replay_check(&window, 3), COSE_OK);
+    CU_ASSERT_EQUAL(cose_replay_check(&window, 1000), COSE_OK);
+
+    /* Sequence numbers that fall out of the window are rejected */
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, COSE_REPLAY_WINDOW + 40, false),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 3, false), COSE_ERR_REPLAY);
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 100, false), COSE_OK);
+    CU_ASSERT_EQUAL(_decrypt_piv(&key, &window, 100, false), COSE_ERR_REPLAY);
+
+    /* Objects with a full IV carry no sequence number */
+    cose_encrypt_t crypt;
+    cose_recp_t recps[1];
+    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, recps, 1);
+    cose_encrypt_add_recipient(&crypt, &key);
+    cose_encrypt_set_payload(&crypt, payload, sizeof(payload) - 1);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    len = cose_encrypt_encode(&crypt, buf, sizeof(buf), nonce, &out);
+    CU_ASSERT_FATAL(len > 0);
+    CU_ASSERT_EQUAL_FATAL(cose_encrypt_decode(&decrypt, out, (size_t)len), 0);
+    CU_ASSERT_EQUAL(cose_encrypt_decrypt_replay(&decrypt, NULL, &key, &window,
+                                                plaintext, 256, plaintext + 256,
+                                                &plaintext_len),
+                    COSE_ERR_CRYPTO);
+
+    /* Every block of the window is reused when the sender moves on */
+    cose_replay_init(&window, nonce, NULL);
+    for (uint64_t seq = 0; seq < 4 * COSE_REPLAY_WINDOW; seq += 3) {
+        CU_ASSERT_EQUAL(cose_replay_update(&window, seq), COSE_OK);
+        CU_ASSERT_EQUAL(cose_replay_update(&window, seq), COSE_ERR_REPLAY);
+        CU_ASSERT_EQUAL(cose_replay_check(&window, seq + 1), COSE_OK);
+    }
+    CU_ASSERT_EQUAL(cose_replay_check(&window, 3 * COSE_REPLAY_WINDOW),
+                    COSE_ERR_REPLAY);
+    CU_ASSERT_EQUAL(cose_replay_update(&window, (uint64_t)1 << 32), COSE_OK);
+    CU_ASSERT_EQUAL(cose_replay_check(&window, 4 * COSE_REPLAY_WINDOW),
+                    COSE_ERR_REPLAY);
+}
+#endif
+
 const test_t tests_encrypt[] = {
 #ifdef HAVE_ALGO_CHACHA20POLY1305
     {
@@ -212,6 +868,45 @@ const test_t tests_encrypt[] = {
         .f = test_encrypt_generic,
         .n = "Encryption with encrypt0 over algos",
     },
+    {
+        .f = test_encrypt_generic_validate,
+        .n = "Validating decoder over algos",
+    },
+    {
+        .f = test_encrypt_split,
+        .n = "Decryption with deferred AEAD",
+    },
+    {
+        .f = test_encrypt_validate,
+        .n = "Validating decoder limits",
+    },
+    {
+        .f = test_encrypt_recipients,
+        .n = "Encryption recipient storage",
+    },
+#ifdef HAVE_ALGO_CHACHA20POLY1305
+    {
+        .f = test_encrypt_replay,
+        .n = "Decryption with Partial IV and replay window",
+    },
+#endif
+#if defined(HAVE_ALGO_CHACHA20POLY1305) && defined(HAVE_ALGO_HMAC)
+    {
+        .f = test_encrypt_hkdf,
+        .n = "Encryption with direct+HKDF recipients",
+    },
+#endif
+#if defined(HAVE_ALGO_CHACHA20POLY1305) && defined(HAVE_ALGO_HMAC_SHA256) && \
+    defined(HAVE_CURVE_X25519)
+    {
+        .f = test_encrypt_ecdh_ss,
+        .n = "Encryption with ECDH-SS+HKDF recipients and secret cache",
+    },
+    {
+        .f = test_encrypt_ecdh_ss_peer,
+        .n = "ECDH-SS+HKDF derivation cache with a refilled peer key",
+    },
+#endif
     {
         .f = NULL,
         .n = NULL,
@@ -162,6 +162,151 @@ void test_hdr7(void)
     CU_ASSERT_EQUAL(memcmp(str, header.v.str, str_len), 0);
 }
 
+/* Encode a COSE_Sign1 shaped object with two unprotected headers */
+static size_t _patch_msg(uint8_t *out, size_t len, bool encrypt0)
+{
+    static const uint8_t prot[] = { 0xA1, 0x01, 0x27 };
+    static const uint8_t data[] = "payload";
+    static const uint8_t sig[] = "signature bytes";
+    nanocbor_encoder_t enc;
+
+    nanocbor_encoder_init(&enc, out, len);
+    nanocbor_fmt_tag(&enc, encrypt0 ? COSE_ENCRYPT0 : COSE_SIGN1);
+    nanocbor_fmt_array(&enc, encrypt0 ? 3 : 4);
+    nanocbor_put_bstr(&enc, prot, sizeof(prot));
+    nanocbor_fmt_map(&enc, 2);
+    nanocbor_fmt_int(&enc, COSE_HDR_KID);
+    nanocbor_put_bstr(&enc, (const uint8_t *)"kid", 3);
+    nanocbor_put_tstr(&enc, "label");
+    nanocbor_fmt_int(&enc, 7);
+    nanocbor_put_bstr(&enc, data, sizeof(data));
+    if (!encrypt0) {
+        nanocbor_put_bstr(&enc, sig, sizeof(sig));
+    }
+    return nanocbor_encoded_len(&enc);
+}
+
+static const uint8_t *_patch_unprot(const uint8_t *msg, size_t len,
+                                    size_t *map_len)
+{
+    nanocbor_value_t p, arr;
+    const uint8_t *map = NULL;
+    nanocbor_decoder_init(&p, msg, len);
+    nanocbor_skip_simple(&p);
+    nanocbor_enter_array(&p, &arr);
+    nanocbor_skip(&arr);
+    nanocbor_get_subcbor(&arr, &map, map_len);
+    return map;
+}
+
+void test_hdr8(void)
+{
+    uint8_t orig[BUF_SIZE];
+    uint8_t head[BUF_SIZE];
+    const uint8_t *tail = NULL;
+    size_t tail_len = 0;
+    size_t map_len = 0;
+    cose_hdr_t hdrs[3];
+    cose_hdr_t *list = NULL;
+    cose_hdr_t hdr;
+
+    for (unsigned encrypt0 = 0; encrypt0 < 2; encrypt0++) {
+        size_t len = _patch_msg(orig, sizeof(orig), encrypt0);
+        const uint8_t *map = _patch_unprot(orig, len, &map_len);
+        const uint8_t *orig_tail = map + map_len;
+
+        /* Replace the key ID, add a content type */
+        list = NULL;
+        cose_hdr_format_data(&hdrs[0], COSE_HDR_KID,
+                             (const uint8_t *)"new kid", 7);
+        cose_hdr_insert(&list, &hdrs[0]);
+        cose_hdr_format_int(&hdrs[1], COSE_HDR_CONTENT_TYPE, 60);
+        cose_hdr_insert(&list, &hdrs[1]);
+
+        COSE_ssize_t head_len = cose_hdr_patch_unprot_head(orig, len, list,
+                                                           head,
+                                                           sizeof(head),
+                                                           &tail, &tail_len);
+        CU_ASSERT_FATAL(head_len > 0);
+        CU_ASSERT(tail == orig_tail);
+        CU_ASSERT_EQUAL(tail_len, len - (size_t)(orig_tail - orig));
+        CU_ASSERT_EQUAL(cose_hdr_patch_unprot_head(orig, len, list, head,
+                                                   (size_t)head_len - 1,
+                                                   &tail, &tail_len),
+                        COSE_ERR_NOMEM);
+
+        map = _patch_unprot(head, (size_t)head_len, &map_len);
+        CU_ASSERT_EQUAL((size_t)(map + map_len - head), (size_t)head_len);
+        CU_ASSERT(cose_hdr_decode_from_cbor(map, map_len, &hdr, COSE_HDR_KID));
+        CU_ASSERT_EQUAL(hdr.len, 7);
+        CU_ASSERT_EQUAL(memcmp(hdr.v.data, "new kid", 7), 0);
+        CU_ASSERT(cose_hdr_decode_from_cbor(map, map_len, &hdr,
+                                            COSE_HDR_CONTENT_TYPE));
+        CU_ASSERT_EQUAL(hdr.v.value, 60);
+
+        /* Same result in place */
+        memcpy(buf, orig, len);
+        CU_ASSERT_EQUAL(cose_hdr_patch_unprot(buf, len, len, list),
+                        COSE_ERR_NOMEM);
+        COSE_ssize_t new_len = cose_hdr_patch_unprot(buf, sizeof(buf), len,
+                                                     list);
+        CU_ASSERT_EQUAL_FATAL(new_len, head_len + (COSE_ssize_t)tail_len);
+        CU_ASSERT_EQUAL(memcmp(buf, head, (size_t)head_len), 0);
+        CU_ASSERT_EQUAL(memcmp(buf + head_len, orig_tail, tail_len), 0);
+
+        /* Remove both integer labelled headers again, shrinking the map */
+        hdrs[0].type = COSE_HDR_TYPE_UNDEF;
+        hdrs[1].type = COSE_HDR_TYPE_UNDEF;
+        new_len = cose_hdr_patch_unprot(buf, sizeof(buf), (size_t)new_len,
+                                        list);
+        CU_ASSERT_FATAL(new_len > 0);
+        map = _patch_unprot(buf, (size_t)new_len, &map_len);
+        CU_ASSERT_FALSE(cose_hdr_decode_from_cbor(map, map_len, &hdr,
+                                                  COSE_HDR_KID));
+        CU_ASSERT_EQUAL(map[0], 0xA1);
+        CU_ASSERT_EQUAL(memcmp(map + map_len, orig_tail, tail_len), 0);
+
+        /* Raw CBOR headers can't be encoded */
+        hdrs[2].type = COSE_HDR_TYPE_CBOR;
+        hdrs[2].key = 33;
+        hdrs[2].next = NULL;
+        CU_ASSERT_EQUAL(cose_hdr_patch_unprot(buf, sizeof(buf),
+                                              (size_t)new_len, &hdrs[2]),
+                        COSE_ERR_INVALID_PARAM);
+    }
+    /* Not a COSE object */
+    CU_ASSERT_EQUAL(cose_hdr_patch_unprot(head, sizeof(head), 1, list),
+                    COSE_ERR_INVALID_CBOR);
+}
+
+void test_hdr9(void)
+{
+    static const uint8_t data[] = "kid";
+    cose_hdr_t hdr;
+    cose_headers_t headers = { .prot = NULL, .unprot = NULL };
+    nanocbor_encoder_t enc;
+
+    CU_ASSERT_TRUE(cose_hdr_format_data(&hdr, COSE_HDR_KID, data, 3));
+    CU_ASSERT_EQUAL(hdr.type, COSE_HDR_TYPE_BSTR);
+    CU_ASSERT_EQUAL(hdr.len, 3);
+    hdr.next = NULL;
+    cose_hdr_insert(&headers.unprot, &hdr);
+    CU_ASSERT_TRUE(cose_hdr_encodable(&headers));
+
+#ifdef COSE_COMPACT_LAYOUT
+    /* Lengths not fitting the 24 bit field are rejected, not truncated */
+    CU_ASSERT_FALSE(cose_hdr_format_data(&hdr, COSE_HDR_KID, data,
+                                         (size_t)COSE_HDR_COMPACT_LEN_MAX + 2));
+    CU_ASSERT_EQUAL(hdr.len, 0);
+#else
+    hdr.type = COSE_HDR_TYPE_UNDEF;
+#endif
+    CU_ASSERT_FALSE(cose_hdr_encodable(&headers));
+    nanocbor_encoder_init(&enc, buf, BUF_SIZE);
+    nanocbor_fmt_map(&enc, 1);
+    CU_ASSERT_NOT_EQUAL(cose_hdr_encode_to_map(&hdr, &enc), 0);
+}
+
 const test_t tests_hdr[] = {
     {
         .f = test_hdr1,
@@ -187,6 +332,14 @@ const test_t tests_hdr[] = {
         .f = test_hdr7,
         .n = "header with bytes to CBOR conversion",
     },
+    {
+        .f = test_hdr8,
+        .n = "Patch unprotected headers of encoded objects",
+    },
+    {
+        .f = test_hdr9,
+        .n = "Reject byte headers not fitting the header",
+    },
     {
         .f = NULL,
         .n = NULL,
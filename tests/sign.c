@@ -26,9 +26,15 @@ static char kid2[] = "koen@example.net";
 #ifdef HAVE_ALGO_EDDSA
 #define TEST_CRYPTO_SIGN_PUBLICKEYBYTES COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES
 #define TEST_CRYPTO_SIGN_SECRETKEYBYTES COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES
+#define TEST_SIGN_PROT_SIZE             3U /* {1: -8} */
 #elif defined(HAVE_ALGO_ECDSA)
 #define TEST_CRYPTO_SIGN_PUBLICKEYBYTES COSE_CRYPTO_SIGN_P521_PUBLICKEYBYTES
 #define TEST_CRYPTO_SIGN_SECRETKEYBYTES COSE_CRYPTO_SIGN_P521_SECRETKEYBYTES
+#if defined(HAVE_CURVE_P521)
+#define TEST_SIGN_PROT_SIZE             4U /* {1: -36} */
+#else
+#define TEST_SIGN_PROT_SIZE             3U /* {1: -7} */
+#endif
 #else
 #error No suitable signature algorithm
 #endif
@@ -267,6 +273,8 @@ void test_sign4(void)
     verification = cose_sign_verify(&verify, &vsignature, &key, ver_buf, sizeof(ver_buf));
     /* Should fail due to modified payload */
     CU_ASSERT_NOT_EQUAL(verification, 0);
+    /* A single signature only */
+    CU_ASSERT_FALSE(cose_sign_signature_iter(&verify, &vsignature));
 }
 
 /* External payload signer test */
@@ -316,6 +324,8 @@ void test_sign5(void)
     verification = cose_sign_verify(&verify, &vsignature, &key, ver_buf, sizeof(ver_buf));
     /* Should fail due to modified payload */
     CU_ASSERT_NOT_EQUAL(verification, 0);
+    /* A single signature only */
+    CU_ASSERT_FALSE(cose_sign_signature_iter(&verify, &vsignature));
 }
 
 /* External payload signer test */
@@ -502,6 +512,870 @@ void test_sign8(void)
     CU_ASSERT_NOT_EQUAL(verification, COSE_OK);
 }
 
+/* Sign1 encoding with a buffer sized by the size helpers */
+void test_sign9(void)
+{
+    uint8_t *psign = NULL;
+    char sign1_payload[] = "Input string";
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    cose_key_t key;
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, sign1_payload, sizeof(sign1_payload) - 1);
+
+    genkey(&key, pkx1, pky1, sk1);
+    cose_key_set_kid(&key, (uint8_t*)kid, sizeof(kid) - 1);
+    cose_sign_add_signer(&sign, &signature, &key);
+
+    CU_ASSERT_EQUAL(COSE_CBOR_HEAD_SIZE(23U), 1);
+    CU_ASSERT_EQUAL(COSE_CBOR_HEAD_SIZE(24U), 2);
+    CU_ASSERT_EQUAL(COSE_CBOR_HEAD_SIZE(0x10000U), 5);
+    CU_ASSERT_EQUAL(COSE_CBOR_HEAD_SIZE(0xffffffffULL), 5);
+    CU_ASSERT_EQUAL(COSE_CBOR_HEAD_SIZE(0x100000000ULL), 9);
+
+    /* Unprotected map only contains the key ID */
+    size_t unprot_size = 1 + COSE_CBOR_HEAD_SIZE(COSE_HDR_KID) +
+                         COSE_CBOR_BSTR_SIZE(sizeof(kid) - 1);
+    size_t sig_size = cose_crypto_sig_size(&key);
+    size_t bufsize = COSE_SIGN1_ENCODE_BUFSIZE(TEST_SIGN_PROT_SIZE,
+                                               unprot_size, 0,
+                                               sizeof(sign1_payload) - 1,
+                                               sig_size);
+    CU_ASSERT_FATAL(bufsize <= sizeof(buf));
+
+    /* Too small for the Sig_structure */
+    CU_ASSERT_EQUAL(cose_sign_encode(&sign, buf, sig_size + 4, &psign),
+                    COSE_ERR_NOMEM);
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, sign1_payload, sizeof(sign1_payload) - 1);
+    cose_sign_add_signer(&sign, &signature, &key);
+
+    COSE_ssize_t encode_size = cose_sign_encode(&sign, buf, bufsize, &psign);
+    CU_ASSERT_FATAL(encode_size > 0);
+    CU_ASSERT((size_t)encode_size <=
+              COSE_SIGN1_SIZE(TEST_SIGN_PROT_SIZE, unprot_size,
+                              sizeof(sign1_payload) - 1, sig_size));
+
+    cose_sign_dec_t verify;
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, encode_size), 0);
+    size_t tbs_size = COSE_SIGN1_TBS_SIZE(TEST_SIGN_PROT_SIZE, 0,
+                                          sizeof(sign1_payload) - 1);
+    CU_ASSERT_EQUAL(cose_sign_verify_first(&verify, &key, ver_buf, tbs_size),
+                    COSE_OK);
+    CU_ASSERT_EQUAL(cose_sign_verify_first(&verify, &key, ver_buf, tbs_size - 1),
+                    COSE_ERR_NOMEM);
+}
+
+/* Sign with signatures generated outside of the encode call */
+void test_sign10(void)
+{
+    uint8_t *psign = NULL;
+    char payload[] = "Input string";
+    static uint8_t sig_bufs[2][160];
+    cose_sign_enc_t sign;
+    cose_signature_t signature1, signature2;
+    cose_signature_t *signatures[] = { &signature1, &signature2 };
+    cose_key_t key1, key2;
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature1);
+    cose_signature_init(&signature2);
+    cose_sign_set_payload(&sign, payload, sizeof(payload) - 1);
+
+    genkey(&key1, pkx1, pky1, sk1);
+    cose_key_set_kid(&key1, (uint8_t*)kid, sizeof(kid) - 1);
+    genkey(&key2, pkx2, pky2, sk2);
+    cose_key_set_kid(&key2, (uint8_t*)kid2, sizeof(kid2) - 1);
+
+    cose_sign_add_signer(&sign, &signature1, &key1);
+    cose_sign_add_signer(&sign, &signature2, &key2);
+
+    /* Missing signatures */
+    CU_ASSERT_EQUAL(cose_sign_encode_signed(&sign, buf, sizeof(buf), &psign),
+                    COSE_ERR_INVALID_PARAM);
+
+    for (unsigned i = 0; i < 2; i++) {
+        cose_signature_t *sig = signatures[i];
+        size_t sig_len = 0;
+        CU_ASSERT_FATAL(cose_crypto_sig_size(sig->signer) <= sizeof(sig_bufs[i]));
+        COSE_ssize_t tbs_len = cose_sign_encode_tbs(&sign, sig, ver_buf,
+                                                    sizeof(ver_buf));
+        CU_ASSERT_FATAL(tbs_len > 0);
+        CU_ASSERT_EQUAL(cose_crypto_sign(sig->signer, sig_bufs[i], &sig_len,
+                                         ver_buf, tbs_len), COSE_OK);
+        cose_signature_set_signature(sig, sig_bufs[i], sig_len);
+    }
+
+    COSE_ssize_t len = cose_sign_encode_signed(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vsignature;
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), 0);
+
+    /* First signature is from the last added signer */
+    cose_sign_signature_iter_init(&vsignature);
+    CU_ASSERT(cose_sign_signature_iter(&verify, &vsignature));
+    COSE_ssize_t tbs_len = cose_sign_verify_tbs(&verify, &vsignature, ver_buf,
+                                                sizeof(ver_buf));
+    CU_ASSERT_FATAL(tbs_len > 0);
+    const uint8_t *sig = NULL;
+    size_t sig_len = 0;
+    CU_ASSERT_EQUAL(cose_sign_decode_signature(&verify, &vsignature, &sig,
+                                               &sig_len), COSE_OK);
+    CU_ASSERT_EQUAL(sig_len, signature2.signature_len);
+    CU_ASSERT_EQUAL(cose_crypto_verify(&key2, sig, sig_len, ver_buf, tbs_len),
+                    COSE_OK);
+
+    CU_ASSERT(cose_sign_signature_iter(&verify, &vsignature));
+    CU_ASSERT_EQUAL(cose_sign_verify(&verify, &vsignature, &key1, ver_buf,
+                                     sizeof(ver_buf)), COSE_OK);
+    CU_ASSERT_NOT_EQUAL(cose_sign_verify(&verify, &vsignature, &key2, ver_buf,
+                                         sizeof(ver_buf)), COSE_OK);
+}
+
+/* Validating decoder with hostile and well formed input */
+void test_sign11(void)
+{
+    uint8_t *psign = NULL;
+    char payload[] = "Input string";
+    cose_sign_enc_t sign;
+    cose_signature_t signature1, signature2;
+    cose_key_t key1, key2;
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vsignature;
+    cose_decode_limits_t limits;
+
+    /* Minimal COSE_Sign1: [h'', {}, nil, h''] */
+    static const uint8_t minimal[] = { 0x84, 0x40, 0xA0, 0xF6, 0x40 };
+    /* Minimal COSE_Sign1 with a trailing byte */
+    static const uint8_t trailing[] = { 0x84, 0x40, 0xA0, 0xF6, 0x40, 0x00 };
+    /* Unprotected header {4: [[[[[[[0]]]]]]]} */
+    static const uint8_t deep[] = {
+        0xD2, 0x84, 0x40, 0xA1, 0x04, 0x81, 0x81, 0x81, 0x81, 0x81,
+        0x81, 0x81, 0x00, 0xF6, 0x40,
+    };
+    /* Header value declaring an array of 2^32 - 1 items */
+    static const uint8_t huge[] = {
+        0x84, 0x40, 0xA1, 0x04, 0x9A, 0xFF, 0xFF, 0xFF, 0xFF, 0xF6, 0x40,
+    };
+    /* Byte string as header label */
+    static const uint8_t label[] = { 0x84, 0x40, 0xA1, 0x40, 0x00, 0xF6, 0x40 };
+    /* Protected header bstr not containing a map */
+    static const uint8_t prot[] = { 0x84, 0x41, 0x00, 0xA0, 0xF6, 0x40 };
+    /* Signature array without signatures */
+    static const uint8_t nosigs[] = { 0x84, 0x40, 0xA0, 0xF6, 0x80 };
+    uint8_t many[8 + 2 * (COSE_DECODE_HDRS_MAX + 1)] = { 0x84, 0x40,
+        0xA0 + COSE_DECODE_HDRS_MAX + 1 };
+    size_t many_len = 3;
+
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, minimal,
+                                              sizeof(minimal), NULL), COSE_OK);
+    CU_ASSERT(verify.flags & COSE_FLAGS_SIGN1);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, trailing,
+                                              sizeof(trailing), NULL),
+                    COSE_ERR_INVALID_CBOR);
+    /* The plain decoder accepts the nested headers */
+    CU_ASSERT_EQUAL(cose_sign_decode(&verify, deep, sizeof(deep)), COSE_OK);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, deep, sizeof(deep),
+                                              NULL), COSE_ERR_CBOR_NOTSUP);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, huge, sizeof(huge),
+                                              NULL), COSE_ERR_INVALID_CBOR);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, label, sizeof(label),
+                                              NULL), COSE_ERR_INVALID_CBOR);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, prot, sizeof(prot),
+                                              NULL), COSE_ERR_INVALID_CBOR);
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, nosigs, sizeof(nosigs),
+                                              NULL), COSE_ERR_INVALID_CBOR);
+
+    for (unsigned i = 0; i <= COSE_DECODE_HDRS_MAX; i++) {
+        many[many_len++] = (uint8_t)(0x20 + i); /* -1 - i */
+        many[many_len++] = 0x00;
+    }
+    many[many_len++] = 0xF6;
+    many[many_len++] = 0x40;
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, many, many_len, NULL),
+                    COSE_ERR_CBOR_NOTSUP);
+    cose_decode_limits_init(&limits);
+    limits.hdrs++;
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, many, many_len,
+                                              &limits), COSE_OK);
+
+    /* Encoded message with two signers */
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature1);
+    cose_signature_init(&signature2);
+    cose_sign_set_payload(&sign, payload, sizeof(payload) - 1);
+    genkey(&key1, pkx1, pky1, sk1);
+    cose_key_set_kid(&key1, (uint8_t*)kid, sizeof(kid) - 1);
+    genkey(&key2, pkx2, pky2, sk2);
+    cose_key_set_kid(&key2, (uint8_t*)kid2, sizeof(kid2) - 1);
+    cose_sign_add_signer(&sign, &signature1, &key1);
+    cose_sign_add_signer(&sign, &signature2, &key2);
+    COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode_validate(&verify, psign, len, NULL),
+                          COSE_OK);
+    cose_sign_signature_iter_init(&vsignature);
+    CU_ASSERT(cose_sign_signature_iter(&verify, &vsignature));
+    CU_ASSERT_EQUAL(cose_sign_verify(&verify, &vsignature, &key2, ver_buf,
+                                     sizeof(ver_buf)), COSE_OK);
+
+    /* Work limit */
+    limits.items = 8;
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, psign, len, &limits),
+                    COSE_ERR_CBOR_NOTSUP);
+    /* Truncated input */
+    CU_ASSERT_EQUAL(cose_sign_decode_validate(&verify, psign, len - 1, NULL),
+                    COSE_ERR_INVALID_CBOR);
+}
+
+/* Append signers to an encoded COSE_Sign */
+void test_sign12(void)
+{
+    uint8_t *psign = NULL;
+    uint8_t *pappend = NULL;
+    char payload[] = "Input string";
+    static uint8_t inplace[4096];
+    cose_sign_enc_t sign;
+    cose_signature_t signature1, signature2, signature3;
+    cose_key_t key1, key2;
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vsignature;
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature1);
+    cose_signature_init(&signature2);
+    cose_signature_init(&signature3);
+    cose_sign_set_payload(&sign, payload, sizeof(payload) - 1);
+    genkey(&key1, pkx1, pky1, sk1);
+    cose_key_set_kid(&key1, (uint8_t*)kid, sizeof(kid) - 1);
+    genkey(&key2, pkx2, pky2, sk2);
+    cose_key_set_kid(&key2, (uint8_t*)kid2, sizeof(kid2) - 1);
+
+    /* A single signer is encoded as COSE_Sign1, which can't be extended */
+    cose_sign_add_signer(&sign, &signature1, &key1);
+    COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+    CU_ASSERT_EQUAL(cose_sign_append_signer(&verify, &signature3, &key2,
+                                            ver_buf, sizeof(ver_buf),
+                                            &pappend),
+                    COSE_ERR_INVALID_PARAM);
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature1);
+    cose_sign_set_payload(&sign, payload, sizeof(payload) - 1);
+    cose_sign_add_signer(&sign, &signature1, &key1);
+    cose_sign_add_signer(&sign, &signature2, &key2);
+    len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+
+    CU_ASSERT_EQUAL(cose_sign_append_signer(&verify, &signature3, &key1,
+                                            ver_buf, len, &pappend),
+                    COSE_ERR_NOMEM);
+    COSE_ssize_t alen = cose_sign_append_signer(&verify, &signature3, &key1,
+                                                ver_buf, sizeof(ver_buf),
+                                                &pappend);
+    CU_ASSERT_FATAL(alen > len);
+    /* Headers and payload are copied unmodified */
+    size_t body_len = (size_t)((const uint8_t *)verify.payload +
+                               verify.payload_len - psign);
+    CU_ASSERT_EQUAL(memcmp(pappend, psign, body_len), 0);
+
+    /* Same result in place */
+    memcpy(inplace, psign, (size_t)len);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, inplace, len), COSE_OK);
+    COSE_ssize_t ilen = cose_sign_append_signer(&verify, &signature3, &key1,
+                                                inplace, sizeof(inplace),
+                                                &pappend);
+    CU_ASSERT_EQUAL_FATAL(ilen, alen);
+    CU_ASSERT(pappend == inplace);
+    CU_ASSERT_EQUAL(memcmp(inplace, ver_buf, (size_t)alen -
+                           signature3.signature_len), 0);
+
+    /* Grow the signatures array past the single byte array header */
+    for (unsigned i = 3; i < 25; i++) {
+        CU_ASSERT_EQUAL_FATAL(cose_sign_decode_validate(&verify, inplace,
+                                                        ilen, NULL), COSE_OK);
+        ilen = cose_sign_append_signer(&verify, &signature3,
+                                       i & 1 ? &key1 : &key2, inplace,
+                                       sizeof(inplace), &pappend);
+        CU_ASSERT_FATAL(ilen > 0);
+    }
+
+    cose_decode_limits_t limits;
+    cose_decode_limits_init(&limits);
+    limits.items = 1024;
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode_validate(&verify, inplace, ilen,
+                                                    &limits), COSE_OK);
+    unsigned count = 0;
+    cose_sign_signature_iter_init(&vsignature);
+    while (cose_sign_signature_iter(&verify, &vsignature)) {
+        /* Signatures alternate between the two keys */
+        CU_ASSERT(cose_sign_verify(&verify, &vsignature, &key1, buf,
+                                   sizeof(buf)) == COSE_OK ||
+                  cose_sign_verify(&verify, &vsignature, &key2, buf,
+                                   sizeof(buf)) == COSE_OK);
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, 25);
+}
+
+/* Executor deferring all jobs to the wait call, running them in reverse */
+typedef struct {
+    cose_job_fn_t fn[4];
+    void *arg[4];
+    unsigned num;
+} test_executor_t;
+
+static int _test_submit(void *ctx, cose_job_fn_t fn, void *arg)
+{
+    test_executor_t *exec = ctx;
+    if (exec->num == 4) {
+        return -1;
+    }
+    exec->fn[exec->num] = fn;
+    exec->arg[exec->num++] = arg;
+    return 0;
+}
+
+static void _test_wait(void *ctx)
+{
+    test_executor_t *exec = ctx;
+    while (exec->num) {
+        exec->num--;
+        exec->fn[exec->num](exec->arg[exec->num]);
+    }
+}
+
+static unsigned _count_countersignatures(const cose_sign_dec_t *sign)
+{
+    cose_signature_dec_t cs;
+    unsigned count = 0;
+    cose_sign_countersignature_iter_init(&cs);
+    while (cose_sign_countersignature_iter(sign, &cs)) {
+        count++;
+    }
+    return count;
+}
+
+/* Countersignatures on sign1 and sign objects */
+void test_sign13(void)
+{
+    uint8_t *psign = NULL;
+    uint8_t *pcs = NULL;
+    char payload[] = "Input string";
+    static uint8_t msg[4096];
+    cose_sign_enc_t sign;
+    cose_signature_t signature1, signature2, countersig;
+    cose_key_t key1, key2;
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vcs;
+    cose_hdr_t hdr;
+
+    genkey(&key1, pkx1, pky1, sk1);
+    cose_key_set_kid(&key1, (uint8_t*)kid, sizeof(kid) - 1);
+    genkey(&key2, pkx2, pky2, sk2);
+    cose_key_set_kid(&key2, (uint8_t*)kid2, sizeof(kid2) - 1);
+
+    for (unsigned signers = 1; signers <= 2; signers++) {
+        cose_sign_init(&sign, 0);
+        cose_signature_init(&signature1);
+        cose_signature_init(&signature2);
+        cose_sign_set_payload(&sign, payload, sizeof(payload) - 1);
+        cose_sign_add_signer(&sign, &signature1, &key1);
+        if (signers == 2) {
+            cose_sign_add_signer(&sign, &signature2, &key2);
+        }
+        /* Signers are prepended, the first signature is from the last */
+        cose_key_t *first = signers == 2 ? &key2 : &key1;
+        /* Unrelated unprotected header in front of the countersignature */
+        cose_hdr_t ct;
+        cose_hdr_format_int(&ct, COSE_HDR_CONTENT_TYPE, 42);
+        cose_sign_insert_unprot(&sign, &ct);
+        COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+        CU_ASSERT_FATAL(len > 0);
+        CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+        CU_ASSERT_EQUAL(_count_countersignatures(&verify), 0);
+
+        /* Into a separate buffer */
+        cose_signature_init(&countersig);
+        COSE_ssize_t cslen = cose_sign_countersign(&verify, &countersig,
+                                                   &key2, msg, sizeof(msg),
+                                                   &pcs);
+        CU_ASSERT_FATAL(cslen > len);
+        CU_ASSERT_EQUAL_FATAL(cose_sign_decode_validate(&verify, pcs, cslen,
+                                                        NULL), COSE_OK);
+        CU_ASSERT_EQUAL(cose_sign_decode_unprotected(&verify, &hdr,
+                                                     COSE_HDR_CONTENT_TYPE),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(hdr.v.value, 42);
+        CU_ASSERT_EQUAL(cose_sign_verify_first(&verify, first, ver_buf,
+                                               sizeof(ver_buf)), COSE_OK);
+        CU_ASSERT_EQUAL_FATAL(_count_countersignatures(&verify), 1);
+        cose_sign_countersignature_iter_init(&vcs);
+        CU_ASSERT_FATAL(cose_sign_countersignature_iter(&verify, &vcs));
+        CU_ASSERT_EQUAL(cose_sign_verify_countersignature(&verify, &vcs, &key2,
+                                                          ver_buf,
+                                                          sizeof(ver_buf)),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(cose_sign_verify_countersignature(&verify, &vcs, &key1,
+                                                          ver_buf,
+                                                          sizeof(ver_buf)),
+                        COSE_ERR_CRYPTO);
+
+        /* In place, turning the countersignature into an array */
+        for (unsigned i = 2; i <= 3; i++) {
+            cose_signature_init(&countersig);
+            cslen = cose_sign_countersign(&verify, &countersig,
+                                          i & 1 ? &key2 : &key1, msg,
+                                          sizeof(msg), &pcs);
+            CU_ASSERT_FATAL(cslen > 0);
+            CU_ASSERT(pcs == msg);
+            CU_ASSERT_EQUAL_FATAL(cose_sign_decode_validate(&verify, pcs,
+                                                            cslen, NULL),
+                                  COSE_OK);
+            CU_ASSERT_EQUAL(_count_countersignatures(&verify), i);
+        }
+
+        /* All signatures checked through the executor */
+        test_executor_t texec = { .num = 0 };
+        cose_executor_t exec = {
+            .submit = _test_submit,
+            .wait = _test_wait,
+            .ctx = &texec,
+        };
+        cose_sign_verify_job_t jobs[4];
+        const cose_key_t *cs_keys[] = { &key2, &key1, &key2, &key1 };
+        CU_ASSERT_EQUAL(cose_sign_verify_concurrent(&verify, first, cs_keys, 3,
+                                                    jobs, &exec, ver_buf,
+                                                    sizeof(ver_buf)),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(cose_sign_verify_concurrent(&verify, first, cs_keys, 3,
+                                                    jobs, NULL, ver_buf,
+                                                    sizeof(ver_buf)),
+                        COSE_OK);
+        CU_ASSERT_EQUAL(cose_sign_verify_concurrent(&verify, first, cs_keys, 4,
+                                                    jobs, &exec, ver_buf,
+                                                    sizeof(ver_buf)),
+                        COSE_ERR_NOT_FOUND);
+        CU_ASSERT_EQUAL(cose_sign_verify_concurrent(&verify, first,
+                                                    cs_keys + 1, 3, jobs,
+                                                    &exec, ver_buf,
+                                                    sizeof(ver_buf)),
+                        COSE_ERR_CRYPTO);
+        CU_ASSERT_EQUAL(jobs[0].res, COSE_OK);
+        CU_ASSERT_EQUAL(jobs[1].res, COSE_ERR_CRYPTO);
+
+        /* Countersignatures cover the payload */
+        cose_sign_decode_set_payload(&verify, "Other string",
+                                     sizeof(payload) - 1);
+        cose_sign_countersignature_iter_init(&vcs);
+        while (cose_sign_countersignature_iter(&verify, &vcs)) {
+            CU_ASSERT_EQUAL(cose_sign_verify_countersignature(&verify, &vcs,
+                                                              &key1, ver_buf,
+                                                              sizeof(ver_buf)),
+                            COSE_ERR_CRYPTO);
+            CU_ASSERT_EQUAL(cose_sign_verify_countersignature(&verify, &vcs,
+                                                              &key2, ver_buf,
+                                                              sizeof(ver_buf)),
+                            COSE_ERR_CRYPTO);
+        }
+    }
+}
+
+#define TEST_KEYGEN_NUM  10
+static uint8_t keymat[TEST_KEYGEN_NUM * (3 * COSE_CRYPTO_EC2_KEYBYTES + 8)];
+
+void test_sign14(void)
+{
+    cose_key_t keys[TEST_KEYGEN_NUM];
+#ifdef HAVE_ALGO_EDDSA
+    cose_key_gen_t gen = { .crv = COSE_EC_CURVE_ED25519, .algo = COSE_ALGO_EDDSA };
+#else
+    cose_key_gen_t gen = { .crv = COSE_EC_CURVE_P256, .algo = COSE_ALGO_ES256 };
+#endif
+    test_executor_t texec = { .num = 0 };
+    cose_executor_t exec = {
+        .submit = _test_submit,
+        .wait = _test_wait,
+        .ctx = &texec,
+    };
+
+    gen.kid = COSE_KEY_KID_COUNTER;
+    gen.kid_len = 2;
+    gen.kid_base = 0x100;
+    size_t size = cose_key_gen_size(&gen);
+    CU_ASSERT_FATAL(size > 0);
+    CU_ASSERT_FATAL(size * TEST_KEYGEN_NUM <= sizeof(keymat));
+
+    CU_ASSERT_EQUAL(cose_key_generate(&gen, keys, TEST_KEYGEN_NUM, keymat,
+                                      size * TEST_KEYGEN_NUM - 1, &exec),
+                    COSE_ERR_NOMEM);
+    CU_ASSERT_EQUAL_FATAL(cose_key_generate(&gen, keys, TEST_KEYGEN_NUM, keymat,
+                                            sizeof(keymat), &exec),
+                          COSE_OK);
+    for (unsigned i = 0; i < TEST_KEYGEN_NUM; i++) {
+        CU_ASSERT_EQUAL(keys[i].kid_len, 2);
+        CU_ASSERT_EQUAL(keys[i].kid[0], 0x01);
+        CU_ASSERT_EQUAL(keys[i].kid[1], i);
+        CU_ASSERT_EQUAL(keys[i].algo, gen.algo);
+    }
+    CU_ASSERT_NOT_EQUAL(memcmp(keys[0].x, keys[TEST_KEYGEN_NUM - 1].x, 32), 0);
+
+    /* Generated keys sign and verify */
+    uint8_t *psign = NULL;
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vsignature;
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, "Input string", 12);
+    cose_sign_add_signer(&sign, &signature, &keys[7]);
+    COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+    cose_sign_signature_iter_init(&vsignature);
+    CU_ASSERT_FATAL(cose_sign_signature_iter(&verify, &vsignature));
+    CU_ASSERT_EQUAL(cose_sign_verify(&verify, &vsignature, &keys[7], ver_buf,
+                                     sizeof(ver_buf)), COSE_OK);
+    CU_ASSERT_NOT_EQUAL(cose_sign_verify(&verify, &vsignature, &keys[6],
+                                         ver_buf, sizeof(ver_buf)), COSE_OK);
+
+    /* Key set export */
+    COSE_ssize_t priv_len = cose_keyset_encode(keys, TEST_KEYGEN_NUM, true,
+                                               NULL, 0);
+    COSE_ssize_t pub_len = cose_keyset_encode(keys, TEST_KEYGEN_NUM, false,
+                                              NULL, 0);
+    CU_ASSERT_FATAL(priv_len > pub_len);
+    CU_ASSERT_FATAL((size_t)priv_len <= sizeof(buf));
+    CU_ASSERT_EQUAL(cose_keyset_encode(keys, TEST_KEYGEN_NUM, true, buf,
+                                       priv_len - 1), COSE_ERR_NOMEM);
+    CU_ASSERT_EQUAL(cose_keyset_encode(keys, TEST_KEYGEN_NUM, true, buf,
+                                       sizeof(buf)), priv_len);
+
+    nanocbor_value_t dec, arr, map;
+    int32_t label, value;
+    nanocbor_decoder_init(&dec, buf, priv_len);
+    CU_ASSERT_EQUAL_FATAL(nanocbor_enter_array(&dec, &arr), NANOCBOR_OK);
+    CU_ASSERT_EQUAL(nanocbor_container_remaining(&arr), TEST_KEYGEN_NUM);
+    CU_ASSERT_EQUAL_FATAL(nanocbor_enter_map(&arr, &map), NANOCBOR_OK);
+    CU_ASSERT(nanocbor_get_int32(&map, &label) >= 0 &&
+              label == COSE_KEY_PARAM_KTY);
+    CU_ASSERT(nanocbor_get_int32(&map, &value) >= 0 &&
+              value == (int32_t)keys[0].kty);
+
+    /* Key identifiers from the public key */
+    gen.kid = COSE_KEY_KID_PUBLIC;
+    gen.kid_len = 8;
+    CU_ASSERT_EQUAL_FATAL(cose_key_generate(&gen, keys, 3, keymat,
+                                            sizeof(keymat), NULL),
+                          COSE_OK);
+#ifdef HAVE_ALGO_EDDSA
+    CU_ASSERT_EQUAL(memcmp(keys[2].kid, keys[2].x, 8), 0);
+#else
+    CU_ASSERT_EQUAL(memcmp(keys[2].kid, keys[2].x +
+                           COSE_CRYPTO_EC2_KEYBYTES - 32, 8), 0);
+#endif
+
+    gen.kid = COSE_KEY_KID_COUNTER;
+    gen.kid_len = 9;
+    CU_ASSERT_EQUAL(cose_key_generate(&gen, keys, 3, keymat, sizeof(keymat),
+                                      NULL), COSE_ERR_INVALID_PARAM);
+
+#ifdef HAVE_ALGO_CHACHA20POLY1305
+    /* Symmetric keys, the secret is only part of the private key set */
+    cose_key_gen_t symm = {
+        .algo = COSE_ALGO_CHACHA20POLY1305,
+        .kid = COSE_KEY_KID_COUNTER,
+        .kid_len = 1,
+    };
+    CU_ASSERT_EQUAL(cose_key_gen_size(&symm),
+                    COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES + 1);
+    CU_ASSERT_EQUAL_FATAL(cose_key_generate(&symm, keys, TEST_KEYGEN_NUM,
+                                            keymat, sizeof(keymat), &exec),
+                          COSE_OK);
+    CU_ASSERT_EQUAL(keys[4].kty, COSE_KTY_SYMM);
+    CU_ASSERT_EQUAL(keys[4].kid[0], 4);
+    priv_len = cose_keyset_encode(keys, TEST_KEYGEN_NUM, true, NULL, 0);
+    pub_len = cose_keyset_encode(keys, TEST_KEYGEN_NUM, false, NULL, 0);
+    CU_ASSERT_EQUAL(priv_len - pub_len, TEST_KEYGEN_NUM * (1 +
+                    COSE_CBOR_BSTR_SIZE(COSE_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES)));
+#endif
+}
+
+static void _sched_done(cose_sign_sched_req_t *req)
+{
+    (*(unsigned *)req->arg)++;
+}
+
+static uint32_t _test_clock(void *arg)
+{
+    return *(uint32_t *)arg;
+}
+
+/* Batched verification through the scheduler */
+void test_sign15(void)
+{
+    static uint8_t scratch[6][512];
+    static uint8_t copy[512];
+    uint8_t *psign = NULL;
+    char payload[] = "Input string";
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    cose_key_t key;
+    cose_sign_dec_t verify, tampered;
+    cose_sign_sched_req_t reqs[6];
+    cose_sign_sched_cfg_t cfg;
+    cose_sign_sched_t sched;
+    uint32_t now = 0xffffff00;
+    unsigned done = 0;
+    test_executor_t texec = { .num = 0 };
+    cose_executor_t exec = {
+        .submit = _test_submit,
+        .wait = _test_wait,
+        .ctx = &texec,
+    };
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, payload, strlen(payload));
+    genkey(&key, pkx1, pky1, sk1);
+    cose_sign_add_signer(&sign, &signature, &key);
+    COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0 && (size_t)len <= sizeof(copy));
+    memcpy(copy, psign, len);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&tampered, copy, len), COSE_OK);
+    ((uint8_t *)tampered.payload)[0]++;
+
+    for (unsigned i = 0; i < 6; i++) {
+        reqs[i].sign = i == 5 ? &tampered : &verify;
+        reqs[i].key = &key;
+        reqs[i].buf = scratch[i];
+        reqs[i].len = sizeof(scratch[i]);
+        reqs[i].done = _sched_done;
+        reqs[i].arg = &done;
+    }
+
+    /* Lingering requests wait for a full batch */
+    cose_sign_sched_cfg_init(&cfg);
+    CU_ASSERT_EQUAL(cfg.batch, COSE_SIGN_SCHED_BATCH);
+    cfg.batch = 4;
+    cfg.linger = true;
+    cose_sign_sched_init(&sched, &cfg, _test_clock, &now, NULL, &exec);
+    for (unsigned i = 0; i < 3; i++) {
+        CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[i]), 0);
+    }
+    CU_ASSERT_EQUAL(done, 0);
+    CU_ASSERT_EQUAL(reqs[0].res, COSE_ERR_NOINIT);
+    CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[3]), 4);
+    CU_ASSERT_EQUAL(done, 4);
+    for (unsigned i = 0; i < 4; i++) {
+        CU_ASSERT_EQUAL(reqs[i].res, COSE_OK);
+    }
+
+    /* or for the deadline, across a clock wrap */
+    CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[4]), 0);
+    now += 100;
+    CU_ASSERT_EQUAL(cose_sign_sched_poll(&sched), 0);
+    now += cfg.deadline;
+    CU_ASSERT_EQUAL(cose_sign_sched_poll(&sched), 1);
+    CU_ASSERT_EQUAL(reqs[4].res, COSE_OK);
+    CU_ASSERT_EQUAL(cose_sign_sched_flush(&sched), 0);
+
+    /* An idle scheduler dispatches immediately */
+    cfg.linger = false;
+    cose_sign_sched_init(&sched, &cfg, _test_clock, &now, NULL, &exec);
+    CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[5]), 1);
+    CU_ASSERT_NOT_EQUAL(reqs[5].res, COSE_OK);
+    CU_ASSERT_EQUAL(done, 6);
+
+    /* Without a clock polling dispatches everything */
+    cfg.linger = true;
+    cose_sign_sched_init(&sched, &cfg, NULL, NULL, NULL, NULL);
+    CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[0]), 0);
+    CU_ASSERT_EQUAL(cose_sign_sched_submit(&sched, &reqs[5]), 0);
+    CU_ASSERT_EQUAL(cose_sign_sched_poll(&sched), 2);
+    CU_ASSERT_EQUAL(reqs[0].res, COSE_OK);
+    CU_ASSERT_NOT_EQUAL(reqs[5].res, COSE_OK);
+}
+
+/* Indexed keystore, keys used as views into the image */
+void test_sign16(void)
+{
+    static uint8_t store_buf[2048];
+    cose_key_t keys[TEST_KEYGEN_NUM];
+    cose_keystore_t store;
+    cose_key_t key;
+#ifdef HAVE_ALGO_EDDSA
+    cose_key_gen_t gen = { .crv = COSE_EC_CURVE_ED25519, .algo = COSE_ALGO_EDDSA };
+#else
+    cose_key_gen_t gen = { .crv = COSE_EC_CURVE_P256, .algo = COSE_ALGO_ES256 };
+#endif
+    uint8_t missing[2];
+
+    gen.kid = COSE_KEY_KID_COUNTER;
+    gen.kid_len = 2;
+    gen.kid_base = 0x100;
+    CU_ASSERT_EQUAL_FATAL(cose_key_generate(&gen, keys, TEST_KEYGEN_NUM, keymat,
+                                            sizeof(keymat), NULL),
+                          COSE_OK);
+    /* Out of order key identifiers are sorted in the index */
+    keys[3].kid = (uint8_t *)"\x00\x07";
+    keys[5].kid = (uint8_t *)"\xff";
+    keys[5].kid_len = 1;
+
+    COSE_ssize_t priv_len = cose_keystore_encode(keys, TEST_KEYGEN_NUM, true,
+                                                 NULL, 0);
+    COSE_ssize_t pub_len = cose_keystore_encode(keys, TEST_KEYGEN_NUM, false,
+                                                NULL, 0);
+    CU_ASSERT_FATAL(priv_len > pub_len);
+    CU_ASSERT_FATAL((size_t)priv_len <= sizeof(store_buf));
+    CU_ASSERT_EQUAL(cose_keystore_encode(keys, TEST_KEYGEN_NUM, true, store_buf,
+                                         priv_len - 1), COSE_ERR_NOMEM);
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_encode(keys, TEST_KEYGEN_NUM, true,
+                                               store_buf, sizeof(store_buf)),
+                          priv_len);
+
+    CU_ASSERT_EQUAL(cose_keystore_open(&store, store_buf, COSE_KEYSTORE_HDR_SIZE - 1),
+                    COSE_ERR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(cose_keystore_open(&store, store_buf, priv_len - 1),
+                    COSE_ERR_INVALID_PARAM);
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_open(&store, store_buf, priv_len),
+                          COSE_OK);
+    CU_ASSERT_EQUAL(store.num, TEST_KEYGEN_NUM);
+
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_get(&store, 9, &key), COSE_OK);
+    CU_ASSERT_EQUAL(key.kid_len, 2);
+    CU_ASSERT_EQUAL(memcmp(key.kid, keys[9].kid, 2), 0);
+    CU_ASSERT_EQUAL(cose_keystore_get(&store, TEST_KEYGEN_NUM, &key),
+                    COSE_ERR_NOT_FOUND);
+
+    for (unsigned i = 0; i < TEST_KEYGEN_NUM; i++) {
+        CU_ASSERT_EQUAL_FATAL(cose_keystore_find(&store, keys[i].kid,
+                                                 keys[i].kid_len, &key),
+                              COSE_OK);
+        CU_ASSERT_EQUAL(key.kty, keys[i].kty);
+        CU_ASSERT_EQUAL(key.algo, keys[i].algo);
+        CU_ASSERT_EQUAL(key.crv, keys[i].crv);
+        CU_ASSERT_EQUAL(memcmp(key.x, keys[i].x, 32), 0);
+        CU_ASSERT_FATAL(key.d != NULL);
+    }
+    missing[0] = 0x01;
+    missing[1] = 0xee;
+    CU_ASSERT_EQUAL(cose_keystore_find(&store, missing, 2, &key), COSE_ERR_NOT_FOUND);
+    CU_ASSERT_EQUAL(cose_keystore_find(&store, missing, 1, &key), COSE_ERR_NOT_FOUND);
+
+    /* Sign with a private view, verify with a view from the public image */
+    uint8_t *psign = NULL;
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vsignature;
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_find(&store, keys[4].kid, 2, &key),
+                          COSE_OK);
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, "Input string", 12);
+    cose_sign_add_signer(&sign, &signature, &key);
+    COSE_ssize_t len = cose_sign_encode(&sign, buf, sizeof(buf), &psign);
+    CU_ASSERT_FATAL(len > 0);
+
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_encode(keys, TEST_KEYGEN_NUM, false,
+                                               store_buf, sizeof(store_buf)),
+                          pub_len);
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_open(&store, store_buf, pub_len),
+                          COSE_OK);
+    CU_ASSERT_EQUAL_FATAL(cose_keystore_find(&store, keys[4].kid, 2, &key),
+                          COSE_OK);
+    CU_ASSERT_PTR_NULL(key.d);
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, psign, len), COSE_OK);
+    cose_sign_signature_iter_init(&vsignature);
+    CU_ASSERT_FATAL(cose_sign_signature_iter(&verify, &vsignature));
+    CU_ASSERT_EQUAL(cose_sign_verify(&verify, &vsignature, &key, ver_buf,
+                                     sizeof(ver_buf)), COSE_OK);
+
+    /* Duplicate key identifiers */
+    keys[6].kid = keys[2].kid;
+    CU_ASSERT_EQUAL(cose_keystore_encode(keys, TEST_KEYGEN_NUM, false,
+                                         store_buf, sizeof(store_buf)),
+                    COSE_ERR_INVALID_PARAM);
+
+    /* Not a keystore */
+    store_buf[0] ^= 0xff;
+    CU_ASSERT_EQUAL(cose_keystore_open(&store, store_buf, pub_len),
+                    COSE_ERR_INVALID_PARAM);
+}
+
+/* Countersign_structure of RFC 9338 for fixed sign1 and sign objects */
+void test_sign17(void)
+{
+    static const uint8_t sign1[] = {
+        0xd2, 0x84, 0x43, 0xa1, 0x01, 0x26,
+        0xa2, 0x04, 0x42, 0x31, 0x31,
+        0x0b, 0x83, 0x43, 0xa1, 0x01, 0x27, 0xa0, 0x42, 0xaa, 0xbb,
+        0x54, 'T', 'h', 'i', 's', ' ', 'i', 's', ' ', 't', 'h', 'e', ' ',
+        'c', 'o', 'n', 't', 'e', 'n', 't', '.',
+        0x44, 0x01, 0x02, 0x03, 0x04,
+    };
+    static const uint8_t sign1_tbs[] = {
+        0x86, 0x72, 'C', 'o', 'u', 'n', 't', 'e', 'r', 'S', 'i', 'g', 'n',
+        'a', 't', 'u', 'r', 'e', 'V', '2',
+        0x43, 0xa1, 0x01, 0x26,
+        0x43, 0xa1, 0x01, 0x27,
+        0x40,
+        0x54, 'T', 'h', 'i', 's', ' ', 'i', 's', ' ', 't', 'h', 'e', ' ',
+        'c', 'o', 'n', 't', 'e', 'n', 't', '.',
+        0x81, 0x44, 0x01, 0x02, 0x03, 0x04,
+    };
+    static const uint8_t sign[] = {
+        0xd8, 0x62, 0x84, 0x43, 0xa1, 0x01, 0x26,
+        0xa1, 0x0b, 0x83, 0x43, 0xa1, 0x01, 0x27, 0xa0, 0x42, 0xaa, 0xbb,
+        0x54, 'T', 'h', 'i', 's', ' ', 'i', 's', ' ', 't', 'h', 'e', ' ',
+        'c', 'o', 'n', 't', 'e', 'n', 't', '.',
+        0x81, 0x83, 0x40, 0xa0, 0x44, 0x01, 0x02, 0x03, 0x04,
+    };
+    static const uint8_t sign_tbs[] = {
+        0x85, 0x70, 'C', 'o', 'u', 'n', 't', 'e', 'r', 'S', 'i', 'g', 'n',
+        'a', 't', 'u', 'r', 'e',
+        0x43, 0xa1, 0x01, 0x26,
+        0x43, 0xa1, 0x01, 0x27,
+        0x40,
+        0x54, 'T', 'h', 'i', 's', ' ', 'i', 's', ' ', 't', 'h', 'e', ' ',
+        'c', 'o', 'n', 't', 'e', 'n', 't', '.',
+    };
+    cose_sign_dec_t verify;
+    cose_signature_dec_t vcs;
+
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, sign1, sizeof(sign1)),
+                          COSE_OK);
+    cose_sign_countersignature_iter_init(&vcs);
+    CU_ASSERT_FATAL(cose_sign_countersignature_iter(&verify, &vcs));
+    CU_ASSERT_EQUAL_FATAL(cose_sign_countersign_tbs(&verify, &vcs, buf,
+                                                    sizeof(buf)),
+                          sizeof(sign1_tbs));
+    CU_ASSERT_EQUAL(memcmp(buf, sign1_tbs, sizeof(sign1_tbs)), 0);
+    CU_ASSERT(sizeof(sign1_tbs) <= COSE_COUNTERSIGN_TBS_SIZE(3, 3, 0, 20, 4));
+
+    CU_ASSERT_EQUAL_FATAL(cose_sign_decode(&verify, sign, sizeof(sign)),
+                          COSE_OK);
+    cose_sign_countersignature_iter_init(&vcs);
+    CU_ASSERT_FATAL(cose_sign_countersignature_iter(&verify, &vcs));
+    CU_ASSERT_EQUAL_FATAL(cose_sign_countersign_tbs(&verify, &vcs, buf,
+                                                    sizeof(buf)),
+                          sizeof(sign_tbs));
+    CU_ASSERT_EQUAL(memcmp(buf, sign_tbs, sizeof(sign_tbs)), 0);
+}
+
 const test_t tests_sign[] = {
     {
         .f = test_sign1,
@@ -535,6 +1409,42 @@ const test_t tests_sign[] = {
         .f = test_sign8,
         .n = "Sign with aad test",
     },
+    {
+        .f = test_sign9,
+        .n = "Sign1 buffer size helpers",
+    },
+    {
+        .f = test_sign10,
+        .n = "Sign with deferred signatures",
+    },
+    {
+        .f = test_sign11,
+        .n = "Validating decoder limits",
+    },
+    {
+        .f = test_sign12,
+        .n = "Append signers to an encoded sign object",
+    },
+    {
+        .f = test_sign13,
+        .n = "Countersign encoded sign objects",
+    },
+    {
+        .f = test_sign14,
+        .n = "Bulk key generation and key set export",
+    },
+    {
+        .f = test_sign15,
+        .n = "Batched verification scheduler",
+    },
+    {
+        .f = test_sign16,
+        .n = "Indexed keystore",
+    },
+    {
+        .f = test_sign17,
+        .n = "Countersign_structure known answer",
+    },
     {
         .f = NULL,
         .n = NULL,
@@ -136,6 +136,7 @@ void test_suit1(void)
     const uint8_t *kid = NULL;
 
     /* First signer */
+    cose_key_init(&signer);
     cose_key_set_keys(&signer, COSE_CURVE, COSE_ALGO, pk_x, pk_y, NULL);
 
     printf("COSE bytestream: \n");
@@ -0,0 +1,645 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Decoder and accessor throughput benchmark.
+ *
+ * A corpus of COSE objects is generated for a sweep of input sizes: number
+ * of signatures and recipients, header map length, payload size and header
+ * nesting depth. Every case measures the time per call of a decoder or
+ * accessor over the sweep and estimates the scaling exponent from the
+ * largest inputs, flagging super-linear behaviour. Results can be written
+ * to a baseline file that later runs compare against.
+ */
+
+#define _GNU_SOURCE
+
+#include "cose.h"
+#include "cose/common.h"
+#include "cose/encrypt.h"
+#include "cose/sign.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nanocbor/nanocbor.h>
+
+#define BENCH_BUF_SIZE      (2U * 1024U * 1024U)
+#define BENCH_POINTS_MAX    24U
+#define BENCH_SIG_SIZE      64U
+#define BENCH_KID           4       /**< Header looked up by the accessors */
+#define BENCH_SUPERLINEAR   1.5     /**< Exponent flagged as super-linear */
+#define BENCH_EXP_SLACK     0.3     /**< Allowed exponent increase */
+
+typedef size_t (*bench_gen_t)(uint8_t *buf, size_t len, size_t n);
+typedef int (*bench_op_t)(const uint8_t *buf, size_t len, size_t n);
+
+typedef struct {
+    const char *name;       /**< Case name, used in the baseline file */
+    const char *desc;       /**< What is swept and measured */
+    bench_gen_t gen;        /**< Corpus generator */
+    bench_op_t op;          /**< Operation under test */
+    size_t first;           /**< First size of the sweep */
+    size_t last;            /**< Last size of the sweep */
+    size_t step;            /**< Multiplier between sizes */
+} bench_case_t;
+
+typedef struct {
+    size_t n;
+    size_t len;
+    double ns;
+} bench_point_t;
+
+typedef struct {
+    char name[32];
+    size_t n;
+    double ns;
+} bench_base_t;
+
+static uint8_t corpus[BENCH_BUF_SIZE];
+static uint8_t payload_filler[BENCH_BUF_SIZE / 2];
+static const uint8_t sig_filler[BENCH_SIG_SIZE];
+static const uint8_t prot_alg[] = { 0xA1, 0x01, 0x27 }; /* {1: -8} */
+static const char kid[] = "bench@example.org";
+static cose_decode_limits_t limits;
+static volatile int sink;
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/* Protected header bstr and unprotected header map with a key ID */
+static void _gen_headers(nanocbor_encoder_t *enc)
+{
+    nanocbor_put_bstr(enc, prot_alg, sizeof(prot_alg));
+    nanocbor_fmt_map(enc, 1);
+    nanocbor_fmt_int(enc, BENCH_KID);
+    nanocbor_put_bstr(enc, (const uint8_t *)kid, sizeof(kid) - 1);
+}
+
+/* COSE_Sign with n signatures */
+static size_t _gen_sigs(uint8_t *buf, size_t len, size_t n)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_SIGN);
+    nanocbor_fmt_array(&enc, 4);
+    _gen_headers(&enc);
+    nanocbor_put_bstr(&enc, sig_filler, 16);
+    nanocbor_fmt_array(&enc, n);
+    for (size_t i = 0; i < n; i++) {
+        nanocbor_fmt_array(&enc, 3);
+        _gen_headers(&enc);
+        nanocbor_put_bstr(&enc, sig_filler, sizeof(sig_filler));
+    }
+    return nanocbor_encoded_len(&enc);
+}
+
+/* COSE_Sign1 with a protected header map of n entries, key ID last */
+static size_t _gen_hdrs(uint8_t *buf, size_t len, size_t n)
+{
+    static uint8_t prot[BENCH_BUF_SIZE / 2];
+    nanocbor_encoder_t enc;
+
+    nanocbor_encoder_init(&enc, prot, sizeof(prot));
+    nanocbor_fmt_map(&enc, n);
+    for (size_t i = 1; i < n; i++) {
+        nanocbor_fmt_int(&enc, -(int64_t)i);
+        nanocbor_fmt_int(&enc, (int64_t)i);
+    }
+    nanocbor_fmt_int(&enc, BENCH_KID);
+    nanocbor_put_bstr(&enc, (const uint8_t *)kid, sizeof(kid) - 1);
+    size_t prot_len = nanocbor_encoded_len(&enc);
+
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_SIGN1);
+    nanocbor_fmt_array(&enc, 4);
+    nanocbor_put_bstr(&enc, prot, prot_len);
+    nanocbor_fmt_map(&enc, 0);
+    nanocbor_put_bstr(&enc, sig_filler, 16);
+    nanocbor_put_bstr(&enc, sig_filler, sizeof(sig_filler));
+    return nanocbor_encoded_len(&enc);
+}
+
+/* COSE_Sign1 with an unprotected header carrying n items of sub-CBOR in
+ * front of the key ID */
+static size_t _gen_subcbor(uint8_t *buf, size_t len, size_t n)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_SIGN1);
+    nanocbor_fmt_array(&enc, 4);
+    nanocbor_put_bstr(&enc, prot_alg, sizeof(prot_alg));
+    nanocbor_fmt_map(&enc, 2);
+    nanocbor_fmt_int(&enc, -1);
+    nanocbor_fmt_array(&enc, n);
+    for (size_t i = 0; i < n; i++) {
+        nanocbor_fmt_map(&enc, 1);
+        nanocbor_fmt_int(&enc, 1);
+        nanocbor_fmt_int(&enc, (int64_t)i);
+    }
+    nanocbor_fmt_int(&enc, BENCH_KID);
+    nanocbor_put_bstr(&enc, (const uint8_t *)kid, sizeof(kid) - 1);
+    nanocbor_put_bstr(&enc, sig_filler, 16);
+    nanocbor_put_bstr(&enc, sig_filler, sizeof(sig_filler));
+    return nanocbor_encoded_len(&enc);
+}
+
+/* COSE_Sign1 with an unprotected header nested n arrays deep */
+static size_t _gen_nested(uint8_t *buf, size_t len, size_t n)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_SIGN1);
+    nanocbor_fmt_array(&enc, 4);
+    nanocbor_put_bstr(&enc, prot_alg, sizeof(prot_alg));
+    nanocbor_fmt_map(&enc, 2);
+    nanocbor_fmt_int(&enc, -1);
+    for (size_t i = 0; i < n; i++) {
+        nanocbor_fmt_array(&enc, 1);
+    }
+    nanocbor_fmt_int(&enc, 0);
+    nanocbor_fmt_int(&enc, BENCH_KID);
+    nanocbor_put_bstr(&enc, (const uint8_t *)kid, sizeof(kid) - 1);
+    nanocbor_put_bstr(&enc, sig_filler, 16);
+    nanocbor_put_bstr(&enc, sig_filler, sizeof(sig_filler));
+    return nanocbor_encoded_len(&enc);
+}
+
+/* COSE_Sign1 with an n byte payload */
+static size_t _gen_payload(uint8_t *buf, size_t len, size_t n)
+{
+    nanocbor_encoder_t enc;
+
+    if (n > sizeof(payload_filler)) {
+        return 0;
+    }
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_SIGN1);
+    nanocbor_fmt_array(&enc, 4);
+    _gen_headers(&enc);
+    nanocbor_put_bstr(&enc, payload_filler, n);
+    nanocbor_put_bstr(&enc, sig_filler, sizeof(sig_filler));
+    return nanocbor_encoded_len(&enc);
+}
+
+/* COSE_Encrypt with n recipients */
+static size_t _gen_recps(uint8_t *buf, size_t len, size_t n)
+{
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, buf, len);
+    nanocbor_fmt_tag(&enc, COSE_ENCRYPT);
+    nanocbor_fmt_array(&enc, 4);
+    _gen_headers(&enc);
+    nanocbor_put_bstr(&enc, sig_filler, 32);
+    nanocbor_fmt_array(&enc, n);
+    for (size_t i = 0; i < n; i++) {
+        nanocbor_fmt_array(&enc, 3);
+        nanocbor_put_bstr(&enc, NULL, 0);
+        nanocbor_fmt_map(&enc, 2);
+        nanocbor_fmt_int(&enc, 1);
+        nanocbor_fmt_int(&enc, COSE_ALGO_DIRECT);
+        nanocbor_fmt_int(&enc, BENCH_KID);
+        nanocbor_put_bstr(&enc, (const uint8_t *)kid, sizeof(kid) - 1);
+        nanocbor_fmt_null(&enc);
+    }
+    return nanocbor_encoded_len(&enc);
+}
+
+static int _op_sign_decode(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    (void)n;
+    return cose_sign_decode(&sign, buf, len);
+}
+
+static int _op_sign_validate(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    (void)n;
+    return cose_sign_decode_validate(&sign, buf, len, &limits);
+}
+
+/* Visit every signature and look up its key ID */
+static int _op_sig_iter(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    cose_signature_dec_t sig;
+    cose_hdr_t hdr;
+    size_t count = 0;
+
+    int res = cose_sign_decode(&sign, buf, len);
+    if (res < 0) {
+        return res;
+    }
+    cose_sign_signature_iter_init(&sig);
+    while (cose_sign_signature_iter(&sign, &sig)) {
+        if (cose_signature_decode_unprotected(&sig, &hdr, BENCH_KID) < 0) {
+            return COSE_ERR_NOT_FOUND;
+        }
+        count++;
+    }
+    return count == n ? COSE_OK : COSE_ERR_INVALID_CBOR;
+}
+
+static int _op_hdr_prot(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    cose_hdr_t hdr;
+    (void)n;
+
+    int res = cose_sign_decode(&sign, buf, len);
+    if (res < 0) {
+        return res;
+    }
+    return cose_sign_decode_protected(&sign, &hdr, BENCH_KID);
+}
+
+static int _op_hdr_unprot(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    cose_hdr_t hdr;
+    (void)n;
+
+    int res = cose_sign_decode(&sign, buf, len);
+    if (res < 0) {
+        return res;
+    }
+    return cose_sign_decode_unprotected(&sign, &hdr, BENCH_KID);
+}
+
+static int _op_payload(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_sign_dec_t sign;
+    const uint8_t *payload = NULL;
+    size_t payload_len = 0;
+
+    int res = cose_sign_decode(&sign, buf, len);
+    if (res < 0) {
+        return res;
+    }
+    cose_sign_decode_payload(&sign, &payload, &payload_len);
+    return payload_len == n ? COSE_OK : COSE_ERR_INVALID_CBOR;
+}
+
+static int _op_recp_iter(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_encrypt_dec_t encrypt;
+    cose_recp_dec_t recp;
+    size_t count = 0;
+
+    int res = cose_encrypt_decode(&encrypt, (uint8_t *)buf, len);
+    if (res < 0) {
+        return res;
+    }
+    cose_recp_decode_init(&recp, NULL, 0);
+    while (cose_encrypt_recp_iter(&encrypt, &recp)) {
+        count++;
+    }
+    return count == n ? COSE_OK : COSE_ERR_INVALID_CBOR;
+}
+
+static int _op_encrypt_validate(const uint8_t *buf, size_t len, size_t n)
+{
+    cose_encrypt_dec_t encrypt;
+    (void)n;
+    return cose_encrypt_decode_validate(&encrypt, (uint8_t *)buf, len,
+                                        &limits);
+}
+
+static const bench_case_t cases[] = {
+    { "sign-decode", "cose_sign_decode, N signatures",
+      _gen_sigs, _op_sign_decode, 1, 1024, 4 },
+    { "sign-validate", "cose_sign_decode_validate, N signatures",
+      _gen_sigs, _op_sign_validate, 1, 1024, 4 },
+    { "sig-iter", "cose_sign_signature_iter over N signatures",
+      _gen_sigs, _op_sig_iter, 1, 1024, 4 },
+    { "hdr-prot", "protected header lookup, N entry map",
+      _gen_hdrs, _op_hdr_prot, 1, 4096, 4 },
+    { "hdr-subcbor", "unprotected lookup behind N sub-CBOR items",
+      _gen_subcbor, _op_hdr_unprot, 1, 4096, 4 },
+    { "hdr-nested", "unprotected lookup behind N nested arrays",
+      _gen_nested, _op_hdr_unprot, 1, 4, 2 },
+    { "payload", "cose_sign_decode_payload, N byte payload",
+      _gen_payload, _op_payload, 64, 1024 * 1024, 16 },
+    { "recp-iter", "cose_encrypt_recp_iter over N recipients",
+      _gen_recps, _op_recp_iter, 1, 1024, 4 },
+    { "encrypt-validate", "cose_encrypt_decode_validate, N recipients",
+      _gen_recps, _op_encrypt_validate, 1, 1024, 4 },
+};
+
+/* Best of three runs, each long enough to cover min_ns */
+static double _measure(bench_op_t op, const uint8_t *buf, size_t len,
+                       size_t n, uint64_t min_ns)
+{
+    double best = 0;
+
+    for (unsigned run = 0; run < 3; run++) {
+        uint64_t iters = 1;
+        uint64_t elapsed = 0;
+        for (;;) {
+            uint64_t start = _now_ns();
+            for (uint64_t i = 0; i < iters; i++) {
+                sink = op(buf, len, n);
+            }
+            elapsed = _now_ns() - start;
+            if (elapsed >= min_ns || iters >= (UINT64_C(1) << 40)) {
+                break;
+            }
+            iters *= 2;
+        }
+        double ns = (double)elapsed / (double)iters;
+        if (run == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+/* Scaling exponent over the upper half of the sweep, where the fixed per
+ * call costs no longer dominate */
+static double _exponent(const bench_point_t *points, size_t num)
+{
+    if (num < 2) {
+        return 0;
+    }
+    const bench_point_t *lo = &points[num / 2 - (num % 2 == 0)];
+    const bench_point_t *hi = &points[num - 1];
+    if (lo->n == hi->n || lo->ns <= 0) {
+        return 0;
+    }
+    return log(hi->ns / lo->ns) / log((double)hi->n / (double)lo->n);
+}
+
+/* Size and cache line footprint of the structs kept per in-flight message */
+static void _print_layout(void)
+{
+    static const struct {
+        const char *name;
+        size_t size;
+    } structs[] = {
+        { "cose_hdr_t", sizeof(cose_hdr_t) },
+        { "cose_signature_t", sizeof(cose_signature_t) },
+        { "cose_recp_t", sizeof(cose_recp_t) },
+        { "cose_sign_dec_t", sizeof(cose_sign_dec_t) },
+        { "cose_encrypt_t", sizeof(cose_encrypt_t) },
+        { "cose_encrypt_dec_t", sizeof(cose_encrypt_dec_t) },
+    };
+    long line = 64;
+
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+    if (sysconf(_SC_LEVEL1_DCACHE_LINESIZE) > 0) {
+        line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    }
+#endif
+#ifdef COSE_COMPACT_LAYOUT
+    printf("layout: compact, %ld byte cache lines\n", line);
+#else
+    printf("layout: default, %ld byte cache lines\n", line);
+#endif
+    for (size_t i = 0; i < sizeof(structs) / sizeof(structs[0]); i++) {
+        size_t size = structs[i].size;
+        printf("  %-20s %5zu bytes %3zu cache lines\n", structs[i].name, size,
+               (size + (size_t)line - 1) / (size_t)line);
+    }
+}
+
+static int _write_corpus(const char *dir, const char *name, size_t n,
+                         const uint8_t *buf, size_t len)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s-%zu.cbor", dir, name, n);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Unable to write %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    size_t res = fwrite(buf, 1, len, f);
+    fclose(f);
+    return res == len ? 0 : -1;
+}
+
+static size_t _load_baseline(const char *path, bench_base_t **out)
+{
+    FILE *f = fopen(path, "r");
+    bench_base_t *base = NULL;
+    size_t num = 0;
+    size_t cap = 0;
+    char line[128];
+
+    if (!f) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        bench_base_t entry;
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%31s %zu %lf", entry.name, &entry.n,
+                   &entry.ns) != 3) {
+            continue;
+        }
+        if (num == cap) {
+            cap = cap ? cap * 2 : 64;
+            bench_base_t *tmp = realloc(base, cap * sizeof(*base));
+            if (!tmp) {
+                break;
+            }
+            base = tmp;
+        }
+        base[num++] = entry;
+    }
+    fclose(f);
+    *out = base;
+    return num;
+}
+
+/* Baseline entry, exponents are stored with size 0 */
+static const bench_base_t *_find_base(const bench_base_t *base, size_t num,
+                                      const char *name, size_t n)
+{
+    for (size_t i = 0; i < num; i++) {
+        if (base[i].n == n && strcmp(base[i].name, name) == 0) {
+            return &base[i];
+        }
+    }
+    return NULL;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] [CASE...]\n"
+            "\n"
+            "  -m MS    minimum measurement time per point (default 20)\n"
+            "  -o DIR   write the generated corpus to DIR\n"
+            "  -w FILE  write the results as baseline to FILE\n"
+            "  -c FILE  compare against the baseline in FILE\n"
+            "  -t PCT   allowed slowdown against the baseline (default 25)\n"
+            "  -l       list the cases\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *corpus_dir = NULL;
+    const char *write_path = NULL;
+    const char *cmp_path = NULL;
+    double threshold = 25;
+    uint64_t min_ns = 20 * 1000000U;
+    bench_base_t *base = NULL;
+    size_t num_base = 0;
+    unsigned regressions = 0;
+    FILE *out = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:o:w:c:t:lh")) != -1) {
+        switch (opt) {
+            case 'm':
+                min_ns = strtoull(optarg, NULL, 0) * 1000000U;
+                break;
+            case 'o':
+                corpus_dir = optarg;
+                break;
+            case 'w':
+                write_path = optarg;
+                break;
+            case 'c':
+                cmp_path = optarg;
+                break;
+            case 't':
+                threshold = strtod(optarg, NULL);
+                break;
+            case 'l':
+                for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+                    printf("%-18s %s\n", cases[i].name, cases[i].desc);
+                }
+                return EXIT_SUCCESS;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    memset(payload_filler, 0xA5, sizeof(payload_filler));
+    /* The harness measures the work, not the limits */
+    cose_decode_limits_init(&limits);
+    limits.items = UINT32_MAX;
+    limits.hdrs = UINT16_MAX;
+    limits.map_size = UINT16_MAX;
+
+    if (cmp_path) {
+        num_base = _load_baseline(cmp_path, &base);
+        if (!num_base) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (write_path) {
+        out = fopen(write_path, "w");
+        if (!out) {
+            fprintf(stderr, "Unable to write %s: %s\n", write_path,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fprintf(out, "# case size ns_per_call, size 0 is the scaling "
+                "exponent\n");
+    }
+
+    _print_layout();
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const bench_case_t *bc = &cases[c];
+        bench_point_t points[BENCH_POINTS_MAX];
+        size_t num = 0;
+
+        if (optind < argc) {
+            bool selected = false;
+            for (int i = optind; i < argc; i++) {
+                selected |= strcmp(argv[i], bc->name) == 0;
+            }
+            if (!selected) {
+                continue;
+            }
+        }
+
+        printf("%s: %s\n", bc->name, bc->desc);
+        for (size_t n = bc->first; n <= bc->last && num < BENCH_POINTS_MAX;
+             n *= bc->step) {
+            size_t len = bc->gen(corpus, sizeof(corpus), n);
+            fflush(stdout);
+            if (len == 0 || len > sizeof(corpus)) {
+                fprintf(stderr, "  %8zu: corpus does not fit\n", n);
+                break;
+            }
+            if (corpus_dir &&
+                    _write_corpus(corpus_dir, bc->name, n, corpus, len) < 0) {
+                return EXIT_FAILURE;
+            }
+            int res = bc->op(corpus, len, n);
+            if (res < 0) {
+                fprintf(stderr, "  %8zu: failed with %d\n", n, res);
+                break;
+            }
+            double ns = _measure(bc->op, corpus, len, n, min_ns);
+            points[num++] = (bench_point_t){ .n = n, .len = len, .ns = ns };
+
+            printf("  N=%-8zu %9zu bytes %12.1f ns %9.3f ns/byte", n, len, ns,
+                   ns / (double)len);
+            const bench_base_t *b = _find_base(base, num_base, bc->name, n);
+            if (b && b->ns > 0) {
+                double delta = 100.0 * (ns - b->ns) / b->ns;
+                printf("  %+6.1f%%", delta);
+                if (delta > threshold) {
+                    printf(" REGRESSION");
+                    regressions++;
+                }
+            }
+            printf("\n");
+            if (out) {
+                fprintf(out, "%s %zu %.1f\n", bc->name, n, ns);
+            }
+        }
+
+        double exp = _exponent(points, num);
+        printf("  scaling O(N^%.2f)%s", exp,
+               exp > BENCH_SUPERLINEAR ? " SUPER-LINEAR" : "");
+        const bench_base_t *b = _find_base(base, num_base, bc->name, 0);
+        if (b) {
+            printf("  baseline O(N^%.2f)", b->ns);
+            if (exp > b->ns + BENCH_EXP_SLACK) {
+                printf(" REGRESSION");
+                regressions++;
+            }
+        }
+        printf("\n");
+        if (out) {
+            fprintf(out, "%s 0 %.2f\n", bc->name, exp);
+        }
+    }
+
+    if (out) {
+        fclose(out);
+    }
+    free(base);
+    if (regressions) {
+        printf("%u regressions against %s\n", regressions, cmp_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
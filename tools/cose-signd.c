@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Local signing daemon
+ *
+ * Holds a private key and signs the requests its clients queue on a shared
+ * memory request ring, see the signd crypto backend. Clients attach the
+ * public key with the same key ID to the ring and sign as usual, for example
+ * with `cose-tool -r`. The daemon polls the ring while requests arrive and
+ * backs off to short sleeps when it is idle.
+ */
+
+#define _GNU_SOURCE
+
+#include "cose.h"
+#include "cose/crypto.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef CRYPTO_SIGND
+#error "cose-signd requires the signd backend, e.g. CRYPTO=\"sodium signd\""
+#endif
+
+#define SIGND_RING_NAME     "/cose-signd"
+#define SIGND_IDLE_POLLS    4096U   /**< Empty polls before sleeping */
+#define SIGND_IDLE_NSEC     50000L  /**< Sleep between polls when idle */
+
+#if defined(HAVE_ALGO_EDDSA)
+#define SIGND_CURVE         COSE_EC_CURVE_ED25519
+#define SIGND_ALGO          COSE_ALGO_EDDSA
+#define SIGND_X_BYTES       COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES
+#define SIGND_Y_BYTES       0U
+#define SIGND_D_BYTES       COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES
+#elif defined(HAVE_ALGO_ECDSA) && defined(HAVE_CURVE_P256)
+#define SIGND_CURVE         COSE_EC_CURVE_P256
+#define SIGND_ALGO          COSE_ALGO_ES256
+#define SIGND_X_BYTES       COSE_CRYPTO_SIGN_P256_PUBLICKEYBYTES
+#define SIGND_Y_BYTES       COSE_CRYPTO_SIGN_P256_PUBLICKEYBYTES
+#define SIGND_D_BYTES       COSE_CRYPTO_SIGN_P256_SECRETKEYBYTES
+#else
+#error No suitable signature algorithm
+#endif
+
+static uint8_t key_x[SIGND_X_BYTES];
+static uint8_t key_y[SIGND_Y_BYTES + 1];
+static uint8_t key_d[SIGND_D_BYTES];
+static uint8_t key_kid[COSE_CRYPTO_SIGND_KID_MAX];
+
+static volatile sig_atomic_t running = 1;
+
+static void _stop(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static int _rng(void *arg, unsigned char *buf, size_t len)
+{
+    (void)arg;
+    while (len) {
+        ssize_t res = getrandom(buf, len, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += res;
+        len -= (size_t)res;
+    }
+    return 0;
+}
+
+static int _load_key(cose_key_t *key, const char *path, const char *kid)
+{
+    uint8_t buf[SIGND_X_BYTES + SIGND_Y_BYTES + SIGND_D_BYTES + 1];
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        fprintf(stderr, "Unable to read key %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if (len != sizeof(buf) - 1) {
+        fprintf(stderr, "Invalid key length in %s, a secret key is required\n",
+                path);
+        return -1;
+    }
+
+    memcpy(key_x, buf, SIGND_X_BYTES);
+    memcpy(key_y, buf + SIGND_X_BYTES, SIGND_Y_BYTES);
+    memcpy(key_d, buf + SIGND_X_BYTES + SIGND_Y_BYTES, SIGND_D_BYTES);
+    explicit_bzero(buf, sizeof(buf));
+
+    cose_key_init(key);
+    cose_key_set_keys(key, SIGND_CURVE, SIGND_ALGO, key_x,
+                      SIGND_Y_BYTES ? key_y : NULL, key_d);
+    if (kid) {
+        size_t kid_len = strlen(kid);
+        if (kid_len > sizeof(key_kid)) {
+            fprintf(stderr, "Key ID too long\n");
+            return -1;
+        }
+        memcpy(key_kid, kid, kid_len);
+        cose_key_set_kid(key, key_kid, kid_len);
+    }
+    return 0;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] -k FILE\n"
+            "\n"
+            "  -k FILE  secret key file as written by cose-tool keygen\n"
+            "  -i KID   key ID clients sign with\n"
+            "  -r NAME  shared memory name of the ring (default %s)\n"
+            "  -f       remove a stale ring left by a previous daemon\n",
+            name, SIGND_RING_NAME);
+}
+
+int main(int argc, char **argv)
+{
+    const char *key_path = NULL;
+    const char *kid = NULL;
+    const char *name = SIGND_RING_NAME;
+    bool force = false;
+    cose_key_t key;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:i:r:fh")) != -1) {
+        switch (opt) {
+            case 'k':
+                key_path = optarg;
+                break;
+            case 'i':
+                kid = optarg;
+                break;
+            case 'r':
+                name = optarg;
+                break;
+            case 'f':
+                force = true;
+                break;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (!key_path) {
+        _usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Keep the key material out of swap */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        fprintf(stderr, "Warning: unable to lock memory: %s\n", strerror(errno));
+    }
+    cose_crypt_set_rng(_rng, NULL);
+    if (_load_key(&key, key_path, kid) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (force) {
+        shm_unlink(name);
+    }
+    cose_signd_ring_t *ring = cose_crypto_signd_open(name, true);
+    if (!ring) {
+        fprintf(stderr, "Unable to create ring %s: %s\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    uint64_t served = 0;
+    unsigned idle = 0;
+    while (running) {
+        size_t num = cose_crypto_signd_serve(ring, &key, 1, NULL);
+        served += num;
+        if (num) {
+            idle = 0;
+        }
+        else if (++idle >= SIGND_IDLE_POLLS) {
+            struct timespec ts = { 0, SIGND_IDLE_NSEC };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    shm_unlink(name);
+    cose_crypto_signd_close(ring);
+    explicit_bzero(key_d, sizeof(key_d));
+    printf("cose-signd: %llu requests served\n", (unsigned long long)served);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,579 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Stack and scratch buffer high-water mark profiler.
+ *
+ * Every public API is run once per algorithm on a separate, painted stack.
+ * The deepest byte that no longer holds the paint pattern gives the stack
+ * high-water mark of the call. Caller supplied scratch buffers are painted
+ * the same way, the highest byte touched gives the exact scratch size the
+ * call needs. Both are measured with two different patterns so a byte
+ * written with the pattern value is not missed.
+ *
+ * The numbers hold for the crypto backends and compiler flags this tool is
+ * built with, the table lists the selected backend per primitive.
+ */
+
+#define _GNU_SOURCE
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/crypto/selectors.h"
+#include "cose/encrypt.h"
+#include "cose/sign.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define PROF_STACK_SIZE     (256U * 1024U)
+#define PROF_SCRATCH_SIZE   (64U * 1024U)
+#define PROF_PAYLOAD_MAX    (16U * 1024U)
+#define PROF_KEY_MAX        COSE_CRYPTO_SIGN_P521_PUBLICKEYBYTES
+#define PROF_SIG_MAX        160U
+#define PROF_NONCE_MAX      16U
+
+static const uint8_t patterns[] = { 0xA5, 0x5A };
+
+typedef struct prof_algo prof_algo_t;
+typedef int (*prof_fn_t)(prof_algo_t *algo, uint8_t *scratch, size_t len);
+
+typedef struct {
+    const char *name;       /**< Public API that is profiled */
+    prof_fn_t fn;           /**< Calls the API once */
+    bool scratch;           /**< The API takes a caller scratch buffer */
+    bool sign;              /**< Signing or AEAD algorithm */
+} prof_api_t;
+
+/* Algorithm under test and the objects prepared for it */
+struct prof_algo {
+    const cose_crypto_algo_t *desc;
+    const char *name;
+    const char *backend;
+    cose_key_t key;
+    uint8_t x[PROF_KEY_MAX];
+    uint8_t y[PROF_KEY_MAX];
+    uint8_t d[PROF_KEY_MAX];
+    uint8_t sig[PROF_SIG_MAX];
+    size_t sig_len;
+    uint8_t msg[PROF_PAYLOAD_MAX + PROF_SIG_MAX];
+    size_t msg_len;
+};
+
+static const struct {
+    cose_algo_t algo;
+    const char *name;
+} algo_names[] = {
+    { COSE_ALGO_EDDSA, "EdDSA" },
+    { COSE_ALGO_ES256, "ES256" },
+    { COSE_ALGO_ES384, "ES384" },
+    { COSE_ALGO_ES512, "ES512" },
+    { COSE_ALGO_CHACHA20POLY1305, "ChaCha20/Poly1305" },
+    { COSE_ALGO_A128GCM, "A128GCM" },
+    { COSE_ALGO_A192GCM, "A192GCM" },
+    { COSE_ALGO_A256GCM, "A256GCM" },
+    { COSE_ALGO_AESCCM_16_64_128, "AES-CCM-16-64-128" },
+    { COSE_ALGO_AESCCM_16_64_256, "AES-CCM-16-64-256" },
+    { COSE_ALGO_AESCCM_64_64_128, "AES-CCM-64-64-128" },
+    { COSE_ALGO_AESCCM_64_64_256, "AES-CCM-64-64-256" },
+    { COSE_ALGO_AESCCM_16_128_128, "AES-CCM-16-128-128" },
+    { COSE_ALGO_AESCCM_16_128_256, "AES-CCM-16-128-256" },
+    { COSE_ALGO_AESCCM_64_128_128, "AES-CCM-64-128-128" },
+    { COSE_ALGO_AESCCM_64_128_256, "AES-CCM-64-128-256" },
+};
+
+static uint8_t stack_area[PROF_STACK_SIZE] __attribute__((aligned(64)));
+static uint8_t scratch_area[PROF_SCRATCH_SIZE + PROF_PAYLOAD_MAX];
+static uint8_t payload[PROF_PAYLOAD_MAX];
+static uint8_t out[PROF_SCRATCH_SIZE + PROF_PAYLOAD_MAX];
+static const uint8_t nonce[PROF_NONCE_MAX];
+static size_t payload_len = 64;
+
+static ucontext_t main_ctx;
+static ucontext_t prof_ctx;
+static struct {
+    prof_fn_t fn;
+    prof_algo_t *algo;
+    uint8_t *scratch;
+    size_t len;
+    int res;
+} call;
+
+static int _rng(void *arg, unsigned char *buf, size_t len)
+{
+    (void)arg;
+    while (len) {
+        ssize_t res = getrandom(buf, len, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += res;
+        len -= (size_t)res;
+    }
+    return 0;
+}
+
+static const char *_backend(const cose_crypto_algo_t *desc)
+{
+    if (desc->algo == COSE_ALGO_EDDSA) {
+#if defined(CRYPTO_OPENSSL_INCLUDE_ED25519)
+        return "openssl";
+#elif defined(CRYPTO_SODIUM_INCLUDE_ED25519)
+        return "sodium";
+#elif defined(CRYPTO_MONOCYPHER_INCLUDE_ED25519)
+        return "monocypher";
+#elif defined(CRYPTO_C25519_INCLUDE_ED25519)
+        return "c25519";
+#elif defined(CRYPTO_HACL_INCLUDE_ED25519)
+        return "hacl";
+#endif
+    }
+    if (desc->algo == COSE_ALGO_CHACHA20POLY1305) {
+#if defined(CRYPTO_CHACHAPOLY_INCLUDE_CHACHAPOLY)
+        return "chachapoly";
+#elif defined(CRYPTO_OPENSSL_INCLUDE_CHACHAPOLY)
+        return "openssl";
+#elif defined(CRYPTO_PSA_INCLUDE_CHACHAPOLY)
+        return "psa";
+#elif defined(CRYPTO_SODIUM_INCLUDE_CHACHAPOLY)
+        return "sodium";
+#elif defined(CRYPTO_MONOCYPHER_INCLUDE_CHACHAPOLY)
+        return "monocypher";
+#elif defined(CRYPTO_MBEDTLS_INCLUDE_CHACHAPOLY)
+        return "mbedtls";
+#elif defined(CRYPTO_HACL_INCLUDE_CHACHAPOLY)
+        return "hacl";
+#endif
+    }
+    if (desc->kty == COSE_KTY_EC2) {
+#if defined(CRYPTO_OPENSSL_INCLUDE_ECDSA)
+        return "openssl";
+#elif defined(CRYPTO_PSA_INCLUDE_ECDSA)
+        return "psa";
+#elif defined(CRYPTO_MBEDTLS_INCLUDE_ECDSA)
+        return "mbedtls";
+#elif defined(CRYPTO_TINYCRYPT_INCLUDE_ECDSA)
+        return "tinycrypt";
+#endif
+    }
+    if (desc->nonce_len == COSE_CRYPTO_AEAD_AES128GCM_NONCEBYTES) {
+#if defined(CRYPTO_AES_INCLUDE_AESGCM)
+        return "aes";
+#elif defined(CRYPTO_OPENSSL_INCLUDE_AESGCM)
+        return "openssl";
+#elif defined(CRYPTO_PSA_INCLUDE_AESGCM)
+        return "psa";
+#elif defined(CRYPTO_MBEDTLS_INCLUDE_AESGCM)
+        return "mbedtls";
+#endif
+    }
+#if defined(CRYPTO_AES_INCLUDE_AESCCM)
+    return "aes";
+#elif defined(CRYPTO_OPENSSL_INCLUDE_AESCCM)
+    return "openssl";
+#elif defined(CRYPTO_PSA_INCLUDE_AESCCM)
+    return "psa";
+#elif defined(CRYPTO_TINYCRYPT_INCLUDE_AESCCM)
+    return "tinycrypt";
+#else
+    return "?";
+#endif
+}
+
+static int _crypto_sign(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    size_t sig_len = 0;
+    (void)scratch;
+    (void)len;
+    return cose_crypto_sign(&algo->key, algo->sig, &sig_len, payload,
+                            payload_len);
+}
+
+static int _crypto_verify(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    (void)scratch;
+    (void)len;
+    return cose_crypto_verify(&algo->key, algo->sig, algo->sig_len, payload,
+                              payload_len);
+}
+
+static int _sign_encode(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    uint8_t *res_buf = NULL;
+
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, payload, payload_len);
+    cose_sign_add_signer(&sign, &signature, &algo->key);
+    COSE_ssize_t res = cose_sign_encode(&sign, scratch, len, &res_buf);
+    return res < 0 ? (int)res : COSE_OK;
+}
+
+static int _sign_decode(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    cose_sign_dec_t sign;
+    (void)scratch;
+    (void)len;
+    return cose_sign_decode_validate(&sign, algo->msg, algo->msg_len, NULL);
+}
+
+static int _sign_verify(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    cose_sign_dec_t sign;
+
+    int res = cose_sign_decode(&sign, algo->msg, algo->msg_len);
+    if (res < 0) {
+        return res;
+    }
+    return cose_sign_verify_first(&sign, &algo->key, scratch, len);
+}
+
+static int _aead_keygen(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    uint8_t key[PROF_KEY_MAX];
+    (void)scratch;
+    (void)len;
+    COSE_ssize_t res = cose_crypto_keygen(key, sizeof(key), algo->desc->algo);
+    return res < 0 ? (int)res : COSE_OK;
+}
+
+static int _aead_encrypt(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    size_t clen = 0;
+    (void)scratch;
+    (void)len;
+    return cose_crypto_aead_encrypt(out, &clen, payload, payload_len, NULL, 0,
+                                    NULL, nonce, algo->d, algo->desc->algo);
+}
+
+static int _aead_decrypt(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    size_t clen = 0;
+    size_t mlen = 0;
+    (void)scratch;
+    (void)len;
+    /* Ciphertext is produced outside of the stack measurement */
+    int res = cose_crypto_aead_encrypt(out, &clen, payload, payload_len,
+                                       NULL, 0, NULL, nonce, algo->d,
+                                       algo->desc->algo);
+    if (res < 0) {
+        return res;
+    }
+    return cose_crypto_aead_decrypt(out + clen, &mlen, out, clen, NULL, 0,
+                                    nonce, algo->d, algo->desc->algo);
+}
+
+static int _encrypt_encode(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    cose_encrypt_t crypt;
+    cose_recp_t recp;
+    uint8_t *res_buf = NULL;
+
+    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, &recp, 1);
+    cose_encrypt_add_recipient(&crypt, &algo->key);
+    cose_encrypt_set_payload(&crypt, payload, payload_len);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    COSE_ssize_t res = cose_encrypt_encode(&crypt, scratch, len, nonce,
+                                           &res_buf);
+    return res < 0 ? (int)res : COSE_OK;
+}
+
+static int _encrypt_decrypt(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    cose_encrypt_dec_t crypt;
+    size_t plain_len = 0;
+
+    int res = cose_encrypt_decode(&crypt, algo->msg, algo->msg_len);
+    if (res < 0) {
+        return res;
+    }
+    return cose_encrypt_decrypt(&crypt, NULL, &algo->key, scratch, len, out,
+                                &plain_len);
+}
+
+static const prof_api_t apis[] = {
+    { "cose_crypto_sign", _crypto_sign, false, true },
+    { "cose_crypto_verify", _crypto_verify, false, true },
+    { "cose_sign_encode", _sign_encode, true, true },
+    { "cose_sign_decode_validate", _sign_decode, false, true },
+    { "cose_sign_verify_first", _sign_verify, true, true },
+    { "cose_crypto_keygen", _aead_keygen, false, false },
+    { "cose_crypto_aead_encrypt", _aead_encrypt, false, false },
+    { "cose_crypto_aead_decrypt", _aead_decrypt, false, false },
+    { "cose_encrypt_encode", _encrypt_encode, true, false },
+    { "cose_encrypt_decrypt", _encrypt_decrypt, true, false },
+};
+
+static int _noop(prof_algo_t *algo, uint8_t *scratch, size_t len)
+{
+    (void)algo;
+    (void)scratch;
+    (void)len;
+    return COSE_OK;
+}
+
+static void _trampoline(void)
+{
+    call.res = call.fn(call.algo, call.scratch, call.len);
+}
+
+/* Run the call on the painted stack, returns the bytes of stack used */
+static size_t _run_painted(prof_fn_t fn, prof_algo_t *algo, uint8_t pattern,
+                           size_t *scratch_used, int *res)
+{
+    memset(stack_area, pattern, sizeof(stack_area));
+    memset(scratch_area, pattern, sizeof(scratch_area));
+
+    call.fn = fn;
+    call.algo = algo;
+    call.scratch = scratch_area;
+    call.len = sizeof(scratch_area);
+
+    getcontext(&prof_ctx);
+    prof_ctx.uc_stack.ss_sp = stack_area;
+    prof_ctx.uc_stack.ss_size = sizeof(stack_area);
+    prof_ctx.uc_link = &main_ctx;
+    makecontext(&prof_ctx, _trampoline, 0);
+    swapcontext(&main_ctx, &prof_ctx);
+    *res = call.res;
+
+    /* Stack grows down from the end of the area */
+    size_t low = 0;
+    while (low < sizeof(stack_area) && stack_area[low] == pattern) {
+        low++;
+    }
+    size_t high = sizeof(scratch_area);
+    while (high > 0 && scratch_area[high - 1] == pattern) {
+        high--;
+    }
+    *scratch_used = high;
+    return sizeof(stack_area) - low;
+}
+
+static size_t _profile(prof_fn_t fn, prof_algo_t *algo, size_t *scratch,
+                       int *res)
+{
+    size_t stack = 0;
+    *scratch = 0;
+    for (size_t i = 0; i < sizeof(patterns); i++) {
+        size_t used = 0;
+        size_t depth = _run_painted(fn, algo, patterns[i], &used, res);
+        if (depth > stack) {
+            stack = depth;
+        }
+        if (used > *scratch) {
+            *scratch = used;
+        }
+    }
+    return stack;
+}
+
+static int _setup_sign(prof_algo_t *algo)
+{
+    cose_curve_t curve = COSE_EC_NONE;
+    switch (algo->desc->algo) {
+        case COSE_ALGO_EDDSA:
+            curve = COSE_EC_CURVE_ED25519;
+            break;
+        case COSE_ALGO_ES256:
+            curve = COSE_EC_CURVE_P256;
+            break;
+        case COSE_ALGO_ES384:
+            curve = COSE_EC_CURVE_P384;
+            break;
+        case COSE_ALGO_ES512:
+            curve = COSE_EC_CURVE_P521;
+            break;
+        default:
+            return COSE_ERR_NOTIMPLEMENTED;
+    }
+    cose_key_init(&algo->key);
+    cose_key_set_keys(&algo->key, curve, algo->desc->algo, algo->x, algo->y,
+                      algo->d);
+#ifdef HAVE_ALGO_EDDSA
+    if (curve == COSE_EC_CURVE_ED25519) {
+        cose_crypto_keypair_ed25519(&algo->key);
+    }
+#endif
+#ifdef HAVE_ALGO_ECDSA
+    if (curve != COSE_EC_CURVE_ED25519) {
+        cose_crypto_keypair_ecdsa(&algo->key, curve);
+    }
+#endif
+
+    int res = cose_crypto_sign(&algo->key, algo->sig, &algo->sig_len,
+                               payload, payload_len);
+    if (res < 0) {
+        return res;
+    }
+
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    uint8_t *res_buf = NULL;
+    cose_sign_init(&sign, 0);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, payload, payload_len);
+    cose_sign_add_signer(&sign, &signature, &algo->key);
+    COSE_ssize_t len = cose_sign_encode(&sign, scratch_area,
+                                        sizeof(scratch_area), &res_buf);
+    if (len < 0 || (size_t)len > sizeof(algo->msg)) {
+        return len < 0 ? (int)len : COSE_ERR_NOMEM;
+    }
+    memcpy(algo->msg, res_buf, (size_t)len);
+    algo->msg_len = (size_t)len;
+    return COSE_OK;
+}
+
+static int _setup_aead(prof_algo_t *algo)
+{
+    COSE_ssize_t res = cose_crypto_keygen(algo->d, sizeof(algo->d),
+                                          algo->desc->algo);
+    if (res < 0) {
+        return (int)res;
+    }
+    cose_key_init(&algo->key);
+    cose_key_set_keys(&algo->key, 0, algo->desc->algo, NULL, NULL, algo->d);
+
+    cose_encrypt_t crypt;
+    cose_recp_t recp;
+    uint8_t *res_buf = NULL;
+    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, &recp, 1);
+    cose_encrypt_add_recipient(&crypt, &algo->key);
+    cose_encrypt_set_payload(&crypt, payload, payload_len);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+    COSE_ssize_t len = cose_encrypt_encode(&crypt, scratch_area,
+                                           sizeof(scratch_area), nonce,
+                                           &res_buf);
+    if (len < 0 || (size_t)len > sizeof(algo->msg)) {
+        return len < 0 ? (int)len : COSE_ERR_NOMEM;
+    }
+    memcpy(algo->msg, res_buf, (size_t)len);
+    algo->msg_len = (size_t)len;
+    return COSE_OK;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "\n"
+            "  -p LEN   payload size in bytes (default 64, max %u)\n"
+            "  -c       comma separated output\n",
+            name, PROF_PAYLOAD_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    static prof_algo_t algos[sizeof(algo_names) / sizeof(algo_names[0])];
+    bool csv = false;
+    size_t max_stack = 0;
+    size_t max_scratch = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:ch")) != -1) {
+        switch (opt) {
+            case 'p':
+                payload_len = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                csv = true;
+                break;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (payload_len > PROF_PAYLOAD_MAX) {
+        _usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    cose_crypt_set_rng(_rng, NULL);
+    memset(payload, 0x42, sizeof(payload));
+
+    /* Paint overhead of the trampoline itself */
+    size_t unused = 0;
+    int res = 0;
+    size_t base = _profile(_noop, NULL, &unused, &res);
+
+    if (csv) {
+        printf("api,algorithm,backend,payload,stack,scratch\n");
+    }
+    else {
+        printf("payload %zu bytes, stack excludes %zu bytes of harness "
+               "overhead\n", payload_len, base);
+        printf("%-26s %-19s %-11s %8s %8s\n", "API", "algorithm", "backend",
+               "stack", "scratch");
+    }
+
+    for (size_t i = 0; i < sizeof(algo_names) / sizeof(algo_names[0]); i++) {
+        prof_algo_t *algo = &algos[i];
+        algo->desc = cose_crypto_algo_get(algo_names[i].algo);
+        algo->name = algo_names[i].name;
+        if (!algo->desc || (!algo->desc->sign && !algo->desc->encrypt)) {
+            continue;
+        }
+        bool sign = algo->desc->cls == COSE_CRYPTO_ALGO_SIGN;
+        algo->backend = _backend(algo->desc);
+        res = sign ? _setup_sign(algo) : _setup_aead(algo);
+        if (res < 0) {
+            fprintf(stderr, "%s: setup failed with %d\n", algo->name, res);
+            continue;
+        }
+
+        for (size_t a = 0; a < sizeof(apis) / sizeof(apis[0]); a++) {
+            const prof_api_t *api = &apis[a];
+            size_t scratch = 0;
+            if (api->sign != sign) {
+                continue;
+            }
+            size_t stack = _profile(api->fn, algo, &scratch, &res);
+            stack = stack > base ? stack - base : 0;
+            if (!api->scratch) {
+                scratch = 0;
+            }
+            if (res < 0) {
+                fprintf(stderr, "%s %s: failed with %d\n", api->name,
+                        algo->name, res);
+                continue;
+            }
+            if (stack > max_stack) {
+                max_stack = stack;
+            }
+            if (scratch > max_scratch) {
+                max_scratch = scratch;
+            }
+            if (csv) {
+                printf("%s,%s,%s,%zu,%zu,%zu\n", api->name, algo->name,
+                       algo->backend, payload_len, stack, scratch);
+            }
+            else {
+                printf("%-26s %-19s %-11s %8zu %8zu\n", api->name,
+                       algo->name, algo->backend, stack, scratch);
+            }
+        }
+    }
+    if (!csv) {
+        printf("largest stack %zu bytes, largest scratch %zu bytes\n",
+               max_stack, max_scratch);
+    }
+    return EXIT_SUCCESS;
+}
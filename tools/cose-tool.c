@@ -0,0 +1,960 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * Command line front end for bulk signing, verification, encryption and
+ * decryption of files with libcose.
+ *
+ * Files are distributed over a pool of worker threads. Every worker claims
+ * the next unprocessed file from a shared counter, so a worker that finishes
+ * a small file early continues with the remaining work instead of idling.
+ * Input files are mapped into memory, the COSE objects are written next to
+ * the input file with a .cose suffix.
+ *
+ * Verification can pick the key per file by the key ID of the signature from
+ * a keystore written by the keyset command. The keystore is mapped read-only
+ * and used in place, so startup does not depend on the number of keys and
+ * concurrent verifiers share the key pages through the page cache.
+ */
+
+#define _GNU_SOURCE
+
+#include "cose.h"
+#include "cose/crypto.h"
+#include "cose/sign.h"
+#include "cose/encrypt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOOL_SUFFIX         ".cose"
+#define TOOL_SUFFIX_PLAIN   ".dec"
+#define TOOL_HDR_SIZE       64U     /**< Upper bound for the fixed headers */
+#define TOOL_KID_MAX        64U
+#define TOOL_SYMKEY_MAX     32U
+#define TOOL_NONCE_MAX      16U
+#define TOOL_MODE_PUBLIC    0644    /**< COSE objects and public keys */
+#define TOOL_MODE_SECRET    0600    /**< Files with private or secret keys */
+
+#if defined(HAVE_ALGO_EDDSA)
+#define TOOL_CURVE          COSE_EC_CURVE_ED25519
+#define TOOL_SIGN_ALGO      COSE_ALGO_EDDSA
+#define TOOL_X_BYTES        COSE_CRYPTO_SIGN_ED25519_PUBLICKEYBYTES
+#define TOOL_Y_BYTES        0U
+#define TOOL_D_BYTES        COSE_CRYPTO_SIGN_ED25519_SECRETKEYBYTES
+#elif defined(HAVE_ALGO_ECDSA) && defined(HAVE_CURVE_P256)
+#define TOOL_CURVE          COSE_EC_CURVE_P256
+#define TOOL_SIGN_ALGO      COSE_ALGO_ES256
+#define TOOL_X_BYTES        COSE_CRYPTO_SIGN_P256_PUBLICKEYBYTES
+#define TOOL_Y_BYTES        COSE_CRYPTO_SIGN_P256_PUBLICKEYBYTES
+#define TOOL_D_BYTES        COSE_CRYPTO_SIGN_P256_SECRETKEYBYTES
+#else
+#error No suitable signature algorithm
+#endif
+
+#if defined(HAVE_ALGO_CHACHA20POLY1305)
+#define TOOL_AEAD_ALGO      COSE_ALGO_CHACHA20POLY1305
+#elif defined(HAVE_ALGO_AES256GCM)
+#define TOOL_AEAD_ALGO      COSE_ALGO_A256GCM
+#elif defined(HAVE_ALGO_AES128GCM)
+#define TOOL_AEAD_ALGO      COSE_ALGO_A128GCM
+#else
+#define TOOL_AEAD_ALGO      COSE_ALGO_NONE
+#endif
+
+typedef enum {
+    TOOL_OP_SIGN,
+    TOOL_OP_VERIFY,
+    TOOL_OP_ENCRYPT,
+    TOOL_OP_DECRYPT,
+} tool_op_t;
+
+typedef struct {
+    const char *path;       /**< Input file */
+    size_t bytes;           /**< Payload bytes processed */
+    uint64_t nsec;          /**< Processing time */
+    int res;                /**< COSE_OK or a negative error */
+    const char *msg;        /**< Failure description */
+} tool_job_t;
+
+typedef struct {
+    tool_op_t op;
+    cose_key_t key;
+    cose_algo_t aead_algo;
+    uint16_t flags;
+    bool signd;             /**< Sign through cose-signd */
+    cose_keystore_t *store; /**< Verify with the key matching the kid */
+    tool_job_t *jobs;
+    size_t num_jobs;
+    atomic_size_t next;     /**< Next unclaimed job */
+} tool_ctx_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    bool mapped;
+} tool_map_t;
+
+static uint8_t key_x[TOOL_X_BYTES];
+static uint8_t key_y[TOOL_Y_BYTES + 1];
+static uint8_t key_d[TOOL_D_BYTES > TOOL_SYMKEY_MAX ? TOOL_D_BYTES : TOOL_SYMKEY_MAX];
+static uint8_t key_kid[TOOL_KID_MAX];
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static int _rng(void *arg, unsigned char *buf, size_t len)
+{
+    (void)arg;
+    while (len) {
+        ssize_t res = getrandom(buf, len, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += res;
+        len -= (size_t)res;
+    }
+    return 0;
+}
+
+static const char *_strerror(int res)
+{
+    switch (res) {
+        case COSE_ERR_NOMEM:
+            return "buffer too small";
+        case COSE_ERR_CRYPTO:
+            return "crypto failure";
+        case COSE_ERR_NOINIT:
+            return "not initialized";
+        case COSE_ERR_INVALID_CBOR:
+            return "invalid CBOR";
+        case COSE_ERR_CBOR_NOTSUP:
+            return "unsupported CBOR";
+        case COSE_ERR_INVALID_PARAM:
+            return "invalid parameter";
+        case COSE_ERR_NOT_FOUND:
+            return "not found";
+        case COSE_ERR_NOTIMPLEMENTED:
+            return "algorithm not implemented";
+        case COSE_ERR_REPLAY:
+            return "replayed message";
+        default:
+            return "unknown error";
+    }
+}
+
+static int _map_file(const char *path, tool_map_t *map)
+{
+    static uint8_t empty[1];
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    map->len = (size_t)st.st_size;
+    map->mapped = map->len > 0;
+    map->data = empty;
+    if (map->mapped) {
+        void *data = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(data, map->len, MADV_SEQUENTIAL);
+        map->data = data;
+    }
+    close(fd);
+    return 0;
+}
+
+static void _unmap_file(tool_map_t *map)
+{
+    if (map->mapped) {
+        munmap(map->data, map->len);
+    }
+}
+
+static int _write_file(const char *path, const uint8_t *buf, size_t len,
+                       mode_t mode)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd < 0) {
+        return -1;
+    }
+    /* An existing file keeps its mode, make sure secrets are not exposed */
+    if (mode == TOOL_MODE_SECRET && fchmod(fd, mode) < 0) {
+        close(fd);
+        return -1;
+    }
+    while (len) {
+        ssize_t res = write(fd, buf, len);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        buf += res;
+        len -= (size_t)res;
+    }
+    return close(fd);
+}
+
+static ssize_t _read_file(const char *path, uint8_t *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t res = read(fd, buf, len);
+    close(fd);
+    return res;
+}
+
+/* Path with the suffix appended, or with the .cose suffix replaced */
+static int _out_path(char *out, size_t len, const char *path,
+                     const char *suffix, bool strip)
+{
+    size_t plen = strlen(path);
+    size_t slen = strlen(TOOL_SUFFIX);
+
+    if (strip) {
+        if (plen <= slen || strcmp(path + plen - slen, TOOL_SUFFIX) != 0) {
+            return -1;
+        }
+        plen -= slen;
+    }
+    int res = snprintf(out, len, "%.*s%s", (int)plen, path, suffix);
+    return (res < 0 || (size_t)res >= len) ? -1 : 0;
+}
+
+static void _job_sign(tool_ctx_t *ctx, tool_job_t *job, const tool_map_t *in)
+{
+    cose_sign_enc_t sign;
+    cose_signature_t signature;
+    char path[PATH_MAX];
+    uint8_t *out = NULL;
+
+    size_t sig_size = cose_crypto_sig_size(&ctx->key);
+    size_t len = COSE_SIGN1_ENCODE_BUFSIZE(TOOL_HDR_SIZE,
+                                           TOOL_HDR_SIZE + ctx->key.kid_len,
+                                           0, in->len, sig_size);
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        job->res = COSE_ERR_NOMEM;
+        return;
+    }
+
+    cose_sign_init(&sign, ctx->flags);
+    cose_signature_init(&signature);
+    cose_sign_set_payload(&sign, in->data, in->len);
+    cose_sign_add_signer(&sign, &signature, &ctx->key);
+
+    COSE_ssize_t res = cose_sign_encode(&sign, buf, len, &out);
+    if (res < 0) {
+        job->res = (int)res;
+    }
+    else if (_out_path(path, sizeof(path), job->path, TOOL_SUFFIX, false) < 0 ||
+             _write_file(path, out, (size_t)res, TOOL_MODE_PUBLIC) < 0) {
+        job->res = COSE_ERR_INVALID_PARAM;
+        job->msg = "unable to write output";
+    }
+    free(buf);
+}
+
+/* Verify the first signature with a key ID found in the keystore */
+static int _verify_keystore(const cose_keystore_t *store, cose_sign_dec_t *sign,
+                            uint8_t *buf, size_t len)
+{
+    cose_signature_dec_t signature;
+    cose_key_t key;
+
+    cose_sign_signature_iter_init(&signature);
+    while (cose_sign_signature_iter(sign, &signature)) {
+        const uint8_t *kid = NULL;
+        COSE_ssize_t kid_len = cose_signature_decode_kid(&signature, &kid);
+        if (kid_len > 0 &&
+                cose_keystore_find(store, kid, (size_t)kid_len, &key) == COSE_OK) {
+            return cose_sign_verify(sign, &signature, &key, buf, len);
+        }
+    }
+    return COSE_ERR_NOT_FOUND;
+}
+
+static void _job_verify(tool_ctx_t *ctx, tool_job_t *job, const tool_map_t *in)
+{
+    cose_sign_dec_t sign;
+    tool_map_t payload = { .mapped = false };
+
+    job->res = cose_sign_decode_validate(&sign, in->data, in->len, NULL);
+    if (job->res != COSE_OK) {
+        return;
+    }
+
+    if (sign.flags & COSE_FLAGS_EXTDATA) {
+        /* Detached payload is the input file without the suffix */
+        char path[PATH_MAX];
+        if (_out_path(path, sizeof(path), job->path, "", true) < 0 ||
+                _map_file(path, &payload) < 0) {
+            job->res = COSE_ERR_INVALID_PARAM;
+            job->msg = "detached payload not found";
+            return;
+        }
+        cose_sign_decode_set_payload(&sign, payload.data, payload.len);
+    }
+    job->bytes = sign.payload_len;
+
+    size_t len = COSE_SIGN1_TBS_SIZE(in->len, 0, sign.payload_len);
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        job->res = COSE_ERR_NOMEM;
+    }
+    else if (ctx->store) {
+        job->res = _verify_keystore(ctx->store, &sign, buf, len);
+    }
+    else {
+        job->res = cose_sign_verify_first(&sign, &ctx->key, buf, len);
+    }
+    free(buf);
+    _unmap_file(&payload);
+}
+
+static void _job_encrypt(tool_ctx_t *ctx, tool_job_t *job, const tool_map_t *in)
+{
+    cose_encrypt_t crypt;
+    cose_recp_t recp;
+    uint8_t nonce[TOOL_NONCE_MAX];
+    char path[PATH_MAX];
+    uint8_t *out = NULL;
+
+    /* Enc_structure, ciphertext and the final object */
+    size_t len = 2 * (in->len + TOOL_HDR_SIZE) + TOOL_HDR_SIZE;
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        job->res = COSE_ERR_NOMEM;
+        return;
+    }
+    if (_rng(NULL, nonce, sizeof(nonce)) < 0) {
+        job->res = COSE_ERR_CRYPTO;
+        job->msg = "no entropy for the nonce";
+        free(buf);
+        return;
+    }
+
+    cose_encrypt_init(&crypt, ctx->flags | COSE_FLAGS_ENCRYPT0);
+    cose_encrypt_set_recipients(&crypt, &recp, 1);
+    cose_encrypt_add_recipient(&crypt, &ctx->key);
+    cose_encrypt_set_payload(&crypt, in->data, in->len);
+    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
+
+    COSE_ssize_t res = cose_encrypt_encode(&crypt, buf, len, nonce, &out);
+    if (res < 0) {
+        job->res = (int)res;
+    }
+    else if (_out_path(path, sizeof(path), job->path, TOOL_SUFFIX, false) < 0 ||
+             _write_file(path, out, (size_t)res, TOOL_MODE_PUBLIC) < 0) {
+        job->res = COSE_ERR_INVALID_PARAM;
+        job->msg = "unable to write output";
+    }
+    free(buf);
+}
+
+static void _job_decrypt(tool_ctx_t *ctx, tool_job_t *job, const tool_map_t *in)
+{
+    cose_encrypt_dec_t crypt;
+    cose_encrypt_aead_t aead;
+    char path[PATH_MAX];
+
+    job->res = cose_encrypt_decode_validate(&crypt, in->data, in->len, NULL);
+    if (job->res != COSE_OK) {
+        return;
+    }
+    job->bytes = crypt.payload_len;
+
+    /* Enc_structure followed by the plaintext */
+    size_t aad_len = in->len + TOOL_HDR_SIZE;
+    size_t len = aad_len + crypt.payload_len;
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        job->res = COSE_ERR_NOMEM;
+        return;
+    }
+    job->res = cose_encrypt_decrypt_prepare(&crypt, NULL, &ctx->key, buf,
+                                            aad_len, &aead);
+    if (job->res == COSE_OK) {
+        size_t plain_len = 0;
+        uint8_t *plain = buf + aead.aad_len;
+        job->res = cose_encrypt_decrypt_aead(&aead, plain, &plain_len);
+        if (job->res != COSE_OK) {
+            job->res = COSE_ERR_CRYPTO;
+        }
+        else if (_out_path(path, sizeof(path), job->path, TOOL_SUFFIX_PLAIN, true) < 0 ||
+                 _write_file(path, plain, plain_len, TOOL_MODE_PUBLIC) < 0) {
+            job->res = COSE_ERR_INVALID_PARAM;
+            job->msg = "unable to write output";
+        }
+    }
+    free(buf);
+}
+
+static void _run_job(tool_ctx_t *ctx, tool_job_t *job)
+{
+    tool_map_t in;
+    uint64_t start = _now_ns();
+
+    if (_map_file(job->path, &in) < 0) {
+        job->res = COSE_ERR_INVALID_PARAM;
+        job->msg = strerror(errno);
+        return;
+    }
+    job->bytes = in.len;
+
+    switch (ctx->op) {
+        case TOOL_OP_SIGN:
+            _job_sign(ctx, job, &in);
+            break;
+        case TOOL_OP_VERIFY:
+            _job_verify(ctx, job, &in);
+            break;
+        case TOOL_OP_ENCRYPT:
+            _job_encrypt(ctx, job, &in);
+            break;
+        case TOOL_OP_DECRYPT:
+            _job_decrypt(ctx, job, &in);
+            break;
+    }
+    _unmap_file(&in);
+    job->nsec = _now_ns() - start;
+}
+
+static void *_worker(void *arg)
+{
+    tool_ctx_t *ctx = arg;
+
+    for (;;) {
+        size_t idx = atomic_fetch_add_explicit(&ctx->next, 1,
+                                               memory_order_relaxed);
+        if (idx >= ctx->num_jobs) {
+            break;
+        }
+        _run_job(ctx, &ctx->jobs[idx]);
+    }
+    return NULL;
+}
+
+static int _load_key(tool_ctx_t *ctx, const char *path, const char *kid)
+{
+    uint8_t buf[TOOL_X_BYTES + TOOL_Y_BYTES + sizeof(key_d)];
+    ssize_t len = _read_file(path, buf, sizeof(buf));
+
+    if (len < 0) {
+        fprintf(stderr, "Unable to read key %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    cose_key_init(&ctx->key);
+    if (ctx->op == TOOL_OP_ENCRYPT || ctx->op == TOOL_OP_DECRYPT) {
+        /* Raw symmetric key */
+        if ((size_t)len > sizeof(key_d)) {
+            fprintf(stderr, "Invalid key length in %s\n", path);
+            return -1;
+        }
+        memcpy(key_d, buf, (size_t)len);
+        cose_key_set_keys(&ctx->key, 0, ctx->aead_algo, NULL, NULL, key_d);
+    }
+    else {
+        /* Public key, optionally followed by the secret key */
+        size_t pub_len = TOOL_X_BYTES + TOOL_Y_BYTES;
+        if ((size_t)len != pub_len && (size_t)len != pub_len + TOOL_D_BYTES) {
+            fprintf(stderr, "Invalid key length in %s\n", path);
+            return -1;
+        }
+        if (ctx->op == TOOL_OP_SIGN && !ctx->signd &&
+                (size_t)len != pub_len + TOOL_D_BYTES) {
+            fprintf(stderr, "Signing requires a secret key\n");
+            return -1;
+        }
+        memcpy(key_x, buf, TOOL_X_BYTES);
+        memcpy(key_y, buf + TOOL_X_BYTES, TOOL_Y_BYTES);
+        memcpy(key_d, buf + pub_len, (size_t)len - pub_len);
+        cose_key_set_keys(&ctx->key, TOOL_CURVE, TOOL_SIGN_ALGO, key_x,
+                          TOOL_Y_BYTES ? key_y : NULL, key_d);
+    }
+
+    if (kid) {
+        size_t kid_len = strlen(kid);
+        if (kid_len > sizeof(key_kid)) {
+            fprintf(stderr, "Key ID too long\n");
+            return -1;
+        }
+        memcpy(key_kid, kid, kid_len);
+        cose_key_set_kid(&ctx->key, key_kid, kid_len);
+    }
+    return 0;
+}
+
+static int _keygen(const char *prefix, cose_algo_t aead_algo)
+{
+    char path[PATH_MAX];
+    uint8_t sym[TOOL_SYMKEY_MAX];
+    cose_key_t key;
+
+    cose_key_init(&key);
+    cose_key_set_keys(&key, TOOL_CURVE, TOOL_SIGN_ALGO, key_x,
+                      TOOL_Y_BYTES ? key_y : NULL, key_d);
+#if defined(HAVE_ALGO_EDDSA)
+    int res = cose_crypto_keypair_ed25519(&key);
+#else
+    int res = cose_crypto_keypair_ecdsa(&key, TOOL_CURVE);
+#endif
+    if (res != COSE_OK) {
+        fprintf(stderr, "Unable to generate a key pair: %s\n", _strerror(res));
+        return -1;
+    }
+
+    uint8_t keypair[TOOL_X_BYTES + TOOL_Y_BYTES + TOOL_D_BYTES];
+    memcpy(keypair, key_x, TOOL_X_BYTES);
+    memcpy(keypair + TOOL_X_BYTES, key_y, TOOL_Y_BYTES);
+    memcpy(keypair + TOOL_X_BYTES + TOOL_Y_BYTES, key_d, TOOL_D_BYTES);
+
+    if (cose_crypto_keygen(sym, sizeof(sym), aead_algo) < 0 &&
+            _rng(NULL, sym, sizeof(sym)) < 0) {
+        fprintf(stderr, "Unable to generate a symmetric key\n");
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s.key", prefix);
+    res = _write_file(path, keypair, sizeof(keypair), TOOL_MODE_SECRET);
+    snprintf(path, sizeof(path), "%s.pub", prefix);
+    res |= _write_file(path, keypair, TOOL_X_BYTES + TOOL_Y_BYTES,
+                       TOOL_MODE_PUBLIC);
+    snprintf(path, sizeof(path), "%s.sym", prefix);
+    res |= _write_file(path, sym, sizeof(sym), TOOL_MODE_SECRET);
+    if (res < 0) {
+        fprintf(stderr, "Unable to write keys: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Executor starting a thread per job, up to a maximum number of threads */
+typedef struct {
+    pthread_t thread;
+    cose_job_fn_t fn;
+    void *arg;
+} tool_spawn_slot_t;
+
+typedef struct {
+    tool_spawn_slot_t slot[COSE_KEY_GEN_JOBS_MAX];
+    size_t num;
+    size_t max;
+} tool_spawn_t;
+
+static void *_spawn_run(void *arg)
+{
+    tool_spawn_slot_t *slot = arg;
+    slot->fn(slot->arg);
+    return NULL;
+}
+
+static int _spawn_submit(void *ctx, cose_job_fn_t fn, void *arg)
+{
+    tool_spawn_t *spawn = ctx;
+    if (spawn->num >= spawn->max || spawn->num >= COSE_KEY_GEN_JOBS_MAX) {
+        return -1;
+    }
+    tool_spawn_slot_t *slot = &spawn->slot[spawn->num];
+    slot->fn = fn;
+    slot->arg = arg;
+    if (pthread_create(&slot->thread, NULL, _spawn_run, slot) != 0) {
+        return -1;
+    }
+    spawn->num++;
+    return 0;
+}
+
+static void _spawn_wait(void *ctx)
+{
+    tool_spawn_t *spawn = ctx;
+    for (size_t i = 0; i < spawn->num; i++) {
+        pthread_join(spawn->slot[i].thread, NULL);
+    }
+    spawn->num = 0;
+}
+
+static int _keyset(const char *prefix, size_t num, long threads)
+{
+    char path[PATH_MAX];
+    tool_spawn_t spawn = { .max = threads > 0 ? (size_t)threads : 1 };
+    cose_executor_t exec = {
+        .submit = _spawn_submit,
+        .wait = _spawn_wait,
+        .ctx = &spawn,
+    };
+    cose_key_gen_t gen = {
+        .crv = TOOL_CURVE,
+        .algo = TOOL_SIGN_ALGO,
+        .kid = COSE_KEY_KID_COUNTER,
+        .kid_len = 4,
+    };
+    size_t size = cose_key_gen_size(&gen);
+    cose_key_t *keys = calloc(num, sizeof(cose_key_t));
+    uint8_t *material = calloc(num, size);
+    uint8_t *out = NULL;
+    int res = -1;
+
+    if (!keys || !material) {
+        goto out;
+    }
+
+    uint64_t start = _now_ns();
+    if (cose_key_generate(&gen, keys, num, material, num * size,
+                          &exec) != COSE_OK) {
+        fprintf(stderr, "Unable to generate keys\n");
+        goto out;
+    }
+    uint64_t elapsed = _now_ns() - start;
+
+    COSE_ssize_t len = cose_keyset_encode(keys, num, true, NULL, 0);
+    if (len < 0 || !(out = malloc((size_t)len))) {
+        goto out;
+    }
+    len = cose_keyset_encode(keys, num, true, out, (size_t)len);
+    snprintf(path, sizeof(path), "%s.keys", prefix);
+    res = len < 0 ? -1 : _write_file(path, out, (size_t)len, TOOL_MODE_SECRET);
+    len = cose_keyset_encode(keys, num, false, out, (size_t)len);
+    snprintf(path, sizeof(path), "%s.pubs", prefix);
+    res |= len < 0 ? -1 : _write_file(path, out, (size_t)len,
+                                      TOOL_MODE_PUBLIC);
+
+    len = cose_keystore_encode(keys, num, false, NULL, 0);
+    free(out);
+    if (len < 0 || !(out = malloc((size_t)len))) {
+        res = -1;
+        goto out;
+    }
+    len = cose_keystore_encode(keys, num, false, out, (size_t)len);
+    snprintf(path, sizeof(path), "%s.kst", prefix);
+    res |= len < 0 ? -1 : _write_file(path, out, (size_t)len,
+                                      TOOL_MODE_PUBLIC);
+    if (res < 0) {
+        fprintf(stderr, "Unable to write key sets: %s\n", strerror(errno));
+    }
+
+    double secs = (double)elapsed / 1e9;
+    printf("keyset: %zu keys in %.3f s (%.1f keys/s)\n", num, secs,
+           secs > 0 ? (double)num / secs : 0.0);
+
+out:
+    if (material) {
+        memset(material, 0, num * size);
+    }
+    free(out);
+    free(material);
+    free(keys);
+    return res;
+}
+
+/* Memory footprint of the structs kept per in-flight message */
+static void _print_layout(void)
+{
+    static const struct {
+        const char *name;
+        size_t size;
+    } structs[] = {
+        { "cose_hdr_t", sizeof(cose_hdr_t) },
+        { "cose_signature_t", sizeof(cose_signature_t) },
+        { "cose_recp_t", sizeof(cose_recp_t) },
+        { "cose_key_t", sizeof(cose_key_t) },
+        { "cose_sign_enc_t", sizeof(cose_sign_enc_t) },
+        { "cose_sign_dec_t", sizeof(cose_sign_dec_t) },
+        { "cose_encrypt_t", sizeof(cose_encrypt_t) },
+        { "cose_encrypt_dec_t", sizeof(cose_encrypt_dec_t) },
+    };
+    long line = 64;
+
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+    if (sysconf(_SC_LEVEL1_DCACHE_LINESIZE) > 0) {
+        line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    }
+#endif
+#ifdef COSE_COMPACT_LAYOUT
+    printf("compact layout, %ld byte cache lines\n", line);
+#else
+    printf("default layout, %ld byte cache lines\n", line);
+#endif
+    for (size_t i = 0; i < sizeof(structs) / sizeof(structs[0]); i++) {
+        size_t size = structs[i].size;
+        printf("  %-20s %5zu bytes %3zu cache lines %8.1f MiB per million\n",
+               structs[i].name, size, (size + (size_t)line - 1) / (size_t)line,
+               (double)size * 1e6 / (1024.0 * 1024.0));
+    }
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] sign|verify|encrypt|decrypt FILE...\n"
+            "       %s [options] keygen PREFIX\n"
+            "       %s [options] keyset PREFIX\n"
+            "\n"
+            "  -k FILE  key file: PREFIX.key for sign, PREFIX.pub for verify,\n"
+            "           PREFIX.sym for encrypt and decrypt\n"
+            "  -i KID   key ID to include in the signature\n"
+            "  -K FILE  verify with the key matching the key ID of the\n"
+            "           signature from a PREFIX.kst keystore\n"
+#ifdef CRYPTO_SIGND
+            "  -r NAME  sign through the cose-signd ring NAME, the key file\n"
+            "           only needs the public key\n"
+#endif
+            "  -a ALG   COSE AEAD algorithm number (default %d)\n"
+            "  -j NUM   number of worker threads (default: online CPUs)\n"
+            "  -n NUM   number of keys in a key set (default 1000)\n"
+            "  -d       detached payload, the signed object does not\n"
+            "           contain the file contents\n"
+            "  -u       untagged COSE objects\n"
+            "  -q       only print failures and the summary\n"
+            "  -s       print the size and cache line footprint of the\n"
+            "           libcose structs, no command required\n",
+            name, name, name, TOOL_AEAD_ALGO);
+}
+
+int main(int argc, char **argv)
+{
+    static tool_ctx_t ctx;
+    const char *key_path = NULL;
+    const char *kid = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long num_keys = 1000;
+    bool quiet = false;
+    bool layout = false;
+    const char *ring_name = NULL;
+    const char *store_path = NULL;
+    tool_map_t store_map = { .mapped = false };
+    cose_keystore_t store;
+    int opt;
+
+    ctx.aead_algo = TOOL_AEAD_ALGO;
+    while ((opt = getopt(argc, argv, "k:K:i:r:a:j:n:duqsh")) != -1) {
+        switch (opt) {
+            case 'k':
+                key_path = optarg;
+                break;
+            case 'K':
+                store_path = optarg;
+                break;
+            case 'i':
+                kid = optarg;
+                break;
+            case 'r':
+                ring_name = optarg;
+                break;
+            case 'a':
+                ctx.aead_algo = (cose_algo_t)strtol(optarg, NULL, 0);
+                break;
+            case 'j':
+                threads = strtol(optarg, NULL, 0);
+                break;
+            case 'n':
+                num_keys = strtol(optarg, NULL, 0);
+                break;
+            case 'd':
+                ctx.flags |= COSE_FLAGS_EXTDATA;
+                break;
+            case 'u':
+                ctx.flags |= COSE_FLAGS_UNTAGGED;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 's':
+                layout = true;
+                break;
+            default:
+                _usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (layout) {
+        _print_layout();
+        if (optind >= argc) {
+            return EXIT_SUCCESS;
+        }
+    }
+    if (optind + 1 >= argc) {
+        _usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    cose_crypt_set_rng(_rng, NULL);
+
+    const char *cmd = argv[optind++];
+    if (strcmp(cmd, "keygen") == 0) {
+        return _keygen(argv[optind], ctx.aead_algo) < 0 ? EXIT_FAILURE
+                                                        : EXIT_SUCCESS;
+    }
+    else if (strcmp(cmd, "keyset") == 0) {
+        if (num_keys < 1) {
+            _usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return _keyset(argv[optind], (size_t)num_keys, threads) < 0
+            ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    else if (strcmp(cmd, "sign") == 0) {
+        ctx.op = TOOL_OP_SIGN;
+    }
+    else if (strcmp(cmd, "verify") == 0) {
+        ctx.op = TOOL_OP_VERIFY;
+    }
+    else if (strcmp(cmd, "encrypt") == 0) {
+        ctx.op = TOOL_OP_ENCRYPT;
+    }
+    else if (strcmp(cmd, "decrypt") == 0) {
+        ctx.op = TOOL_OP_DECRYPT;
+    }
+    else {
+        _usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (store_path && ctx.op == TOOL_OP_VERIFY) {
+        if (_map_file(store_path, &store_map) < 0 ||
+                cose_keystore_open(&store, store_map.data, store_map.len) != COSE_OK) {
+            fprintf(stderr, "Unable to open keystore %s\n", store_path);
+            return EXIT_FAILURE;
+        }
+        /* Lookups touch a few pages of a possibly large file */
+        if (store_map.mapped) {
+            madvise(store_map.data, store_map.len, MADV_RANDOM);
+        }
+        ctx.store = &store;
+    }
+    else if (!key_path) {
+        fprintf(stderr, "No key file given\n");
+        return EXIT_FAILURE;
+    }
+    ctx.signd = ring_name && ctx.op == TOOL_OP_SIGN;
+    if (!ctx.store && _load_key(&ctx, key_path, kid) < 0) {
+        return EXIT_FAILURE;
+    }
+#ifdef CRYPTO_SIGND
+    cose_signd_ring_t *ring = NULL;
+    if (ctx.signd) {
+        ring = cose_crypto_signd_open(ring_name, false);
+        if (!ring) {
+            fprintf(stderr, "Unable to open ring %s: %s\n", ring_name,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+        cose_crypto_signd_attach(&ctx.key, ring);
+    }
+#else
+    if (ctx.signd) {
+        fprintf(stderr, "Built without the signd backend\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    ctx.num_jobs = (size_t)(argc - optind);
+    ctx.jobs = calloc(ctx.num_jobs, sizeof(tool_job_t));
+    if (!ctx.jobs) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < ctx.num_jobs; i++) {
+        ctx.jobs[i].path = argv[optind + (int)i];
+    }
+    atomic_init(&ctx.next, 0);
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > ctx.num_jobs) {
+        threads = (long)ctx.num_jobs;
+    }
+
+    pthread_t *workers = calloc((size_t)threads, sizeof(pthread_t));
+    if (!workers) {
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start = _now_ns();
+    long started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, _worker, &ctx) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        /* Fall back to processing everything in this thread */
+        _worker(&ctx);
+    }
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    uint64_t elapsed = _now_ns() - start;
+
+    size_t failed = 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < ctx.num_jobs; i++) {
+        tool_job_t *job = &ctx.jobs[i];
+        total += job->bytes;
+        if (job->res != COSE_OK) {
+            failed++;
+            printf("FAIL %s: %s\n", job->path,
+                   job->msg ? job->msg : _strerror(job->res));
+        }
+        else if (!quiet) {
+            printf("OK   %s (%zu bytes, %.3f ms)\n", job->path, job->bytes,
+                   (double)job->nsec / 1e6);
+        }
+    }
+
+    double secs = (double)elapsed / 1e9;
+    printf("%s: %zu files, %zu failed, %llu bytes in %.3f s "
+           "(%.1f files/s, %.2f MiB/s) with %ld threads\n",
+           cmd, ctx.num_jobs, failed, (unsigned long long)total, secs,
+           secs > 0 ? (double)ctx.num_jobs / secs : 0.0,
+           secs > 0 ? (double)total / secs / (1024.0 * 1024.0) : 0.0,
+           started ? started : 1);
+
+    free(workers);
+    free(ctx.jobs);
+    _unmap_file(&store_map);
+#ifdef CRYPTO_SIGND
+    if (ring) {
+        cose_crypto_signd_close(ring);
+    }
+#endif
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}